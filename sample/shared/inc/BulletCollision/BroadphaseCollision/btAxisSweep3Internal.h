@@ -29,6 +29,17 @@
 //#define DEBUG_BROADPHASE 1
 #define USE_OVERLAP_TEST_ON_REMOVES 1
 
+///btAxisSweep3StateHeader starts the flat buffer written by btAxisSweep3Internal::saveState
+ATTRIBUTE_ALIGNED16(struct)
+btAxisSweep3StateHeader
+{
+	int m_numSavedHandles;  // handles from m_numSavedHandles on were never allocated and are not saved
+	int m_numHandles;
+	int m_firstFreeHandle;
+	int m_invalidPair;
+	int m_hasRaycastAccelerator;
+};
+
 /// The internal templace class btAxisSweep3Internal implements the sweep and prune broadphase.
 /// It uses quantized integers to represent the begin and end points for each of the 3 axis.
 /// Dont use this class directly, use btAxisSweep3 or bt32BitAxisSweep3 instead.
@@ -78,6 +89,7 @@ protected:
 	Handle* m_pHandles;           // handles pool
 
 	BP_FP_INT_TYPE m_firstFreeHandle;  // free handles list
+	BP_FP_INT_TYPE m_handleHighWater;  // handles from here on are still on the initial free list (i -> i + 1)
 
 	Edge* m_pEdges[3];  // edge arrays for the 3 axes (each array has m_maxHandles * 2 + 2 sentinel entries)
 	void* m_pEdgesRawPtr[3];
@@ -133,6 +145,9 @@ public:
 
 	virtual void resetPool(btDispatcher* dispatcher);
 
+	virtual bool saveState(btAlignedObjectArray<char>& buffer) const;
+	virtual int loadState(const char* data);
+
 	void processAllOverlappingPairs(btOverlapCallback* callback);
 
 	//Broadphase Interface
@@ -143,6 +158,10 @@ public:
 
 	virtual void rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin = btVector3(0, 0, 0), const btVector3& aabbMax = btVector3(0, 0, 0));
 	virtual void aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback);
+	virtual int getRayTestTrees(const btDbvt** trees, int maxTrees) const
+	{
+		return m_raycastAccelerator ? m_raycastAccelerator->getRayTestTrees(trees, maxTrees) : 0;
+	}
 
 	void quantize(BP_FP_INT_TYPE* out, const btVector3& point, int isMax) const;
 	///unQuantize should be conservative: aabbMin/aabbMax should be larger then 'getAabb' result
@@ -373,6 +392,7 @@ btAxisSweep3Internal<BP_FP_INT_TYPE>::btAxisSweep3Internal(const btVector3& worl
 
 	// handle 0 is reserved as the null index, and is also used as the sentinel
 	m_firstFreeHandle = 1;
+	m_handleHighWater = 1;
 	{
 		for (BP_FP_INT_TYPE i = m_firstFreeHandle; i < maxHandles; i++)
 			m_pHandles[i].SetNextFree(static_cast<BP_FP_INT_TYPE>(i + 1));
@@ -461,6 +481,10 @@ BP_FP_INT_TYPE btAxisSweep3Internal<BP_FP_INT_TYPE>::allocHandle()
 	BP_FP_INT_TYPE handle = m_firstFreeHandle;
 	m_firstFreeHandle = getHandle(handle)->GetNextFree();
 	m_numHandles++;
+	if (handle >= m_handleHighWater)
+	{
+		m_handleHighWater = static_cast<BP_FP_INT_TYPE>(handle + 1);
+	}
 
 	return handle;
 }
@@ -581,6 +605,7 @@ void btAxisSweep3Internal<BP_FP_INT_TYPE>::resetPool(btDispatcher* /*dispatcher*
 	if (m_numHandles == 0)
 	{
 		m_firstFreeHandle = 1;
+		m_handleHighWater = 1;
 		{
 			for (BP_FP_INT_TYPE i = m_firstFreeHandle; i < m_maxHandles; i++)
 				m_pHandles[i].SetNextFree(static_cast<BP_FP_INT_TYPE>(i + 1));
@@ -589,6 +614,83 @@ void btAxisSweep3Internal<BP_FP_INT_TYPE>::resetPool(btDispatcher* /*dispatcher*
 	}
 }
 
+template <typename BP_FP_INT_TYPE>
+bool btAxisSweep3Internal<BP_FP_INT_TYPE>::saveState(btAlignedObjectArray<char>& buffer) const
+{
+	// the handles and the edge arrays are flat, so they are copied as they are
+	int numEdges = m_numHandles * 2 + 2;
+	int handleBytes = m_handleHighWater * int(sizeof(Handle));
+	int edgeBytes = (numEdges * int(sizeof(Edge)) + 15) & ~15;
+
+	int offset = buffer.size();
+	buffer.resizeNoInitialize(offset + int(sizeof(btAxisSweep3StateHeader)) + handleBytes + 3 * edgeBytes);
+	char* data = &buffer[offset];
+
+	btAxisSweep3StateHeader* header = (btAxisSweep3StateHeader*)data;
+	header->m_numSavedHandles = m_handleHighWater;
+	header->m_numHandles = m_numHandles;
+	header->m_firstFreeHandle = m_firstFreeHandle;
+	header->m_invalidPair = m_invalidPair;
+	header->m_hasRaycastAccelerator = (m_raycastAccelerator != 0);
+	data += sizeof(btAxisSweep3StateHeader);
+
+	memcpy(data, m_pHandles, handleBytes);
+	data += handleBytes;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		memcpy(data, m_pEdges[axis], numEdges * sizeof(Edge));
+		data += edgeBytes;
+	}
+
+	if (m_raycastAccelerator)
+	{
+		m_raycastAccelerator->saveState(buffer);
+	}
+	return true;
+}
+
+template <typename BP_FP_INT_TYPE>
+int btAxisSweep3Internal<BP_FP_INT_TYPE>::loadState(const char* data)
+{
+	const char* start = data;
+	const btAxisSweep3StateHeader* header = (const btAxisSweep3StateHeader*)data;
+	data += sizeof(btAxisSweep3StateHeader);
+
+	BP_FP_INT_TYPE numSaved = static_cast<BP_FP_INT_TYPE>(header->m_numSavedHandles);
+	int numEdges = header->m_numHandles * 2 + 2;
+	int edgeBytes = (numEdges * int(sizeof(Edge)) + 15) & ~15;
+	btAssert(numSaved <= m_maxHandles);
+
+	// the records are 16 byte aligned, so the saved handles are read in place
+	const Handle* savedHandles = (const Handle*)data;
+	for (BP_FP_INT_TYPE i = 0; i < numSaved; i++)
+	{
+		m_pHandles[i] = savedHandles[i];
+	}
+	data += numSaved * sizeof(Handle);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		memcpy(m_pEdges[axis], data, numEdges * sizeof(Edge));
+		data += edgeBytes;
+	}
+
+	// handles allocated after the save go back to the initial free list
+	for (BP_FP_INT_TYPE i = numSaved; i < m_handleHighWater; i++)
+	{
+		m_pHandles[i].SetNextFree(static_cast<BP_FP_INT_TYPE>(i + 1 < m_maxHandles ? i + 1 : 0));
+	}
+	m_handleHighWater = numSaved;
+	m_numHandles = static_cast<BP_FP_INT_TYPE>(header->m_numHandles);
+	m_firstFreeHandle = static_cast<BP_FP_INT_TYPE>(header->m_firstFreeHandle);
+	m_invalidPair = header->m_invalidPair;
+
+	if (header->m_hasRaycastAccelerator && m_raycastAccelerator)
+	{
+		data += m_raycastAccelerator->loadState(data);
+	}
+	return int(data - start);
+}
+
 //#include <stdio.h>
 
 template <typename BP_FP_INT_TYPE>
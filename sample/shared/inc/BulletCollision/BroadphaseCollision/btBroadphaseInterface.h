@@ -21,6 +21,7 @@ class btDispatcher;
 #include "btBroadphaseProxy.h"
 
 class btOverlappingPairCache;
+struct btDbvt;
 
 struct btBroadphaseAabbCallback
 {
@@ -42,6 +43,7 @@ protected:
 };
 
 #include "LinearMath/btVector3.h"
+#include "LinearMath/btAlignedObjectArray.h"
 
 ///The btBroadphaseInterface class provides an interface to detect aabb-overlapping object pairs.
 ///Some implementations for this broadphase interface include btAxisSweep3, bt32BitAxisSweep3 and btDbvtBroadphase.
@@ -73,6 +75,31 @@ public:
 	///reset broadphase internal structures, to ensure determinism/reproducability
 	virtual void resetPool(btDispatcher* dispatcher) { (void)dispatcher; };
 
+	///getRayTestTrees gives the dynamic aabb trees that rayTest traverses, so batched queries can walk them directly.
+	///It writes at most maxTrees trees and returns their number, 0 if the broadphase does not use btDbvt for ray tests
+	virtual int getRayTestTrees(const btDbvt** trees, int maxTrees) const
+	{
+		(void)trees;
+		(void)maxTrees;
+		return 0;
+	}
+
+	///saveState appends the acceleration structure (but not the overlapping pairs) to a flat buffer, see btDiscreteDynamicsWorld::saveSnapshot.
+	///It returns false if the broadphase does not support snapshots
+	virtual bool saveState(btAlignedObjectArray<char>& buffer) const
+	{
+		(void)buffer;
+		return false;
+	}
+
+	///loadState restores the acceleration structure written by saveState. The broadphase must hold the same proxies as when it was saved.
+	///It returns the number of bytes read, or 0 without changing anything if the state does not fit this broadphase
+	virtual int loadState(const char* data)
+	{
+		(void)data;
+		return 0;
+	}
+
 	virtual void printStats() = 0;
 };
 
@@ -93,6 +93,146 @@ static inline void clear(T& value)
 	value = zerodummy;
 }
 
+//
+// Snapshots
+//
+
+///btDbvtBroadphaseStateHeader starts the flat buffer written by btDbvtBroadphase::saveState,
+///followed by the proxies of each stage list in list order and the nodes of both trees in preorder
+ATTRIBUTE_ALIGNED16(struct)
+btDbvtBroadphaseStateHeader
+{
+	int m_numProxies[btDbvtBroadphase::STAGECOUNT + 1];
+	int m_numNodes[2];
+	int m_lkhd[2];
+	int m_leaves[2];
+	unsigned m_opath[2];
+	int m_stageCurrent;
+	int m_fupdates;
+	int m_dupdates;
+	int m_cupdates;
+	int m_newpairs;
+	int m_fixedleft;
+	unsigned m_updates_call;
+	unsigned m_updates_done;
+	btScalar m_updates_ratio;
+	int m_pid;
+	int m_cid;
+	int m_gid;
+	int m_needcleanup;
+};
+
+ATTRIBUTE_ALIGNED16(struct)
+btDbvtProxyState
+{
+	btVector3 m_aabbMin;
+	btVector3 m_aabbMax;
+	btDbvtProxy* m_proxy;
+};
+
+ATTRIBUTE_ALIGNED16(struct)
+btDbvtNodeState
+{
+	btDbvtVolume m_volume;
+	btDbvtProxy* m_proxy;  // 0 for internal nodes
+};
+
+//
+static void savenodes(const btDbvtNode* root, btDbvtNodeState*& out)
+{
+	// depth first with the first child written first, the same order loadnodes reads
+	btAlignedObjectArray<const btDbvtNode*> stack;
+	stack.reserve(btDbvt::SIMPLE_STACKSIZE);
+	stack.push_back(root);
+	do
+	{
+		const btDbvtNode* node = stack[stack.size() - 1];
+		stack.pop_back();
+		out->m_volume = node->volume;
+		out->m_proxy = node->isleaf() ? (btDbvtProxy*)node->data : 0;
+		++out;
+		if (node->isinternal())
+		{
+			stack.push_back(node->childs[1]);
+			stack.push_back(node->childs[0]);
+		}
+	} while (stack.size() > 0);
+}
+
+//
+static void collectnodes(btDbvtNode* root, btAlignedObjectArray<btDbvtNode*>& nodes)
+{
+	// the nodes are appended to the output and it is walked as the stack
+	int first = nodes.size();
+	nodes.push_back(root);
+	for (int i = first; i < nodes.size(); ++i)
+	{
+		btDbvtNode* node = nodes[i];
+		if (node->isinternal())
+		{
+			nodes.push_back(node->childs[0]);
+			nodes.push_back(node->childs[1]);
+		}
+	}
+}
+
+//
+static btDbvtNode* loadnodes(const btDbvtNodeState*& in, int count, btAlignedObjectArray<btDbvtNode*>& spare)
+{
+	// internal nodes wait on the stack until both children are read
+	btAlignedObjectArray<btDbvtNode*> stack;
+	stack.reserve(btDbvt::SIMPLE_STACKSIZE);
+	btDbvtNode* root = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		btDbvtNode* node;
+		if (spare.size())
+		{
+			node = spare[spare.size() - 1];
+			spare.pop_back();
+		}
+		else
+		{
+			node = new (btAlignedAlloc(sizeof(btDbvtNode), 16)) btDbvtNode();
+		}
+		const btDbvtNodeState& state = *in++;
+		node->volume = state.m_volume;
+		if (stack.size())
+		{
+			btDbvtNode* parent = stack[stack.size() - 1];
+			node->parent = parent;
+			if (parent->childs[0])
+			{
+				parent->childs[1] = node;
+				stack.pop_back();
+			}
+			else
+			{
+				parent->childs[0] = node;
+			}
+		}
+		else
+		{
+			node->parent = 0;
+			root = node;
+		}
+		if (state.m_proxy)
+		{
+			node->childs[1] = 0;
+			node->data = state.m_proxy;
+			state.m_proxy->leaf = node;
+		}
+		else
+		{
+			node->childs[0] = 0;
+			node->childs[1] = 0;
+			stack.push_back(node);
+		}
+	}
+	btAssert(stack.size() == 0);
+	return (root);
+}
+
 //
 // Colliders
 //
@@ -693,6 +833,131 @@ void btDbvtBroadphase::resetPool(btDispatcher* dispatcher)
 	}
 }
 
+//
+bool btDbvtBroadphase::saveState(btAlignedObjectArray<char>& buffer) const
+{
+	int numProxies = 0;
+	int numNodes[2];
+	for (int i = 0; i <= STAGECOUNT; ++i)
+	{
+		numProxies += listcount(m_stageRoots[i]);
+	}
+	for (int i = 0; i < 2; ++i)
+	{
+		numNodes[i] = m_sets[i].m_root ? m_sets[i].m_leaves * 2 - 1 : 0;
+	}
+
+	int offset = buffer.size();
+	buffer.resizeNoInitialize(offset + int(sizeof(btDbvtBroadphaseStateHeader)) + numProxies * int(sizeof(btDbvtProxyState)) + (numNodes[0] + numNodes[1]) * int(sizeof(btDbvtNodeState)));
+	char* data = &buffer[offset];
+
+	btDbvtBroadphaseStateHeader* header = (btDbvtBroadphaseStateHeader*)data;
+	header->m_stageCurrent = m_stageCurrent;
+	header->m_fupdates = m_fupdates;
+	header->m_dupdates = m_dupdates;
+	header->m_cupdates = m_cupdates;
+	header->m_newpairs = m_newpairs;
+	header->m_fixedleft = m_fixedleft;
+	header->m_updates_call = m_updates_call;
+	header->m_updates_done = m_updates_done;
+	header->m_updates_ratio = m_updates_ratio;
+	header->m_pid = m_pid;
+	header->m_cid = m_cid;
+	header->m_gid = m_gid;
+	header->m_needcleanup = m_needcleanup;
+
+	btDbvtProxyState* proxies = (btDbvtProxyState*)(header + 1);
+	for (int i = 0; i <= STAGECOUNT; ++i)
+	{
+		header->m_numProxies[i] = 0;
+		for (btDbvtProxy* proxy = m_stageRoots[i]; proxy; proxy = proxy->links[1])
+		{
+			proxies->m_aabbMin = proxy->m_aabbMin;
+			proxies->m_aabbMax = proxy->m_aabbMax;
+			proxies->m_proxy = proxy;
+			++proxies;
+			++header->m_numProxies[i];
+		}
+	}
+
+	btDbvtNodeState* nodes = (btDbvtNodeState*)proxies;
+	for (int i = 0; i < 2; ++i)
+	{
+		header->m_numNodes[i] = numNodes[i];
+		header->m_lkhd[i] = m_sets[i].m_lkhd;
+		header->m_leaves[i] = m_sets[i].m_leaves;
+		header->m_opath[i] = m_sets[i].m_opath;
+		if (m_sets[i].m_root) savenodes(m_sets[i].m_root, nodes);
+	}
+	btAssert((char*)nodes == &buffer[0] + buffer.size());
+	return true;
+}
+
+//
+int btDbvtBroadphase::loadState(const char* data)
+{
+	const btDbvtBroadphaseStateHeader* header = (const btDbvtBroadphaseStateHeader*)data;
+
+	// relink the stage lists in the saved order
+	const btDbvtProxyState* proxies = (const btDbvtProxyState*)(header + 1);
+	for (int i = 0; i <= STAGECOUNT; ++i)
+	{
+		btDbvtProxy* prev = 0;
+		m_stageRoots[i] = 0;
+		for (int j = 0; j < header->m_numProxies[i]; ++j, ++proxies)
+		{
+			btDbvtProxy* proxy = proxies->m_proxy;
+			proxy->m_aabbMin = proxies->m_aabbMin;
+			proxy->m_aabbMax = proxies->m_aabbMax;
+			proxy->stage = i;
+			proxy->links[0] = prev;
+			proxy->links[1] = 0;
+			if (prev)
+				prev->links[1] = proxy;
+			else
+				m_stageRoots[i] = proxy;
+			prev = proxy;
+		}
+	}
+
+	// rebuild both trees, reusing the current nodes
+	btAlignedObjectArray<btDbvtNode*> spare;
+	spare.reserve((m_sets[0].m_leaves + m_sets[1].m_leaves) * 2 + 2);
+	for (int i = 0; i < 2; ++i)
+	{
+		if (m_sets[i].m_root) collectnodes(m_sets[i].m_root, spare);
+		if (m_sets[i].m_free) spare.push_back(m_sets[i].m_free);
+		m_sets[i].m_free = 0;
+	}
+	const btDbvtNodeState* nodes = (const btDbvtNodeState*)proxies;
+	for (int i = 0; i < 2; ++i)
+	{
+		m_sets[i].m_root = header->m_numNodes[i] ? loadnodes(nodes, header->m_numNodes[i], spare) : 0;
+		m_sets[i].m_lkhd = header->m_lkhd[i];
+		m_sets[i].m_leaves = header->m_leaves[i];
+		m_sets[i].m_opath = header->m_opath[i];
+	}
+	for (int i = 0; i < spare.size(); ++i)
+	{
+		btAlignedFree(spare[i]);
+	}
+
+	m_stageCurrent = header->m_stageCurrent;
+	m_fupdates = header->m_fupdates;
+	m_dupdates = header->m_dupdates;
+	m_cupdates = header->m_cupdates;
+	m_newpairs = header->m_newpairs;
+	m_fixedleft = header->m_fixedleft;
+	m_updates_call = header->m_updates_call;
+	m_updates_done = header->m_updates_done;
+	m_updates_ratio = header->m_updates_ratio;
+	m_pid = header->m_pid;
+	m_cid = header->m_cid;
+	m_gid = header->m_gid;
+	m_needcleanup = header->m_needcleanup != 0;
+	return int((const char*)nodes - data);
+}
+
 //
 void btDbvtBroadphase::printStats()
 {
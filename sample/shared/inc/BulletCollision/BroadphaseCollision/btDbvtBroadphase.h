@@ -112,6 +112,15 @@ struct btDbvtBroadphase : btBroadphaseInterface
 	virtual void setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher);
 	virtual void rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin = btVector3(0, 0, 0), const btVector3& aabbMax = btVector3(0, 0, 0));
 	virtual void aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback);
+	virtual int getRayTestTrees(const btDbvt** trees, int maxTrees) const
+	{
+		int numTrees = 0;
+		for (int i = 0; i < 2 && numTrees < maxTrees; ++i)
+		{
+			trees[numTrees++] = &m_sets[i];
+		}
+		return numTrees;
+	}
 
 	virtual void getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const;
 	virtual void calculateOverlappingPairs(btDispatcher* dispatcher);
@@ -123,6 +132,9 @@ struct btDbvtBroadphase : btBroadphaseInterface
 	///reset broadphase internal structures, to ensure determinism/reproducability
 	virtual void resetPool(btDispatcher* dispatcher);
 
+	virtual bool saveState(btAlignedObjectArray<char>& buffer) const;
+	virtual int loadState(const char* data);
+
 	void performDeferredRemoval(btDispatcher* dispatcher);
 
 	void setVelocityPrediction(btScalar prediction)
@@ -0,0 +1,443 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btHashedGridBroadphase.h"
+#include "LinearMath/btQuickprof.h"
+
+#include <stdio.h>
+
+// the automatic cell size is this many times the mean aabb extent
+static const btScalar btHashedGridCellExtents = 2;
+
+// cell coordinates are clamped to +-this, only their order matters so far away proxies just share cells
+static const btScalar btHashedGridMaxCoord = 1048576;
+
+typedef btSortAndSweepBroadphase::btSortAndSweepTask btHashedGridTask;
+
+///btHashedGridCells maps positions to cell coordinates and cells to hashes.
+///The hash is the linear index of the cell in the box of the proxies wrapped to the table size, so neighboring cells
+///(and the proxies in them once sorted) are close in memory, and a box smaller than the table has no collisions
+struct btHashedGridCells
+{
+	btScalar m_scale;        // 1 / cell size
+	unsigned int m_strideY;  // cells along x
+	unsigned int m_strideZ;  // cells along x times cells along y
+	unsigned int m_mask;     // table size - 1
+
+	SIMD_FORCE_INLINE int coord(btScalar value) const
+	{
+		// truncating a positive number is floor, the rounding of the sum keeps the mapping monotone
+		btScalar c = btMax(-btHashedGridMaxCoord, btMin(value * m_scale, btHashedGridMaxCoord));
+		return int(c + btHashedGridMaxCoord) - int(btHashedGridMaxCoord);
+	}
+	SIMD_FORCE_INLINE unsigned int hash(int x, int y, int z) const
+	{
+		return (unsigned(x) + unsigned(y) * m_strideY + unsigned(z) * m_strideZ) & m_mask;
+	}
+};
+
+//
+// Parallel steps
+//
+
+///copies the aabbs in live order, sums their extents and bounds their centers
+struct btHashedGridAabbBody : public btIParallelForBody
+{
+	btSortAndSweepProxy* const* m_proxies;
+	btVector3* m_aabbs;
+	btHashedGridTask* const* m_tasks;
+	int m_numProxies;
+	int m_numTasks;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int t = iBegin; t < iEnd; ++t)
+		{
+			int begin, end;
+			btHashedGridBroadphase::getTaskRange(t, m_numTasks, m_numProxies, begin, end);
+			btVector3 extent(0, 0, 0);
+			btVector3 centerMin(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT), centerMax(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+			for (int i = begin; i < end; ++i)
+			{
+				const btSortAndSweepProxy* proxy = m_proxies[i];
+				m_aabbs[2 * i] = proxy->m_aabbMin;
+				m_aabbs[2 * i + 1] = proxy->m_aabbMax;
+				extent += proxy->m_aabbMax - proxy->m_aabbMin;
+				btVector3 center = (proxy->m_aabbMin + proxy->m_aabbMax) * btScalar(0.5);
+				centerMin.setMin(center);
+				centerMax.setMax(center);
+			}
+			m_tasks[t]->m_extent = extent;
+			m_tasks[t]->m_centerMin = centerMin;
+			m_tasks[t]->m_centerMax = centerMax;
+		}
+	}
+};
+
+///keys of the hashed cell of the aabb minimum, proxies larger than a cell get the table size so they are sorted last
+struct btHashedGridBinBody : public btIParallelForBody
+{
+	const btVector3* m_aabbs;
+	btSortAndSweepKey* m_keys;
+	btHashedGridTask* const* m_tasks;
+	btHashedGridCells m_cells;
+	btScalar m_cellSize;
+	int m_numProxies;
+	int m_numTasks;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		const btSortAndSweepKey large = btSortAndSweepKey(m_cells.m_mask + 1) << 32;
+		for (int t = iBegin; t < iEnd; ++t)
+		{
+			int begin, end;
+			btHashedGridBroadphase::getTaskRange(t, m_numTasks, m_numProxies, begin, end);
+			int numLarge = 0;
+			btVector3 maxExtent(0, 0, 0);
+			for (int i = begin; i < end; ++i)
+			{
+				const btVector3& aabbMin = m_aabbs[2 * i];
+				btVector3 extent = m_aabbs[2 * i + 1] - aabbMin;
+				if (extent.x() > m_cellSize || extent.y() > m_cellSize || extent.z() > m_cellSize)
+				{
+					m_keys[i] = large | unsigned(i);
+					numLarge++;
+					continue;
+				}
+				unsigned int hash = m_cells.hash(m_cells.coord(aabbMin.x()), m_cells.coord(aabbMin.y()), m_cells.coord(aabbMin.z()));
+				m_keys[i] = (btSortAndSweepKey(hash) << 32) | unsigned(i);
+				maxExtent.setMax(extent);
+			}
+			m_tasks[t]->m_numEntries = numLarge;
+			m_tasks[t]->m_maxExtent = maxExtent;
+		}
+	}
+};
+
+struct btHashedGridClearBody : public btIParallelForBody
+{
+	int* m_buckets;
+	int m_numBuckets;
+	int m_numTasks;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int t = iBegin; t < iEnd; ++t)
+		{
+			int begin, end;
+			btHashedGridBroadphase::getTaskRange(t, m_numTasks, m_numBuckets, begin, end);
+			for (int i = begin; i < end; ++i)
+			{
+				m_buckets[i] = -1;
+			}
+		}
+	}
+};
+
+///copies the proxy data in sorted order and marks where each hash starts
+struct btHashedGridGatherBody : public btIParallelForBody
+{
+	btSortAndSweepProxy* const* m_proxies;
+	const btVector3* m_liveAabbs;
+	const btSortAndSweepKey* m_keys;
+	btVector3* m_aabbs;
+	unsigned int* m_ids;
+	int* m_cellCoords;
+	int* m_buckets;
+	btHashedGridCells m_cells;
+	int m_numProxies;
+	int m_numTasks;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		const unsigned int numBuckets = m_cells.m_mask + 1;
+		for (int t = iBegin; t < iEnd; ++t)
+		{
+			int begin, end;
+			btHashedGridBroadphase::getTaskRange(t, m_numTasks, m_numProxies, begin, end);
+			for (int i = begin; i < end; ++i)
+			{
+				const unsigned int live = unsigned(m_keys[i]);
+				const unsigned int hash = unsigned(m_keys[i] >> 32);
+				const btSortAndSweepProxy* proxy = m_proxies[live];
+				const btVector3& aabbMin = m_liveAabbs[2 * live];
+				m_aabbs[2 * i] = aabbMin;
+				m_aabbs[2 * i + 1] = m_liveAabbs[2 * live + 1];
+				m_ids[3 * i] = proxy->m_uniqueId;
+				m_ids[3 * i + 1] = proxy->m_collisionFilterGroup;
+				m_ids[3 * i + 2] = proxy->m_collisionFilterMask;
+				m_cellCoords[3 * i] = m_cells.coord(aabbMin.x());
+				m_cellCoords[3 * i + 1] = m_cells.coord(aabbMin.y());
+				m_cellCoords[3 * i + 2] = m_cells.coord(aabbMin.z());
+				if (hash < numBuckets && (i == 0 || unsigned(m_keys[i - 1] >> 32) != hash))
+				{
+					m_buckets[hash] = i;
+				}
+			}
+		}
+	}
+};
+
+///tests each binned proxy against the proxies whose cell its aabb can reach, and against the large proxies.
+///A binned proxy B overlapping A has its minimum in [A.min - B.extent, A.max], so the cells from A.min - maxExtent to A.max hold all of them.
+///Both find each other, the pair is kept by the one with the smaller unique id
+struct btHashedGridPairBody : public btIParallelForBody
+{
+	btHashedGridTask* const* m_tasks;
+	const btSortAndSweepKey* m_keys;
+	const btVector3* m_aabbs;
+	const unsigned int* m_ids;
+	const int* m_cellCoords;
+	const int* m_buckets;
+	btHashedGridCells m_cells;
+	btVector3 m_reach;  // largest extent of the binned proxies
+	int m_numBinned;
+	int m_numProxies;
+	int m_numTasks;
+
+	static SIMD_FORCE_INLINE bool overlaps(const btVector3& min0, const btVector3& max0, const btVector3& min1, const btVector3& max1)
+	{
+		return (min0.x() <= max1.x()) & (min1.x() <= max0.x()) & (min0.y() <= max1.y()) & (min1.y() <= max0.y()) &
+			   (min0.z() <= max1.z()) & (min1.z() <= max0.z());
+	}
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int t = iBegin; t < iEnd; ++t)
+		{
+			btAlignedObjectArray<btSortAndSweepKey>& pairs = m_tasks[t]->m_pairs;
+			pairs.resize(0);
+			int begin, end;
+			btHashedGridBroadphase::getTaskRange(t, m_numTasks, m_numBinned, begin, end);
+			for (int i = begin; i < end; ++i)
+			{
+				const btVector3& aabbMin = m_aabbs[2 * i];
+				const btVector3& aabbMax = m_aabbs[2 * i + 1];
+				const unsigned int uid = m_ids[3 * i];
+				const unsigned int group = m_ids[3 * i + 1];
+				const unsigned int mask = m_ids[3 * i + 2];
+
+				const btVector3 reachMin = aabbMin - m_reach;
+				const int lo[3] = {m_cells.coord(reachMin.x()), m_cells.coord(reachMin.y()), m_cells.coord(reachMin.z())};
+				const int hi[3] = {m_cells.coord(aabbMax.x()), m_cells.coord(aabbMax.y()), m_cells.coord(aabbMax.z())};
+				for (int z = lo[2]; z <= hi[2]; ++z)
+				{
+					for (int y = lo[1]; y <= hi[1]; ++y)
+					{
+						// the cells of a row along x have consecutive hashes, so their proxies are one run of the sorted list
+						// (split in two where the hash wraps around)
+						for (int x = lo[0]; x <= hi[0];)
+						{
+							const unsigned int hash = m_cells.hash(x, y, z);
+							const unsigned int count = btMin(unsigned(hi[0] - x + 1), m_cells.m_mask - hash + 1);
+							const int x0 = x;
+							x += int(count);
+
+							int j = -1;
+							for (unsigned int k = 0; k < count && j < 0; ++k)
+							{
+								j = m_buckets[hash + k];
+							}
+							if (j < 0)
+								continue;
+							for (; j < m_numBinned && unsigned(m_keys[j] >> 32) - hash < count; ++j)
+							{
+								const int* cell = &m_cellCoords[3 * j];
+								const unsigned int* ids = &m_ids[3 * j];
+								// other cells with the same hash and proxies found from the other side are skipped
+								if ((cell[0] >= x0) & (cell[0] < x) & (cell[1] == y) & (cell[2] == z) & (ids[0] > uid) &
+									((ids[1] & mask) != 0) & ((group & ids[2]) != 0) &&
+									overlaps(aabbMin, aabbMax, m_aabbs[2 * j], m_aabbs[2 * j + 1]))
+								{
+									pairs.push_back((btSortAndSweepKey(uid) << 32) | ids[0]);
+								}
+							}
+						}
+					}
+				}
+
+				for (int j = m_numBinned; j < m_numProxies; ++j)
+				{
+					const unsigned int* ids = &m_ids[3 * j];
+					if (((ids[1] & mask) != 0) & ((group & ids[2]) != 0) &&
+						overlaps(aabbMin, aabbMax, m_aabbs[2 * j], m_aabbs[2 * j + 1]))
+					{
+						pairs.push_back(uid < ids[0] ? (btSortAndSweepKey(uid) << 32) | ids[0] : (btSortAndSweepKey(ids[0]) << 32) | uid);
+					}
+				}
+			}
+		}
+	}
+};
+
+//
+// btHashedGridBroadphase
+//
+
+btHashedGridBroadphase::btHashedGridBroadphase(btOverlappingPairCache* pairCache, bool disableRaycastAccelerator, btScalar cellSize)
+	: btSortAndSweepBroadphase(pairCache, disableRaycastAccelerator),
+	  m_cellSize(cellSize),
+	  m_lastCellSize(cellSize),
+	  m_numLargeProxies(0)
+{
+}
+
+btHashedGridBroadphase::~btHashedGridBroadphase()
+{
+}
+
+void btHashedGridBroadphase::findOverlappingPairs(btAlignedObjectArray<btSortAndSweepKey>& pairs)
+{
+	BT_PROFILE("hashed grid");
+	const int n = m_liveProxies.size();
+	const int numTasks = getNumTasks(n);
+	int t, numBinned;
+	btHashedGridCells cells;
+	btVector3 reach(0, 0, 0);
+
+	{
+		BT_PROFILE("bin cells");
+		m_liveAabbs.resizeNoInitialize(2 * n);
+
+		btHashedGridAabbBody aabbs;
+		aabbs.m_proxies = &m_liveProxies[0];
+		aabbs.m_aabbs = &m_liveAabbs[0];
+		aabbs.m_tasks = &m_tasks[0];
+		aabbs.m_numProxies = n;
+		aabbs.m_numTasks = numTasks;
+		parallelFor(numTasks, aabbs);
+
+		btVector3 extent(0, 0, 0);
+		btVector3 centerMin(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT), centerMax(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+		for (t = 0; t < numTasks; t++)
+		{
+			extent += m_tasks[t]->m_extent;
+			centerMin.setMin(m_tasks[t]->m_centerMin);
+			centerMax.setMax(m_tasks[t]->m_centerMax);
+		}
+		btScalar cellSize = m_cellSize;
+		if (cellSize <= btScalar(0))
+		{
+			cellSize = btHashedGridCellExtents * extent[extent.maxAxis()] / btScalar(n);
+			if (cellSize <= btScalar(0))
+			{
+				cellSize = btScalar(1);
+			}
+		}
+		m_lastCellSize = cellSize;
+
+		// about two buckets per proxy
+		unsigned int numBuckets = 1;
+		while (numBuckets < unsigned(2 * n))
+		{
+			numBuckets <<= 1;
+		}
+		cells.m_scale = btScalar(1) / cellSize;
+		cells.m_mask = numBuckets - 1;
+		// the minima of the binned proxies lie within half a cell of their centers, one more cell for the neighbors
+		int numCellsX = cells.coord(centerMax.x() + cellSize) - cells.coord(centerMin.x() - cellSize) + 1;
+		int numCellsY = cells.coord(centerMax.y() + cellSize) - cells.coord(centerMin.y() - cellSize) + 1;
+		cells.m_strideY = unsigned(numCellsX);
+		cells.m_strideZ = unsigned(numCellsX) * unsigned(numCellsY);
+
+		m_cellKeys.resizeNoInitialize(n);
+		btHashedGridBinBody bin;
+		bin.m_aabbs = &m_liveAabbs[0];
+		bin.m_keys = &m_cellKeys[0];
+		bin.m_tasks = &m_tasks[0];
+		bin.m_cells = cells;
+		bin.m_cellSize = cellSize;
+		bin.m_numProxies = n;
+		bin.m_numTasks = numTasks;
+		parallelFor(numTasks, bin);
+
+		m_numLargeProxies = 0;
+		for (t = 0; t < numTasks; t++)
+		{
+			m_numLargeProxies += m_tasks[t]->m_numEntries;
+			reach.setMax(m_tasks[t]->m_maxExtent);
+		}
+		numBinned = n - m_numLargeProxies;
+		// a little margin for the rounding of the extents
+		reach *= btScalar(1.001);
+
+		// only the upper half (the hash) needs sorting, the live indices are unique
+		sortKeys(m_cellKeys, 4);
+
+		m_buckets.resizeNoInitialize(int(numBuckets));
+		btHashedGridClearBody clear;
+		clear.m_buckets = &m_buckets[0];
+		clear.m_numBuckets = int(numBuckets);
+		clear.m_numTasks = getNumTasks(int(numBuckets));
+		parallelFor(clear.m_numTasks, clear);
+
+		m_gridAabbs.resizeNoInitialize(2 * n);
+		m_gridIds.resizeNoInitialize(3 * n);
+		m_gridCells.resizeNoInitialize(3 * n);
+		btHashedGridGatherBody gather;
+		gather.m_proxies = &m_liveProxies[0];
+		gather.m_liveAabbs = &m_liveAabbs[0];
+		gather.m_keys = &m_cellKeys[0];
+		gather.m_aabbs = &m_gridAabbs[0];
+		gather.m_ids = &m_gridIds[0];
+		gather.m_cellCoords = &m_gridCells[0];
+		gather.m_buckets = &m_buckets[0];
+		gather.m_cells = cells;
+		gather.m_numProxies = n;
+		gather.m_numTasks = numTasks;
+		parallelFor(numTasks, gather);
+	}
+
+	const int numPairTasks = getNumTasks(numBinned);
+	{
+		BT_PROFILE("find pairs");
+		btHashedGridPairBody find;
+		find.m_tasks = &m_tasks[0];
+		find.m_keys = &m_cellKeys[0];
+		find.m_aabbs = &m_gridAabbs[0];
+		find.m_ids = &m_gridIds[0];
+		find.m_cellCoords = &m_gridCells[0];
+		find.m_buckets = &m_buckets[0];
+		find.m_cells = cells;
+		find.m_reach = reach;
+		find.m_numBinned = numBinned;
+		find.m_numProxies = n;
+		find.m_numTasks = numPairTasks;
+		parallelFor(numPairTasks, find);
+
+		// pairs of two large proxies, there are few of them
+		btAlignedObjectArray<btSortAndSweepKey>& largePairs = m_tasks[numPairTasks - 1]->m_pairs;
+		for (int i = numBinned; i < n; i++)
+		{
+			const unsigned int* ids = &m_gridIds[3 * i];
+			for (int j = i + 1; j < n; j++)
+			{
+				const unsigned int* other = &m_gridIds[3 * j];
+				if (((other[1] & ids[2]) != 0) & ((ids[1] & other[2]) != 0) &&
+					btHashedGridPairBody::overlaps(m_gridAabbs[2 * i], m_gridAabbs[2 * i + 1], m_gridAabbs[2 * j], m_gridAabbs[2 * j + 1]))
+				{
+					largePairs.push_back(ids[0] < other[0] ? (btSortAndSweepKey(ids[0]) << 32) | other[0] : (btSortAndSweepKey(other[0]) << 32) | ids[0]);
+				}
+			}
+		}
+	}
+
+	mergeTaskPairs(numPairTasks, pairs);
+}
+
+void btHashedGridBroadphase::printStats()
+{
+	printf("btHashedGridBroadphase: %d proxies (%d large), %d pairs (+%d -%d), cell size %f\n", m_liveProxies.size(), m_numLargeProxies, getNumOverlappingPairs(), m_numAddedPairs, m_numRemovedPairs, float(m_lastCellSize));
+}
@@ -0,0 +1,69 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_HASHED_GRID_BROADPHASE_H
+#define BT_HASHED_GRID_BROADPHASE_H
+
+#include "btSortAndSweepBroadphase.h"
+
+///btHashedGridBroadphase finds the overlapping pairs with a uniform grid whose cells are hashed into a table. It is meant for
+///many dynamic objects of about the same size (particles, piles of boxes), where btDbvtBroadphase spends its time refitting and rotating trees.
+///Each call bins every proxy into the cell of its aabb minimum, radix sorts the proxies by the hash of that cell and tests each proxy
+///against the proxies of the cells its aabb can reach, at most 3 cells along each axis. Binning and testing run in parallel with btParallelFor.
+///Unless set, the cell size is twice the mean aabb extent of the call. Proxies larger than a cell (ground, walls) are not binned
+///and are tested against all other proxies, so the grid gets slow if the sizes differ a lot (use btSortAndSweepBroadphase or btDbvtBroadphase there).
+///Proxies, the pair cache update ("update pair cache" in the profiler), snapshots and the raycast accelerator are those of btSortAndSweepBroadphase.
+class btHashedGridBroadphase : public btSortAndSweepBroadphase
+{
+protected:
+	btScalar m_cellSize;      // fixed cell size, 0 to choose it in each call
+	btScalar m_lastCellSize;  // cell size of the last call
+	int m_numLargeProxies;    // proxies of the last call that did not fit in a cell
+
+	// hash of the cell (or the table size for large proxies) and live index of each proxy, sorted
+	btAlignedObjectArray<btSortAndSweepKey> m_cellKeys;
+	// first sorted proxy of each hash, -1 if none
+	btAlignedObjectArray<int> m_buckets;
+
+	// aabbs in live order, then the proxy data in sorted order
+	btAlignedObjectArray<btVector3> m_liveAabbs;
+	btAlignedObjectArray<btVector3> m_gridAabbs;
+	btAlignedObjectArray<unsigned int> m_gridIds;  // unique id, group and mask of each sorted proxy
+	btAlignedObjectArray<int> m_gridCells;         // cell coordinates of each sorted proxy
+
+	virtual void findOverlappingPairs(btAlignedObjectArray<btSortAndSweepKey>& pairs);
+
+public:
+	btHashedGridBroadphase(btOverlappingPairCache* pairCache = 0, bool disableRaycastAccelerator = false, btScalar cellSize = btScalar(0));
+	virtual ~btHashedGridBroadphase();
+
+	virtual void printStats();
+
+	///a cell size of 0 chooses twice the mean aabb extent in each call
+	void setCellSize(btScalar cellSize)
+	{
+		m_cellSize = cellSize;
+	}
+	btScalar getCellSize() const
+	{
+		return m_lastCellSize;
+	}
+	int getNumLargeProxies() const
+	{
+		return m_numLargeProxies;
+	}
+};
+
+#endif  //BT_HASHED_GRID_BROADPHASE_H
@@ -0,0 +1,917 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btOpenAddressingPairCache.h"
+#include "btDispatcher.h"
+#include "btCollisionAlgorithm.h"
+#include "LinearMath/btQuickprof.h"
+#include "LinearMath/btThreads.h"
+
+#include <new>
+#include <string.h>
+
+// keys of free slots, a pair key never has them since the first unique id is the smaller one
+static const btOpenAddressingKey btOpenAddressingEmpty = ~0ULL;
+static const btOpenAddressingKey btOpenAddressingRemoved = ~0ULL - 1;
+
+static const int btOpenAddressingMinGroups = 4;
+
+// Keys per task and the maximum number of tasks of one parallel step.
+// The split does not depend on the number of threads, so the pair array does not either.
+static const int btOpenAddressingGrain = 2048;
+static const int btOpenAddressingMaxTasks = 64;
+
+static int btOpenAddressingNumTasks(int n)
+{
+	return btMax(1, btMin(btOpenAddressingMaxTasks, (n + btOpenAddressingGrain - 1) / btOpenAddressingGrain));
+}
+
+static void btOpenAddressingRange(int task, int numTasks, int n, int& begin, int& end)
+{
+	begin = int((long long)n * task / numTasks);
+	end = int((long long)n * (task + 1) / numTasks);
+}
+
+static bool btOpenAddressingIsParallel(int numTasks)
+{
+#if BT_THREADSAFE
+	btITaskScheduler* scheduler = btGetTaskScheduler();
+	return numTasks > 1 && scheduler && scheduler->getNumThreads() > 1;
+#else
+	(void)numTasks;
+	return false;
+#endif  //BT_THREADSAFE
+}
+
+static void btOpenAddressingParallelFor(int numTasks, const btIParallelForBody& body)
+{
+	if (btOpenAddressingIsParallel(numTasks))
+	{
+		btParallelFor(0, numTasks, 1, body);
+		return;
+	}
+	body.forLoop(0, numTasks);
+}
+
+///grows the array geometrically, resizeNoInitialize alone reserves the exact size
+template <typename T>
+static void btOpenAddressingResize(btAlignedObjectArray<T>& array, int size)
+{
+	if (size > array.capacity())
+	{
+		array.reserve(btMax(size, array.capacity() * 2));
+	}
+	array.resizeNoInitialize(size);
+}
+
+static SIMD_FORCE_INLINE int btOpenAddressingHomeGroup(btOpenAddressingKey key, int groupMask)
+{
+	// Fibonacci hashing, the upper bits mix both unique ids
+	return int(unsigned((key * 0x9E3779B97F4A7C15ULL) >> 32) & unsigned(groupMask));
+}
+
+static const int btOpenAddressingLowestBit[16] = {0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0};
+
+///btOpenAddressingProbe compares the 4 slots of a group with a key. Bit i of the result is set if slot i holds the key,
+///bit i of empty if slot i is empty
+static SIMD_FORCE_INLINE int btOpenAddressingProbe(const btOpenAddressingKey* group, btOpenAddressingKey key, int& empty)
+{
+#ifdef BT_USE_SSE
+	// SSE2 has no 64 bit compare: compare 32 bit halves and require both halves of a slot to match
+	const __m128i k = _mm_set_epi32(int(unsigned(key >> 32)), int(unsigned(key)), int(unsigned(key >> 32)), int(unsigned(key)));
+	const __m128i e = _mm_set1_epi32(-1);
+	const __m128i a = _mm_load_si128((const __m128i*)group);
+	const __m128i b = _mm_load_si128((const __m128i*)(group + 2));
+	__m128i ma = _mm_cmpeq_epi32(a, k);
+	__m128i mb = _mm_cmpeq_epi32(b, k);
+	__m128i ea = _mm_cmpeq_epi32(a, e);
+	__m128i eb = _mm_cmpeq_epi32(b, e);
+	ma = _mm_and_si128(ma, _mm_shuffle_epi32(ma, _MM_SHUFFLE(2, 3, 0, 1)));
+	mb = _mm_and_si128(mb, _mm_shuffle_epi32(mb, _MM_SHUFFLE(2, 3, 0, 1)));
+	ea = _mm_and_si128(ea, _mm_shuffle_epi32(ea, _MM_SHUFFLE(2, 3, 0, 1)));
+	eb = _mm_and_si128(eb, _mm_shuffle_epi32(eb, _MM_SHUFFLE(2, 3, 0, 1)));
+	empty = _mm_movemask_pd(_mm_castsi128_pd(ea)) | (_mm_movemask_pd(_mm_castsi128_pd(eb)) << 2);
+	return _mm_movemask_pd(_mm_castsi128_pd(ma)) | (_mm_movemask_pd(_mm_castsi128_pd(mb)) << 2);
+#else
+	empty = 0;
+	int match = 0;
+	for (int i = 0; i < btOpenAddressingPairCache::GROUP_SIZE; i++)
+	{
+		empty |= int(group[i] == btOpenAddressingEmpty) << i;
+		match |= int(group[i] == key) << i;
+	}
+	return match;
+#endif  //BT_USE_SSE
+}
+
+///bit i of the result is set if slot i of the group is empty or removed
+static SIMD_FORCE_INLINE int btOpenAddressingFree(const btOpenAddressingKey* group)
+{
+	int freeSlots = 0;
+	for (int i = 0; i < btOpenAddressingPairCache::GROUP_SIZE; i++)
+	{
+		freeSlots |= int(group[i] >= btOpenAddressingRemoved) << i;
+	}
+	return freeSlots;
+}
+
+///btOpenAddressingTable is the table of a btOpenAddressingPairCache as seen by the parallel steps
+struct btOpenAddressingTable
+{
+	btOpenAddressingGroup* m_groups;
+	int* m_pairSlots;
+	int m_groupMask;
+
+	int& pairIndex(int slot) const
+	{
+		return m_groups[slot / btOpenAddressingPairCache::GROUP_SIZE].m_pairIndices[slot % btOpenAddressingPairCache::GROUP_SIZE];
+	}
+
+	///owner of a group when the groups are split into numOwners ranges with btOpenAddressingRange
+	int getOwner(int group, int numOwners) const
+	{
+		return int(((long long)(group + 1) * numOwners - 1) / (m_groupMask + 1));
+	}
+
+	int find(btOpenAddressingKey key) const
+	{
+		int group = btOpenAddressingHomeGroup(key, m_groupMask);
+		for (;;)
+		{
+			int empty;
+			int match = btOpenAddressingProbe(m_groups[group].m_keys, key, empty);
+			if (match)
+			{
+				return group * btOpenAddressingPairCache::GROUP_SIZE + btOpenAddressingLowestBit[match];
+			}
+			// the table is never full, so every probe ends at an empty slot
+			if (empty)
+			{
+				return -1;
+			}
+			group = (group + 1) & m_groupMask;
+		}
+	}
+
+	///finds the slot of a key like find, or the first free slot on its probe in freeSlot if the key is not in the table
+	int findOrFree(btOpenAddressingKey key, int& freeSlot) const
+	{
+		int group = btOpenAddressingHomeGroup(key, m_groupMask);
+		freeSlot = -1;
+		for (;;)
+		{
+			int empty;
+			int match = btOpenAddressingProbe(m_groups[group].m_keys, key, empty);
+			if (match)
+			{
+				return group * btOpenAddressingPairCache::GROUP_SIZE + btOpenAddressingLowestBit[match];
+			}
+			if (freeSlot < 0)
+			{
+				int freeSlots = btOpenAddressingFree(m_groups[group].m_keys);
+				if (freeSlots)
+				{
+					freeSlot = group * btOpenAddressingPairCache::GROUP_SIZE + btOpenAddressingLowestBit[freeSlots];
+				}
+			}
+			if (empty)
+			{
+				return -1;
+			}
+			group = (group + 1) & m_groupMask;
+		}
+	}
+
+	///puts a key into a free slot, returns 1 if the slot was empty and 0 if it was removed
+	int insertAt(int slot, btOpenAddressingKey key, int pairIndex) const
+	{
+		btOpenAddressingGroup& group = m_groups[slot / btOpenAddressingPairCache::GROUP_SIZE];
+		int i = slot % btOpenAddressingPairCache::GROUP_SIZE;
+		int wasEmpty = group.m_keys[i] == btOpenAddressingEmpty ? 1 : 0;
+		group.m_keys[i] = key;
+		group.m_pairIndices[i] = pairIndex;
+		m_pairSlots[pairIndex] = slot;
+		return wasEmpty;
+	}
+
+	///puts an entry that is not in the table into the first free slot from its home group on and stops before endGroup.
+	///Returns 1 if an empty slot was used, 0 for a removed slot and -1 if the probe reached endGroup
+	int insert(const btOpenAddressingEntry& entry, int endGroup) const
+	{
+		int group = entry.m_group;
+		for (;;)
+		{
+			int freeSlots = btOpenAddressingFree(m_groups[group].m_keys);
+			if (freeSlots)
+			{
+				return insertAt(group * btOpenAddressingPairCache::GROUP_SIZE + btOpenAddressingLowestBit[freeSlots], entry.m_key, entry.m_pairIndex);
+			}
+			group = (group + 1) & m_groupMask;
+			if (group == endGroup)
+			{
+				return -1;
+			}
+		}
+	}
+};
+
+static btOpenAddressingTable btOpenAddressingGetTable(btOpenAddressingGroup* groups, int* pairSlots, int groupMask)
+{
+	btOpenAddressingTable table;
+	table.m_groups = groups;
+	table.m_pairSlots = pairSlots;
+	table.m_groupMask = groupMask;
+	return table;
+}
+
+//
+// Parallel steps
+//
+
+///looks up the pairs of a batch, m_keys gets the key of each new pair or btOpenAddressingEmpty and m_counts the number of new pairs of each task
+struct btOpenAddressingFindNewBody : public btIParallelForBody
+{
+	const btOpenAddressingPairCache* m_cache;
+	btOpenAddressingTable m_table;
+	const btBroadphasePair* m_pairs;
+	int m_numPairs;
+	int m_numTasks;
+	btOpenAddressingKey* m_keys;
+	int* m_counts;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int t = iBegin; t < iEnd; t++)
+		{
+			int begin, end;
+			btOpenAddressingRange(t, m_numTasks, m_numPairs, begin, end);
+			int count = 0;
+			for (int i = begin; i < end; i++)
+			{
+				btBroadphaseProxy* proxy0 = m_pairs[i].m_pProxy0;
+				btBroadphaseProxy* proxy1 = m_pairs[i].m_pProxy1;
+				btOpenAddressingKey key = btOpenAddressingPairCache::getKey(proxy0, proxy1);
+				if (!m_cache->needsBroadphaseCollision(proxy0, proxy1) || m_table.find(key) >= 0)
+				{
+					key = btOpenAddressingEmpty;
+				}
+				else
+				{
+					count++;
+				}
+				m_keys[i] = key;
+			}
+			m_counts[t] = count;
+		}
+	}
+};
+
+///appends the new pairs of a batch at the offsets of their tasks and fills the entries to insert
+struct btOpenAddressingAppendBody : public btIParallelForBody
+{
+	const btBroadphasePair* m_pairs;
+	const btOpenAddressingKey* m_keys;
+	int m_numPairs;
+	int m_numTasks;
+	const int* m_offsets;
+	int m_firstPair;
+	int m_groupMask;
+	btBroadphasePair* m_pairArray;
+	btOpenAddressingEntry* m_entries;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int t = iBegin; t < iEnd; t++)
+		{
+			int begin, end;
+			btOpenAddressingRange(t, m_numTasks, m_numPairs, begin, end);
+			int index = m_firstPair + m_offsets[t];
+			for (int i = begin; i < end; i++)
+			{
+				if (m_keys[i] == btOpenAddressingEmpty)
+					continue;
+				new (&m_pairArray[index]) btBroadphasePair(*m_pairs[i].m_pProxy0, *m_pairs[i].m_pProxy1);
+				btOpenAddressingEntry& entry = m_entries[index - m_firstPair];
+				entry.m_key = m_keys[i];
+				entry.m_pairIndex = index;
+				entry.m_group = btOpenAddressingHomeGroup(m_keys[i], m_groupMask);
+				index++;
+			}
+		}
+	}
+};
+
+///fills the entries of all pairs when the table is rebuilt
+struct btOpenAddressingRehashBody : public btIParallelForBody
+{
+	const btBroadphasePair* m_pairArray;
+	int m_numPairs;
+	int m_numTasks;
+	int m_groupMask;
+	btOpenAddressingEntry* m_entries;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int t = iBegin; t < iEnd; t++)
+		{
+			int begin, end;
+			btOpenAddressingRange(t, m_numTasks, m_numPairs, begin, end);
+			for (int i = begin; i < end; i++)
+			{
+				btOpenAddressingEntry& entry = m_entries[i];
+				entry.m_key = btOpenAddressingPairCache::getKey(m_pairArray[i].m_pProxy0, m_pairArray[i].m_pProxy1);
+				entry.m_pairIndex = i;
+				entry.m_group = btOpenAddressingHomeGroup(entry.m_key, m_groupMask);
+			}
+		}
+	}
+};
+
+///counts the entries of each task by the owner of their home group (pass 0) or scatters them by owner (pass 1)
+struct btOpenAddressingPartitionBody : public btIParallelForBody
+{
+	btOpenAddressingTable m_table;
+	const btOpenAddressingEntry* m_entries;
+	int m_numEntries;
+	int m_numTasks;
+	int m_numOwners;
+	int* m_counts;  // numOwners per task, counts and then offsets
+	btOpenAddressingEntry* m_sorted;
+	int m_pass;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int t = iBegin; t < iEnd; t++)
+		{
+			int begin, end;
+			btOpenAddressingRange(t, m_numTasks, m_numEntries, begin, end);
+			int* counts = &m_counts[t * m_numOwners];
+			int i;
+			if (m_pass == 0)
+			{
+				for (i = 0; i < m_numOwners; i++)
+					counts[i] = 0;
+				for (i = begin; i < end; i++)
+					counts[m_table.getOwner(m_entries[i].m_group, m_numOwners)]++;
+			}
+			else
+			{
+				for (i = begin; i < end; i++)
+					m_sorted[counts[m_table.getOwner(m_entries[i].m_group, m_numOwners)]++] = m_entries[i];
+			}
+		}
+	}
+};
+
+///each owner inserts the entries of its groups without leaving them. Entries that would leave them are moved to the front of
+///the range of the owner and inserted on the calling thread afterwards
+struct btOpenAddressingInsertBody : public btIParallelForBody
+{
+	btOpenAddressingTable m_table;
+	btOpenAddressingEntry* m_sorted;
+	int m_numOwners;
+	const int* m_ownerBegin;  // numOwners + 1
+	int* m_numSpills;
+	int* m_numEmptyUsed;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		int numGroups = m_table.m_groupMask + 1;
+		for (int owner = iBegin; owner < iEnd; owner++)
+		{
+			int groupBegin, groupEnd;
+			btOpenAddressingRange(owner, m_numOwners, numGroups, groupBegin, groupEnd);
+			int endGroup = groupEnd & m_table.m_groupMask;
+			int numSpills = 0;
+			int numEmptyUsed = 0;
+			for (int i = m_ownerBegin[owner]; i < m_ownerBegin[owner + 1]; i++)
+			{
+				int result = m_table.insert(m_sorted[i], endGroup);
+				if (result < 0)
+				{
+					m_sorted[m_ownerBegin[owner] + numSpills++] = m_sorted[i];
+				}
+				else
+				{
+					numEmptyUsed += result;
+				}
+			}
+			m_numSpills[owner] = numSpills;
+			m_numEmptyUsed[owner] = numEmptyUsed;
+		}
+	}
+};
+
+///looks up the slots of the pairs of a batch, -1 for pairs that are not in the cache
+struct btOpenAddressingFindBody : public btIParallelForBody
+{
+	btOpenAddressingTable m_table;
+	const btBroadphasePair* m_pairs;
+	int m_numPairs;
+	int m_numTasks;
+	int* m_slots;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int t = iBegin; t < iEnd; t++)
+		{
+			int begin, end;
+			btOpenAddressingRange(t, m_numTasks, m_numPairs, begin, end);
+			for (int i = begin; i < end; i++)
+			{
+				m_slots[i] = m_table.find(btOpenAddressingPairCache::getKey(m_pairs[i].m_pProxy0, m_pairs[i].m_pProxy1));
+			}
+		}
+	}
+};
+
+///moves the kept pairs at the end of the array into the holes left by removed pairs
+struct btOpenAddressingMoveBody : public btIParallelForBody
+{
+	btOpenAddressingTable m_table;
+	btBroadphasePair* m_pairArray;
+	const int* m_holes;
+	const int* m_kept;
+	int m_numMoves;
+	int m_numTasks;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int t = iBegin; t < iEnd; t++)
+		{
+			int begin, end;
+			btOpenAddressingRange(t, m_numTasks, m_numMoves, begin, end);
+			for (int i = begin; i < end; i++)
+			{
+				int hole = m_holes[i];
+				int from = m_kept[i];
+				m_pairArray[hole] = m_pairArray[from];
+				int slot = m_table.m_pairSlots[from];
+				m_table.m_pairSlots[hole] = slot;
+				m_table.pairIndex(slot) = hole;
+			}
+		}
+	}
+};
+
+//
+// btOpenAddressingPairCache
+//
+
+btOpenAddressingPairCache::btOpenAddressingPairCache()
+	: m_groups(0),
+	  m_groupMask(-1),
+	  m_numUsedSlots(0),
+	  m_overlapFilterCallback(0),
+	  m_ghostPairCallback(0)
+{
+	growTable(0);
+}
+
+btOpenAddressingPairCache::~btOpenAddressingPairCache()
+{
+	btAlignedFree(m_groups);
+}
+
+int btOpenAddressingPairCache::findSlot(btOpenAddressingKey key) const
+{
+	btOpenAddressingTable table = btOpenAddressingGetTable(m_groups, 0, m_groupMask);
+	return table.find(key);
+}
+
+void btOpenAddressingPairCache::growTable(int numPairs)
+{
+	BT_PROFILE("btOpenAddressingPairCache::growTable");
+
+	// at most a third of the slots are used after growing, a half before growing again
+	int numGroups = btOpenAddressingMinGroups;
+	while (numGroups * GROUP_SIZE < 3 * numPairs)
+	{
+		numGroups *= 2;
+	}
+	if (numGroups != m_groupMask + 1)
+	{
+		btAlignedFree(m_groups);
+		m_groups = (btOpenAddressingGroup*)btAlignedAlloc(sizeof(btOpenAddressingGroup) * numGroups, 64);
+	}
+	memset(m_groups, 0xff, sizeof(btOpenAddressingGroup) * numGroups);  // btOpenAddressingEmpty
+	m_groupMask = numGroups - 1;
+	m_numUsedSlots = 0;
+
+	int numEntries = m_overlappingPairArray.size();
+	if (!numEntries)
+		return;
+
+	btOpenAddressingResize(m_batchEntries, numEntries);
+	btOpenAddressingRehashBody rehash;
+	rehash.m_pairArray = &m_overlappingPairArray[0];
+	rehash.m_numPairs = numEntries;
+	rehash.m_numTasks = btOpenAddressingNumTasks(numEntries);
+	rehash.m_groupMask = m_groupMask;
+	rehash.m_entries = &m_batchEntries[0];
+	btOpenAddressingParallelFor(rehash.m_numTasks, rehash);
+
+	insertEntries(numEntries);
+}
+
+void btOpenAddressingPairCache::insertEntries(int numEntries)
+{
+	btOpenAddressingTable table = btOpenAddressingGetTable(m_groups, &m_pairSlots[0], m_groupMask);
+
+	int numTasks = btOpenAddressingNumTasks(numEntries);
+	int numOwners = btMin(numTasks, m_groupMask + 1);
+	int i;
+	if (!btOpenAddressingIsParallel(numOwners))
+	{
+		for (i = 0; i < numEntries; i++)
+		{
+			m_numUsedSlots += table.insert(m_batchEntries[i], m_batchEntries[i].m_group);
+		}
+		return;
+	}
+
+	// split the groups into one range per owner and sort the entries by the owner of their home group
+	btOpenAddressingResize(m_taskCounts, numTasks * numOwners + 3 * numOwners + 1);
+	int* counts = &m_taskCounts[0];
+	int* ownerBegin = counts + numTasks * numOwners;
+	int* numSpills = ownerBegin + numOwners + 1;
+	int* numEmptyUsed = numSpills + numOwners;
+	btOpenAddressingResize(m_sortedEntries, numEntries);
+
+	btOpenAddressingPartitionBody partition;
+	partition.m_table = table;
+	partition.m_entries = &m_batchEntries[0];
+	partition.m_numEntries = numEntries;
+	partition.m_numTasks = numTasks;
+	partition.m_numOwners = numOwners;
+	partition.m_counts = counts;
+	partition.m_sorted = &m_sortedEntries[0];
+	partition.m_pass = 0;
+	btOpenAddressingParallelFor(numTasks, partition);
+
+	int sum = 0;
+	for (int owner = 0; owner < numOwners; owner++)
+	{
+		ownerBegin[owner] = sum;
+		for (int t = 0; t < numTasks; t++)
+		{
+			int count = counts[t * numOwners + owner];
+			counts[t * numOwners + owner] = sum;
+			sum += count;
+		}
+	}
+	ownerBegin[numOwners] = sum;
+
+	partition.m_pass = 1;
+	btOpenAddressingParallelFor(numTasks, partition);
+
+	btOpenAddressingInsertBody insert;
+	insert.m_table = table;
+	insert.m_sorted = &m_sortedEntries[0];
+	insert.m_numOwners = numOwners;
+	insert.m_ownerBegin = ownerBegin;
+	insert.m_numSpills = numSpills;
+	insert.m_numEmptyUsed = numEmptyUsed;
+	btOpenAddressingParallelFor(numOwners, insert);
+
+	// entries whose probe left the groups of their owner
+	for (int owner = 0; owner < numOwners; owner++)
+	{
+		m_numUsedSlots += numEmptyUsed[owner];
+		for (i = 0; i < numSpills[owner]; i++)
+		{
+			const btOpenAddressingEntry& entry = m_sortedEntries[ownerBegin[owner] + i];
+			m_numUsedSlots += table.insert(entry, entry.m_group);
+		}
+	}
+}
+
+void btOpenAddressingPairCache::eraseSlot(int slot)
+{
+	// a probe only passes a group that was full when its key was inserted, and a group that has been full never gets an empty slot
+	// again until the table is rebuilt. So a slot can be emptied if its group has an empty slot, otherwise it is marked as removed
+	int empty;
+	btOpenAddressingGroup& group = m_groups[slot / GROUP_SIZE];
+	btOpenAddressingProbe(group.m_keys, btOpenAddressingEmpty, empty);
+	if (empty)
+	{
+		group.m_keys[slot % GROUP_SIZE] = btOpenAddressingEmpty;
+		m_numUsedSlots--;
+	}
+	else
+	{
+		group.m_keys[slot % GROUP_SIZE] = btOpenAddressingRemoved;
+	}
+}
+
+btBroadphasePair* btOpenAddressingPairCache::internalAddPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1)
+{
+	int index = m_overlappingPairArray.size();
+	if ((m_numUsedSlots + 1) * 2 > getNumSlots())
+	{
+		growTable(index + 1);
+	}
+
+	btOpenAddressingKey key = getKey(proxy0, proxy1);
+	btOpenAddressingTable table = btOpenAddressingGetTable(m_groups, 0, m_groupMask);
+	int freeSlot;
+	int slot = table.findOrFree(key, freeSlot);
+	if (slot >= 0)
+	{
+		return &m_overlappingPairArray[getSlotPair(slot)];
+	}
+
+	void* mem = &m_overlappingPairArray.expandNonInitializing();
+	m_pairSlots.expandNonInitializing();
+
+	//this is where we add an actual pair, so also call the 'ghost'
+	if (m_ghostPairCallback)
+		m_ghostPairCallback->addOverlappingPair(proxy0, proxy1);
+
+	btBroadphasePair* pair = new (mem) btBroadphasePair(*proxy0, *proxy1);
+	table.m_pairSlots = &m_pairSlots[0];
+	m_numUsedSlots += table.insertAt(freeSlot, key, index);
+	return pair;
+}
+
+void* btOpenAddressingPairCache::removeOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1, btDispatcher* dispatcher)
+{
+	int slot = findSlot(getKey(proxy0, proxy1));
+	if (slot < 0)
+	{
+		return 0;
+	}
+
+	int index = getSlotPair(slot);
+	btBroadphasePair& pair = m_overlappingPairArray[index];
+	cleanOverlappingPair(pair, dispatcher);
+	void* userData = pair.m_internalInfo1;
+
+	if (m_ghostPairCallback)
+		m_ghostPairCallback->removeOverlappingPair(pair.m_pProxy0, pair.m_pProxy1, dispatcher);
+
+	eraseSlot(slot);
+
+	// move the last pair into the hole
+	int last = m_overlappingPairArray.size() - 1;
+	if (index != last)
+	{
+		m_overlappingPairArray[index] = m_overlappingPairArray[last];
+		m_pairSlots[index] = m_pairSlots[last];
+		getSlotPair(m_pairSlots[index]) = index;
+	}
+	m_overlappingPairArray.pop_back();
+	m_pairSlots.pop_back();
+	return userData;
+}
+
+void btOpenAddressingPairCache::addOverlappingPairs(const btBroadphasePair* pairs, int numPairs)
+{
+	BT_PROFILE("btOpenAddressingPairCache::addOverlappingPairs");
+	if (numPairs <= 0)
+		return;
+
+	int firstPair = m_overlappingPairArray.size();
+	if ((m_numUsedSlots + numPairs) * 2 > getNumSlots())
+	{
+		growTable(firstPair + numPairs);
+	}
+
+	int numTasks = btOpenAddressingNumTasks(numPairs);
+	if (m_overlapFilterCallback || !btOpenAddressingIsParallel(numTasks))
+	{
+		// one probe finds the pair or the slot for it. The filter callback of the application may not be thread safe
+		btOpenAddressingTable table = btOpenAddressingGetTable(m_groups, 0, m_groupMask);
+		for (int i = 0; i < numPairs; i++)
+		{
+			btBroadphaseProxy* proxy0 = pairs[i].m_pProxy0;
+			btBroadphaseProxy* proxy1 = pairs[i].m_pProxy1;
+			if (!needsBroadphaseCollision(proxy0, proxy1))
+				continue;
+			btOpenAddressingKey key = getKey(proxy0, proxy1);
+			int freeSlot;
+			if (table.findOrFree(key, freeSlot) >= 0)
+				continue;
+
+			int index = m_overlappingPairArray.size();
+			new (&m_overlappingPairArray.expandNonInitializing()) btBroadphasePair(*proxy0, *proxy1);
+			m_pairSlots.expandNonInitializing();
+			table.m_pairSlots = &m_pairSlots[0];
+			m_numUsedSlots += table.insertAt(freeSlot, key, index);
+		}
+	}
+	else
+	{
+		btOpenAddressingResize(m_batchKeys, numPairs);
+		btOpenAddressingResize(m_taskCounts, numTasks);
+
+		btOpenAddressingFindNewBody find;
+		find.m_cache = this;
+		find.m_table = btOpenAddressingGetTable(m_groups, 0, m_groupMask);
+		find.m_pairs = pairs;
+		find.m_numPairs = numPairs;
+		find.m_numTasks = numTasks;
+		find.m_keys = &m_batchKeys[0];
+		find.m_counts = &m_taskCounts[0];
+		btOpenAddressingParallelFor(numTasks, find);
+
+		int numNew = 0;
+		for (int t = 0; t < numTasks; t++)
+		{
+			int count = m_taskCounts[t];
+			m_taskCounts[t] = numNew;
+			numNew += count;
+		}
+		if (!numNew)
+			return;
+
+		btOpenAddressingResize(m_overlappingPairArray, firstPair + numNew);
+		btOpenAddressingResize(m_pairSlots, firstPair + numNew);
+		btOpenAddressingResize(m_batchEntries, numNew);
+
+		btOpenAddressingAppendBody append;
+		append.m_pairs = pairs;
+		append.m_keys = &m_batchKeys[0];
+		append.m_numPairs = numPairs;
+		append.m_numTasks = numTasks;
+		append.m_offsets = &m_taskCounts[0];
+		append.m_firstPair = firstPair;
+		append.m_groupMask = m_groupMask;
+		append.m_pairArray = &m_overlappingPairArray[0];
+		append.m_entries = &m_batchEntries[0];
+		btOpenAddressingParallelFor(numTasks, append);
+
+		insertEntries(numNew);
+	}
+
+	if (m_ghostPairCallback)
+	{
+		for (int i = firstPair; i < m_overlappingPairArray.size(); i++)
+		{
+			m_ghostPairCallback->addOverlappingPair(m_overlappingPairArray[i].m_pProxy0, m_overlappingPairArray[i].m_pProxy1);
+		}
+	}
+}
+
+void btOpenAddressingPairCache::removeOverlappingPairs(const btBroadphasePair* pairs, int numPairs, btDispatcher* dispatcher)
+{
+	BT_PROFILE("btOpenAddressingPairCache::removeOverlappingPairs");
+	if (numPairs <= 0 || !m_overlappingPairArray.size())
+		return;
+
+	btOpenAddressingResize(m_batchSlots, numPairs);
+
+	// the lookups run in parallel, or in the loop below with a single thread
+	int numTasks = btOpenAddressingNumTasks(numPairs);
+	bool parallel = btOpenAddressingIsParallel(numTasks);
+	if (parallel)
+	{
+		btOpenAddressingFindBody find;
+		find.m_table = btOpenAddressingGetTable(m_groups, 0, m_groupMask);
+		find.m_pairs = pairs;
+		find.m_numPairs = numPairs;
+		find.m_numTasks = numTasks;
+		find.m_slots = &m_batchSlots[0];
+		btOpenAddressingParallelFor(numTasks, find);
+	}
+
+	// collision algorithms and the ghost pair callback are not thread safe, the removed pair indices replace the slots
+	int numRemoved = 0;
+	int i;
+	for (i = 0; i < numPairs; i++)
+	{
+		int slot = parallel ? m_batchSlots[i] : findSlot(getKey(pairs[i].m_pProxy0, pairs[i].m_pProxy1));
+		// a pair can only be removed once
+		if (slot < 0 || getSlotKey(slot) >= btOpenAddressingRemoved)
+			continue;
+
+		int index = getSlotPair(slot);
+		btBroadphasePair& pair = m_overlappingPairArray[index];
+		cleanOverlappingPair(pair, dispatcher);
+		if (m_ghostPairCallback)
+			m_ghostPairCallback->removeOverlappingPair(pair.m_pProxy0, pair.m_pProxy1, dispatcher);
+
+		eraseSlot(slot);
+		m_pairSlots[index] = -1;
+		m_batchSlots[numRemoved++] = index;
+	}
+	if (!numRemoved)
+		return;
+
+	// the holes below the new size, in the order of the batch, are filled with the kept pairs above it, in the order of the array
+	int newSize = m_overlappingPairArray.size() - numRemoved;
+	int numMoves = 0;
+	for (i = 0; i < numRemoved; i++)
+	{
+		if (m_batchSlots[i] < newSize)
+			m_batchSlots[numMoves++] = m_batchSlots[i];
+	}
+	btOpenAddressingResize(m_batchSlots, 2 * numMoves);
+	int numKept = 0;
+	for (i = newSize; numKept < numMoves; i++)
+	{
+		if (m_pairSlots[i] >= 0)
+			m_batchSlots[numMoves + numKept++] = i;
+	}
+
+	if (numMoves)
+	{
+		btOpenAddressingMoveBody move;
+		move.m_table = btOpenAddressingGetTable(m_groups, &m_pairSlots[0], m_groupMask);
+		move.m_pairArray = &m_overlappingPairArray[0];
+		move.m_holes = &m_batchSlots[0];
+		move.m_kept = &m_batchSlots[numMoves];
+		move.m_numMoves = numMoves;
+		move.m_numTasks = btOpenAddressingNumTasks(numMoves);
+		btOpenAddressingParallelFor(move.m_numTasks, move);
+	}
+
+	m_overlappingPairArray.resizeNoInitialize(newSize);
+	m_pairSlots.resizeNoInitialize(newSize);
+}
+
+void btOpenAddressingPairCache::removeOverlappingPairsContainingProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher)
+{
+	m_batchPairs.resizeNoInitialize(0);
+	for (int i = 0; i < m_overlappingPairArray.size(); i++)
+	{
+		const btBroadphasePair& pair = m_overlappingPairArray[i];
+		if (pair.m_pProxy0 == proxy || pair.m_pProxy1 == proxy)
+		{
+			m_batchPairs.push_back(pair);
+		}
+	}
+	if (m_batchPairs.size())
+	{
+		removeOverlappingPairs(&m_batchPairs[0], m_batchPairs.size(), dispatcher);
+	}
+}
+
+void btOpenAddressingPairCache::cleanProxyFromPairs(btBroadphaseProxy* proxy, btDispatcher* dispatcher)
+{
+	for (int i = 0; i < m_overlappingPairArray.size(); i++)
+	{
+		btBroadphasePair& pair = m_overlappingPairArray[i];
+		if (pair.m_pProxy0 == proxy || pair.m_pProxy1 == proxy)
+		{
+			cleanOverlappingPair(pair, dispatcher);
+		}
+	}
+}
+
+void btOpenAddressingPairCache::cleanOverlappingPair(btBroadphasePair& pair, btDispatcher* dispatcher)
+{
+	if (pair.m_algorithm && dispatcher)
+	{
+		pair.m_algorithm->~btCollisionAlgorithm();
+		dispatcher->freeCollisionAlgorithm(pair.m_algorithm);
+		pair.m_algorithm = 0;
+	}
+}
+
+void btOpenAddressingPairCache::processAllOverlappingPairs(btOverlapCallback* callback, btDispatcher* dispatcher)
+{
+	BT_PROFILE("btOpenAddressingPairCache::processAllOverlappingPairs");
+	for (int i = 0; i < m_overlappingPairArray.size();)
+	{
+		btBroadphasePair* pair = &m_overlappingPairArray[i];
+		if (callback->processOverlap(*pair))
+		{
+			// the last pair moves to i
+			removeOverlappingPair(pair->m_pProxy0, pair->m_pProxy1, dispatcher);
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+void btOpenAddressingPairCache::processAllOverlappingPairs(btOverlapCallback* callback, btDispatcher* dispatcher, const struct btDispatcherInfo& /*dispatchInfo*/)
+{
+	processAllOverlappingPairs(callback, dispatcher);
+}
+
+btBroadphasePair* btOpenAddressingPairCache::findPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1)
+{
+	int slot = findSlot(getKey(proxy0, proxy1));
+	return slot >= 0 ? &m_overlappingPairArray[getSlotPair(slot)] : 0;
+}
+
+void btOpenAddressingPairCache::sortOverlappingPairs(btDispatcher* /*dispatcher*/)
+{
+	m_overlappingPairArray.quickSort(btBroadphasePairSortPredicate());
+	growTable(m_overlappingPairArray.size());
+}
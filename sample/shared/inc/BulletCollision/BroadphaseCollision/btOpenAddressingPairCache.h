@@ -0,0 +1,211 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_OPEN_ADDRESSING_PAIR_CACHE_H
+#define BT_OPEN_ADDRESSING_PAIR_CACHE_H
+
+#include "btOverlappingPairCache.h"
+
+typedef unsigned long long int btOpenAddressingKey;
+
+///btOpenAddressingEntry is a key to insert into the table of btOpenAddressingPairCache
+struct btOpenAddressingEntry
+{
+	btOpenAddressingKey m_key;
+	int m_pairIndex;
+	int m_group;  // home group of the key
+};
+
+///btOpenAddressingGroup is one cache line of the table of btOpenAddressingPairCache: the keys of 4 slots and the indices of their pairs
+ATTRIBUTE_ALIGNED64(struct)
+btOpenAddressingGroup
+{
+	btOpenAddressingKey m_keys[4];
+	int m_pairIndices[4];
+	int m_unused[4];
+};
+
+///btOpenAddressingPairCache is a pair cache for many pairs that change a lot, such as a pile of debris that collapses.
+///The pairs are stored in one array as in btHashedOverlappingPairCache, but the index is an open addressing table:
+///the key of a pair (both unique ids in 64 bits) is stored in the table itself, in groups of 4 slots that are compared with SSE2.
+///A group and the pair indices of its slots fill one cache line, so a lookup usually reads a single cache line and never follows a chain through the pair array.
+///addOverlappingPairs and removeOverlappingPairs change many pairs at once with btParallelFor (if BT_THREADSAFE is enabled):
+///lookups run in parallel, new pairs are appended in the order of the batch and each task inserts the keys of its own part of the table.
+///Collision algorithms are freed and the ghost pair callback is called on the calling thread, in the order of the batch.
+///The pair array only depends on the calls made on the cache, not on the number of threads.
+///A custom btOverlapFilterCallback is called on the calling thread, since it may not be thread safe.
+ATTRIBUTE_ALIGNED16(class)
+btOpenAddressingPairCache : public btOverlappingPairCache
+{
+protected:
+	btBroadphasePairArray m_overlappingPairArray;
+	btAlignedObjectArray<int> m_pairSlots;  // slot of each pair
+
+	// the table, a power of two of groups. Free slots have a key that no pair has, empty or removed
+	btOpenAddressingGroup* m_groups;
+	int m_groupMask;
+	int m_numUsedSlots;  // slots that are not empty, removed slots included
+
+	btOverlapFilterCallback* m_overlapFilterCallback;
+	btOverlappingPairCallback* m_ghostPairCallback;
+
+	// scratch of the batch functions
+	btAlignedObjectArray<btOpenAddressingKey> m_batchKeys;
+	btAlignedObjectArray<int> m_batchSlots;
+	btAlignedObjectArray<btOpenAddressingEntry> m_batchEntries;
+	btAlignedObjectArray<btOpenAddressingEntry> m_sortedEntries;  // entries sorted by the task that owns their home group
+	btAlignedObjectArray<int> m_taskCounts;
+	btBroadphasePairArray m_batchPairs;
+
+	btOpenAddressingKey& getSlotKey(int slot)
+	{
+		return m_groups[slot / GROUP_SIZE].m_keys[slot % GROUP_SIZE];
+	}
+	int& getSlotPair(int slot)
+	{
+		return m_groups[slot / GROUP_SIZE].m_pairIndices[slot % GROUP_SIZE];
+	}
+
+	btBroadphasePair* internalAddPair(btBroadphaseProxy * proxy0, btBroadphaseProxy * proxy1);
+	void eraseSlot(int slot);
+	///makes room for numPairs pairs, removed slots are dropped
+	void growTable(int numPairs);
+	///inserts the first numEntries keys of m_batchEntries
+	void insertEntries(int numEntries);
+
+public:
+	enum
+	{
+		GROUP_SIZE = 4
+	};
+
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	btOpenAddressingPairCache();
+	virtual ~btOpenAddressingPairCache();
+
+	static btOpenAddressingKey getKey(const btBroadphaseProxy* proxy0, const btBroadphaseProxy* proxy1)
+	{
+		unsigned int uid0 = unsigned(proxy0->m_uniqueId);
+		unsigned int uid1 = unsigned(proxy1->m_uniqueId);
+		return uid0 < uid1 ? (btOpenAddressingKey(uid0) << 32) | uid1 : (btOpenAddressingKey(uid1) << 32) | uid0;
+	}
+
+	///slot of the key, -1 if the pair is not in the cache
+	int findSlot(btOpenAddressingKey key) const;
+
+	SIMD_FORCE_INLINE bool needsBroadphaseCollision(btBroadphaseProxy * proxy0, btBroadphaseProxy * proxy1) const
+	{
+		if (m_overlapFilterCallback)
+			return m_overlapFilterCallback->needBroadphaseCollision(proxy0, proxy1);
+
+		bool collides = (proxy0->m_collisionFilterGroup & proxy1->m_collisionFilterMask) != 0;
+		collides = collides && (proxy1->m_collisionFilterGroup & proxy0->m_collisionFilterMask);
+
+		return collides;
+	}
+
+	// Add a pair and return the new pair. If the pair already exists,
+	// no new pair is created and the old one is returned.
+	virtual btBroadphasePair* addOverlappingPair(btBroadphaseProxy * proxy0, btBroadphaseProxy * proxy1)
+	{
+		if (!needsBroadphaseCollision(proxy0, proxy1))
+			return 0;
+
+		return internalAddPair(proxy0, proxy1);
+	}
+
+	///removes the pair and moves the last pair into its place, as btHashedOverlappingPairCache does
+	virtual void* removeOverlappingPair(btBroadphaseProxy * proxy0, btBroadphaseProxy * proxy1, btDispatcher * dispatcher);
+
+	///the pairs of one call must be different, pairs that are already in the cache are skipped.
+	///The new pairs are appended in the order of the batch
+	virtual void addOverlappingPairs(const btBroadphasePair* pairs, int numPairs);
+
+	///the last pairs of the array that are kept fill the holes, in the order of the batch
+	virtual void removeOverlappingPairs(const btBroadphasePair* pairs, int numPairs, btDispatcher* dispatcher);
+
+	virtual void removeOverlappingPairsContainingProxy(btBroadphaseProxy * proxy, btDispatcher * dispatcher);
+
+	virtual void cleanProxyFromPairs(btBroadphaseProxy * proxy, btDispatcher * dispatcher);
+
+	virtual void cleanOverlappingPair(btBroadphasePair & pair, btDispatcher * dispatcher);
+
+	virtual void processAllOverlappingPairs(btOverlapCallback*, btDispatcher * dispatcher);
+
+	///the order of the pair array does not depend on the number of threads, so the pairs are not sorted for m_deterministicOverlappingPairs
+	virtual void processAllOverlappingPairs(btOverlapCallback * callback, btDispatcher * dispatcher, const struct btDispatcherInfo& dispatchInfo);
+
+	virtual btBroadphasePair* findPair(btBroadphaseProxy * proxy0, btBroadphaseProxy * proxy1);
+
+	virtual btBroadphasePair* getOverlappingPairArrayPtr()
+	{
+		return &m_overlappingPairArray[0];
+	}
+
+	const btBroadphasePair* getOverlappingPairArrayPtr() const
+	{
+		return &m_overlappingPairArray[0];
+	}
+
+	btBroadphasePairArray& getOverlappingPairArray()
+	{
+		return m_overlappingPairArray;
+	}
+
+	const btBroadphasePairArray& getOverlappingPairArray() const
+	{
+		return m_overlappingPairArray;
+	}
+
+	int getNumOverlappingPairs() const
+	{
+		return m_overlappingPairArray.size();
+	}
+
+	btOverlapFilterCallback* getOverlapFilterCallback()
+	{
+		return m_overlapFilterCallback;
+	}
+
+	void setOverlapFilterCallback(btOverlapFilterCallback * callback)
+	{
+		m_overlapFilterCallback = callback;
+	}
+
+	virtual bool hasDeferredRemoval()
+	{
+		return false;
+	}
+
+	virtual void setInternalGhostPairCallback(btOverlappingPairCallback * ghostPairCallback)
+	{
+		m_ghostPairCallback = ghostPairCallback;
+	}
+
+	///sorts the pairs by unique ids and keeps their collision algorithms
+	virtual void sortOverlappingPairs(btDispatcher * dispatcher);
+
+	int getNumSlots() const
+	{
+		return (m_groupMask + 1) * GROUP_SIZE;
+	}
+	int getNumUsedSlots() const
+	{
+		return m_numUsedSlots;
+	}
+};
+
+#endif  //BT_OPEN_ADDRESSING_PAIR_CACHE_H
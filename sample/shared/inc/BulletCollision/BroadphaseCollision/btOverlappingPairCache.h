@@ -80,6 +80,25 @@ public:
 	virtual void setInternalGhostPairCallback(btOverlappingPairCallback* ghostPairCallback) = 0;
 
 	virtual void sortOverlappingPairs(btDispatcher* dispatcher) = 0;
+
+	///addOverlappingPairs adds many pairs at once, the proxies of each pair can be in any order.
+	///The default adds them one by one, a cache can override it to add them in parallel (see btOpenAddressingPairCache)
+	virtual void addOverlappingPairs(const btBroadphasePair* pairs, int numPairs)
+	{
+		for (int i = 0; i < numPairs; i++)
+		{
+			addOverlappingPair(pairs[i].m_pProxy0, pairs[i].m_pProxy1);
+		}
+	}
+
+	///removeOverlappingPairs removes many pairs at once, pairs that are not in the cache are skipped
+	virtual void removeOverlappingPairs(const btBroadphasePair* pairs, int numPairs, btDispatcher* dispatcher)
+	{
+		for (int i = 0; i < numPairs; i++)
+		{
+			removeOverlappingPair(pairs[i].m_pProxy0, pairs[i].m_pProxy1, dispatcher);
+		}
+	}
 };
 
 /// Hash-space based Pair Cache, thanks to Erin Catto, Box2D, http://www.box2d.org, and Pierre Terdiman, Codercorner, http://codercorner.com
@@ -18,6 +18,8 @@ subject to the following restrictions:
 #include "LinearMath/btAabbUtil2.h"
 #include "LinearMath/btIDebugDraw.h"
 #include "LinearMath/btSerializer.h"
+#include "LinearMath/btQuickprof.h"
+#include "LinearMath/btThreads.h"
 
 #define RAYAABB2
 
@@ -33,7 +35,7 @@ btQuantizedBvh::btQuantizedBvh() : m_bulletVersion(BT_BULLET_VERSION),
 	m_bvhAabbMax.setValue(SIMD_INFINITY, SIMD_INFINITY, SIMD_INFINITY);
 }
 
-void btQuantizedBvh::buildInternal()
+void btQuantizedBvh::buildInternal(btBuildMode buildMode)
 {
 	///assumes that caller filled in the m_quantizedLeafNodes
 	m_useQuantization = true;
@@ -49,7 +51,14 @@ void btQuantizedBvh::buildInternal()
 
 	m_curNodeIndex = 0;
 
-	buildTree(0, numLeafNodes);
+	if (buildMode == BUILD_SAH)
+	{
+		buildTreeSah(0, numLeafNodes);
+	}
+	else
+	{
+		buildTree(0, numLeafNodes);
+	}
 
 	///if the entire tree is small then subtree size, we need to create a header info for the tree
 	if (m_useQuantization && !m_SubtreeHeaders.size())
@@ -309,6 +318,603 @@ int btQuantizedBvh::calcSplittingAxis(int startIndex, int endIndex)
 	return variance.maxAxis();
 }
 
+//
+// SAH builder
+//
+
+// bins per axis of the surface area heuristic
+static const int btQuantizedBvhNumBins = 16;
+
+// below this depth the SAH splits, deeper nodes split at the mean like buildTree so that degenerate meshes cannot overflow the stack
+static const int btQuantizedBvhMaxSahDepth = 64;
+
+// subtrees with at most this many leaves are built by one task, larger nodes are split on the calling thread with parallel binning
+static const int btQuantizedBvhTaskLeaves = 4096;
+
+// Leaves per binning task and the maximum number of binning tasks of one node.
+// The bins do not depend on the split into tasks, so the tree does not depend on the number of threads.
+static const int btQuantizedBvhGrain = 8192;
+static const int btQuantizedBvhMaxTasks = 64;
+
+static int btQuantizedBvhNumTasks(int n)
+{
+	return btMax(1, btMin(btQuantizedBvhMaxTasks, (n + btQuantizedBvhGrain - 1) / btQuantizedBvhGrain));
+}
+
+static void btQuantizedBvhRange(int task, int numTasks, int begin, int end, int& taskBegin, int& taskEnd)
+{
+	int n = end - begin;
+	taskBegin = begin + int((long long)n * task / numTasks);
+	taskEnd = begin + int((long long)n * (task + 1) / numTasks);
+}
+
+static void btQuantizedBvhParallelFor(int numTasks, const btIParallelForBody& body)
+{
+#if BT_THREADSAFE
+	btITaskScheduler* scheduler = btGetTaskScheduler();
+	if (numTasks > 1 && scheduler && scheduler->getNumThreads() > 1)
+	{
+		btParallelFor(0, numTasks, 1, body);
+		return;
+	}
+#endif  //BT_THREADSAFE
+	body.forLoop(0, numTasks);
+}
+
+///btQuantizedBvhBuildContext gives the builder access to the leaf and node arrays of one of the two layouts.
+///Quantized leaves are binned in quantized coordinates, m_areaScale turns them back into world units for the surface areas
+struct btQuantizedBvhBuildContext
+{
+	btQuantizedBvhNode* m_quantizedLeafNodes;
+	btQuantizedBvhNode* m_quantizedNodes;
+	btOptimizedBvhNode* m_leafNodes;
+	btOptimizedBvhNode* m_nodes;
+	btVector3 m_areaScale;
+
+	SIMD_FORCE_INLINE void getLeafAabb(int i, btVector3& aabbMin, btVector3& aabbMax) const
+	{
+		if (m_quantizedLeafNodes)
+		{
+			const btQuantizedBvhNode& leaf = m_quantizedLeafNodes[i];
+			aabbMin.setValue(btScalar(leaf.m_quantizedAabbMin[0]), btScalar(leaf.m_quantizedAabbMin[1]), btScalar(leaf.m_quantizedAabbMin[2]));
+			aabbMax.setValue(btScalar(leaf.m_quantizedAabbMax[0]), btScalar(leaf.m_quantizedAabbMax[1]), btScalar(leaf.m_quantizedAabbMax[2]));
+		}
+		else
+		{
+			aabbMin = m_leafNodes[i].m_aabbMinOrg;
+			aabbMax = m_leafNodes[i].m_aabbMaxOrg;
+		}
+	}
+
+	///twice the center of the leaf aabb
+	SIMD_FORCE_INLINE btVector3 getLeafCentroid(int i) const
+	{
+		btVector3 aabbMin, aabbMax;
+		getLeafAabb(i, aabbMin, aabbMax);
+		return aabbMin + aabbMax;
+	}
+
+	SIMD_FORCE_INLINE void swapLeaves(int i, int j) const
+	{
+		if (m_quantizedLeafNodes)
+		{
+			btSwap(m_quantizedLeafNodes[i], m_quantizedLeafNodes[j]);
+		}
+		else
+		{
+			btSwap(m_leafNodes[i], m_leafNodes[j]);
+		}
+	}
+
+	SIMD_FORCE_INLINE btScalar getArea(const btVector3& aabbMin, const btVector3& aabbMax) const
+	{
+		btVector3 extent = (aabbMax - aabbMin) * m_areaScale;
+		return extent.getX() * extent.getY() + extent.getY() * extent.getZ() + extent.getZ() * extent.getX();
+	}
+
+	void setLeafNode(int nodeIndex, int leafIndex) const
+	{
+		if (m_quantizedLeafNodes)
+		{
+			m_quantizedNodes[nodeIndex] = m_quantizedLeafNodes[leafIndex];
+		}
+		else
+		{
+			m_nodes[nodeIndex] = m_leafNodes[leafIndex];
+		}
+	}
+
+	///merges the aabbs of the children, escapeIndex is the number of nodes of the subtree as in buildTree
+	void setInternalNode(int nodeIndex, int leftChildIndex, int rightChildIndex, int escapeIndex) const
+	{
+		if (m_quantizedLeafNodes)
+		{
+			btQuantizedBvhNode& node = m_quantizedNodes[nodeIndex];
+			const btQuantizedBvhNode& left = m_quantizedNodes[leftChildIndex];
+			const btQuantizedBvhNode& right = m_quantizedNodes[rightChildIndex];
+			for (int i = 0; i < 3; i++)
+			{
+				node.m_quantizedAabbMin[i] = btMin(left.m_quantizedAabbMin[i], right.m_quantizedAabbMin[i]);
+				node.m_quantizedAabbMax[i] = btMax(left.m_quantizedAabbMax[i], right.m_quantizedAabbMax[i]);
+			}
+			node.m_escapeIndexOrTriangleIndex = -escapeIndex;
+		}
+		else
+		{
+			btOptimizedBvhNode& node = m_nodes[nodeIndex];
+			node.m_aabbMinOrg = m_nodes[leftChildIndex].m_aabbMinOrg;
+			node.m_aabbMaxOrg = m_nodes[leftChildIndex].m_aabbMaxOrg;
+			node.m_aabbMinOrg.setMin(m_nodes[rightChildIndex].m_aabbMinOrg);
+			node.m_aabbMaxOrg.setMax(m_nodes[rightChildIndex].m_aabbMaxOrg);
+			node.m_escapeIndex = escapeIndex;
+		}
+	}
+};
+
+struct btQuantizedBvhBin
+{
+	btVector3 m_aabbMin;
+	btVector3 m_aabbMax;
+	int m_count;
+};
+
+///btQuantizedBvhBins holds the bins of the 3 axes of one node (or of one binning task)
+struct btQuantizedBvhBins
+{
+	btQuantizedBvhBin m_bins[3][btQuantizedBvhNumBins];
+	btVector3 m_centroidMin;
+	btVector3 m_centroidMax;
+
+	btQuantizedBvhBins()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (int i = 0; i < btQuantizedBvhNumBins; i++)
+			{
+				m_bins[axis][i].m_aabbMin.setValue(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+				m_bins[axis][i].m_aabbMax.setValue(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+				m_bins[axis][i].m_count = 0;
+			}
+		}
+		m_centroidMin.setValue(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+		m_centroidMax.setValue(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+	}
+
+	void merge(const btQuantizedBvhBins& other)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (int i = 0; i < btQuantizedBvhNumBins; i++)
+			{
+				m_bins[axis][i].m_aabbMin.setMin(other.m_bins[axis][i].m_aabbMin);
+				m_bins[axis][i].m_aabbMax.setMax(other.m_bins[axis][i].m_aabbMax);
+				m_bins[axis][i].m_count += other.m_bins[axis][i].m_count;
+			}
+		}
+		m_centroidMin.setMin(other.m_centroidMin);
+		m_centroidMax.setMax(other.m_centroidMax);
+	}
+};
+
+///maps centroids to bins, the same mapping is used for binning and partitioning
+struct btQuantizedBvhBinMapping
+{
+	btVector3 m_centroidMin;
+	btVector3 m_scale;
+
+	void init(const btVector3& centroidMin, const btVector3& centroidMax)
+	{
+		m_centroidMin = centroidMin;
+		btVector3 extent = centroidMax - centroidMin;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			m_scale[axis] = extent[axis] > btScalar(0) ? btScalar(btQuantizedBvhNumBins) * btScalar(0.9999) / extent[axis] : btScalar(0);
+		}
+	}
+
+	SIMD_FORCE_INLINE int getBin(const btVector3& centroid, int axis) const
+	{
+		int bin = int((centroid[axis] - m_centroidMin[axis]) * m_scale[axis]);
+		return btMin(btMax(bin, 0), btQuantizedBvhNumBins - 1);
+	}
+};
+
+static void btQuantizedBvhCentroidBounds(const btQuantizedBvhBuildContext& context, int begin, int end, btVector3& centroidMin, btVector3& centroidMax)
+{
+	for (int i = begin; i < end; i++)
+	{
+		btVector3 centroid = context.getLeafCentroid(i);
+		centroidMin.setMin(centroid);
+		centroidMax.setMax(centroid);
+	}
+}
+
+static void btQuantizedBvhBinLeaves(const btQuantizedBvhBuildContext& context, const btQuantizedBvhBinMapping& mapping, int begin, int end, btQuantizedBvhBins& bins)
+{
+	for (int i = begin; i < end; i++)
+	{
+		btVector3 aabbMin, aabbMax;
+		context.getLeafAabb(i, aabbMin, aabbMax);
+		btVector3 centroid = aabbMin + aabbMax;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			btQuantizedBvhBin& bin = bins.m_bins[axis][mapping.getBin(centroid, axis)];
+			bin.m_aabbMin.setMin(aabbMin);
+			bin.m_aabbMax.setMax(aabbMax);
+			bin.m_count++;
+		}
+	}
+}
+
+struct btQuantizedBvhCentroidBody : public btIParallelForBody
+{
+	const btQuantizedBvhBuildContext* m_context;
+	btQuantizedBvhBins* m_taskBins;
+	int m_begin;
+	int m_end;
+	int m_numTasks;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int t = iBegin; t < iEnd; ++t)
+		{
+			int begin, end;
+			btQuantizedBvhRange(t, m_numTasks, m_begin, m_end, begin, end);
+			m_taskBins[t].clear();
+			btQuantizedBvhCentroidBounds(*m_context, begin, end, m_taskBins[t].m_centroidMin, m_taskBins[t].m_centroidMax);
+		}
+	}
+};
+
+struct btQuantizedBvhBinBody : public btIParallelForBody
+{
+	const btQuantizedBvhBuildContext* m_context;
+	const btQuantizedBvhBinMapping* m_mapping;
+	btQuantizedBvhBins* m_taskBins;
+	int m_begin;
+	int m_end;
+	int m_numTasks;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int t = iBegin; t < iEnd; ++t)
+		{
+			int begin, end;
+			btQuantizedBvhRange(t, m_numTasks, m_begin, m_end, begin, end);
+			btQuantizedBvhBinLeaves(*m_context, *m_mapping, begin, end, m_taskBins[t]);
+		}
+	}
+};
+
+///splits at the mean centroid of the axis with the largest centroid extent, like sortAndCalcSplittingIndex
+static int btQuantizedBvhMeanSplit(const btQuantizedBvhBuildContext& context, int startIndex, int endIndex, const btVector3& centroidMin, const btVector3& centroidMax)
+{
+	int numIndices = endIndex - startIndex;
+	int splitAxis = (centroidMax - centroidMin).maxAxis();
+	btScalar splitValue = 0;
+	for (int i = startIndex; i < endIndex; i++)
+	{
+		splitValue += context.getLeafCentroid(i)[splitAxis];
+	}
+	splitValue /= btScalar(numIndices);
+
+	int splitIndex = startIndex;
+	for (int i = startIndex; i < endIndex; i++)
+	{
+		if (context.getLeafCentroid(i)[splitAxis] > splitValue)
+		{
+			context.swapLeaves(i, splitIndex);
+			splitIndex++;
+		}
+	}
+
+	int rangeBalancedIndices = numIndices / 3;
+	bool unbalanced = ((splitIndex <= (startIndex + rangeBalancedIndices)) || (splitIndex >= (endIndex - 1 - rangeBalancedIndices)));
+	if (unbalanced)
+	{
+		splitIndex = startIndex + (numIndices >> 1);
+	}
+	return splitIndex;
+}
+
+///sorts the leaves of a node into its two children and returns the first leaf of the right child.
+///taskBins is the scratch of the parallel binning, 0 to bin on the calling thread
+static int btQuantizedBvhSplit(const btQuantizedBvhBuildContext& context, int startIndex, int endIndex, int depth, btAlignedObjectArray<btQuantizedBvhBins>* taskBins)
+{
+	int numIndices = endIndex - startIndex;
+	if (numIndices == 2)
+	{
+		return startIndex + 1;
+	}
+
+	int numTasks = taskBins ? btQuantizedBvhNumTasks(numIndices) : 1;
+	if (numTasks > 1 && taskBins->size() < numTasks)
+	{
+		taskBins->resize(numTasks);
+	}
+	btQuantizedBvhBins localBins;
+	btQuantizedBvhBins& bins = numTasks > 1 ? (*taskBins)[0] : localBins;
+	if (numTasks > 1)
+	{
+		btQuantizedBvhCentroidBody body;
+		body.m_context = &context;
+		body.m_taskBins = &(*taskBins)[0];
+		body.m_begin = startIndex;
+		body.m_end = endIndex;
+		body.m_numTasks = numTasks;
+		btQuantizedBvhParallelFor(numTasks, body);
+		for (int t = 1; t < numTasks; t++)
+		{
+			bins.m_centroidMin.setMin((*taskBins)[t].m_centroidMin);
+			bins.m_centroidMax.setMax((*taskBins)[t].m_centroidMax);
+		}
+	}
+	else
+	{
+		bins.clear();
+		btQuantizedBvhCentroidBounds(context, startIndex, endIndex, bins.m_centroidMin, bins.m_centroidMax);
+	}
+
+	// all centroids at the same point: any split is as good as another
+	btVector3 centroidMin = bins.m_centroidMin;
+	btVector3 centroidMax = bins.m_centroidMax;
+	if (centroidMin == centroidMax)
+	{
+		return startIndex + (numIndices >> 1);
+	}
+	if (depth >= btQuantizedBvhMaxSahDepth)
+	{
+		return btQuantizedBvhMeanSplit(context, startIndex, endIndex, centroidMin, centroidMax);
+	}
+
+	btQuantizedBvhBinMapping mapping;
+	mapping.init(centroidMin, centroidMax);
+	if (numTasks > 1)
+	{
+		for (int t = 1; t < numTasks; t++)
+		{
+			(*taskBins)[t].clear();
+		}
+		btQuantizedBvhBinBody body;
+		body.m_context = &context;
+		body.m_mapping = &mapping;
+		body.m_taskBins = &(*taskBins)[0];
+		body.m_begin = startIndex;
+		body.m_end = endIndex;
+		body.m_numTasks = numTasks;
+		// task 0 bins into the bins of the node, whose centroid bounds are kept
+		bins.clear();
+		btQuantizedBvhParallelFor(numTasks, body);
+		for (int t = 1; t < numTasks; t++)
+		{
+			bins.merge((*taskBins)[t]);
+		}
+	}
+	else
+	{
+		btQuantizedBvhBinLeaves(context, mapping, startIndex, endIndex, bins);
+	}
+
+	// sweep the bins from both sides and take the split with the lowest area*count sum
+	int bestAxis = -1;
+	int bestBin = 0;
+	btScalar bestCost = SIMD_INFINITY;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (mapping.m_scale[axis] == btScalar(0))
+			continue;
+
+		const btQuantizedBvhBin* axisBins = bins.m_bins[axis];
+		btScalar rightCost[btQuantizedBvhNumBins];
+		btVector3 aabbMin(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+		btVector3 aabbMax(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+		int count = 0;
+		for (int i = btQuantizedBvhNumBins - 1; i > 0; i--)
+		{
+			aabbMin.setMin(axisBins[i].m_aabbMin);
+			aabbMax.setMax(axisBins[i].m_aabbMax);
+			count += axisBins[i].m_count;
+			rightCost[i] = count ? context.getArea(aabbMin, aabbMax) * btScalar(count) : btScalar(0);
+		}
+
+		aabbMin.setValue(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+		aabbMax.setValue(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+		count = 0;
+		for (int i = 0; i < btQuantizedBvhNumBins - 1; i++)
+		{
+			aabbMin.setMin(axisBins[i].m_aabbMin);
+			aabbMax.setMax(axisBins[i].m_aabbMax);
+			count += axisBins[i].m_count;
+			// both children need leaves
+			if (count == 0 || count == numIndices)
+				continue;
+			btScalar cost = context.getArea(aabbMin, aabbMax) * btScalar(count) + rightCost[i + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = i;
+			}
+		}
+	}
+	if (bestAxis < 0)
+	{
+		return btQuantizedBvhMeanSplit(context, startIndex, endIndex, centroidMin, centroidMax);
+	}
+
+	// partition: leaves in the bins up to bestBin go to the left child
+	int left = startIndex;
+	int right = endIndex - 1;
+	for (;;)
+	{
+		while (left <= right && mapping.getBin(context.getLeafCentroid(left), bestAxis) <= bestBin)
+			left++;
+		while (left <= right && mapping.getBin(context.getLeafCentroid(right), bestAxis) > bestBin)
+			right--;
+		if (left >= right)
+			break;
+		context.swapLeaves(left, right);
+		left++;
+		right--;
+	}
+	btAssert(left > startIndex && left < endIndex);
+	return left;
+}
+
+///builds the subtree of the leaves startIndex to endIndex on the calling thread, its root is nodeIndex
+static void btQuantizedBvhBuildSubtree(const btQuantizedBvhBuildContext& context, int startIndex, int endIndex, int nodeIndex, int depth)
+{
+	int numIndices = endIndex - startIndex;
+	if (numIndices == 1)
+	{
+		context.setLeafNode(nodeIndex, startIndex);
+		return;
+	}
+	int splitIndex = btQuantizedBvhSplit(context, startIndex, endIndex, depth, 0);
+
+	// the left subtree has 2*n-1 nodes for n leaves, so the right child comes after them
+	int leftChildNodeIndex = nodeIndex + 1;
+	int rightChildNodeIndex = nodeIndex + 2 * (splitIndex - startIndex);
+	btQuantizedBvhBuildSubtree(context, startIndex, splitIndex, leftChildNodeIndex, depth + 1);
+	btQuantizedBvhBuildSubtree(context, splitIndex, endIndex, rightChildNodeIndex, depth + 1);
+	context.setInternalNode(nodeIndex, leftChildNodeIndex, rightChildNodeIndex, 2 * numIndices - 1);
+}
+
+///a node of the top of the tree, a subtree of a task if m_splitIndex is -1
+struct btQuantizedBvhBuildTask
+{
+	int m_startIndex;
+	int m_endIndex;
+	int m_nodeIndex;
+	int m_depth;
+	int m_splitIndex;
+};
+
+struct btQuantizedBvhSubtreeBody : public btIParallelForBody
+{
+	const btQuantizedBvhBuildContext* m_context;
+	const btQuantizedBvhBuildTask* m_tasks;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int t = iBegin; t < iEnd; ++t)
+		{
+			const btQuantizedBvhBuildTask& task = m_tasks[t];
+			btQuantizedBvhBuildSubtree(*m_context, task.m_startIndex, task.m_endIndex, task.m_nodeIndex, task.m_depth);
+		}
+	}
+};
+
+void btQuantizedBvh::buildTreeSah(int startIndex, int endIndex)
+{
+	BT_PROFILE("btQuantizedBvh::buildTreeSah");
+	int numLeaves = endIndex - startIndex;
+	if (numLeaves <= 0)
+		return;
+
+	btQuantizedBvhBuildContext context;
+	if (m_useQuantization)
+	{
+		context.m_quantizedLeafNodes = &m_quantizedLeafNodes[0];
+		context.m_quantizedNodes = &m_quantizedContiguousNodes[0];
+		context.m_leafNodes = 0;
+		context.m_nodes = 0;
+		context.m_areaScale = btVector3(1, 1, 1) / m_bvhQuantization;
+	}
+	else
+	{
+		context.m_quantizedLeafNodes = 0;
+		context.m_quantizedNodes = 0;
+		context.m_leafNodes = &m_leafNodes[0];
+		context.m_nodes = &m_contiguousNodes[0];
+		context.m_areaScale.setValue(1, 1, 1);
+	}
+
+	// split the top of the tree on the calling thread (binning in parallel) until the subtrees are small enough for one task
+	btAlignedObjectArray<btQuantizedBvhBuildTask> topNodes;
+	btAlignedObjectArray<btQuantizedBvhBuildTask> subtrees;
+	btAlignedObjectArray<btQuantizedBvhBuildTask> stack;
+	btAlignedObjectArray<btQuantizedBvhBins> taskBins;
+	btQuantizedBvhBuildTask root;
+	root.m_startIndex = startIndex;
+	root.m_endIndex = endIndex;
+	root.m_nodeIndex = m_curNodeIndex;
+	root.m_depth = 0;
+	root.m_splitIndex = -1;
+	stack.push_back(root);
+	while (stack.size())
+	{
+		btQuantizedBvhBuildTask task = stack[stack.size() - 1];
+		stack.pop_back();
+		if (task.m_endIndex - task.m_startIndex <= btQuantizedBvhTaskLeaves)
+		{
+			subtrees.push_back(task);
+			continue;
+		}
+		task.m_splitIndex = btQuantizedBvhSplit(context, task.m_startIndex, task.m_endIndex, task.m_depth, &taskBins);
+		topNodes.push_back(task);
+
+		btQuantizedBvhBuildTask child;
+		child.m_depth = task.m_depth + 1;
+		child.m_splitIndex = -1;
+		child.m_startIndex = task.m_splitIndex;
+		child.m_endIndex = task.m_endIndex;
+		child.m_nodeIndex = task.m_nodeIndex + 2 * (task.m_splitIndex - task.m_startIndex);
+		stack.push_back(child);
+		child.m_startIndex = task.m_startIndex;
+		child.m_endIndex = task.m_splitIndex;
+		child.m_nodeIndex = task.m_nodeIndex + 1;
+		stack.push_back(child);
+	}
+
+	// the subtrees write disjoint node ranges
+	if (subtrees.size())
+	{
+		btQuantizedBvhSubtreeBody body;
+		body.m_context = &context;
+		body.m_tasks = &subtrees[0];
+		btQuantizedBvhParallelFor(subtrees.size(), body);
+	}
+
+	// children are pushed after their parents, so going backwards merges the children first
+	for (int i = topNodes.size() - 1; i >= 0; i--)
+	{
+		const btQuantizedBvhBuildTask& task = topNodes[i];
+		int leftChildNodeIndex = task.m_nodeIndex + 1;
+		int rightChildNodeIndex = task.m_nodeIndex + 2 * (task.m_splitIndex - task.m_startIndex);
+		context.setInternalNode(task.m_nodeIndex, leftChildNodeIndex, rightChildNodeIndex, 2 * (task.m_endIndex - task.m_startIndex) - 1);
+	}
+
+	if (m_useQuantization)
+	{
+		buildSubtreeHeaders(m_curNodeIndex);
+	}
+	m_curNodeIndex += 2 * numLeaves - 1;
+}
+
+void btQuantizedBvh::buildSubtreeHeaders(int nodeIndex)
+{
+	// buildTree adds the headers of the small children of a large node after the headers of their subtrees
+	const btQuantizedBvhNode& node = m_quantizedContiguousNodes[nodeIndex];
+	if (node.isLeafNode())
+		return;
+	int treeSizeInBytes = node.getEscapeIndex() * static_cast<int>(sizeof(btQuantizedBvhNode));
+	if (treeSizeInBytes <= MAX_SUBTREE_SIZE_IN_BYTES)
+		return;
+
+	int leftChildNodeIndex = nodeIndex + 1;
+	const btQuantizedBvhNode& leftChildNode = m_quantizedContiguousNodes[leftChildNodeIndex];
+	int rightChildNodeIndex = leftChildNodeIndex + (leftChildNode.isLeafNode() ? 1 : leftChildNode.getEscapeIndex());
+	buildSubtreeHeaders(leftChildNodeIndex);
+	buildSubtreeHeaders(rightChildNodeIndex);
+	updateSubtreeHeaders(leftChildNodeIndex, rightChildNodeIndex);
+}
+
 void btQuantizedBvh::reportAabbOverlappingNodex(btNodeOverlapCallback* nodeCallback, const btVector3& aabbMin, const btVector3& aabbMax) const
 {
 	//either choose recursive traversal (walkTree) or stackless (walkStacklessTree)
@@ -442,6 +1048,9 @@ void btQuantizedBvh::walkRecursiveQuantizedTreeAgainstQueryAabb(const btQuantize
 void btQuantizedBvh::walkStacklessTreeAgainstRay(btNodeOverlapCallback* nodeCallback, const btVector3& raySource, const btVector3& rayTarget, const btVector3& aabbMin, const btVector3& aabbMax, int startNodeIndex, int endNodeIndex) const
 {
 	btAssert(!m_useQuantization);
+	//the non-quantized tree is always walked from the root
+	(void)startNodeIndex;
+	(void)endNodeIndex;
 
 	const btOptimizedBvhNode* rootNode = &m_contiguousNodes[0];
 	int escapeIndex, curIndex = 0;
@@ -174,6 +174,15 @@ public:
 		TRAVERSAL_RECURSIVE
 	};
 
+	///BUILD_MEAN is the original builder, it splits at the mean of the axis with the largest variance.
+	///BUILD_SAH splits each node where the surface area heuristic of 16 bins per axis is lowest and builds the subtrees in parallel with btParallelFor.
+	///SAH builds trees with smaller boxes but on regular meshes such as height fields its queries can be slower than those of the mean split, so it is opt-in per build.
+	enum btBuildMode
+	{
+		BUILD_MEAN = 0,
+		BUILD_SAH
+	};
+
 protected:
 	btVector3 m_bvhAabbMin;
 	btVector3 m_bvhAabbMax;
@@ -284,6 +293,12 @@ protected:
 protected:
 	void buildTree(int startIndex, int endIndex);
 
+	///builds the same node layout as buildTree with the surface area heuristic, see BUILD_SAH
+	void buildTreeSah(int startIndex, int endIndex);
+
+	///adds the subtree headers of a finished tree in the order buildTree adds them
+	void buildSubtreeHeaders(int nodeIndex);
+
 	int calcSplittingAxis(int startIndex, int endIndex);
 
 	int sortAndCalcSplittingIndex(int startIndex, int endIndex, int splitAxis);
@@ -316,7 +331,7 @@ public:
 	void setQuantizationValues(const btVector3& bvhAabbMin, const btVector3& bvhAabbMax, btScalar quantizationMargin = btScalar(1.0));
 	QuantizedNodeArray& getLeafNodeArray() { return m_quantizedLeafNodes; }
 	///buildInternal is expert use only: assumes that setQuantizationValues and LeafNodeArray are initialized
-	void buildInternal();
+	void buildInternal(btBuildMode buildMode = BUILD_MEAN);
 	///***************************************** expert/internal use only *************************
 
 	void reportAabbOverlappingNodex(btNodeOverlapCallback * nodeCallback, const btVector3& aabbMin, const btVector3& aabbMax) const;
@@ -420,11 +435,36 @@ public:
 		return m_quantizedContiguousNodes;
 	}
 
+	SIMD_FORCE_INLINE const QuantizedNodeArray& getQuantizedNodeArray() const
+	{
+		return m_quantizedContiguousNodes;
+	}
+
 	SIMD_FORCE_INLINE BvhSubtreeInfoArray& getSubtreeInfoArray()
 	{
 		return m_SubtreeHeaders;
 	}
 
+	SIMD_FORCE_INLINE const BvhSubtreeInfoArray& getSubtreeInfoArray() const
+	{
+		return m_SubtreeHeaders;
+	}
+
+	SIMD_FORCE_INLINE const btVector3& getBvhAabbMin() const
+	{
+		return m_bvhAabbMin;
+	}
+
+	SIMD_FORCE_INLINE const btVector3& getBvhQuantization() const
+	{
+		return m_bvhQuantization;
+	}
+
+	SIMD_FORCE_INLINE int getNumNodes() const
+	{
+		return m_curNodeIndex;
+	}
+
 	////////////////////////////////////////////////////////////////////
 
 	/////Calculate space needed to store BVH for serialization
@@ -450,7 +490,7 @@ public:
 
 	////////////////////////////////////////////////////////////////////
 
-	SIMD_FORCE_INLINE bool isQuantized()
+	SIMD_FORCE_INLINE bool isQuantized() const
 	{
 		return m_useQuantization;
 	}
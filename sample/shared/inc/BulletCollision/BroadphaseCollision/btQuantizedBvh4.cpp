@@ -0,0 +1,475 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btQuantizedBvh4.h"
+#include "LinearMath/btAabbUtil2.h"
+#include "LinearMath/btQuickprof.h"
+
+// a minimum is stored with the top bit flipped, a maximum as the complement of that
+static const unsigned short btQuantizedBvh4FlipMin = 0x8000;
+static const unsigned short btQuantizedBvh4FlipMax = 0x7fff;
+
+///btQuantizedBvh4Query holds the bounds of a query in the layout of btQuantizedBvh4Node::m_bounds, repeated for the 4 children
+ATTRIBUTE_ALIGNED16(struct)
+btQuantizedBvh4Query
+{
+	short m_bounds[3][8];
+
+	void set(const unsigned short* quantizedQueryAabbMin, const unsigned short* quantizedQueryAabbMax)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			// a child overlaps if its minimum is not above the query maximum and its maximum not below the query minimum
+			m_bounds[0][i] = short(quantizedQueryAabbMax[0] ^ btQuantizedBvh4FlipMin);
+			m_bounds[0][4 + i] = short(quantizedQueryAabbMax[1] ^ btQuantizedBvh4FlipMin);
+			m_bounds[1][i] = short(quantizedQueryAabbMax[2] ^ btQuantizedBvh4FlipMin);
+			m_bounds[1][4 + i] = short(quantizedQueryAabbMin[0] ^ btQuantizedBvh4FlipMax);
+			m_bounds[2][i] = short(quantizedQueryAabbMin[1] ^ btQuantizedBvh4FlipMax);
+			m_bounds[2][4 + i] = short(quantizedQueryAabbMin[2] ^ btQuantizedBvh4FlipMax);
+		}
+	}
+};
+
+///bit i is set if child i of the node overlaps the query
+static SIMD_FORCE_INLINE int btQuantizedBvh4Overlap(const btQuantizedBvh4Node& node, const btQuantizedBvh4Query& query)
+{
+#ifdef BT_USE_SSE
+	__m128i fail = _mm_cmpgt_epi16(_mm_load_si128((const __m128i*)node.m_bounds[0]), _mm_load_si128((const __m128i*)query.m_bounds[0]));
+	fail = _mm_or_si128(fail, _mm_cmpgt_epi16(_mm_load_si128((const __m128i*)node.m_bounds[1]), _mm_load_si128((const __m128i*)query.m_bounds[1])));
+	fail = _mm_or_si128(fail, _mm_cmpgt_epi16(_mm_load_si128((const __m128i*)node.m_bounds[2]), _mm_load_si128((const __m128i*)query.m_bounds[2])));
+	// lanes 0-3 and 4-7 hold different bounds of the same 4 children
+	fail = _mm_or_si128(fail, _mm_srli_si128(fail, 8));
+	int failMask = _mm_movemask_epi8(_mm_packs_epi16(fail, fail)) & 15;
+	int emptyMask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_load_si128((const __m128i*)node.m_children), _mm_set1_epi32(btQuantizedBvh4::EMPTY_CHILD))));
+	return ~(failMask | emptyMask) & 15;
+#else
+	int mask = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		if (node.m_children[i] == btQuantizedBvh4::EMPTY_CHILD)
+			continue;
+		bool overlap = true;
+		for (int j = 0; j < 3; j++)
+		{
+			overlap = overlap && node.m_bounds[j][i] <= query.m_bounds[j][i] && node.m_bounds[j][4 + i] <= query.m_bounds[j][4 + i];
+		}
+		mask |= int(overlap) << i;
+	}
+	return mask;
+#endif  //BT_USE_SSE
+}
+
+static SIMD_FORCE_INLINE void btQuantizedBvh4GetChildAabb(const btQuantizedBvh4Node& node, int child, unsigned short* quantizedAabbMin, unsigned short* quantizedAabbMax)
+{
+	quantizedAabbMin[0] = (unsigned short)(node.m_bounds[0][child] ^ btQuantizedBvh4FlipMin);
+	quantizedAabbMin[1] = (unsigned short)(node.m_bounds[0][4 + child] ^ btQuantizedBvh4FlipMin);
+	quantizedAabbMin[2] = (unsigned short)(node.m_bounds[1][child] ^ btQuantizedBvh4FlipMin);
+	quantizedAabbMax[0] = (unsigned short)(node.m_bounds[1][4 + child] ^ btQuantizedBvh4FlipMax);
+	quantizedAabbMax[1] = (unsigned short)(node.m_bounds[2][child] ^ btQuantizedBvh4FlipMax);
+	quantizedAabbMax[2] = (unsigned short)(node.m_bounds[2][4 + child] ^ btQuantizedBvh4FlipMax);
+}
+
+static SIMD_FORCE_INLINE void btQuantizedBvh4ProcessLeaf(btNodeOverlapCallback* nodeCallback, int child)
+{
+	// same packing as btQuantizedBvhNode::getPartId/getTriangleIndex
+	nodeCallback->processNode(child >> (31 - MAX_NUM_PARTS_IN_BITS), child & ((1 << (31 - MAX_NUM_PARTS_IN_BITS)) - 1));
+}
+
+btQuantizedBvh4::btQuantizedBvh4()
+	: m_bvh(0),
+	  m_nodes(0),
+	  m_numNodes(0),
+	  m_maxDepth(0)
+{
+}
+
+btQuantizedBvh4::~btQuantizedBvh4()
+{
+	clear();
+}
+
+void btQuantizedBvh4::clear()
+{
+	btAlignedFree(m_nodes);
+	m_nodes = 0;
+	m_numNodes = 0;
+	m_maxDepth = 0;
+	m_bvh = 0;
+	m_childOfNode.clear();
+	m_subtreeHeaders.clear();
+}
+
+void btQuantizedBvh4::setChildBounds(int child, const btQuantizedBvhNode& node)
+{
+	btQuantizedBvh4Node& parent = m_nodes[child >> 2];
+	int i = child & 3;
+	parent.m_bounds[0][i] = short(node.m_quantizedAabbMin[0] ^ btQuantizedBvh4FlipMin);
+	parent.m_bounds[0][4 + i] = short(node.m_quantizedAabbMin[1] ^ btQuantizedBvh4FlipMin);
+	parent.m_bounds[1][i] = short(node.m_quantizedAabbMin[2] ^ btQuantizedBvh4FlipMin);
+	parent.m_bounds[1][4 + i] = short(node.m_quantizedAabbMax[0] ^ btQuantizedBvh4FlipMax);
+	parent.m_bounds[2][i] = short(node.m_quantizedAabbMax[1] ^ btQuantizedBvh4FlipMax);
+	parent.m_bounds[2][4 + i] = short(node.m_quantizedAabbMax[2] ^ btQuantizedBvh4FlipMax);
+}
+
+int btQuantizedBvh4::collectChildren(const btQuantizedBvhNode* nodes, int nodeIndex, int children[4]) const
+{
+	btAssert(!nodes[nodeIndex].isLeafNode());
+	const btVector3 areaScale = btVector3(1, 1, 1) / m_bvh->getBvhQuantization();
+	int numChildren = 2;
+	children[0] = nodeIndex + 1;
+	children[1] = children[0] + (nodes[children[0]].isLeafNode() ? 1 : nodes[children[0]].getEscapeIndex());
+	while (numChildren < 4)
+	{
+		// open the inner child with the largest surface area, it is the most likely to be hit
+		int best = -1;
+		btScalar bestArea = btScalar(-1);
+		for (int i = 0; i < numChildren; i++)
+		{
+			const btQuantizedBvhNode& child = nodes[children[i]];
+			if (child.isLeafNode())
+				continue;
+			btVector3 extent(btScalar(child.m_quantizedAabbMax[0] - child.m_quantizedAabbMin[0]),
+							 btScalar(child.m_quantizedAabbMax[1] - child.m_quantizedAabbMin[1]),
+							 btScalar(child.m_quantizedAabbMax[2] - child.m_quantizedAabbMin[2]));
+			extent *= areaScale;
+			btScalar area = extent.getX() * extent.getY() + extent.getY() * extent.getZ() + extent.getZ() * extent.getX();
+			if (area > bestArea)
+			{
+				bestArea = area;
+				best = i;
+			}
+		}
+		if (best < 0)
+			break;
+
+		// replace it by its two children, keeping the order of the binary tree
+		int left = children[best] + 1;
+		int right = left + (nodes[left].isLeafNode() ? 1 : nodes[left].getEscapeIndex());
+		for (int i = numChildren; i > best + 1; i--)
+		{
+			children[i] = children[i - 1];
+		}
+		children[best] = left;
+		children[best + 1] = right;
+		numChildren++;
+	}
+	return numChildren;
+}
+
+int btQuantizedBvh4::countNodes(const btQuantizedBvhNode* nodes, int nodeIndex, int depth)
+{
+	m_maxDepth = btMax(m_maxDepth, depth);
+	int children[4];
+	int numChildren = collectChildren(nodes, nodeIndex, children);
+	int numNodes = 1;
+	for (int i = 0; i < numChildren; i++)
+	{
+		if (!nodes[children[i]].isLeafNode())
+		{
+			numNodes += countNodes(nodes, children[i], depth + 1);
+		}
+	}
+	return numNodes;
+}
+
+int btQuantizedBvh4::buildNode(const btQuantizedBvhNode* nodes, int nodeIndex)
+{
+	// parents come before their children as in the binary tree
+	int index = m_numNodes++;
+	int children[4];
+	int numChildren = nodeIndex < 0 ? 1 : collectChildren(nodes, nodeIndex, children);
+	if (nodeIndex < 0)
+	{
+		// a tree of a single leaf
+		children[0] = 0;
+	}
+	for (int i = 0; i < 4; i++)
+	{
+		btQuantizedBvh4Node& node = m_nodes[index];
+		if (i >= numChildren)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				node.m_bounds[j][i] = node.m_bounds[j][4 + i] = 0x7fff;
+			}
+			node.m_children[i] = EMPTY_CHILD;
+			continue;
+		}
+
+		const btQuantizedBvhNode& child = nodes[children[i]];
+		setChildBounds(4 * index + i, child);
+		m_childOfNode[children[i]] = 4 * index + i;
+		if (child.isLeafNode())
+		{
+			node.m_children[i] = child.m_escapeIndexOrTriangleIndex;
+		}
+		else
+		{
+			int childIndex = buildNode(nodes, children[i]);
+			m_nodes[index].m_children[i] = ~childIndex;
+		}
+	}
+	return index;
+}
+
+bool btQuantizedBvh4::build(const btQuantizedBvh& bvh)
+{
+	BT_PROFILE("btQuantizedBvh4::build");
+	clear();
+	if (!bvh.isQuantized() || bvh.getNumNodes() == 0)
+		return false;
+
+	m_bvh = &bvh;
+	const btQuantizedBvhNode* nodes = &bvh.getQuantizedNodeArray()[0];
+	int root = nodes[0].isLeafNode() ? -1 : 0;
+	int numNodes = root < 0 ? 1 : countNodes(nodes, root, 0);
+	if (3 * m_maxDepth + 1 > MAX_STACK_SIZE)
+	{
+		clear();
+		return false;
+	}
+
+	m_nodes = (btQuantizedBvh4Node*)btAlignedAlloc(sizeof(btQuantizedBvh4Node) * numNodes, 64);
+	m_childOfNode.resize(bvh.getQuantizedNodeArray().size(), -1);
+	buildNode(nodes, root);
+	btAssert(m_numNodes == numNodes);
+	m_subtreeHeaders = bvh.getSubtreeInfoArray();
+	return true;
+}
+
+void btQuantizedBvh4::refitRange(int firstNode, int endNode)
+{
+	const btQuantizedBvhNode* nodes = &m_bvh->getQuantizedNodeArray()[0];
+	for (int i = firstNode; i < endNode; i++)
+	{
+		int child = m_childOfNode[i];
+		if (child >= 0)
+		{
+			setChildBounds(child, nodes[i]);
+		}
+	}
+}
+
+void btQuantizedBvh4::refit()
+{
+	BT_PROFILE("btQuantizedBvh4::refit");
+	if (!m_nodes)
+		return;
+	refitRange(0, m_childOfNode.size());
+	m_subtreeHeaders = m_bvh->getSubtreeInfoArray();
+}
+
+void btQuantizedBvh4::refitPartial(const btVector3& aabbMin, const btVector3& aabbMax)
+{
+	BT_PROFILE("btQuantizedBvh4::refitPartial");
+	if (!m_nodes)
+		return;
+	const BvhSubtreeInfoArray& subtreeHeaders = m_bvh->getSubtreeInfoArray();
+	btAssert(subtreeHeaders.size() == m_subtreeHeaders.size());
+
+	unsigned short quantizedQueryAabbMin[3];
+	unsigned short quantizedQueryAabbMax[3];
+	m_bvh->quantize(&quantizedQueryAabbMin[0], aabbMin, 0);
+	m_bvh->quantize(&quantizedQueryAabbMax[0], aabbMax, 1);
+
+	// the same subtrees as btOptimizedBvh::refitPartial, which tests the aabbs they had before the refit
+	for (int i = 0; i < m_subtreeHeaders.size(); i++)
+	{
+		btBvhSubtreeInfo& subtree = m_subtreeHeaders[i];
+		if (testQuantizedAabbAgainstQuantizedAabb(quantizedQueryAabbMin, quantizedQueryAabbMax, subtree.m_quantizedAabbMin, subtree.m_quantizedAabbMax))
+		{
+			refitRange(subtree.m_rootNodeIndex, subtree.m_rootNodeIndex + subtree.m_subtreeSize);
+			subtree = subtreeHeaders[i];
+		}
+	}
+}
+
+void btQuantizedBvh4::walkTree(btNodeOverlapCallback* nodeCallback, const unsigned short* quantizedQueryAabbMin, const unsigned short* quantizedQueryAabbMax) const
+{
+	btQuantizedBvh4Query query;
+	query.set(quantizedQueryAabbMin, quantizedQueryAabbMax);
+
+	int stack[MAX_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize)
+	{
+		const btQuantizedBvh4Node& node = m_nodes[stack[--stackSize]];
+		int mask = btQuantizedBvh4Overlap(node, query);
+		if (!mask)
+			continue;
+
+		// report the leaves in order and push the inner children so that the first one is popped first
+		for (int i = 0; i < 4; i++)
+		{
+			if ((mask & (1 << i)) && node.m_children[i] >= 0)
+			{
+				btQuantizedBvh4ProcessLeaf(nodeCallback, node.m_children[i]);
+			}
+		}
+		for (int i = 3; i >= 0; i--)
+		{
+			if ((mask & (1 << i)) && node.m_children[i] < 0)
+			{
+				btAssert(stackSize < MAX_STACK_SIZE);
+				stack[stackSize++] = ~node.m_children[i];
+			}
+		}
+	}
+}
+
+void btQuantizedBvh4::walkTreeAgainstRay(btNodeOverlapCallback* nodeCallback, const btVector3& raySource, const btVector3& rayTarget, const btVector3& aabbMin, const btVector3& aabbMax) const
+{
+	// the same tests as btQuantizedBvh::walkStacklessQuantizedTreeAgainstRay: the quantized aabb of the box cast first, then the ray against the unquantized child aabbs
+	btVector3 rayDirection = (rayTarget - raySource);
+	rayDirection.safeNormalize();
+	btScalar lambda_max = rayDirection.dot(rayTarget - raySource);
+	rayDirection[0] = rayDirection[0] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / rayDirection[0];
+	rayDirection[1] = rayDirection[1] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / rayDirection[1];
+	rayDirection[2] = rayDirection[2] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / rayDirection[2];
+
+	btVector3 rayAabbMin = raySource;
+	btVector3 rayAabbMax = raySource;
+	rayAabbMin.setMin(rayTarget);
+	rayAabbMax.setMax(rayTarget);
+	rayAabbMin += aabbMin;
+	rayAabbMax += aabbMax;
+
+	unsigned short int quantizedQueryAabbMin[3];
+	unsigned short int quantizedQueryAabbMax[3];
+	m_bvh->quantizeWithClamp(quantizedQueryAabbMin, rayAabbMin, 0);
+	m_bvh->quantizeWithClamp(quantizedQueryAabbMax, rayAabbMax, 1);
+	btQuantizedBvh4Query query;
+	query.set(quantizedQueryAabbMin, quantizedQueryAabbMax);
+
+#ifdef BT_USE_SSE
+	const btVector3& bvhAabbMin = m_bvh->getBvhAabbMin();
+	const btVector3& quantization = m_bvh->getBvhQuantization();
+	__m128 origin[3], inverseDirection[3], castMin[3], castMax[3], offset[3], scale[3];
+	for (int k = 0; k < 3; k++)
+	{
+		origin[k] = _mm_set1_ps(raySource[k]);
+		inverseDirection[k] = _mm_set1_ps(rayDirection[k]);
+		castMin[k] = _mm_set1_ps(aabbMin[k]);
+		castMax[k] = _mm_set1_ps(aabbMax[k]);
+		offset[k] = _mm_set1_ps(bvhAabbMin[k]);
+		scale[k] = _mm_set1_ps(quantization[k]);
+	}
+	const __m128 lambda = _mm_set1_ps(lambda_max);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128i flip0 = _mm_set1_epi16(short(btQuantizedBvh4FlipMin));
+	const __m128i flip1 = _mm_set_epi16(short(btQuantizedBvh4FlipMax), short(btQuantizedBvh4FlipMax), short(btQuantizedBvh4FlipMax), short(btQuantizedBvh4FlipMax),
+										short(btQuantizedBvh4FlipMin), short(btQuantizedBvh4FlipMin), short(btQuantizedBvh4FlipMin), short(btQuantizedBvh4FlipMin));
+	const __m128i flip2 = _mm_set1_epi16(short(btQuantizedBvh4FlipMax));
+#else
+	unsigned int sign[3] = {rayDirection[0] < 0.0, rayDirection[1] < 0.0, rayDirection[2] < 0.0};
+#endif  //BT_USE_SSE
+
+	int stack[MAX_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize)
+	{
+		const btQuantizedBvh4Node& node = m_nodes[stack[--stackSize]];
+		int mask = btQuantizedBvh4Overlap(node, query);
+		if (!mask)
+			continue;
+
+#ifdef BT_USE_SSE
+		// unquantize the 4 child aabbs (as unQuantize does) and do the slab test of btRayAabb2 on all of them
+		const __m128i zeroi = _mm_setzero_si128();
+		__m128i b0 = _mm_xor_si128(_mm_load_si128((const __m128i*)node.m_bounds[0]), flip0);
+		__m128i b1 = _mm_xor_si128(_mm_load_si128((const __m128i*)node.m_bounds[1]), flip1);
+		__m128i b2 = _mm_xor_si128(_mm_load_si128((const __m128i*)node.m_bounds[2]), flip2);
+		__m128 bounds[2][3];
+		bounds[0][0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(b0, zeroi));
+		bounds[0][1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(b0, zeroi));
+		bounds[0][2] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(b1, zeroi));
+		bounds[1][0] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(b1, zeroi));
+		bounds[1][1] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(b2, zeroi));
+		bounds[1][2] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(b2, zeroi));
+		__m128 tmin = _mm_set1_ps(-SIMD_INFINITY);
+		__m128 tmax = _mm_set1_ps(SIMD_INFINITY);
+		for (int k = 0; k < 3; k++)
+		{
+			// add the box cast extents
+			__m128 lower = _mm_sub_ps(_mm_add_ps(_mm_div_ps(bounds[0][k], scale[k]), offset[k]), castMax[k]);
+			__m128 upper = _mm_sub_ps(_mm_add_ps(_mm_div_ps(bounds[1][k], scale[k]), offset[k]), castMin[k]);
+			__m128 t0 = _mm_mul_ps(_mm_sub_ps(lower, origin[k]), inverseDirection[k]);
+			__m128 t1 = _mm_mul_ps(_mm_sub_ps(upper, origin[k]), inverseDirection[k]);
+			tmin = _mm_max_ps(tmin, _mm_min_ps(t0, t1));
+			tmax = _mm_min_ps(tmax, _mm_max_ps(t0, t1));
+		}
+		__m128 hit = _mm_and_ps(_mm_cmple_ps(tmin, tmax), _mm_and_ps(_mm_cmplt_ps(tmin, lambda), _mm_cmpgt_ps(tmax, zero)));
+		mask &= _mm_movemask_ps(hit);
+#else
+		for (int i = 0; i < 4; i++)
+		{
+			if (!(mask & (1 << i)))
+				continue;
+			unsigned short int quantizedAabbMin[3];
+			unsigned short int quantizedAabbMax[3];
+			btQuantizedBvh4GetChildAabb(node, i, quantizedAabbMin, quantizedAabbMax);
+			btVector3 bounds[2];
+			bounds[0] = m_bvh->unQuantize(quantizedAabbMin) - aabbMax;
+			bounds[1] = m_bvh->unQuantize(quantizedAabbMax) - aabbMin;
+			btScalar param = 1.0;
+			if (!btRayAabb2(raySource, rayDirection, sign, bounds, param, 0.0f, lambda_max))
+			{
+				mask &= ~(1 << i);
+			}
+		}
+#endif  //BT_USE_SSE
+
+		for (int i = 0; i < 4; i++)
+		{
+			if ((mask & (1 << i)) && node.m_children[i] >= 0)
+			{
+				btQuantizedBvh4ProcessLeaf(nodeCallback, node.m_children[i]);
+			}
+		}
+		for (int i = 3; i >= 0; i--)
+		{
+			if ((mask & (1 << i)) && node.m_children[i] < 0)
+			{
+				btAssert(stackSize < MAX_STACK_SIZE);
+				stack[stackSize++] = ~node.m_children[i];
+			}
+		}
+	}
+}
+
+void btQuantizedBvh4::reportAabbOverlappingNodex(btNodeOverlapCallback* nodeCallback, const btVector3& aabbMin, const btVector3& aabbMax) const
+{
+	if (!m_numNodes)
+		return;
+	unsigned short int quantizedQueryAabbMin[3];
+	unsigned short int quantizedQueryAabbMax[3];
+	m_bvh->quantizeWithClamp(quantizedQueryAabbMin, aabbMin, 0);
+	m_bvh->quantizeWithClamp(quantizedQueryAabbMax, aabbMax, 1);
+	walkTree(nodeCallback, quantizedQueryAabbMin, quantizedQueryAabbMax);
+}
+
+void btQuantizedBvh4::reportRayOverlappingNodex(btNodeOverlapCallback* nodeCallback, const btVector3& raySource, const btVector3& rayTarget) const
+{
+	reportBoxCastOverlappingNodex(nodeCallback, raySource, rayTarget, btVector3(0, 0, 0), btVector3(0, 0, 0));
+}
+
+void btQuantizedBvh4::reportBoxCastOverlappingNodex(btNodeOverlapCallback* nodeCallback, const btVector3& raySource, const btVector3& rayTarget, const btVector3& aabbMin, const btVector3& aabbMax) const
+{
+	if (!m_numNodes)
+		return;
+	walkTreeAgainstRay(nodeCallback, raySource, rayTarget, aabbMin, aabbMax);
+}
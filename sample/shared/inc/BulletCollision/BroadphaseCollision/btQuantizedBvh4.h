@@ -0,0 +1,104 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_QUANTIZED_BVH4_H
+#define BT_QUANTIZED_BVH4_H
+
+#include "btQuantizedBvh.h"
+
+///btQuantizedBvh4Node holds the quantized aabbs of up to 4 children in one cache line.
+///The bounds are stored as signed shorts such that one signed compare per bound tests all 4 children:
+///a minimum is the quantized value with the top bit flipped, a maximum its complement, so that a child overlaps a query if no bound is larger than the bound of the query.
+///m_bounds[0] holds min x and min y of the children 0-3, m_bounds[1] min z and max x, m_bounds[2] max y and max z
+ATTRIBUTE_ALIGNED64(struct)
+btQuantizedBvh4Node
+{
+	short m_bounds[3][8];
+	///the m_escapeIndexOrTriangleIndex of a leaf (>= 0), the complement of a node index (< 0) or EMPTY_CHILD
+	int m_children[4];
+};
+
+///btQuantizedBvh4 is a 4-ary copy of the tree of a quantized btQuantizedBvh for faster queries.
+///Each node is made of up to 4 nodes of the binary tree (the children with the largest surface area are opened first),
+///and the aabbs of its children are tested against the query aabb with a single SSE2 sequence, rays against them with 4-wide slab tests.
+///The nodes of the btQuantizedBvh are not changed, so it can still be serialized and used on its own.
+///The btQuantizedBvh4 has to be built again after the btQuantizedBvh is built again. A refit keeps the topology of the binary tree,
+///so after btOptimizedBvh::refit/refitPartial the bounds are copied in place with refit/refitPartial
+ATTRIBUTE_ALIGNED16(class)
+btQuantizedBvh4
+{
+protected:
+	const btQuantizedBvh* m_bvh;
+	btQuantizedBvh4Node* m_nodes;
+	int m_numNodes;
+	int m_maxDepth;
+	///for every node of the binary tree the child (4 * node index + child) that holds its bounds, or -1 if it was opened
+	btAlignedObjectArray<int> m_childOfNode;
+	///the aabbs of the subtree headers when the bounds were last copied, refitPartial tests them like btOptimizedBvh::refitPartial
+	BvhSubtreeInfoArray m_subtreeHeaders;
+
+	int collectChildren(const btQuantizedBvhNode* nodes, int nodeIndex, int children[4]) const;
+	int countNodes(const btQuantizedBvhNode* nodes, int nodeIndex, int depth);
+	int buildNode(const btQuantizedBvhNode* nodes, int nodeIndex);
+	void setChildBounds(int child, const btQuantizedBvhNode& node);
+	void refitRange(int firstNode, int endNode);
+
+	void walkTree(btNodeOverlapCallback * nodeCallback, const unsigned short* quantizedQueryAabbMin, const unsigned short* quantizedQueryAabbMax) const;
+	void walkTreeAgainstRay(btNodeOverlapCallback * nodeCallback, const btVector3& raySource, const btVector3& rayTarget, const btVector3& aabbMin, const btVector3& aabbMax) const;
+
+public:
+	enum
+	{
+		EMPTY_CHILD = (int)0x80000000,
+		///the traversal stack holds at most 3 entries per level
+		MAX_STACK_SIZE = 512
+	};
+
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	btQuantizedBvh4();
+	virtual ~btQuantizedBvh4();
+
+	///builds the nodes from a quantized bvh, which has to live as long as the btQuantizedBvh4.
+	///Returns false (and leaves the btQuantizedBvh4 empty) if the bvh is not quantized or too deep for the traversal stack
+	bool build(const btQuantizedBvh& bvh);
+
+	void clear();
+
+	///copies the bounds of all nodes after btOptimizedBvh::refit
+	void refit();
+
+	///copies the bounds of the subtrees that btOptimizedBvh::refitPartial updated, call it after that with the same aabb
+	void refitPartial(const btVector3& aabbMin, const btVector3& aabbMax);
+
+	void reportAabbOverlappingNodex(btNodeOverlapCallback * nodeCallback, const btVector3& aabbMin, const btVector3& aabbMax) const;
+	void reportRayOverlappingNodex(btNodeOverlapCallback * nodeCallback, const btVector3& raySource, const btVector3& rayTarget) const;
+	void reportBoxCastOverlappingNodex(btNodeOverlapCallback * nodeCallback, const btVector3& raySource, const btVector3& rayTarget, const btVector3& aabbMin, const btVector3& aabbMax) const;
+
+	int getNumNodes() const
+	{
+		return m_numNodes;
+	}
+	int getMaxDepth() const
+	{
+		return m_maxDepth;
+	}
+	const btQuantizedBvh* getBvh() const
+	{
+		return m_bvh;
+	}
+};
+
+#endif  //BT_QUANTIZED_BVH4_H
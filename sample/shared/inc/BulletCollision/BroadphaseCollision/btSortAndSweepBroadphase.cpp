@@ -0,0 +1,1095 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btSortAndSweepBroadphase.h"
+#include "btDbvtBroadphase.h"
+#include "LinearMath/btAabbUtil2.h"
+#include "LinearMath/btQuickprof.h"
+#include "LinearMath/btThreads.h"
+
+#include <new>
+#include <stdio.h>
+#include <string.h>
+
+// Proxies (or pair keys) per task and the maximum number of tasks of one parallel step.
+// The split does not depend on the number of threads, so the results do not either.
+static const int btSortAndSweepGrain = 2048;
+static const int btSortAndSweepMaxTasks = 64;
+
+// Grid cells are at least this many times the mean aabb extent, hold this many proxies on average
+// and there are at most this many along each grid axis (the cell coordinates are packed into 16 bits each)
+static const btScalar btSortAndSweepCellSize = 4;
+static const int btSortAndSweepCellProxies = 32;
+static const int btSortAndSweepMaxCells = 256;
+
+typedef btSortAndSweepBroadphase::btSortAndSweepTask btSortAndSweepTask;
+
+static int btSortAndSweepNumTasks(int n)
+{
+	return btMax(1, btMin(btSortAndSweepMaxTasks, (n + btSortAndSweepGrain - 1) / btSortAndSweepGrain));
+}
+
+static void btSortAndSweepRange(int task, int numTasks, int n, int& begin, int& end)
+{
+	begin = int((long long)n * task / numTasks);
+	end = int((long long)n * (task + 1) / numTasks);
+}
+
+static void btSortAndSweepParallelFor(int numTasks, const btIParallelForBody& body)
+{
+#if BT_THREADSAFE
+	btITaskScheduler* scheduler = btGetTaskScheduler();
+	if (numTasks > 1 && scheduler && scheduler->getNumThreads() > 1)
+	{
+		btParallelFor(0, numTasks, 1, body);
+		return;
+	}
+#endif  //BT_THREADSAFE
+	body.forLoop(0, numTasks);
+}
+
+///btSortAndSweepFloatKey maps a float to an unsigned int with the same order, so that endpoints can be radix sorted.
+///Negative numbers flip all bits, positive numbers only the sign bit. -0 is turned into +0 first
+static SIMD_FORCE_INLINE unsigned int btSortAndSweepFloatKey(btScalar value)
+{
+	union {
+		float m_float;
+		unsigned int m_bits;
+	} convert;
+	convert.m_float = float(value) + 0.0f;
+	return (convert.m_bits & 0x80000000u) ? ~convert.m_bits : (convert.m_bits | 0x80000000u);
+}
+
+static SIMD_FORCE_INLINE int btSortAndSweepLowestBit(int bits)
+{
+	int k = 0;
+	while (!(bits & (1 << k)))
+		k++;
+	return k;
+}
+
+//
+// Parallel steps
+//
+
+struct btSortAndSweepHistogramBody : public btIParallelForBody
+{
+	const btSortAndSweepKey* m_keys;
+	btSortAndSweepTask* const* m_tasks;
+	int m_numKeys;
+	int m_numTasks;
+	int m_shift;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int t = iBegin; t < iEnd; ++t)
+		{
+			int* histogram = m_tasks[t]->m_histogram;
+			memset(histogram, 0, 256 * sizeof(int));
+			int begin, end;
+			btSortAndSweepRange(t, m_numTasks, m_numKeys, begin, end);
+			for (int i = begin; i < end; ++i)
+			{
+				histogram[(m_keys[i] >> m_shift) & 255]++;
+			}
+		}
+	}
+};
+
+struct btSortAndSweepScatterBody : public btIParallelForBody
+{
+	const btSortAndSweepKey* m_keys;
+	btSortAndSweepKey* m_sorted;
+	btSortAndSweepTask* const* m_tasks;
+	int m_numKeys;
+	int m_numTasks;
+	int m_shift;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int t = iBegin; t < iEnd; ++t)
+		{
+			int* offsets = m_tasks[t]->m_histogram;
+			int begin, end;
+			btSortAndSweepRange(t, m_numTasks, m_numKeys, begin, end);
+			for (int i = begin; i < end; ++i)
+			{
+				btSortAndSweepKey key = m_keys[i];
+				m_sorted[offsets[(key >> m_shift) & 255]++] = key;
+			}
+		}
+	}
+};
+
+///the upper half of an endpoint is the key of the aabb minimum on the sweep axis, the lower half the index in the live proxies
+struct btSortAndSweepEndpointBody : public btIParallelForBody
+{
+	btSortAndSweepProxy* const* m_proxies;
+	btSortAndSweepKey* m_endpoints;
+	int m_numProxies;
+	int m_numTasks;
+	int m_axis;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int t = iBegin; t < iEnd; ++t)
+		{
+			int begin, end;
+			btSortAndSweepRange(t, m_numTasks, m_numProxies, begin, end);
+			for (int i = begin; i < end; ++i)
+			{
+				m_endpoints[i] = (btSortAndSweepKey(btSortAndSweepFloatKey(m_proxies[i]->m_aabbMin[m_axis])) << 32) | unsigned(i);
+			}
+		}
+	}
+};
+
+///copies the aabbs and ids in sorted order, the passes that follow read them in (nearly) sequential order
+struct btSortAndSweepSortedBody : public btIParallelForBody
+{
+	btSortAndSweepProxy* const* m_proxies;
+	const btSortAndSweepKey* m_endpoints;
+	btVector3* m_aabbs;
+	unsigned int* m_ids;
+	int m_numProxies;
+	int m_numTasks;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int t = iBegin; t < iEnd; ++t)
+		{
+			int begin, end;
+			btSortAndSweepRange(t, m_numTasks, m_numProxies, begin, end);
+			for (int i = begin; i < end; ++i)
+			{
+				const btSortAndSweepProxy* proxy = m_proxies[unsigned(m_endpoints[i])];
+				m_aabbs[2 * i] = proxy->m_aabbMin;
+				m_aabbs[2 * i + 1] = proxy->m_aabbMax;
+				m_ids[8 * i] = proxy->m_uniqueId;
+				m_ids[8 * i + 1] = proxy->m_collisionFilterGroup;
+				m_ids[8 * i + 2] = proxy->m_collisionFilterMask;
+			}
+		}
+	}
+};
+
+///btSortAndSweepGrid maps a coordinate to a cell on the two grid axes. The mapping only has to be monotonic (coordinates
+///outside the grid go to the border cells), then two aabbs that overlap share a cell, so any grid gives the same pairs
+struct btSortAndSweepGrid
+{
+	int m_axis[2];
+	int m_numCells[2];
+	btScalar m_origin[2];
+	btScalar m_scale[2];
+
+	SIMD_FORCE_INLINE unsigned int cell(int k, btScalar value) const
+	{
+		btScalar c = (value - m_origin[k]) * m_scale[k];
+		if (!(c > btScalar(0)))
+			return 0;
+		if (c >= btScalar(m_numCells[k] - 1))
+			return m_numCells[k] - 1;
+		return unsigned(c);
+	}
+};
+
+///computes the cells of each proxy in sorted order and counts (or writes) the cell entries,
+///and sums up the aabbs to choose the sweep axis and the grid of the next call
+struct btSortAndSweepCellBody : public btIParallelForBody
+{
+	const btVector3* m_aabbs;
+	btSortAndSweepTask* const* m_tasks;
+	unsigned int* m_ids;
+	btSortAndSweepKey* m_entries;  // 0 to count the entries
+	btSortAndSweepGrid m_grid;
+	int m_numProxies;
+	int m_numTasks;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int t = iBegin; t < iEnd; ++t)
+		{
+			btSortAndSweepTask* task = m_tasks[t];
+			int begin, end;
+			btSortAndSweepRange(t, m_numTasks, m_numProxies, begin, end);
+			if (m_entries)
+			{
+				btSortAndSweepKey* entry = m_entries + task->m_firstEntry;
+				for (unsigned int i = begin; i < unsigned(end); ++i)
+				{
+					const unsigned int* range = &m_ids[8 * i + 4];
+					for (unsigned int c0 = range[0]; c0 <= range[1]; ++c0)
+					{
+						for (unsigned int c1 = range[2]; c1 <= range[3]; ++c1)
+						{
+							*entry++ = (btSortAndSweepKey((c0 << 16) | c1) << 32) | i;
+						}
+					}
+				}
+				continue;
+			}
+
+			int numEntries = 0;
+			btVector3 sum(0, 0, 0), sumSq(0, 0, 0), extent(0, 0, 0);
+			btVector3 centerMin(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT), centerMax(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+			for (int i = begin; i < end; ++i)
+			{
+				const btVector3& aabbMin = m_aabbs[2 * i];
+				const btVector3& aabbMax = m_aabbs[2 * i + 1];
+				unsigned int* range = &m_ids[8 * i + 4];
+				range[0] = m_grid.cell(0, aabbMin[m_grid.m_axis[0]]);
+				range[1] = m_grid.cell(0, aabbMax[m_grid.m_axis[0]]);
+				range[2] = m_grid.cell(1, aabbMin[m_grid.m_axis[1]]);
+				range[3] = m_grid.cell(1, aabbMax[m_grid.m_axis[1]]);
+				numEntries += (range[1] - range[0] + 1) * (range[3] - range[2] + 1);
+
+				btVector3 center = (aabbMin + aabbMax) * btScalar(0.5);
+				sum += center;
+				sumSq += center * center;
+				centerMin.setMin(center);
+				centerMax.setMax(center);
+				extent += aabbMax - aabbMin;
+			}
+			task->m_numEntries = numEntries;
+			task->m_sum = sum;
+			task->m_sumSq = sumSq;
+			task->m_centerMin = centerMin;
+			task->m_centerMax = centerMax;
+			task->m_extent = extent;
+		}
+	}
+};
+
+///copies the data needed by the sweep into arrays in the order of the cell entries
+struct btSortAndSweepGatherBody : public btIParallelForBody
+{
+	const btSortAndSweepKey* m_endpoints;
+	const btVector3* m_aabbs;
+	const unsigned int* m_sortedIds;
+	const btSortAndSweepKey* m_entries;
+	btScalar* m_bounds;
+	unsigned int* m_ids;
+	int m_numEntries;
+	int m_numTasks;
+	int m_axis;
+	int m_gridAxis[2];
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		const int n = m_numEntries;
+		for (int t = iBegin; t < iEnd; ++t)
+		{
+			int begin, end;
+			btSortAndSweepRange(t, m_numTasks, n, begin, end);
+			for (int e = begin; e < end; ++e)
+			{
+				const unsigned int i = unsigned(m_entries[e]);
+				const btVector3& aabbMin = m_aabbs[2 * i];
+				const btVector3& aabbMax = m_aabbs[2 * i + 1];
+				const unsigned int* ids = &m_sortedIds[8 * i];
+				m_bounds[e] = aabbMin[m_gridAxis[0]];
+				m_bounds[n + e] = aabbMin[m_gridAxis[1]];
+				m_bounds[2 * n + e] = aabbMax[m_gridAxis[0]];
+				m_bounds[3 * n + e] = aabbMax[m_gridAxis[1]];
+				m_ids[e] = ids[0];
+				m_ids[n + e] = ids[1];
+				m_ids[2 * n + e] = ids[2];
+				m_ids[3 * n + e] = unsigned(m_endpoints[i] >> 32);
+				m_ids[4 * n + e] = btSortAndSweepFloatKey(aabbMax[m_axis]);
+				m_ids[5 * n + e] = unsigned(m_entries[e] >> 32);
+				m_ids[6 * n + e] = (ids[4] << 16) | ids[6];
+			}
+		}
+	}
+};
+
+///each entry is tested against the following ones of the same cell until their minimum passes its maximum.
+///Those overlap on the sweep axis (with double precision the float keys may add pairs that are apart by less than a float ulp),
+///so only the grid axes and the filters are tested. Most of the tests fail, with SSE 4 entries are tested at once without branches
+struct btSortAndSweepSweepBody : public btIParallelForBody
+{
+	btSortAndSweepTask* const* m_tasks;
+	const btScalar* m_bounds;
+	const unsigned int* m_ids;
+	int m_numEntries;
+	int m_numTasks;
+
+	static SIMD_FORCE_INLINE void addPair(btAlignedObjectArray<btSortAndSweepKey>& pairs, unsigned int uid, unsigned int other,
+										  unsigned int cell, unsigned int firstCell, unsigned int otherFirstCell)
+	{
+		// a pair that shares several cells is reported by the first one only
+		unsigned int first = (btMax(firstCell >> 16, otherFirstCell >> 16) << 16) | btMax(firstCell & 0xffff, otherFirstCell & 0xffff);
+		if (first == cell)
+		{
+			pairs.push_back(uid < other ? (btSortAndSweepKey(uid) << 32) | other : (btSortAndSweepKey(other) << 32) | uid);
+		}
+	}
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		const int n = m_numEntries;
+		const btScalar* min1 = m_bounds;
+		const btScalar* min2 = m_bounds + n;
+		const btScalar* max1 = m_bounds + 2 * n;
+		const btScalar* max2 = m_bounds + 3 * n;
+		const unsigned int* uids = m_ids;
+		const unsigned int* groups = m_ids + n;
+		const unsigned int* masks = m_ids + 2 * n;
+		const unsigned int* minKeys = m_ids + 3 * n;
+		const unsigned int* maxKeys = m_ids + 4 * n;
+		const unsigned int* cells = m_ids + 5 * n;
+		const unsigned int* firstCells = m_ids + 6 * n;
+
+		for (int t = iBegin; t < iEnd; ++t)
+		{
+			btAlignedObjectArray<btSortAndSweepKey>& pairs = m_tasks[t]->m_pairs;
+			pairs.resize(0);
+			int begin, end;
+			btSortAndSweepRange(t, m_numTasks, n, begin, end);
+			for (int i = begin; i < end; ++i)
+			{
+				const unsigned int uid = uids[i];
+				const unsigned int group = groups[i];
+				const unsigned int mask = masks[i];
+				const unsigned int maxKey = maxKeys[i];
+				const unsigned int cell = cells[i];
+				int j = i + 1;
+#if defined(BT_USE_SSE) && !defined(BT_USE_DOUBLE_PRECISION)
+				const __m128 imin1 = _mm_set1_ps(min1[i]), imin2 = _mm_set1_ps(min2[i]);
+				const __m128 imax1 = _mm_set1_ps(max1[i]), imax2 = _mm_set1_ps(max2[i]);
+				const __m128i igroup = _mm_set1_epi32(int(group)), imask = _mm_set1_epi32(int(mask));
+				const __m128i sign = _mm_set1_epi32(int(0x80000000u));
+				const __m128i imaxKey = _mm_xor_si128(_mm_set1_epi32(int(maxKey)), sign);
+				const __m128i icell = _mm_set1_epi32(int(cell));
+				const __m128i zero = _mm_setzero_si128();
+				for (; j + 4 <= n; j += 4)
+				{
+					// unsigned compare of the keys through a signed compare with flipped sign bits
+					__m128i past = _mm_cmpgt_epi32(_mm_xor_si128(_mm_loadu_si128((const __m128i*)&minKeys[j]), sign), imaxKey);
+					past = _mm_or_si128(past, _mm_xor_si128(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)&cells[j]), icell), _mm_set1_epi32(-1)));
+					__m128 overlap = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(imin1, _mm_loadu_ps(&max1[j])), _mm_cmple_ps(_mm_loadu_ps(&min1[j]), imax1)),
+												_mm_and_ps(_mm_cmple_ps(imin2, _mm_loadu_ps(&max2[j])), _mm_cmple_ps(_mm_loadu_ps(&min2[j]), imax2)));
+					__m128i filtered = _mm_or_si128(_mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128((const __m128i*)&groups[j]), imask), zero),
+													_mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128((const __m128i*)&masks[j]), igroup), zero));
+					int bits = _mm_movemask_ps(_mm_andnot_ps(_mm_castsi128_ps(_mm_or_si128(past, filtered)), overlap));
+					while (bits)
+					{
+						int k = j + btSortAndSweepLowestBit(bits);
+						bits &= bits - 1;
+						addPair(pairs, uid, uids[k], cell, firstCells[i], firstCells[k]);
+					}
+					if (_mm_movemask_epi8(past))
+					{
+						j = n;  // the rest lie beyond the max or in other cells
+						break;
+					}
+				}
+#endif
+				for (; j < n && minKeys[j] <= maxKey && cells[j] == cell; ++j)
+				{
+					int overlap = (min1[i] <= max1[j]) & (min1[j] <= max1[i]) & (min2[i] <= max2[j]) & (min2[j] <= max2[i]) &
+								  ((groups[j] & mask) != 0) & ((group & masks[j]) != 0);
+					if (overlap)
+					{
+						addPair(pairs, uid, uids[j], cell, firstCells[i], firstCells[j]);
+					}
+				}
+			}
+		}
+	}
+};
+
+static int btSortAndSweepLowerBound(const btAlignedObjectArray<btSortAndSweepKey>& keys, btSortAndSweepKey key)
+{
+	int lo = 0, hi = keys.size();
+	while (lo < hi)
+	{
+		int mid = (lo + hi) >> 1;
+		if (keys[mid] < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+///merges the sorted pairs of the previous and the current call, each task takes a range of the current pairs
+struct btSortAndSweepDiffBody : public btIParallelForBody
+{
+	const btAlignedObjectArray<btSortAndSweepKey>* m_previous;
+	const btAlignedObjectArray<btSortAndSweepKey>* m_current;
+	btSortAndSweepTask* const* m_tasks;
+	int m_numTasks;
+
+	int split(int task, int& currentBegin) const
+	{
+		currentBegin = int((long long)m_current->size() * task / m_numTasks);
+		if (task == 0)
+			return 0;
+		if (currentBegin >= m_current->size())
+			return m_previous->size();
+		return btSortAndSweepLowerBound(*m_previous, (*m_current)[currentBegin]);
+	}
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int t = iBegin; t < iEnd; ++t)
+		{
+			btAlignedObjectArray<btSortAndSweepKey>& added = m_tasks[t]->m_added;
+			btAlignedObjectArray<btSortAndSweepKey>& removed = m_tasks[t]->m_removed;
+			added.resize(0);
+			removed.resize(0);
+
+			int i, iEnd2, j, jEnd;
+			j = split(t, i);
+			jEnd = split(t + 1, iEnd2);
+			while (i < iEnd2 && j < jEnd)
+			{
+				btSortAndSweepKey a = (*m_current)[i], b = (*m_previous)[j];
+				if (a < b)
+				{
+					added.push_back(a);
+					i++;
+				}
+				else if (b < a)
+				{
+					removed.push_back(b);
+					j++;
+				}
+				else
+				{
+					i++;
+					j++;
+				}
+			}
+			for (; i < iEnd2; i++)
+				added.push_back((*m_current)[i]);
+			for (; j < jEnd; j++)
+				removed.push_back((*m_previous)[j]);
+		}
+	}
+};
+
+///turns the added or removed pair keys of the diff tasks into pairs for the batch functions of the pair cache.
+///Pairs of destroyed proxies are not in the pair cache anymore, their unique ids are not reused before the next call
+struct btSortAndSweepChangedPairsBody : public btIParallelForBody
+{
+	btSortAndSweepTask* const* m_tasks;
+	int m_numTasks;
+	btSortAndSweepProxy* const* m_chunks;
+	bool m_removed;
+	btBroadphasePair* m_pairs;
+
+	btSortAndSweepProxy* getProxy(unsigned int uid) const
+	{
+		int index = int(uid) - 1;
+		return &m_chunks[index >> btSortAndSweepBroadphase::CHUNK_SHIFT][index & (btSortAndSweepBroadphase::CHUNK_SIZE - 1)];
+	}
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int t = iBegin; t < iEnd; ++t)
+		{
+			int first = 0;
+			for (int u = 0; u < t; u++)
+				first += m_removed ? m_tasks[u]->m_removed.size() : m_tasks[u]->m_added.size();
+
+			const btAlignedObjectArray<btSortAndSweepKey>& keys = m_removed ? m_tasks[t]->m_removed : m_tasks[t]->m_added;
+			for (int i = 0; i < keys.size(); i++)
+			{
+				new (&m_pairs[first + i]) btBroadphasePair(*getProxy(unsigned(keys[i] >> 32)), *getProxy(unsigned(keys[i])));
+			}
+		}
+	}
+};
+
+//
+// btSortAndSweepBroadphase
+//
+
+btSortAndSweepBroadphase::btSortAndSweepBroadphase(btOverlappingPairCache* pairCache, bool disableRaycastAccelerator)
+	: m_numIndices(0),
+	  m_pairCache(pairCache),
+	  m_ownsPairCache(false),
+	  m_raycastAccelerator(0),
+	  m_nullPairCache(0),
+	  m_axis(0),
+	  m_currentPairs(0),
+	  m_numAddedPairs(0),
+	  m_numRemovedPairs(0)
+{
+	if (!m_pairCache)
+	{
+		void* ptr = btAlignedAlloc(sizeof(btHashedOverlappingPairCache), 16);
+		m_pairCache = new (ptr) btHashedOverlappingPairCache();
+		m_ownsPairCache = true;
+	}
+
+	for (int k = 0; k < 2; k++)
+	{
+		m_numCells[k] = 1;
+		m_cellOrigin[k] = btScalar(0);
+		m_cellScale[k] = btScalar(0);
+	}
+
+	if (!disableRaycastAccelerator)
+	{
+		m_nullPairCache = new (btAlignedAlloc(sizeof(btNullPairCache), 16)) btNullPairCache();
+		m_raycastAccelerator = new (btAlignedAlloc(sizeof(btDbvtBroadphase), 16)) btDbvtBroadphase(m_nullPairCache);
+		m_raycastAccelerator->m_deferedcollide = true;  //don't add/remove pairs
+	}
+}
+
+btSortAndSweepBroadphase::~btSortAndSweepBroadphase()
+{
+	int i;
+	for (i = 0; i < m_chunks.size(); i++)
+	{
+		btAlignedFree(m_chunks[i]);
+	}
+	for (i = 0; i < m_tasks.size(); i++)
+	{
+		m_tasks[i]->~btSortAndSweepTask();
+		btAlignedFree(m_tasks[i]);
+	}
+	if (m_raycastAccelerator)
+	{
+		m_nullPairCache->~btOverlappingPairCache();
+		btAlignedFree(m_nullPairCache);
+		m_raycastAccelerator->~btDbvtBroadphase();
+		btAlignedFree(m_raycastAccelerator);
+	}
+	if (m_ownsPairCache)
+	{
+		m_pairCache->~btOverlappingPairCache();
+		btAlignedFree(m_pairCache);
+	}
+}
+
+btBroadphaseProxy* btSortAndSweepBroadphase::createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* dispatcher)
+{
+	int index;
+	if (m_freeIndices.size())
+	{
+		index = m_freeIndices[m_freeIndices.size() - 1];
+		m_freeIndices.pop_back();
+	}
+	else
+	{
+		index = m_numIndices++;
+		if ((index >> CHUNK_SHIFT) >= m_chunks.size())
+		{
+			m_chunks.push_back((btSortAndSweepProxy*)btAlignedAlloc(sizeof(btSortAndSweepProxy) * CHUNK_SIZE, 16));
+		}
+	}
+
+	btSortAndSweepProxy* proxy = new (&m_chunks[index >> CHUNK_SHIFT][index & (CHUNK_SIZE - 1)]) btSortAndSweepProxy();
+	proxy->m_aabbMin = aabbMin;
+	proxy->m_aabbMax = aabbMax;
+	proxy->m_clientObject = userPtr;
+	proxy->m_collisionFilterGroup = collisionFilterGroup;
+	proxy->m_collisionFilterMask = collisionFilterMask;
+	proxy->m_uniqueId = index + 1;
+	proxy->m_index = index;
+	proxy->m_liveIndex = m_liveProxies.size();
+	proxy->m_dbvtProxy = 0;
+	m_liveProxies.push_back(proxy);
+
+	if (m_raycastAccelerator)
+	{
+		proxy->m_dbvtProxy = m_raycastAccelerator->createProxy(aabbMin, aabbMax, shapeType, userPtr, collisionFilterGroup, collisionFilterMask, dispatcher);
+	}
+	return proxy;
+}
+
+void btSortAndSweepBroadphase::destroyProxy(btBroadphaseProxy* absproxy, btDispatcher* dispatcher)
+{
+	btSortAndSweepProxy* proxy = static_cast<btSortAndSweepProxy*>(absproxy);
+	if (m_raycastAccelerator)
+	{
+		m_raycastAccelerator->destroyProxy(proxy->m_dbvtProxy, dispatcher);
+	}
+	m_pairCache->removeOverlappingPairsContainingProxy(proxy, dispatcher);
+
+	btSortAndSweepProxy* last = m_liveProxies[m_liveProxies.size() - 1];
+	m_liveProxies[proxy->m_liveIndex] = last;
+	last->m_liveIndex = proxy->m_liveIndex;
+	m_liveProxies.pop_back();
+
+	// the pairs of the previous call still refer to the unique id, so the index is reused only after the next calculateOverlappingPairs
+	proxy->m_liveIndex = -1;
+	proxy->m_clientObject = 0;
+	m_pendingFreeIndices.push_back(proxy->m_index);
+}
+
+void btSortAndSweepBroadphase::setAabb(btBroadphaseProxy* absproxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher)
+{
+	btSortAndSweepProxy* proxy = static_cast<btSortAndSweepProxy*>(absproxy);
+	proxy->m_aabbMin = aabbMin;
+	proxy->m_aabbMax = aabbMax;
+	if (m_raycastAccelerator)
+	{
+		m_raycastAccelerator->setAabb(proxy->m_dbvtProxy, aabbMin, aabbMax, dispatcher);
+	}
+}
+
+void btSortAndSweepBroadphase::getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const
+{
+	aabbMin = proxy->m_aabbMin;
+	aabbMax = proxy->m_aabbMax;
+}
+
+void btSortAndSweepBroadphase::rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin, const btVector3& aabbMax)
+{
+	if (m_raycastAccelerator)
+	{
+		m_raycastAccelerator->rayTest(rayFrom, rayTo, rayCallback, aabbMin, aabbMax);
+		return;
+	}
+	for (int i = 0; i < m_liveProxies.size(); i++)
+	{
+		rayCallback.process(m_liveProxies[i]);
+	}
+}
+
+void btSortAndSweepBroadphase::aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback)
+{
+	if (m_raycastAccelerator)
+	{
+		m_raycastAccelerator->aabbTest(aabbMin, aabbMax, callback);
+		return;
+	}
+	for (int i = 0; i < m_liveProxies.size(); i++)
+	{
+		btSortAndSweepProxy* proxy = m_liveProxies[i];
+		if (TestAabbAgainstAabb2(aabbMin, aabbMax, proxy->m_aabbMin, proxy->m_aabbMax))
+		{
+			callback.process(proxy);
+		}
+	}
+}
+
+int btSortAndSweepBroadphase::getRayTestTrees(const btDbvt** trees, int maxTrees) const
+{
+	return m_raycastAccelerator ? m_raycastAccelerator->getRayTestTrees(trees, maxTrees) : 0;
+}
+
+int btSortAndSweepBroadphase::getNumTasks(int n)
+{
+	return btSortAndSweepNumTasks(n);
+}
+
+void btSortAndSweepBroadphase::getTaskRange(int task, int numTasks, int n, int& begin, int& end)
+{
+	btSortAndSweepRange(task, numTasks, n, begin, end);
+}
+
+void btSortAndSweepBroadphase::parallelFor(int numTasks, const btIParallelForBody& body)
+{
+	btSortAndSweepParallelFor(numTasks, body);
+}
+
+void btSortAndSweepBroadphase::sortKeys(btAlignedObjectArray<btSortAndSweepKey>& keys, int firstByte)
+{
+	// LSD radix sort, 8 bits per pass. Each task counts the digits of its range, the counts give every task
+	// its own output offsets per digit so the tasks scatter in parallel and the sort stays stable
+	int n = keys.size();
+	if (n < 2)
+		return;
+	int numTasks = btSortAndSweepNumTasks(n);
+	m_sortBuffer.resizeNoInitialize(n);
+	btSortAndSweepKey* src = &keys[0];
+	btSortAndSweepKey* dst = &m_sortBuffer[0];
+
+	for (int byte = firstByte; byte < 8; byte++)
+	{
+		btSortAndSweepHistogramBody histogram;
+		histogram.m_keys = src;
+		histogram.m_tasks = &m_tasks[0];
+		histogram.m_numKeys = n;
+		histogram.m_numTasks = numTasks;
+		histogram.m_shift = byte * 8;
+		btSortAndSweepParallelFor(numTasks, histogram);
+
+		// skip the pass if all keys have the same digit (e.g. the high bits of the unique ids)
+		bool skip = false;
+		int offset = 0;
+		for (int d = 0; d < 256 && !skip; d++)
+		{
+			int count = 0;
+			for (int t = 0; t < numTasks; t++)
+			{
+				int c = m_tasks[t]->m_histogram[d];
+				m_tasks[t]->m_histogram[d] = offset + count;
+				count += c;
+			}
+			skip = (count == n);
+			offset += count;
+		}
+		if (skip)
+			continue;
+
+		btSortAndSweepScatterBody scatter;
+		scatter.m_keys = src;
+		scatter.m_sorted = dst;
+		scatter.m_tasks = &m_tasks[0];
+		scatter.m_numKeys = n;
+		scatter.m_numTasks = numTasks;
+		scatter.m_shift = byte * 8;
+		btSortAndSweepParallelFor(numTasks, scatter);
+		btSwap(src, dst);
+	}
+
+	if (src != &keys[0])
+	{
+		memcpy(&keys[0], src, n * sizeof(btSortAndSweepKey));
+	}
+}
+
+void btSortAndSweepBroadphase::updateGrid(int numProxies, int numTasks)
+{
+	btVector3 sum(0, 0, 0), sumSq(0, 0, 0), extent(0, 0, 0);
+	btVector3 centerMin(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT), centerMax(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+	for (int t = 0; t < numTasks; t++)
+	{
+		sum += m_tasks[t]->m_sum;
+		sumSq += m_tasks[t]->m_sumSq;
+		centerMin.setMin(m_tasks[t]->m_centerMin);
+		centerMax.setMax(m_tasks[t]->m_centerMax);
+		extent += m_tasks[t]->m_extent;
+	}
+	const btScalar n = btScalar(numProxies);
+
+	// sweep along the axis with the largest variance of the aabb centers
+	m_axis = (sumSq - sum * sum / n).maxAxis();
+
+	// cells on the other two axes span the aabb centers and are a few times larger than the mean aabb
+	int k, numCells[2];
+	btScalar range[2];
+	for (k = 0; k < 2; k++)
+	{
+		int axis = (m_axis + 1 + k) % 3;
+		range[k] = centerMax[axis] - centerMin[axis];
+		btScalar size = btSortAndSweepCellSize * extent[axis] / n;
+		numCells[k] = (size > btScalar(0) && range[k] > size) ? int(btMin(range[k] / size, btScalar(btSortAndSweepMaxCells))) : 1;
+		m_cellOrigin[k] = centerMin[axis];
+	}
+	int maxCells = btMax(1, numProxies / btSortAndSweepCellProxies);
+	while (numCells[0] * numCells[1] > maxCells)
+	{
+		k = (numCells[0] > numCells[1]) ? 0 : 1;
+		numCells[k] = btMax(1, numCells[k] * 3 / 4);
+	}
+	for (k = 0; k < 2; k++)
+	{
+		m_numCells[k] = numCells[k];
+		m_cellScale[k] = (numCells[k] > 1) ? btScalar(numCells[k]) / range[k] : btScalar(0);
+	}
+}
+
+void btSortAndSweepBroadphase::mergeTaskPairs(int numTasks, btAlignedObjectArray<btSortAndSweepKey>& pairs)
+{
+	int t, numPairs = 0;
+	for (t = 0; t < numTasks; t++)
+	{
+		numPairs += m_tasks[t]->m_pairs.size();
+	}
+	pairs.resizeNoInitialize(numPairs);
+	numPairs = 0;
+	for (t = 0; t < numTasks; t++)
+	{
+		const btAlignedObjectArray<btSortAndSweepKey>& taskPairs = m_tasks[t]->m_pairs;
+		if (taskPairs.size())
+		{
+			memcpy(&pairs[numPairs], &taskPairs[0], taskPairs.size() * sizeof(btSortAndSweepKey));
+			numPairs += taskPairs.size();
+		}
+	}
+	sortKeys(pairs, 0);
+}
+
+void btSortAndSweepBroadphase::findOverlappingPairs(btAlignedObjectArray<btSortAndSweepKey>& pairs)
+{
+	BT_PROFILE("sort and sweep");
+	const int n = m_liveProxies.size();
+	const int numTasks = btSortAndSweepNumTasks(n);
+	m_endpoints.resizeNoInitialize(n);
+
+	btSortAndSweepEndpointBody endpoints;
+	endpoints.m_proxies = &m_liveProxies[0];
+	endpoints.m_endpoints = &m_endpoints[0];
+	endpoints.m_numProxies = n;
+	endpoints.m_numTasks = numTasks;
+	endpoints.m_axis = m_axis;
+	btSortAndSweepParallelFor(numTasks, endpoints);
+
+	// only the upper half (the aabb minimum) needs sorting, the live indices are unique
+	sortKeys(m_endpoints, 4);
+
+	m_sortedAabbs.resizeNoInitialize(2 * n);
+	m_sortedIds.resizeNoInitialize(8 * n);
+
+	btSortAndSweepSortedBody sorted;
+	sorted.m_proxies = &m_liveProxies[0];
+	sorted.m_endpoints = &m_endpoints[0];
+	sorted.m_aabbs = &m_sortedAabbs[0];
+	sorted.m_ids = &m_sortedIds[0];
+	sorted.m_numProxies = n;
+	sorted.m_numTasks = numTasks;
+	btSortAndSweepParallelFor(numTasks, sorted);
+
+	// cell entries in the order of the endpoints, then sorted by cell (stable, so each cell stays in endpoint order)
+	btSortAndSweepCellBody cells;
+	cells.m_aabbs = &m_sortedAabbs[0];
+	cells.m_tasks = &m_tasks[0];
+	cells.m_ids = &m_sortedIds[0];
+	cells.m_entries = 0;
+	for (int k = 0; k < 2; k++)
+	{
+		cells.m_grid.m_axis[k] = (m_axis + 1 + k) % 3;
+		cells.m_grid.m_numCells[k] = m_numCells[k];
+		cells.m_grid.m_origin[k] = m_cellOrigin[k];
+		cells.m_grid.m_scale[k] = m_cellScale[k];
+	}
+	cells.m_numProxies = n;
+	cells.m_numTasks = numTasks;
+	btSortAndSweepParallelFor(numTasks, cells);
+
+	int t, numEntries = 0;
+	for (t = 0; t < numTasks; t++)
+	{
+		m_tasks[t]->m_firstEntry = numEntries;
+		numEntries += m_tasks[t]->m_numEntries;
+	}
+	m_entries.resizeNoInitialize(numEntries);
+	cells.m_entries = &m_entries[0];
+	btSortAndSweepParallelFor(numTasks, cells);
+	if (m_numCells[0] * m_numCells[1] > 1)
+	{
+		sortKeys(m_entries, 4);
+	}
+
+	const int numEntryTasks = btSortAndSweepNumTasks(numEntries);
+	m_entryBounds.resizeNoInitialize(4 * numEntries);
+	m_entryIds.resizeNoInitialize(7 * numEntries);
+
+	btSortAndSweepGatherBody gather;
+	gather.m_endpoints = &m_endpoints[0];
+	gather.m_aabbs = &m_sortedAabbs[0];
+	gather.m_sortedIds = &m_sortedIds[0];
+	gather.m_entries = &m_entries[0];
+	gather.m_bounds = &m_entryBounds[0];
+	gather.m_ids = &m_entryIds[0];
+	gather.m_numEntries = numEntries;
+	gather.m_numTasks = numEntryTasks;
+	gather.m_axis = m_axis;
+	gather.m_gridAxis[0] = cells.m_grid.m_axis[0];
+	gather.m_gridAxis[1] = cells.m_grid.m_axis[1];
+	btSortAndSweepParallelFor(numEntryTasks, gather);
+
+	btSortAndSweepSweepBody sweep;
+	sweep.m_tasks = &m_tasks[0];
+	sweep.m_bounds = &m_entryBounds[0];
+	sweep.m_ids = &m_entryIds[0];
+	sweep.m_numEntries = numEntries;
+	sweep.m_numTasks = numEntryTasks;
+	btSortAndSweepParallelFor(numEntryTasks, sweep);
+
+	mergeTaskPairs(numEntryTasks, pairs);
+
+	updateGrid(n, numTasks);
+}
+
+void btSortAndSweepBroadphase::calculateOverlappingPairs(btDispatcher* dispatcher)
+{
+	BT_PROFILE("btSortAndSweepBroadphase::calculateOverlappingPairs");
+
+	while (m_tasks.size() < btSortAndSweepMaxTasks)
+	{
+		void* ptr = btAlignedAlloc(sizeof(btSortAndSweepTask), 16);
+		m_tasks.push_back(new (ptr) btSortAndSweepTask());
+	}
+
+	btAlignedObjectArray<btSortAndSweepKey>& previous = m_pairs[m_currentPairs];
+	btAlignedObjectArray<btSortAndSweepKey>& current = m_pairs[1 - m_currentPairs];
+	current.resize(0);
+
+	if (m_liveProxies.size())
+	{
+		findOverlappingPairs(current);
+	}
+
+	{
+		BT_PROFILE("update pair cache");
+		int numDiffTasks = btSortAndSweepNumTasks(current.size() + previous.size());
+
+		btSortAndSweepDiffBody diff;
+		diff.m_previous = &previous;
+		diff.m_current = &current;
+		diff.m_tasks = &m_tasks[0];
+		diff.m_numTasks = numDiffTasks;
+		btSortAndSweepParallelFor(numDiffTasks, diff);
+
+		// removed pairs first, so that the added pairs can reuse their slots. The batches are in the order of the pair keys,
+		// the pair cache applies them on many threads but keeps that order
+		m_numAddedPairs = 0;
+		m_numRemovedPairs = 0;
+		for (int t = 0; t < numDiffTasks; t++)
+		{
+			m_numAddedPairs += m_tasks[t]->m_added.size();
+			m_numRemovedPairs += m_tasks[t]->m_removed.size();
+		}
+
+		btSortAndSweepChangedPairsBody changed;
+		changed.m_tasks = &m_tasks[0];
+		changed.m_numTasks = numDiffTasks;
+		changed.m_chunks = m_chunks.size() ? &m_chunks[0] : 0;
+		if (m_numRemovedPairs)
+		{
+			m_changedPairs.resizeNoInitialize(m_numRemovedPairs);
+			changed.m_removed = true;
+			changed.m_pairs = &m_changedPairs[0];
+			btSortAndSweepParallelFor(numDiffTasks, changed);
+			m_pairCache->removeOverlappingPairs(&m_changedPairs[0], m_numRemovedPairs, dispatcher);
+		}
+		if (m_numAddedPairs)
+		{
+			m_changedPairs.resizeNoInitialize(m_numAddedPairs);
+			changed.m_removed = false;
+			changed.m_pairs = &m_changedPairs[0];
+			btSortAndSweepParallelFor(numDiffTasks, changed);
+			m_pairCache->addOverlappingPairs(&m_changedPairs[0], m_numAddedPairs);
+		}
+	}
+
+	m_currentPairs = 1 - m_currentPairs;
+
+	for (int i = 0; i < m_pendingFreeIndices.size(); i++)
+	{
+		m_freeIndices.push_back(m_pendingFreeIndices[i]);
+	}
+	m_pendingFreeIndices.resize(0);
+}
+
+void btSortAndSweepBroadphase::getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const
+{
+	if (!m_liveProxies.size())
+	{
+		aabbMin.setValue(0, 0, 0);
+		aabbMax.setValue(0, 0, 0);
+		return;
+	}
+	aabbMin = m_liveProxies[0]->m_aabbMin;
+	aabbMax = m_liveProxies[0]->m_aabbMax;
+	for (int i = 1; i < m_liveProxies.size(); i++)
+	{
+		aabbMin.setMin(m_liveProxies[i]->m_aabbMin);
+		aabbMax.setMax(m_liveProxies[i]->m_aabbMax);
+	}
+}
+
+void btSortAndSweepBroadphase::resetPool(btDispatcher* dispatcher)
+{
+	if (m_liveProxies.size() == 0)
+	{
+		m_numIndices = 0;
+		m_freeIndices.resize(0);
+		m_pendingFreeIndices.resize(0);
+		m_pairs[0].resize(0);
+		m_pairs[1].resize(0);
+		m_axis = 0;
+		m_numCells[0] = m_numCells[1] = 1;
+		if (m_raycastAccelerator)
+		{
+			m_raycastAccelerator->resetPool(dispatcher);
+		}
+	}
+}
+
+void btSortAndSweepBroadphase::printStats()
+{
+	printf("btSortAndSweepBroadphase: %d proxies, %d pairs (+%d -%d), axis %d, %dx%d cells\n", m_liveProxies.size(), getNumOverlappingPairs(), m_numAddedPairs, m_numRemovedPairs, m_axis, m_numCells[0], m_numCells[1]);
+}
+
+//
+// Snapshots
+//
+
+///btSortAndSweepStateHeader starts the flat buffer written by btSortAndSweepBroadphase::saveState, followed by the sorted pair keys
+ATTRIBUTE_ALIGNED16(struct)
+btSortAndSweepStateHeader
+{
+	int m_numProxies;
+	int m_numPairs;
+	int m_axis;
+	int m_hasRaycastAccelerator;
+};
+
+bool btSortAndSweepBroadphase::saveState(btAlignedObjectArray<char>& buffer) const
+{
+	const btAlignedObjectArray<btSortAndSweepKey>& pairs = m_pairs[m_currentPairs];
+	int pairBytes = (pairs.size() * int(sizeof(btSortAndSweepKey)) + 15) & ~15;
+
+	int offset = buffer.size();
+	buffer.resizeNoInitialize(offset + int(sizeof(btSortAndSweepStateHeader)) + pairBytes);
+	char* data = &buffer[offset];
+
+	btSortAndSweepStateHeader* header = (btSortAndSweepStateHeader*)data;
+	header->m_numProxies = m_liveProxies.size();
+	header->m_numPairs = pairs.size();
+	header->m_axis = m_axis;
+	header->m_hasRaycastAccelerator = (m_raycastAccelerator != 0);
+	data += sizeof(btSortAndSweepStateHeader);
+
+	if (pairs.size())
+	{
+		memcpy(data, &pairs[0], pairs.size() * sizeof(btSortAndSweepKey));
+	}
+
+	if (m_raycastAccelerator)
+	{
+		m_raycastAccelerator->saveState(buffer);
+	}
+	return true;
+}
+
+int btSortAndSweepBroadphase::loadState(const char* data)
+{
+	const char* start = data;
+	const btSortAndSweepStateHeader* header = (const btSortAndSweepStateHeader*)data;
+	data += sizeof(btSortAndSweepStateHeader);
+
+	// the saved pairs index the live proxies, so the state only fits a broadphase with the same proxies and the same accelerator
+	if (header->m_numProxies != m_liveProxies.size() || header->m_numPairs < 0 || header->m_axis < 0 || header->m_axis > 2 ||
+		(header->m_hasRaycastAccelerator != 0) != (m_raycastAccelerator != 0))
+	{
+		return 0;
+	}
+
+	btAlignedObjectArray<btSortAndSweepKey>& pairs = m_pairs[m_currentPairs];
+	pairs.resizeNoInitialize(header->m_numPairs);
+	if (header->m_numPairs)
+	{
+		memcpy(&pairs[0], data, header->m_numPairs * sizeof(btSortAndSweepKey));
+	}
+	data += (header->m_numPairs * int(sizeof(btSortAndSweepKey)) + 15) & ~15;
+	m_axis = header->m_axis;
+
+	if (m_raycastAccelerator)
+	{
+		data += m_raycastAccelerator->loadState(data);
+	}
+	return int(data - start);
+}
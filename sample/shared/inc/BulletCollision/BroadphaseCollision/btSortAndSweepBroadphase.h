@@ -0,0 +1,205 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_SORT_AND_SWEEP_BROADPHASE_H
+#define BT_SORT_AND_SWEEP_BROADPHASE_H
+
+#include "btBroadphaseInterface.h"
+#include "btBroadphaseProxy.h"
+#include "btOverlappingPairCache.h"
+#include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btThreads.h"
+
+class btDbvtBroadphase;
+
+typedef unsigned long long int btSortAndSweepKey;
+
+///btSortAndSweepProxy is the proxy of btSortAndSweepBroadphase, it only stores the aabb between calls to calculateOverlappingPairs
+ATTRIBUTE_ALIGNED16(struct)
+btSortAndSweepProxy : public btBroadphaseProxy
+{
+	int m_index;      // index in the proxy chunks, m_uniqueId is m_index+1
+	int m_liveIndex;  // position in the list of live proxies, -1 once destroyed
+	btBroadphaseProxy* m_dbvtProxy;  //for faster raycast
+
+	btSortAndSweepProxy() {}
+};
+
+///btSortAndSweepBroadphase finds all overlapping pairs from scratch in calculateOverlappingPairs.
+///Each call radix sorts the aabb minima along the axis with the largest spread, sweeps the sorted list and
+///compares the new set of pairs with the one of the previous call to add and remove pairs in the pair cache.
+///With many proxies a single sweep tests each proxy against all proxies in a slab of the world, so the other two axes are
+///split into a grid of cells that adapts to the proxies of the previous call, and each cell is swept on its own (multi box sweep and prune).
+///A proxy goes into every cell it overlaps, and a pair is only reported by the first cell both share.
+///Unlike btAxisSweep3 there is no world box and no limit on the number of proxies, and creating, moving or destroying
+///a proxy costs O(1). Sorting, sweeping and comparing run in parallel with btParallelFor if BT_THREADSAFE is enabled,
+///each task writes into its own buffer. The changes are passed to the batch functions of the pair cache in sorted order
+///(by default a btHashedOverlappingPairCache; pass a btOpenAddressingPairCache to apply them in parallel), so the pair cache ends up the same
+///for any number of threads (and any grid).
+///The optional raycast accelerator (a btDbvtBroadphase without pairs, as in btAxisSweep3) is needed for fast rayTest, aabbTest and
+///btCollisionWorld::rayTestBatch. Without it they test all proxies.
+class btSortAndSweepBroadphase : public btBroadphaseInterface
+{
+public:
+	enum
+	{
+		CHUNK_SHIFT = 10,
+		CHUNK_SIZE = 1 << CHUNK_SHIFT
+	};
+
+	///buffers of one parallel task, the work is split into the same tasks for any number of threads
+	struct btSortAndSweepTask
+	{
+		btAlignedObjectArray<btSortAndSweepKey> m_pairs;    // pairs found by the task, unsorted
+		btAlignedObjectArray<btSortAndSweepKey> m_added;    // pairs of the current call that were not in the previous one
+		btAlignedObjectArray<btSortAndSweepKey> m_removed;  // pairs of the previous call that are not in the current one
+		int m_histogram[256];
+		int m_numEntries;
+		int m_firstEntry;
+		// statistics of the aabbs of the task
+		btVector3 m_sum;
+		btVector3 m_sumSq;
+		btVector3 m_centerMin;
+		btVector3 m_centerMax;
+		btVector3 m_extent;
+		btVector3 m_maxExtent;
+	};
+
+	///number of tasks for n items, their ranges, and btParallelFor over the tasks (serial without BT_THREADSAFE or a single thread)
+	static int getNumTasks(int n);
+	static void getTaskRange(int task, int numTasks, int n, int& begin, int& end);
+	static void parallelFor(int numTasks, const btIParallelForBody& body);
+
+protected:
+	// proxies are allocated in chunks that never move, destroyed proxies are reused after the next calculateOverlappingPairs
+	btAlignedObjectArray<btSortAndSweepProxy*> m_chunks;
+	btAlignedObjectArray<btSortAndSweepProxy*> m_liveProxies;
+	btAlignedObjectArray<int> m_freeIndices;
+	btAlignedObjectArray<int> m_pendingFreeIndices;
+	int m_numIndices;  // indices handed out so far
+
+	btOverlappingPairCache* m_pairCache;
+	bool m_ownsPairCache;
+
+	btDbvtBroadphase* m_raycastAccelerator;
+	btOverlappingPairCache* m_nullPairCache;
+
+	// sweep axis and the grid on the other two axes, chosen from the aabbs of the previous call
+	int m_axis;
+	int m_numCells[2];
+	btScalar m_cellOrigin[2];
+	btScalar m_cellScale[2];  // 1 / cell size
+
+	// sorted endpoints and the proxy data gathered in sorted order
+	btAlignedObjectArray<btSortAndSweepKey> m_endpoints;
+	btAlignedObjectArray<btSortAndSweepKey> m_sortBuffer;
+	btAlignedObjectArray<btVector3> m_sortedAabbs;     // min and max of each sorted proxy
+	btAlignedObjectArray<unsigned int> m_sortedIds;    // unique id, group, mask and first and last cell on the two grid axes of each sorted proxy
+
+	// cell entries (cell and sorted endpoint) sorted by cell, and the data needed by the sweep in the same order
+	btAlignedObjectArray<btSortAndSweepKey> m_entries;
+	btAlignedObjectArray<btScalar> m_entryBounds;      // min and max on the grid axes, as 4 arrays
+	btAlignedObjectArray<unsigned int> m_entryIds;     // unique id, group, mask, keys of the min and max on the sweep axis, cell and first cell, as 7 arrays
+
+	// sorted pair keys of the previous and the current call
+	btAlignedObjectArray<btSortAndSweepKey> m_pairs[2];
+	int m_currentPairs;
+
+	btAlignedObjectArray<btSortAndSweepTask*> m_tasks;
+	btBroadphasePairArray m_changedPairs;  // added or removed pairs for the pair cache
+
+	int m_numAddedPairs;
+	int m_numRemovedPairs;
+
+	btSortAndSweepProxy* getProxyByUniqueId(int uid) const
+	{
+		int index = uid - 1;
+		return &m_chunks[index >> CHUNK_SHIFT][index & (CHUNK_SIZE - 1)];
+	}
+
+	void sortKeys(btAlignedObjectArray<btSortAndSweepKey>& keys, int firstByte);
+	void updateGrid(int numProxies, int numTasks);
+
+	///concatenates the pairs found by the first numTasks tasks and sorts them
+	void mergeTaskPairs(int numTasks, btAlignedObjectArray<btSortAndSweepKey>& pairs);
+
+	///fills pairs with the keys of all overlapping pairs of live proxies (the smaller unique id in the upper half), sorted and without duplicates.
+	///A derived broadphase can replace the sweep with another search and keep the proxies, the pair cache updates and the raycast accelerator
+	virtual void findOverlappingPairs(btAlignedObjectArray<btSortAndSweepKey>& pairs);
+
+public:
+	btSortAndSweepBroadphase(btOverlappingPairCache* pairCache = 0, bool disableRaycastAccelerator = false);
+	virtual ~btSortAndSweepBroadphase();
+
+	virtual btBroadphaseProxy* createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* dispatcher);
+	virtual void destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher);
+	virtual void setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher);
+	virtual void getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const;
+
+	virtual void rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin = btVector3(0, 0, 0), const btVector3& aabbMax = btVector3(0, 0, 0));
+	virtual void aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback);
+
+	virtual void calculateOverlappingPairs(btDispatcher* dispatcher);
+
+	btOverlappingPairCache* getOverlappingPairCache()
+	{
+		return m_pairCache;
+	}
+	const btOverlappingPairCache* getOverlappingPairCache() const
+	{
+		return m_pairCache;
+	}
+
+	virtual void getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const;
+
+	///reset broadphase internal structures, to ensure determinism/reproducability
+	virtual void resetPool(btDispatcher* dispatcher);
+
+	virtual int getRayTestTrees(const btDbvt** trees, int maxTrees) const;
+
+	///saveState writes the pairs found by the last calculateOverlappingPairs (and the raycast accelerator)
+	virtual bool saveState(btAlignedObjectArray<char>& buffer) const;
+	virtual int loadState(const char* data);
+
+	virtual void printStats();
+
+	int getNumProxies() const
+	{
+		return m_liveProxies.size();
+	}
+	///number of pairs found, added and removed by the last calculateOverlappingPairs
+	int getNumOverlappingPairs() const
+	{
+		return m_pairs[m_currentPairs].size();
+	}
+	int getNumAddedPairs() const
+	{
+		return m_numAddedPairs;
+	}
+	int getNumRemovedPairs() const
+	{
+		return m_numRemovedPairs;
+	}
+	int getSweepAxis() const
+	{
+		return m_axis;
+	}
+	int getNumCells() const
+	{
+		return m_numCells[0] * m_numCells[1];
+	}
+};
+
+#endif  //BT_SORT_AND_SWEEP_BROADPHASE_H
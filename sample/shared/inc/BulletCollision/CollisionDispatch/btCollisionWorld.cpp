@@ -34,6 +34,7 @@ subject to the following restrictions:
 #include "LinearMath/btAabbUtil2.h"
 #include "LinearMath/btQuickprof.h"
 #include "LinearMath/btSerializer.h"
+#include "LinearMath/btThreads.h"
 #include "BulletCollision/CollisionShapes/btConvexPolyhedron.h"
 #include "BulletCollision/CollisionDispatch/btCollisionObjectWrapper.h"
 
@@ -1131,6 +1132,520 @@ void btCollisionWorld::convexSweepTest(const btConvexShape* castShape, const btT
 #endif  //USE_BRUTEFORCE_RAYBROADPHASE
 }
 
+/* Batched queries	*/
+
+// Packets of rays (or sweeps) per parallelFor work item
+static const int btBatchPacketGrain = 16;
+
+static void btBatchParallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body)
+{
+#if BT_THREADSAFE
+	btITaskScheduler* scheduler = btGetTaskScheduler();
+	if (scheduler && scheduler->getNumThreads() > 1 && iEnd - iBegin > grainSize)
+	{
+		btParallelFor(iBegin, iEnd, grainSize, body);
+		return;
+	}
+#endif  //BT_THREADSAFE
+	if (iBegin < iEnd)
+	{
+		body.forLoop(iBegin, iEnd);
+	}
+}
+
+///btRayPacket holds up to 4 rays (or sweeps) as structure of arrays, so one slab test checks a tree node against all of them.
+///The ray parameter runs from 0 at the start to 1 at the end, and m_maxFraction shrinks to the closest hit found so far.
+ATTRIBUTE_ALIGNED16(struct)
+btRayPacket
+{
+	btScalar m_origin[3][4];
+	btScalar m_invDir[3][4];       // 1/(to-from), BT_LARGE_FLOAT for zero components
+	btScalar m_extentMin[3][4];    // aabb of the cast shape, subtracted from the node aabb (zero for rays)
+	btScalar m_extentMax[3][4];
+	btScalar m_maxFraction[4];
+	btVector3 m_direction;         // direction of the first ray, used to visit the near child first
+	int m_query[4];
+	int m_laneMask;                // lanes that hold a query
+
+	btRayPacket()
+	{
+		init(0, 0);
+	}
+
+	///resets every lane to an empty ray at the origin, setLane fills the lanes of the queries
+	void init(int first, int count)
+	{
+		m_laneMask = (1 << count) - 1;
+		m_direction.setValue(btScalar(0.), btScalar(0.), btScalar(0.));
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			m_query[lane] = first + (lane < count ? lane : 0);
+			for (int i = 0; i < 3; ++i)
+			{
+				m_origin[i][lane] = btScalar(0.);
+				m_invDir[i][lane] = btScalar(BT_LARGE_FLOAT);
+				m_extentMin[i][lane] = btScalar(0.);
+				m_extentMax[i][lane] = btScalar(0.);
+			}
+			m_maxFraction[lane] = btScalar(0.);
+		}
+	}
+
+	void setLane(int lane, const btVector3& from, const btVector3& to, const btVector3& extentMin, const btVector3& extentMax)
+	{
+		const btVector3 dir = to - from;
+		if (lane == 0)
+		{
+			m_direction = dir;
+		}
+		for (int i = 0; i < 3; ++i)
+		{
+			m_origin[i][lane] = from[i];
+			m_invDir[i][lane] = dir[i] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / dir[i];
+			m_extentMin[i][lane] = extentMin[i];
+			m_extentMax[i][lane] = extentMax[i];
+		}
+		m_maxFraction[lane] = btScalar(1.);
+	}
+
+	///returns the mask of the lanes whose ray segment [0,m_maxFraction] overlaps the aabb
+	int overlap(const btVector3& aabbMin, const btVector3& aabbMax) const
+	{
+#if defined(BT_USE_SSE) && !defined(BT_USE_DOUBLE_PRECISION)
+		__m128 tmin = _mm_setzero_ps();
+		__m128 tmax = _mm_load_ps(m_maxFraction);
+		for (int i = 0; i < 3; ++i)
+		{
+			const __m128 origin = _mm_load_ps(m_origin[i]);
+			const __m128 invDir = _mm_load_ps(m_invDir[i]);
+			const __m128 lo = _mm_sub_ps(_mm_set1_ps(aabbMin[i]), _mm_load_ps(m_extentMax[i]));
+			const __m128 hi = _mm_sub_ps(_mm_set1_ps(aabbMax[i]), _mm_load_ps(m_extentMin[i]));
+			const __m128 t0 = _mm_mul_ps(_mm_sub_ps(lo, origin), invDir);
+			const __m128 t1 = _mm_mul_ps(_mm_sub_ps(hi, origin), invDir);
+			tmin = _mm_max_ps(tmin, _mm_min_ps(t0, t1));
+			tmax = _mm_min_ps(tmax, _mm_max_ps(t0, t1));
+		}
+		return _mm_movemask_ps(_mm_cmple_ps(tmin, tmax)) & m_laneMask;
+#else
+		int mask = 0;
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			btScalar tmin = btScalar(0.);
+			btScalar tmax = m_maxFraction[lane];
+			for (int i = 0; i < 3; ++i)
+			{
+				const btScalar t0 = (aabbMin[i] - m_extentMax[i][lane] - m_origin[i][lane]) * m_invDir[i][lane];
+				const btScalar t1 = (aabbMax[i] - m_extentMin[i][lane] - m_origin[i][lane]) * m_invDir[i][lane];
+				tmin = btMax(tmin, btMin(t0, t1));
+				tmax = btMin(tmax, btMax(t0, t1));
+			}
+			if (tmin <= tmax)
+			{
+				mask |= 1 << lane;
+			}
+		}
+		return mask & m_laneMask;
+#endif
+	}
+};
+
+///btRayPacketTraverse walks the tree with the packet and hands every leaf that some lanes overlap to NARROWPHASE::process.
+///The near child is visited first, so closer hits shrink m_maxFraction before the far child is tested
+template <typename NARROWPHASE>
+static void btRayPacketTraverse(const btDbvtNode* root, btRayPacket& packet, btAlignedObjectArray<const btDbvtNode*>& stack, NARROWPHASE& narrowphase)
+{
+	if (!root)
+	{
+		return;
+	}
+	stack.resize(0);
+	stack.push_back(root);
+	while (stack.size())
+	{
+		const btDbvtNode* node = stack[stack.size() - 1];
+		stack.pop_back();
+		const int mask = packet.overlap(node->volume.Mins(), node->volume.Maxs());
+		if (!mask)
+		{
+			continue;
+		}
+		if (node->isinternal())
+		{
+			const btDbvtNode* nearChild = node->childs[0];
+			const btDbvtNode* farChild = node->childs[1];
+			const btVector3 delta = (farChild->volume.Mins() + farChild->volume.Maxs()) - (nearChild->volume.Mins() + nearChild->volume.Maxs());
+			if (packet.m_direction.dot(delta) < btScalar(0.))
+			{
+				btSwap(nearChild, farChild);
+			}
+			stack.push_back(farChild);
+			stack.push_back(nearChild);
+		}
+		else
+		{
+			const btBroadphaseProxy* proxy = (const btBroadphaseProxy*)node->data;
+			narrowphase.process((const btCollisionObject*)proxy->m_clientObject, mask, packet);
+		}
+	}
+}
+
+static bool btBatchNeedsCollision(const btCollisionObject* collisionObject, int collisionFilterGroup, int collisionFilterMask)
+{
+	const btBroadphaseProxy* proxy = collisionObject->getBroadphaseHandle();
+	if (!proxy || collisionObject->getInternalType() == btCollisionObject::CO_SOFT_BODY)
+	{
+		return false;
+	}
+	return (proxy->m_collisionFilterGroup & collisionFilterMask) && (collisionFilterGroup & proxy->m_collisionFilterMask);
+}
+
+///btBatchRayTestSingle finds the hit of the ray on one object if it is closer than fraction.
+///Spheres and boxes hit from outside are intersected directly, other shapes go through rayTestSingle
+static bool btBatchRayTestSingle(const btVector3& rayFromWorld, const btVector3& rayToWorld, const btCollisionObject* collisionObject,
+								 int collisionFilterGroup, int collisionFilterMask, btScalar& fraction, btVector3& hitNormalWorld)
+{
+	const btCollisionShape* shape = collisionObject->getCollisionShape();
+	const btTransform& worldTransform = collisionObject->getWorldTransform();
+	const btVector3 dir = rayToWorld - rayFromWorld;
+	switch (shape->getShapeType())
+	{
+		case SPHERE_SHAPE_PROXYTYPE:
+		{
+			const btScalar radius = ((const btSphereShape*)shape)->getRadius();
+			const btVector3 origin = rayFromWorld - worldTransform.getOrigin();
+			const btScalar c = origin.length2() - radius * radius;
+			if (c <= btScalar(0.))
+			{
+				break;  // starts inside
+			}
+			const btScalar a = dir.length2();
+			const btScalar b = origin.dot(dir);
+			const btScalar disc = b * b - a * c;
+			if (a == btScalar(0.) || disc < btScalar(0.))
+			{
+				return false;
+			}
+			const btScalar t = (-b - btSqrt(disc)) / a;
+			if (t < btScalar(0.) || t >= fraction)
+			{
+				return false;
+			}
+			fraction = t;
+			hitNormalWorld = (origin + dir * t).normalized();
+			return true;
+		}
+		case BOX_SHAPE_PROXYTYPE:
+		{
+			const btVector3 halfExtents = ((const btBoxShape*)shape)->getHalfExtentsWithMargin();
+			const btVector3 origin = worldTransform.invXform(rayFromWorld);
+			const btVector3 localDir = dir * worldTransform.getBasis();
+			if (btFabs(origin[0]) <= halfExtents[0] && btFabs(origin[1]) <= halfExtents[1] && btFabs(origin[2]) <= halfExtents[2])
+			{
+				break;  // starts inside
+			}
+			btScalar tEnter = -BT_LARGE_FLOAT;
+			btScalar tExit = fraction;
+			int axis = -1;
+			for (int i = 0; i < 3; ++i)
+			{
+				if (localDir[i] == btScalar(0.))
+				{
+					if (btFabs(origin[i]) > halfExtents[i])
+					{
+						return false;
+					}
+					continue;
+				}
+				const btScalar inv = btScalar(1.) / localDir[i];
+				const btScalar t0 = (-halfExtents[i] - origin[i]) * inv;
+				const btScalar t1 = (halfExtents[i] - origin[i]) * inv;
+				if (btMin(t0, t1) > tEnter)
+				{
+					tEnter = btMin(t0, t1);
+					axis = i;
+				}
+				tExit = btMin(tExit, btMax(t0, t1));
+			}
+			if (axis < 0 || tEnter > tExit || tEnter < btScalar(0.) || tEnter >= fraction)
+			{
+				return false;
+			}
+			btVector3 localNormal(0, 0, 0);
+			localNormal[axis] = localDir[axis] > btScalar(0.) ? btScalar(-1.) : btScalar(1.);
+			fraction = tEnter;
+			hitNormalWorld = worldTransform.getBasis() * localNormal;
+			return true;
+		}
+		default:
+			break;
+	}
+
+	btTransform rayFromTrans, rayToTrans;
+	rayFromTrans.setIdentity();
+	rayFromTrans.setOrigin(rayFromWorld);
+	rayToTrans.setIdentity();
+	rayToTrans.setOrigin(rayToWorld);
+	btCollisionWorld::ClosestRayResultCallback resultCallback(rayFromWorld, rayToWorld);
+	resultCallback.m_closestHitFraction = fraction;
+	resultCallback.m_collisionFilterGroup = collisionFilterGroup;
+	resultCallback.m_collisionFilterMask = collisionFilterMask;
+	btCollisionWorld::rayTestSingle(rayFromTrans, rayToTrans, (btCollisionObject*)collisionObject, shape, worldTransform, resultCallback);
+	if (!resultCallback.hasHit())
+	{
+		return false;
+	}
+	fraction = resultCallback.m_closestHitFraction;
+	hitNormalWorld = resultCallback.m_hitNormalWorld;
+	return true;
+}
+
+struct btBatchRayNarrowphase
+{
+	const btVector3* m_rayFromWorld;
+	const btVector3* m_rayToWorld;
+	btCollisionWorld::BatchedQueryResults* m_results;
+	int m_collisionFilterGroup;
+	int m_collisionFilterMask;
+
+	void process(const btCollisionObject* collisionObject, int mask, btRayPacket& packet)
+	{
+		if (!btBatchNeedsCollision(collisionObject, m_collisionFilterGroup, m_collisionFilterMask))
+		{
+			return;
+		}
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			if (!(mask & (1 << lane)) || packet.m_maxFraction[lane] == btScalar(0.))
+			{
+				continue;
+			}
+			const int q = packet.m_query[lane];
+			btScalar fraction = packet.m_maxFraction[lane];
+			btVector3 hitNormalWorld;
+			if (btBatchRayTestSingle(m_rayFromWorld[q], m_rayToWorld[q], collisionObject, m_collisionFilterGroup, m_collisionFilterMask, fraction, hitNormalWorld))
+			{
+				packet.m_maxFraction[lane] = fraction;
+				m_results->m_collisionObjects[q] = collisionObject;
+				m_results->m_hitFractions[q] = fraction;
+				m_results->m_hitNormalWorld[q] = hitNormalWorld;
+				m_results->m_hitPointWorld[q].setInterpolate3(m_rayFromWorld[q], m_rayToWorld[q], fraction);
+			}
+		}
+	}
+};
+
+struct btBatchRayTask : public btIParallelForBody
+{
+	const btDbvt* const* m_trees;
+	int m_numTrees;
+	int m_numRays;
+	btBatchRayNarrowphase m_narrowphase;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		btBatchRayNarrowphase narrowphase = m_narrowphase;
+		btAlignedObjectArray<const btDbvtNode*> stack;
+		stack.reserve(btDbvt::DOUBLE_STACKSIZE);
+		const btVector3 zero(0, 0, 0);
+		btRayPacket packet;
+		for (int p = iBegin; p < iEnd; ++p)
+		{
+			const int first = p * 4;
+			const int count = btMin(4, m_numRays - first);
+			packet.init(first, count);
+			for (int lane = 0; lane < 4; ++lane)
+			{
+				const int q = packet.m_query[lane];
+				packet.setLane(lane, narrowphase.m_rayFromWorld[q], narrowphase.m_rayToWorld[q], zero, zero);
+			}
+			for (int t = 0; t < m_numTrees; ++t)
+			{
+				btRayPacketTraverse(m_trees[t]->m_root, packet, stack, narrowphase);
+			}
+		}
+	}
+};
+
+static void btBatchClearResults(btCollisionWorld::BatchedQueryResults& results, int numQueries, const btVector3* queryTo)
+{
+	results.resize(numQueries);
+	for (int i = 0; i < numQueries; ++i)
+	{
+		results.m_collisionObjects[i] = 0;
+		results.m_hitFractions[i] = btScalar(1.);
+		results.m_hitPointWorld[i] = queryTo ? queryTo[i] : btVector3(0, 0, 0);
+		results.m_hitNormalWorld[i].setValue(0, 0, 0);
+	}
+}
+
+void btCollisionWorld::rayTestBatch(const btVector3* rayFromWorld, const btVector3* rayToWorld, int numRays, BatchedQueryResults& results,
+									int collisionFilterGroup, int collisionFilterMask) const
+{
+	BT_PROFILE("rayTestBatch");
+	btBatchClearResults(results, numRays, rayToWorld);
+
+	const btDbvt* trees[2];
+	const int numTrees = m_broadphasePairCache->getRayTestTrees(trees, 2);
+	if (numTrees == 0)
+	{
+		// the broadphase has no dbvt, cast the rays one by one
+		for (int i = 0; i < numRays; ++i)
+		{
+			ClosestRayResultCallback resultCallback(rayFromWorld[i], rayToWorld[i]);
+			resultCallback.m_collisionFilterGroup = collisionFilterGroup;
+			resultCallback.m_collisionFilterMask = collisionFilterMask;
+			btCollisionWorld::rayTest(rayFromWorld[i], rayToWorld[i], resultCallback);
+			if (resultCallback.hasHit())
+			{
+				results.m_collisionObjects[i] = resultCallback.m_collisionObject;
+				results.m_hitFractions[i] = resultCallback.m_closestHitFraction;
+				results.m_hitPointWorld[i] = resultCallback.m_hitPointWorld;
+				results.m_hitNormalWorld[i] = resultCallback.m_hitNormalWorld;
+			}
+		}
+		return;
+	}
+
+	btBatchRayTask task;
+	task.m_trees = trees;
+	task.m_numTrees = numTrees;
+	task.m_numRays = numRays;
+	task.m_narrowphase.m_rayFromWorld = rayFromWorld;
+	task.m_narrowphase.m_rayToWorld = rayToWorld;
+	task.m_narrowphase.m_results = &results;
+	task.m_narrowphase.m_collisionFilterGroup = collisionFilterGroup;
+	task.m_narrowphase.m_collisionFilterMask = collisionFilterMask;
+	btBatchParallelFor(0, (numRays + 3) / 4, btBatchPacketGrain, task);
+}
+
+struct btBatchSweepNarrowphase
+{
+	const btConvexShape* m_castShape;
+	const btTransform* m_convexFromWorld;
+	const btTransform* m_convexToWorld;
+	btCollisionWorld::BatchedQueryResults* m_results;
+	int m_collisionFilterGroup;
+	int m_collisionFilterMask;
+	btScalar m_allowedCcdPenetration;
+
+	void process(const btCollisionObject* collisionObject, int mask, btRayPacket& packet)
+	{
+		if (!btBatchNeedsCollision(collisionObject, m_collisionFilterGroup, m_collisionFilterMask))
+		{
+			return;
+		}
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			if (!(mask & (1 << lane)) || packet.m_maxFraction[lane] == btScalar(0.))
+			{
+				continue;
+			}
+			const int q = packet.m_query[lane];
+			btCollisionWorld::ClosestConvexResultCallback resultCallback(m_convexFromWorld[q].getOrigin(), m_convexToWorld[q].getOrigin());
+			resultCallback.m_closestHitFraction = packet.m_maxFraction[lane];
+			resultCallback.m_collisionFilterGroup = m_collisionFilterGroup;
+			resultCallback.m_collisionFilterMask = m_collisionFilterMask;
+			btCollisionWorld::objectQuerySingle(m_castShape, m_convexFromWorld[q], m_convexToWorld[q],
+												(btCollisionObject*)collisionObject,
+												collisionObject->getCollisionShape(),
+												collisionObject->getWorldTransform(),
+												resultCallback,
+												m_allowedCcdPenetration);
+			if (resultCallback.m_hitCollisionObject)
+			{
+				packet.m_maxFraction[lane] = resultCallback.m_closestHitFraction;
+				m_results->m_collisionObjects[q] = resultCallback.m_hitCollisionObject;
+				m_results->m_hitFractions[q] = resultCallback.m_closestHitFraction;
+				m_results->m_hitPointWorld[q] = resultCallback.m_hitPointWorld;
+				m_results->m_hitNormalWorld[q] = resultCallback.m_hitNormalWorld;
+			}
+		}
+	}
+};
+
+struct btBatchSweepTask : public btIParallelForBody
+{
+	const btDbvt* const* m_trees;
+	int m_numTrees;
+	int m_numSweeps;
+	btBatchSweepNarrowphase m_narrowphase;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		btBatchSweepNarrowphase narrowphase = m_narrowphase;
+		btAlignedObjectArray<const btDbvtNode*> stack;
+		stack.reserve(btDbvt::DOUBLE_STACKSIZE);
+		btRayPacket packet;
+		for (int p = iBegin; p < iEnd; ++p)
+		{
+			const int first = p * 4;
+			const int count = btMin(4, m_numSweeps - first);
+			packet.init(first, count);
+			for (int lane = 0; lane < 4; ++lane)
+			{
+				// aabb of the cast shape over its rotation, as in convexSweepTest
+				const int q = packet.m_query[lane];
+				const btTransform& convexFromTrans = narrowphase.m_convexFromWorld[q];
+				const btTransform& convexToTrans = narrowphase.m_convexToWorld[q];
+				btVector3 linVel, angVel;
+				btTransformUtil::calculateVelocity(convexFromTrans, convexToTrans, 1.0f, linVel, angVel);
+				btTransform R;
+				R.setIdentity();
+				R.setRotation(convexFromTrans.getRotation());
+				btVector3 castShapeAabbMin, castShapeAabbMax;
+				narrowphase.m_castShape->calculateTemporalAabb(R, btVector3(0, 0, 0), angVel, 1.0f, castShapeAabbMin, castShapeAabbMax);
+				packet.setLane(lane, convexFromTrans.getOrigin(), convexToTrans.getOrigin(), castShapeAabbMin, castShapeAabbMax);
+			}
+			for (int t = 0; t < m_numTrees; ++t)
+			{
+				btRayPacketTraverse(m_trees[t]->m_root, packet, stack, narrowphase);
+			}
+		}
+	}
+};
+
+void btCollisionWorld::convexSweepTestBatch(const btConvexShape* castShape, const btTransform* convexFromWorld, const btTransform* convexToWorld, int numSweeps, BatchedQueryResults& results,
+											int collisionFilterGroup, int collisionFilterMask, btScalar allowedCcdPenetration) const
+{
+	BT_PROFILE("convexSweepTestBatch");
+	btBatchClearResults(results, numSweeps, 0);
+
+	const btDbvt* trees[2];
+	const int numTrees = m_broadphasePairCache->getRayTestTrees(trees, 2);
+	if (numTrees == 0)
+	{
+		// the broadphase has no dbvt, sweep one by one
+		for (int i = 0; i < numSweeps; ++i)
+		{
+			ClosestConvexResultCallback resultCallback(convexFromWorld[i].getOrigin(), convexToWorld[i].getOrigin());
+			resultCallback.m_collisionFilterGroup = collisionFilterGroup;
+			resultCallback.m_collisionFilterMask = collisionFilterMask;
+			convexSweepTest(castShape, convexFromWorld[i], convexToWorld[i], resultCallback, allowedCcdPenetration);
+			if (resultCallback.hasHit())
+			{
+				results.m_collisionObjects[i] = resultCallback.m_hitCollisionObject;
+				results.m_hitFractions[i] = resultCallback.m_closestHitFraction;
+				results.m_hitPointWorld[i] = resultCallback.m_hitPointWorld;
+				results.m_hitNormalWorld[i] = resultCallback.m_hitNormalWorld;
+			}
+		}
+		return;
+	}
+
+	btBatchSweepTask task;
+	task.m_trees = trees;
+	task.m_numTrees = numTrees;
+	task.m_numSweeps = numSweeps;
+	task.m_narrowphase.m_castShape = castShape;
+	task.m_narrowphase.m_convexFromWorld = convexFromWorld;
+	task.m_narrowphase.m_convexToWorld = convexToWorld;
+	task.m_narrowphase.m_results = &results;
+	task.m_narrowphase.m_collisionFilterGroup = collisionFilterGroup;
+	task.m_narrowphase.m_collisionFilterMask = collisionFilterMask;
+	task.m_narrowphase.m_allowedCcdPenetration = allowedCcdPenetration;
+	btBatchParallelFor(0, (numSweeps + 3) / 4, btBatchPacketGrain, task);
+}
+
 struct btBridgedManifoldResult : public btManifoldResult
 {
 	btCollisionWorld::ContactResultCallback& m_resultCallback;
@@ -437,6 +437,38 @@ public:
 	/// This allows for several queries: first hit, all hits, any hit, dependent on the value return by the callback.
 	void convexSweepTest(const btConvexShape* castShape, const btTransform& from, const btTransform& to, ConvexResultCallback& resultCallback, btScalar allowedCcdPenetration = btScalar(0.)) const;
 
+	///BatchedQueryResults holds the closest hit of every ray or sweep of a batched query in flat arrays.
+	///Entry i belongs to query i. m_collisionObjects[i] is 0 and m_hitFractions[i] is 1 if the query hit nothing
+	struct BatchedQueryResults
+	{
+		btAlignedObjectArray<const btCollisionObject*> m_collisionObjects;
+		btAlignedObjectArray<btScalar> m_hitFractions;
+		btAlignedObjectArray<btVector3> m_hitPointWorld;
+		btAlignedObjectArray<btVector3> m_hitNormalWorld;
+
+		///resize only allocates when numQueries exceeds the capacity, so reusing the results avoids allocations
+		void resize(int numQueries)
+		{
+			const btVector3 zero(btScalar(0.), btScalar(0.), btScalar(0.));
+			m_collisionObjects.resize(numQueries, 0);
+			m_hitFractions.resize(numQueries, btScalar(1.));
+			m_hitPointWorld.resize(numQueries, zero);
+			m_hitNormalWorld.resize(numQueries, zero);
+		}
+	};
+
+	/// rayTestBatch casts numRays rays from rayFromWorld[i] to rayToWorld[i] and stores the closest hit of each ray in results.
+	/// Groups of 4 rays traverse the broadphase dbvt together, and the groups are distributed over the task scheduler threads.
+	/// There are no callbacks: objects are filtered with collisionFilterGroup/Mask like RayResultCallback::needsCollision.
+	/// Soft bodies are not reported, use rayTest for them.
+	void rayTestBatch(const btVector3* rayFromWorld, const btVector3* rayToWorld, int numRays, BatchedQueryResults& results,
+					  int collisionFilterGroup = btBroadphaseProxy::DefaultFilter, int collisionFilterMask = btBroadphaseProxy::AllFilter) const;
+
+	/// convexSweepTestBatch sweeps castShape from convexFromWorld[i] to convexToWorld[i] and stores the closest hit of each sweep in results,
+	/// the same way rayTestBatch does for rays. The hit point is the contact point, as in ClosestConvexResultCallback.
+	void convexSweepTestBatch(const btConvexShape* castShape, const btTransform* convexFromWorld, const btTransform* convexToWorld, int numSweeps, BatchedQueryResults& results,
+							  int collisionFilterGroup = btBroadphaseProxy::DefaultFilter, int collisionFilterMask = btBroadphaseProxy::AllFilter, btScalar allowedCcdPenetration = btScalar(0.)) const;
+
 	///contactTest performs a discrete collision test between colObj against all objects in the btCollisionWorld, and calls the resultCallback.
 	///it reports one or more contact points for every overlapping object (including the one with deepest penetration)
 	void contactTest(btCollisionObject* colObj, ContactResultCallback& resultCallback);
@@ -25,8 +25,10 @@ btBvhTriangleMeshShape::btBvhTriangleMeshShape(btStridingMeshInterface* meshInte
 	: btTriangleMeshShape(meshInterface),
 	  m_bvh(0),
 	  m_triangleInfoMap(0),
+	  m_bvh4(0),
 	  m_useQuantizedAabbCompression(useQuantizedAabbCompression),
-	  m_ownsBvh(false)
+	  m_ownsBvh(false),
+	  m_useBvh4(false)
 {
 	m_shapeType = TRIANGLE_MESH_SHAPE_PROXYTYPE;
 	//construct bvh from meshInterface
@@ -44,8 +46,10 @@ btBvhTriangleMeshShape::btBvhTriangleMeshShape(btStridingMeshInterface* meshInte
 	: btTriangleMeshShape(meshInterface),
 	  m_bvh(0),
 	  m_triangleInfoMap(0),
+	  m_bvh4(0),
 	  m_useQuantizedAabbCompression(useQuantizedAabbCompression),
-	  m_ownsBvh(false)
+	  m_ownsBvh(false),
+	  m_useBvh4(false)
 {
 	m_shapeType = TRIANGLE_MESH_SHAPE_PROXYTYPE;
 	//construct bvh from meshInterface
@@ -66,6 +70,10 @@ btBvhTriangleMeshShape::btBvhTriangleMeshShape(btStridingMeshInterface* meshInte
 void btBvhTriangleMeshShape::partialRefitTree(const btVector3& aabbMin, const btVector3& aabbMax)
 {
 	m_bvh->refitPartial(m_meshInterface, aabbMin, aabbMax);
+	if (m_bvh4)
+	{
+		m_bvh4->refitPartial(aabbMin, aabbMax);
+	}
 
 	m_localAabbMin.setMin(aabbMin);
 	m_localAabbMax.setMax(aabbMax);
@@ -74,12 +82,21 @@ void btBvhTriangleMeshShape::partialRefitTree(const btVector3& aabbMin, const bt
 void btBvhTriangleMeshShape::refitTree(const btVector3& aabbMin, const btVector3& aabbMax)
 {
 	m_bvh->refit(m_meshInterface, aabbMin, aabbMax);
+	if (m_bvh4)
+	{
+		m_bvh4->refit();
+	}
 
 	recalcLocalAabb();
 }
 
 btBvhTriangleMeshShape::~btBvhTriangleMeshShape()
 {
+	if (m_bvh4)
+	{
+		m_bvh4->~btQuantizedBvh4();
+		btAlignedFree(m_bvh4);
+	}
 	if (m_ownsBvh)
 	{
 		m_bvh->~btOptimizedBvh();
@@ -158,6 +175,11 @@ void btBvhTriangleMeshShape::performRaycast(btTriangleCallback* callback, const
 
 	MyNodeOverlapCallback myNodeCallback(callback, m_meshInterface);
 
+	if (m_bvh4)
+	{
+		m_bvh4->reportRayOverlappingNodex(&myNodeCallback, raySource, rayTarget);
+		return;
+	}
 	m_bvh->reportRayOverlappingNodex(&myNodeCallback, raySource, rayTarget);
 }
 
@@ -232,6 +254,11 @@ void btBvhTriangleMeshShape::performConvexcast(btTriangleCallback* callback, con
 
 	MyNodeOverlapCallback myNodeCallback(callback, m_meshInterface);
 
+	if (m_bvh4)
+	{
+		m_bvh4->reportBoxCastOverlappingNodex(&myNodeCallback, raySource, rayTarget, aabbMin, aabbMax);
+		return;
+	}
 	m_bvh->reportBoxCastOverlappingNodex(&myNodeCallback, raySource, rayTarget, aabbMin, aabbMax);
 }
 
@@ -323,6 +350,11 @@ void btBvhTriangleMeshShape::processAllTriangles(btTriangleCallback* callback, c
 
 	MyNodeOverlapCallback myNodeCallback(callback, m_meshInterface);
 
+	if (m_bvh4)
+	{
+		m_bvh4->reportAabbOverlappingNodex(&myNodeCallback, aabbMin, aabbMax);
+		return;
+	}
 	m_bvh->reportAabbOverlappingNodex(&myNodeCallback, aabbMin, aabbMax);
 
 #endif  //DISABLE_BVH
@@ -350,6 +382,35 @@ void btBvhTriangleMeshShape::buildOptimizedBvh()
 	//rebuild the bvh...
 	m_bvh->build(m_meshInterface, m_useQuantizedAabbCompression, m_localAabbMin, m_localAabbMax);
 	m_ownsBvh = true;
+	updateBvh4();
+}
+
+void btBvhTriangleMeshShape::setUseQuantizedBvh4(bool useBvh4)
+{
+	m_useBvh4 = useBvh4;
+	updateBvh4();
+}
+
+void btBvhTriangleMeshShape::updateBvh4()
+{
+	if (m_bvh4)
+	{
+		m_bvh4->~btQuantizedBvh4();
+		btAlignedFree(m_bvh4);
+		m_bvh4 = 0;
+	}
+	if (!m_useBvh4 || !m_bvh || !m_bvh->isQuantized())
+		return;
+
+	void* mem = btAlignedAlloc(sizeof(btQuantizedBvh4), 16);
+	m_bvh4 = new (mem) btQuantizedBvh4();
+	if (!m_bvh4->build(*m_bvh))
+	{
+		// too deep, the queries use the bvh
+		m_bvh4->~btQuantizedBvh4();
+		btAlignedFree(m_bvh4);
+		m_bvh4 = 0;
+	}
 }
 
 void btBvhTriangleMeshShape::setOptimizedBvh(btOptimizedBvh* bvh, const btVector3& scaling)
@@ -364,6 +425,7 @@ void btBvhTriangleMeshShape::setOptimizedBvh(btOptimizedBvh* bvh, const btVector
 	{
 		btTriangleMeshShape::setLocalScaling(scaling);
 	}
+	updateBvh4();
 }
 
 ///fills the dataBuffer and returns the struct name (and 0 on failure)
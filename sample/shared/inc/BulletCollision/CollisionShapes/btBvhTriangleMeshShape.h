@@ -18,6 +18,7 @@ subject to the following restrictions:
 
 #include "btTriangleMeshShape.h"
 #include "btOptimizedBvh.h"
+#include "BulletCollision/BroadphaseCollision/btQuantizedBvh4.h"
 #include "LinearMath/btAlignedAllocator.h"
 #include "btTriangleInfoMap.h"
 
@@ -31,20 +32,25 @@ subject to the following restrictions:
 ///It takes a triangle mesh as input, for example a btTriangleMesh or btTriangleIndexVertexArray. The btBvhTriangleMeshShape class allows for triangle mesh deformations by a refit or partialRefit method.
 ///Instead of building the bounding volume hierarchy acceleration structure, it is also possible to serialize (save) and deserialize (load) the structure from disk.
 ///See Demos\ConcaveDemo\ConcavePhysicsDemo.cpp for an example.
+///With setUseQuantizedBvh4(true) the queries walk a 4-ary copy of the quantized bvh (btQuantizedBvh4), which is kept up to date by the build and refit methods.
 ATTRIBUTE_ALIGNED16(class)
 btBvhTriangleMeshShape : public btTriangleMeshShape
 {
 	btOptimizedBvh* m_bvh;
 	btTriangleInfoMap* m_triangleInfoMap;
+	btQuantizedBvh4* m_bvh4;
 
 	bool m_useQuantizedAabbCompression;
 	bool m_ownsBvh;
+	bool m_useBvh4;
 #ifdef __clang__
-	bool m_pad[11] __attribute__((unused));  ////need padding due to alignment
+	bool m_pad[10] __attribute__((unused));  ////need padding due to alignment
 #else
-	bool m_pad[11];  ////need padding due to alignment
+	bool m_pad[10];  ////need padding due to alignment
 #endif
 
+	void updateBvh4();
+
 public:
 	BT_DECLARE_ALIGNED_ALLOCATOR();
 
@@ -89,6 +95,20 @@ public:
 		return m_useQuantizedAabbCompression;
 	}
 
+	///builds (or frees) the 4-ary copy of the bvh that the queries use instead of the bvh. It needs useQuantizedAabbCompression
+	void setUseQuantizedBvh4(bool useBvh4);
+
+	bool getUseQuantizedBvh4() const
+	{
+		return m_useBvh4;
+	}
+
+	///0 if setUseQuantizedBvh4 is off or the bvh cannot be converted
+	const btQuantizedBvh4* getQuantizedBvh4() const
+	{
+		return m_bvh4;
+	}
+
 	void setTriangleInfoMap(btTriangleInfoMap * triangleInfoMap)
 	{
 		m_triangleInfoMap = triangleInfoMap;
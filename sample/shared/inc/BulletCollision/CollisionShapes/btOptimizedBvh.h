@@ -35,7 +35,8 @@ public:
 
 	virtual ~btOptimizedBvh();
 
-	void build(btStridingMeshInterface * triangles, bool useQuantizedAabbCompression, const btVector3& bvhAabbMin, const btVector3& bvhAabbMax);
+	///buildMode selects the builder, see btQuantizedBvh::btBuildMode
+	void build(btStridingMeshInterface * triangles, bool useQuantizedAabbCompression, const btVector3& bvhAabbMin, const btVector3& bvhAabbMax, btBuildMode buildMode = BUILD_MEAN);
 
 	void refit(btStridingMeshInterface * triangles, const btVector3& aabbMin, const btVector3& aabbMax);
 
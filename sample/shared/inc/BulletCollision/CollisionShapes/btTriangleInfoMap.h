@@ -76,6 +76,43 @@ struct btTriangleInfoMap : public btInternalTriangleInfoMap
 	virtual const char* serialize(void* dataBuffer, btSerializer* serializer) const;
 
 	void deSerialize(struct btTriangleInfoMapData& data);
+
+	///the size of the contiguous buffer written by serializeFlat: a btTriangleInfoMapFlatData followed by its arrays
+	unsigned calculateFlatBufferSize() const;
+
+	///writes the map to a contiguous buffer without a btSerializer, for example to cache it in a file.
+	///Unlike serialize the values are stored as btScalar, so deSerializeFlat restores them exactly; the buffer can only be read by a build with the same btScalar.
+	///m_maxEdgeAngleThreshold is only used by btGenerateInternalEdgeInfo and is not stored
+	bool serializeFlat(void* o_dataBuffer, unsigned i_dataBufferSize) const;
+
+	///reads a map written by serializeFlat, the buffer has to be aligned to sizeof(btScalar) and is not referenced afterwards
+	bool deSerializeFlat(const void* i_dataBuffer, unsigned i_dataBufferSize);
+};
+
+///header of the buffer written by btTriangleInfoMap::serializeFlat.
+///It is followed by m_numValues btTriangleInfoFlatData and the int arrays of the hash table, next and keys
+struct btTriangleInfoMapFlatData
+{
+	btScalar m_convexEpsilon;
+	btScalar m_planarEpsilon;
+	btScalar m_equalVertexThreshold;
+	btScalar m_edgeDistanceThreshold;
+	btScalar m_zeroAreaThreshold;
+	int m_hashTableSize;
+	int m_nextSize;
+	int m_numValues;
+	int m_numKeys;
+	int m_scalarSize;  //sizeof(btScalar) of the writer
+	int m_padding;
+};
+
+struct btTriangleInfoFlatData
+{
+	btScalar m_edgeV0V1Angle;
+	btScalar m_edgeV1V2Angle;
+	btScalar m_edgeV2V0Angle;
+	int m_flags;
+	int m_padding;
 };
 
 // clang-format off
@@ -219,6 +256,9 @@ SIMD_FORCE_INLINE void btTriangleInfoMap::deSerialize(btTriangleInfoMapData& tma
 	{
 		m_next[i] = tmapData.m_nextPtr[i];
 	}
+	//findIndex masks the hash with the capacity of m_valueArray, which has to be the size of the hash table
+	m_valueArray.clear();
+	m_valueArray.reserve(tmapData.m_hashTableSize);
 	m_valueArray.resize(tmapData.m_numValues);
 	for (i = 0; i < tmapData.m_numValues; i++)
 	{
@@ -235,4 +275,108 @@ SIMD_FORCE_INLINE void btTriangleInfoMap::deSerialize(btTriangleInfoMapData& tma
 	}
 }
 
+SIMD_FORCE_INLINE unsigned btTriangleInfoMap::calculateFlatBufferSize() const
+{
+	return sizeof(btTriangleInfoMapFlatData) + sizeof(btTriangleInfoFlatData) * m_valueArray.size() + sizeof(int) * (m_hashTable.size() + m_next.size() + m_keyArray.size());
+}
+
+SIMD_FORCE_INLINE bool btTriangleInfoMap::serializeFlat(void* o_dataBuffer, unsigned i_dataBufferSize) const
+{
+	if (i_dataBufferSize < calculateFlatBufferSize())
+		return false;
+
+	btTriangleInfoMapFlatData* tmapData = (btTriangleInfoMapFlatData*)o_dataBuffer;
+	memset(tmapData, 0, sizeof(btTriangleInfoMapFlatData));
+	tmapData->m_convexEpsilon = m_convexEpsilon;
+	tmapData->m_planarEpsilon = m_planarEpsilon;
+	tmapData->m_equalVertexThreshold = m_equalVertexThreshold;
+	tmapData->m_edgeDistanceThreshold = m_edgeDistanceThreshold;
+	tmapData->m_zeroAreaThreshold = m_zeroAreaThreshold;
+	tmapData->m_hashTableSize = m_hashTable.size();
+	tmapData->m_nextSize = m_next.size();
+	tmapData->m_numValues = m_valueArray.size();
+	tmapData->m_numKeys = m_keyArray.size();
+	tmapData->m_scalarSize = sizeof(btScalar);
+
+	//the values come first so that they stay aligned to btScalar
+	btTriangleInfoFlatData* values = (btTriangleInfoFlatData*)(tmapData + 1);
+	int* hashTable = (int*)(values + m_valueArray.size());
+	int* next = hashTable + m_hashTable.size();
+	int* keys = next + m_next.size();
+	int i;
+	for (i = 0; i < m_valueArray.size(); i++)
+	{
+		values[i].m_edgeV0V1Angle = m_valueArray[i].m_edgeV0V1Angle;
+		values[i].m_edgeV1V2Angle = m_valueArray[i].m_edgeV1V2Angle;
+		values[i].m_edgeV2V0Angle = m_valueArray[i].m_edgeV2V0Angle;
+		values[i].m_flags = m_valueArray[i].m_flags;
+		values[i].m_padding = 0;
+	}
+	for (i = 0; i < m_hashTable.size(); i++)
+	{
+		hashTable[i] = m_hashTable[i];
+	}
+	for (i = 0; i < m_next.size(); i++)
+	{
+		next[i] = m_next[i];
+	}
+	for (i = 0; i < m_keyArray.size(); i++)
+	{
+		keys[i] = m_keyArray[i].getUid1();
+	}
+	return true;
+}
+
+SIMD_FORCE_INLINE bool btTriangleInfoMap::deSerializeFlat(const void* i_dataBuffer, unsigned i_dataBufferSize)
+{
+	if (i_dataBufferSize < sizeof(btTriangleInfoMapFlatData))
+		return false;
+
+	const btTriangleInfoMapFlatData* tmapData = (const btTriangleInfoMapFlatData*)i_dataBuffer;
+	if (tmapData->m_scalarSize != (int)sizeof(btScalar) || tmapData->m_hashTableSize < 0 || tmapData->m_nextSize < 0 || tmapData->m_numValues < 0 || tmapData->m_numKeys != tmapData->m_numValues)
+		return false;
+	unsigned long long size = sizeof(btTriangleInfoMapFlatData) + sizeof(btTriangleInfoFlatData) * (unsigned long long)tmapData->m_numValues + sizeof(int) * ((unsigned long long)tmapData->m_hashTableSize + tmapData->m_nextSize + tmapData->m_numKeys);
+	if (i_dataBufferSize < size)
+		return false;
+
+	const btTriangleInfoFlatData* values = (const btTriangleInfoFlatData*)(tmapData + 1);
+	const int* hashTable = (const int*)(values + tmapData->m_numValues);
+	const int* next = hashTable + tmapData->m_hashTableSize;
+	const int* keys = next + tmapData->m_nextSize;
+
+	m_convexEpsilon = tmapData->m_convexEpsilon;
+	m_planarEpsilon = tmapData->m_planarEpsilon;
+	m_equalVertexThreshold = tmapData->m_equalVertexThreshold;
+	m_edgeDistanceThreshold = tmapData->m_edgeDistanceThreshold;
+	m_zeroAreaThreshold = tmapData->m_zeroAreaThreshold;
+	int i;
+	m_hashTable.resize(tmapData->m_hashTableSize);
+	for (i = 0; i < tmapData->m_hashTableSize; i++)
+	{
+		m_hashTable[i] = hashTable[i];
+	}
+	m_next.resize(tmapData->m_nextSize);
+	for (i = 0; i < tmapData->m_nextSize; i++)
+	{
+		m_next[i] = next[i];
+	}
+	//findIndex masks the hash with the capacity of m_valueArray, which has to be the size of the hash table (see deSerialize)
+	m_valueArray.clear();
+	m_valueArray.reserve(tmapData->m_hashTableSize);
+	m_valueArray.resize(tmapData->m_numValues);
+	for (i = 0; i < tmapData->m_numValues; i++)
+	{
+		m_valueArray[i].m_edgeV0V1Angle = values[i].m_edgeV0V1Angle;
+		m_valueArray[i].m_edgeV1V2Angle = values[i].m_edgeV1V2Angle;
+		m_valueArray[i].m_edgeV2V0Angle = values[i].m_edgeV2V0Angle;
+		m_valueArray[i].m_flags = values[i].m_flags;
+	}
+	m_keyArray.resize(tmapData->m_numKeys, btHashInt(0));
+	for (i = 0; i < tmapData->m_numKeys; i++)
+	{
+		m_keyArray[i].setUid1(keys[i]);
+	}
+	return true;
+}
+
 #endif  //_BT_TRIANGLE_INFO_MAP_H
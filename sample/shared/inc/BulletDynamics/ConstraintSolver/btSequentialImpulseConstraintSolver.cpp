@@ -111,7 +111,11 @@ static inline __m128 btSimdDot3(__m128 vec0, __m128 vec1)
 }
 
 #if defined(BT_ALLOW_SSE4)
+#ifdef _MSC_VER
 #include <intrin.h>
+#else
+#include <immintrin.h>
+#endif
 
 #define USE_FMA 1
 #define USE_FMA3_INSTEAD_FMA4 1
@@ -178,7 +182,7 @@ static btScalar gResolveSingleConstraintRowGeneric_sse2(btSolverBody& bodyA, btS
 }
 
 // Enhanced version of gResolveSingleConstraintRowGeneric_sse2 with SSE4.1 and FMA3
-static btScalar gResolveSingleConstraintRowGeneric_sse4_1_fma3(btSolverBody& bodyA, btSolverBody& bodyB, const btSolverConstraint& c)
+static BT_SSE4_FMA3_TARGET btScalar gResolveSingleConstraintRowGeneric_sse4_1_fma3(btSolverBody& bodyA, btSolverBody& bodyB, const btSolverConstraint& c)
 {
 #if defined(BT_ALLOW_SSE4)
 	__m128 tmp = _mm_set_ps1(c.m_jacDiagABInv);
@@ -233,7 +237,7 @@ static btScalar gResolveSingleConstraintRowLowerLimit_sse2(btSolverBody& bodyA,
 }
 
 // Enhanced version of gResolveSingleConstraintRowGeneric_sse2 with SSE4.1 and FMA3
-static btScalar gResolveSingleConstraintRowLowerLimit_sse4_1_fma3(btSolverBody& bodyA, btSolverBody& bodyB, const btSolverConstraint& c)
+static BT_SSE4_FMA3_TARGET btScalar gResolveSingleConstraintRowLowerLimit_sse4_1_fma3(btSolverBody& bodyA, btSolverBody& bodyB, const btSolverConstraint& c)
 {
 #ifdef BT_ALLOW_SSE4
 	__m128 tmp = _mm_set_ps1(c.m_jacDiagABInv);
@@ -370,14 +374,14 @@ void btSequentialImpulseConstraintSolver::setupSolverFunctions(bool useSimd)
 		m_resolveSingleConstraintRowLowerLimit = gResolveSingleConstraintRowLowerLimit_sse2;
 		m_resolveSplitPenetrationImpulse = gResolveSplitPenetrationImpulse_sse2;
 
-#ifdef BT_ALLOW_SSE4
+#if defined(BT_ALLOW_SSE4) && defined(BT_USE_FMA3_RUNTIME_DISPATCH)
 		int cpuFeatures = btCpuFeatureUtility::getCpuFeatures();
 		if ((cpuFeatures & btCpuFeatureUtility::CPU_FEATURE_FMA3) && (cpuFeatures & btCpuFeatureUtility::CPU_FEATURE_SSE4_1))
 		{
 			m_resolveSingleConstraintRowGeneric = gResolveSingleConstraintRowGeneric_sse4_1_fma3;
 			m_resolveSingleConstraintRowLowerLimit = gResolveSingleConstraintRowLowerLimit_sse4_1_fma3;
 		}
-#endif  //BT_ALLOW_SSE4
+#endif  //BT_ALLOW_SSE4 && BT_USE_FMA3_RUNTIME_DISPATCH
 #endif  //USE_SIMD
 	}
 }
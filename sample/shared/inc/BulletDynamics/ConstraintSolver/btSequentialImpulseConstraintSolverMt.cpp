@@ -513,7 +513,12 @@ struct AllocContactConstraintsLoop : public btIParallelForBody
 void btSequentialImpulseConstraintSolverMt::allocAllContactConstraints(btPersistentManifold** manifoldPtr, int numManifolds, const btContactSolverInfo& infoGlobal)
 {
 	BT_PROFILE("allocAllContactConstraints");
-	btAlignedObjectArray<btContactManifoldCachedInfo> cachedInfoArray;  // = m_manifoldCachedInfoArray;
+	// reuse the member array so steady-state stepping does not allocate, with some slack so a slowly growing manifold count does not reallocate every frame
+	btAlignedObjectArray<btContactManifoldCachedInfo>& cachedInfoArray = m_manifoldCachedInfoArray;
+	if (cachedInfoArray.capacity() < numManifolds)
+	{
+		cachedInfoArray.reserve(numManifolds + numManifolds / 16);
+	}
 	cachedInfoArray.resizeNoInitialize(numManifolds);
 	if (/* DISABLES CODE */ (false))
 	{
@@ -705,7 +710,11 @@ void btSequentialImpulseConstraintSolverMt::convertJoints(btTypedConstraint** co
 	}
 
 	int totalNumRows = 0;
-	btAlignedObjectArray<JointParams> jointParamsArray;
+	btAlignedObjectArray<JointParams>& jointParamsArray = m_jointParamsArray;
+	if (jointParamsArray.capacity() < numConstraints)
+	{
+		jointParamsArray.reserve(numConstraints + numConstraints / 16);
+	}
 	jointParamsArray.resizeNoInitialize(numConstraints);
 
 	//calculate the total number of contraint rows
@@ -1467,3 +1467,460 @@ void btDiscreteDynamicsWorld::serialize(btSerializer* serializer)
 
 	serializer->finishSerialization();
 }
+
+//
+// Snapshots
+//
+
+///the snapshot buffer starts with this header, followed by the objects, constraints, overlapping pairs, manifolds, contact points
+///and the broadphase state. All records are 16 byte aligned, so that the buffer can be read in place
+ATTRIBUTE_ALIGNED16(struct)
+btDynamicsWorldSnapshotHeader
+{
+	int m_numObjects;
+	int m_numConstraints;
+	int m_numPairs;
+	int m_numManifolds;
+	int m_numPoints;
+	int m_broadphaseSize;  // 0 if the broadphase does not support snapshots
+	btScalar m_localTime;
+};
+
+ATTRIBUTE_ALIGNED16(struct)
+btCollisionObjectSnapshot
+{
+	btTransform m_worldTransform;
+	btTransform m_interpolationWorldTransform;
+	btVector3 m_interpolationLinearVelocity;
+	btVector3 m_interpolationAngularVelocity;
+	btVector3 m_linearVelocity;
+	btVector3 m_angularVelocity;
+	btCollisionObject* m_object;
+	btBroadphaseProxy* m_proxy;
+	btScalar m_hitFraction;
+	btScalar m_deactivationTime;
+	int m_activationState;
+	int m_islandTag;
+	int m_companionId;
+};
+
+ATTRIBUTE_ALIGNED16(struct)
+btConstraintSnapshot
+{
+	btJointFeedback m_feedback;
+	btTypedConstraint* m_constraint;
+	btScalar m_appliedImpulse;
+	int m_enabled;
+};
+
+ATTRIBUTE_ALIGNED16(struct)
+btOverlappingPairSnapshot
+{
+	btBroadphaseProxy* m_proxy0;
+	btBroadphaseProxy* m_proxy1;
+	void* m_internalInfo1;
+	int m_hasAlgorithm;
+};
+
+ATTRIBUTE_ALIGNED16(struct)
+btManifoldSnapshot
+{
+	const btCollisionObject* m_body0;
+	const btCollisionObject* m_body1;
+	btScalar m_contactBreakingThreshold;
+	btScalar m_contactProcessingThreshold;
+	int m_numContacts;
+	int m_companionIdA;
+	int m_companionIdB;
+	int m_predictive;
+};
+
+///manifolds are matched by their pair of bodies (world array indices), and by their order for manifolds of the same pair
+struct btManifoldSnapshotKey
+{
+	int m_body0;
+	int m_body1;
+	int m_index;
+};
+
+class btManifoldSnapshotKeySortPredicate
+{
+public:
+	bool operator()(const btManifoldSnapshotKey& a, const btManifoldSnapshotKey& b) const
+	{
+		if (a.m_body0 != b.m_body0)
+			return a.m_body0 < b.m_body0;
+		if (a.m_body1 != b.m_body1)
+			return a.m_body1 < b.m_body1;
+		return a.m_index < b.m_index;
+	}
+};
+
+bool btDiscreteDynamicsWorld::saveSnapshot(btAlignedObjectArray<char>& buffer)
+{
+	BT_PROFILE("saveSnapshot");
+	int i;
+	for (i = 0; i < m_collisionObjects.size(); i++)
+	{
+		int type = m_collisionObjects[i]->getInternalType();
+		if (type != btCollisionObject::CO_COLLISION_OBJECT && type != btCollisionObject::CO_RIGID_BODY && type != btCollisionObject::CO_GHOST_OBJECT)
+			return false;
+	}
+
+	const btBroadphasePairArray& pairs = m_broadphasePairCache->getOverlappingPairCache()->getOverlappingPairArray();
+	int numManifolds = m_dispatcher1->getNumManifolds();
+	btPersistentManifold** manifolds = m_dispatcher1->getInternalManifoldPointer();
+	int numPoints = 0;
+	for (i = 0; i < numManifolds; i++)
+		numPoints += manifolds[i]->getNumContacts();
+
+	// the broadphase appends its state to the end of the buffer
+	int size = int(sizeof(btDynamicsWorldSnapshotHeader) + m_collisionObjects.size() * sizeof(btCollisionObjectSnapshot) + m_constraints.size() * sizeof(btConstraintSnapshot) + pairs.size() * sizeof(btOverlappingPairSnapshot) + numManifolds * sizeof(btManifoldSnapshot) + numPoints * sizeof(btManifoldPoint));
+	if (buffer.capacity() < size)
+		buffer.reserve(size + size / 16);
+	buffer.resizeNoInitialize(size);
+	char* data = &buffer[0];
+
+	btDynamicsWorldSnapshotHeader* header = (btDynamicsWorldSnapshotHeader*)data;
+	header->m_numObjects = m_collisionObjects.size();
+	header->m_numConstraints = m_constraints.size();
+	header->m_numPairs = pairs.size();
+	header->m_numManifolds = numManifolds;
+	header->m_numPoints = numPoints;
+	header->m_broadphaseSize = 0;
+	header->m_localTime = m_localTime;
+	data += sizeof(btDynamicsWorldSnapshotHeader);
+
+	btCollisionObjectSnapshot* objects = (btCollisionObjectSnapshot*)data;
+	for (i = 0; i < m_collisionObjects.size(); i++)
+	{
+		btCollisionObject* obj = m_collisionObjects[i];
+		btCollisionObjectSnapshot& os = objects[i];
+		os.m_worldTransform = obj->getWorldTransform();
+		os.m_interpolationWorldTransform = obj->getInterpolationWorldTransform();
+		os.m_interpolationLinearVelocity = obj->getInterpolationLinearVelocity();
+		os.m_interpolationAngularVelocity = obj->getInterpolationAngularVelocity();
+		btRigidBody* body = btRigidBody::upcast(obj);
+		os.m_linearVelocity = body ? body->getLinearVelocity() : btVector3(0, 0, 0);
+		os.m_angularVelocity = body ? body->getAngularVelocity() : btVector3(0, 0, 0);
+		os.m_object = obj;
+		os.m_proxy = obj->getBroadphaseHandle();
+		os.m_hitFraction = obj->getHitFraction();
+		os.m_deactivationTime = obj->getDeactivationTime();
+		os.m_activationState = obj->getActivationState();
+		os.m_islandTag = obj->getIslandTag();
+		os.m_companionId = obj->getCompanionId();
+	}
+	data += m_collisionObjects.size() * sizeof(btCollisionObjectSnapshot);
+
+	btConstraintSnapshot* constraints = (btConstraintSnapshot*)data;
+	for (i = 0; i < m_constraints.size(); i++)
+	{
+		btTypedConstraint* constraint = m_constraints[i];
+		btConstraintSnapshot& cs = constraints[i];
+		if (constraint->getJointFeedback())
+		{
+			cs.m_feedback = *constraint->getJointFeedback();
+		}
+		else
+		{
+			cs.m_feedback.m_appliedForceBodyA.setZero();
+			cs.m_feedback.m_appliedTorqueBodyA.setZero();
+			cs.m_feedback.m_appliedForceBodyB.setZero();
+			cs.m_feedback.m_appliedTorqueBodyB.setZero();
+		}
+		cs.m_constraint = constraint;
+		cs.m_appliedImpulse = constraint->getAppliedImpulse();
+		cs.m_enabled = constraint->isEnabled();
+	}
+	data += m_constraints.size() * sizeof(btConstraintSnapshot);
+
+	btOverlappingPairSnapshot* pairStates = (btOverlappingPairSnapshot*)data;
+	for (i = 0; i < pairs.size(); i++)
+	{
+		const btBroadphasePair& pair = pairs[i];
+		btOverlappingPairSnapshot& ps = pairStates[i];
+		ps.m_proxy0 = pair.m_pProxy0;
+		ps.m_proxy1 = pair.m_pProxy1;
+		ps.m_internalInfo1 = pair.m_internalInfo1;
+		ps.m_hasAlgorithm = pair.m_algorithm != 0;
+	}
+	data += pairs.size() * sizeof(btOverlappingPairSnapshot);
+
+	btManifoldSnapshot* manifoldStates = (btManifoldSnapshot*)data;
+	for (i = 0; i < numManifolds; i++)
+	{
+		const btPersistentManifold* manifold = manifolds[i];
+		btManifoldSnapshot& ms = manifoldStates[i];
+		ms.m_body0 = manifold->getBody0();
+		ms.m_body1 = manifold->getBody1();
+		ms.m_contactBreakingThreshold = manifold->getContactBreakingThreshold();
+		ms.m_contactProcessingThreshold = manifold->getContactProcessingThreshold();
+		ms.m_numContacts = manifold->getNumContacts();
+		ms.m_companionIdA = manifold->m_companionIdA;
+		ms.m_companionIdB = manifold->m_companionIdB;
+		ms.m_predictive = 0;
+	}
+	for (i = 0; i < m_predictiveManifolds.size(); i++)
+	{
+		manifoldStates[m_predictiveManifolds[i]->m_index1a].m_predictive = 1;
+	}
+	data += numManifolds * sizeof(btManifoldSnapshot);
+
+	btManifoldPoint* points = (btManifoldPoint*)data;
+	for (i = 0; i < numManifolds; i++)
+	{
+		for (int j = 0; j < manifolds[i]->getNumContacts(); j++)
+		{
+			*points++ = manifolds[i]->getContactPoint(j);
+		}
+	}
+
+	if (m_broadphasePairCache->saveState(buffer))
+	{
+		header = (btDynamicsWorldSnapshotHeader*)&buffer[0];
+		header->m_broadphaseSize = buffer.size() - size;
+	}
+	return true;
+}
+
+bool btDiscreteDynamicsWorld::restoreSnapshot(const btAlignedObjectArray<char>& buffer)
+{
+	BT_PROFILE("restoreSnapshot");
+	if (buffer.size() < int(sizeof(btDynamicsWorldSnapshotHeader)))
+		return false;
+	const char* data = &buffer[0];
+	const btDynamicsWorldSnapshotHeader* header = (const btDynamicsWorldSnapshotHeader*)data;
+	data += sizeof(btDynamicsWorldSnapshotHeader);
+	const btCollisionObjectSnapshot* objects = (const btCollisionObjectSnapshot*)data;
+	data += header->m_numObjects * sizeof(btCollisionObjectSnapshot);
+	const btConstraintSnapshot* constraints = (const btConstraintSnapshot*)data;
+	data += header->m_numConstraints * sizeof(btConstraintSnapshot);
+	const btOverlappingPairSnapshot* pairStates = (const btOverlappingPairSnapshot*)data;
+	data += header->m_numPairs * sizeof(btOverlappingPairSnapshot);
+	const btManifoldSnapshot* manifoldStates = (const btManifoldSnapshot*)data;
+	data += header->m_numManifolds * sizeof(btManifoldSnapshot);
+	const btManifoldPoint* points = (const btManifoldPoint*)data;
+	data += header->m_numPoints * sizeof(btManifoldPoint);
+	const char* broadphaseState = data;
+	data += header->m_broadphaseSize;
+	if (data != &buffer[0] + buffer.size())
+		return false;
+
+	// the snapshot only references the objects, so they must still be the same
+	int i;
+	if (header->m_numObjects != m_collisionObjects.size() || header->m_numConstraints != m_constraints.size())
+		return false;
+	for (i = 0; i < m_collisionObjects.size(); i++)
+	{
+		if (objects[i].m_object != m_collisionObjects[i] || objects[i].m_proxy != m_collisionObjects[i]->getBroadphaseHandle())
+			return false;
+	}
+	for (i = 0; i < m_constraints.size(); i++)
+	{
+		if (constraints[i].m_constraint != m_constraints[i])
+			return false;
+	}
+
+	// the broadphase checks its own state first, so nothing is changed if it does not fit
+	if (header->m_broadphaseSize && m_broadphasePairCache->loadState(broadphaseState) != header->m_broadphaseSize)
+		return false;
+
+	for (i = 0; i < m_collisionObjects.size(); i++)
+	{
+		const btCollisionObjectSnapshot& os = objects[i];
+		btCollisionObject* obj = m_collisionObjects[i];
+		obj->setWorldTransform(os.m_worldTransform);
+		obj->setInterpolationWorldTransform(os.m_interpolationWorldTransform);
+		obj->setInterpolationLinearVelocity(os.m_interpolationLinearVelocity);
+		obj->setInterpolationAngularVelocity(os.m_interpolationAngularVelocity);
+		obj->setHitFraction(os.m_hitFraction);
+		obj->setDeactivationTime(os.m_deactivationTime);
+		obj->forceActivationState(os.m_activationState);
+		obj->setIslandTag(os.m_islandTag);
+		obj->setCompanionId(os.m_companionId);
+		btRigidBody* body = btRigidBody::upcast(obj);
+		if (body)
+		{
+			body->setLinearVelocity(os.m_linearVelocity);
+			body->setAngularVelocity(os.m_angularVelocity);
+			body->clearForces();
+			body->updateInertiaTensor();
+		}
+	}
+
+	for (i = 0; i < m_constraints.size(); i++)
+	{
+		const btConstraintSnapshot& cs = constraints[i];
+		btTypedConstraint* constraint = m_constraints[i];
+		constraint->internalSetAppliedImpulse(cs.m_appliedImpulse);
+		constraint->setEnabled(cs.m_enabled != 0);
+		if (constraint->getJointFeedback())
+			*constraint->getJointFeedback() = cs.m_feedback;
+	}
+
+	// predictive manifolds belong to the world, the saved ones are created again below
+	releasePredictiveContacts();
+
+	// take all pairs out of the cache but keep their collision algorithms, so that pairs that still overlap keep their manifolds
+	btOverlappingPairCache* pairCache = m_broadphasePairCache->getOverlappingPairCache();
+	btBroadphasePairArray& livePairs = pairCache->getOverlappingPairArray();
+	btBroadphasePairArray oldPairs;
+	oldPairs.copyFromArray(livePairs);
+	for (i = 0; i < livePairs.size(); i++)
+		livePairs[i].m_algorithm = 0;
+	while (livePairs.size())
+	{
+		btBroadphaseProxy* proxy0 = livePairs[livePairs.size() - 1].m_pProxy0;
+		btBroadphaseProxy* proxy1 = livePairs[livePairs.size() - 1].m_pProxy1;
+		pairCache->removeOverlappingPair(proxy0, proxy1, m_dispatcher1);
+	}
+
+	for (i = 0; i < header->m_numPairs; i++)
+	{
+		btBroadphasePair* pair = pairCache->addOverlappingPair(pairStates[i].m_proxy0, pairStates[i].m_proxy1);
+		if (pair)
+			pair->m_internalInfo1 = pairStates[i].m_internalInfo1;
+	}
+
+	// pairs are added in the saved order, so the index in the cache is the index in the snapshot
+	for (i = 0; i < oldPairs.size(); i++)
+	{
+		btCollisionAlgorithm* algorithm = oldPairs[i].m_algorithm;
+		if (!algorithm)
+			continue;
+		btBroadphasePair* pair = pairCache->findPair(oldPairs[i].m_pProxy0, oldPairs[i].m_pProxy1);
+		int index = pair ? int(pair - &livePairs[0]) : -1;
+		if (pair && index < header->m_numPairs && pairStates[index].m_proxy0 == pair->m_pProxy0 && pairStates[index].m_hasAlgorithm)
+		{
+			pair->m_algorithm = algorithm;
+		}
+		else
+		{
+			algorithm->~btCollisionAlgorithm();
+			m_dispatcher1->freeCollisionAlgorithm(algorithm);
+		}
+	}
+
+	// new pairs get their algorithm like in btCollisionDispatcher::defaultNearCallback, which also creates their manifolds
+	for (i = 0; i < livePairs.size(); i++)
+	{
+		btBroadphasePair& pair = livePairs[i];
+		if (pair.m_algorithm || i >= header->m_numPairs || pairStates[i].m_proxy0 != pair.m_pProxy0 || !pairStates[i].m_hasAlgorithm)
+			continue;
+		btCollisionObject* colObj0 = (btCollisionObject*)pair.m_pProxy0->m_clientObject;
+		btCollisionObject* colObj1 = (btCollisionObject*)pair.m_pProxy1->m_clientObject;
+		btCollisionObjectWrapper obj0Wrap(0, colObj0->getCollisionShape(), colObj0, colObj0->getWorldTransform(), -1, -1);
+		btCollisionObjectWrapper obj1Wrap(0, colObj1->getCollisionShape(), colObj1, colObj1->getWorldTransform(), -1, -1);
+		pair.m_algorithm = m_dispatcher1->findAlgorithm(&obj0Wrap, &obj1Wrap, 0, BT_CONTACT_POINT_ALGORITHMS);
+		if (pair.m_algorithm)
+		{
+			btManifoldResult contactPointResult(&obj0Wrap, &obj1Wrap);
+			pair.m_algorithm->processCollision(&obj0Wrap, &obj1Wrap, getDispatchInfo(), &contactPointResult);
+		}
+	}
+
+	// manifolds are owned by the collision algorithms. Match the saved manifolds to the live ones by their bodies,
+	// and put them in the saved order, which is the order in which the solver visits them
+	int numLive = m_dispatcher1->getNumManifolds();
+	btPersistentManifold** manifolds = m_dispatcher1->getInternalManifoldPointer();
+	btAlignedObjectArray<btManifoldSnapshotKey> liveKeys;
+	liveKeys.resize(numLive);
+	for (i = 0; i < numLive; i++)
+	{
+		manifolds[i]->m_index1a = i;
+		liveKeys[i].m_body0 = manifolds[i]->getBody0()->getWorldArrayIndex();
+		liveKeys[i].m_body1 = manifolds[i]->getBody1()->getWorldArrayIndex();
+		liveKeys[i].m_index = i;
+	}
+	liveKeys.quickSort(btManifoldSnapshotKeySortPredicate());
+
+	btAlignedObjectArray<btManifoldSnapshotKey> savedKeys;
+	savedKeys.reserve(header->m_numManifolds);
+	for (i = 0; i < header->m_numManifolds; i++)
+	{
+		if (manifoldStates[i].m_predictive)
+			continue;
+		btManifoldSnapshotKey key;
+		key.m_body0 = manifoldStates[i].m_body0->getWorldArrayIndex();
+		key.m_body1 = manifoldStates[i].m_body1->getWorldArrayIndex();
+		key.m_index = i;
+		savedKeys.push_back(key);
+	}
+	savedKeys.quickSort(btManifoldSnapshotKeySortPredicate());
+
+	btAlignedObjectArray<btPersistentManifold*> matched;
+	matched.resize(header->m_numManifolds, 0);
+	int j = 0;
+	for (i = 0; i < savedKeys.size() && j < numLive;)
+	{
+		const btManifoldSnapshotKey& saved = savedKeys[i];
+		const btManifoldSnapshotKey& live = liveKeys[j];
+		if (saved.m_body0 < live.m_body0 || (saved.m_body0 == live.m_body0 && saved.m_body1 < live.m_body1))
+		{
+			i++;
+		}
+		else if (saved.m_body0 != live.m_body0 || saved.m_body1 != live.m_body1)
+		{
+			j++;
+		}
+		else
+		{
+			matched[saved.m_index] = manifolds[live.m_index];
+			i++;
+			j++;
+		}
+	}
+	for (i = 0; i < header->m_numManifolds; i++)
+	{
+		if (manifoldStates[i].m_predictive)
+		{
+			matched[i] = m_dispatcher1->getNewManifold(manifoldStates[i].m_body0, manifoldStates[i].m_body1);
+			m_predictiveManifolds.push_back(matched[i]);
+		}
+	}
+
+	btAlignedObjectArray<btPersistentManifold*> order;
+	order.reserve(m_dispatcher1->getNumManifolds());
+	const btManifoldPoint* point = points;
+	for (i = 0; i < header->m_numManifolds; i++)
+	{
+		const btManifoldSnapshot& ms = manifoldStates[i];
+		btPersistentManifold* manifold = matched[i];
+		if (manifold)
+		{
+			manifold->setNumContacts(ms.m_numContacts);
+			for (j = 0; j < ms.m_numContacts; j++)
+				manifold->getContactPoint(j) = point[j];
+			manifold->setContactBreakingThreshold(ms.m_contactBreakingThreshold);
+			manifold->setContactProcessingThreshold(ms.m_contactProcessingThreshold);
+			manifold->m_companionIdA = ms.m_companionIdA;
+			manifold->m_companionIdB = ms.m_companionIdB;
+			manifold->m_index1a = -1;
+			order.push_back(manifold);
+		}
+		point += ms.m_numContacts;
+	}
+	// live manifolds that were not in the snapshot (an algorithm with more manifolds than before) are emptied
+	manifolds = m_dispatcher1->getInternalManifoldPointer();
+	for (i = 0; i < numLive; i++)
+	{
+		if (manifolds[i]->m_index1a != -1)
+		{
+			manifolds[i]->clearManifold();
+			order.push_back(manifolds[i]);
+		}
+	}
+	btAssert(order.size() == m_dispatcher1->getNumManifolds());
+	for (i = 0; i < order.size(); i++)
+	{
+		manifolds[i] = order[i];
+		manifolds[i]->m_index1a = i;
+	}
+
+	// sleeping bodies may have moved since the snapshot, so all motion states are updated
+	m_localTime = header->m_localTime;
+	for (i = 0; i < m_nonStaticRigidBodies.size(); i++)
+		synchronizeSingleMotionState(m_nonStaticRigidBodies[i]);
+	return true;
+}
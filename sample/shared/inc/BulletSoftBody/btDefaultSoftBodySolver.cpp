@@ -20,6 +20,8 @@ subject to the following restrictions:
 #include "btDefaultSoftBodySolver.h"
 #include "BulletCollision/CollisionShapes/btCapsuleShape.h"
 #include "BulletSoftBody/btSoftBody.h"
+#include "LinearMath/btHashMap.h"
+#include "LinearMath/btThreads.h"
 
 btDefaultSoftBodySolver::btDefaultSoftBodySolver()
 {
@@ -43,16 +45,36 @@ void btDefaultSoftBodySolver::optimize(btAlignedObjectArray<btSoftBody *> &softB
 	m_softBodySet.copyFromArray(softBodies);
 }
 
+/* integrateMotion of the active soft bodies [iBegin,iEnd)	*/
+struct btSoftBodyIntegrateMotionTask : public btIParallelForBody
+{
+	btSoftBody *const *m_bodies;
+	btSoftBodyIntegrateMotionTask(btSoftBody *const *bodies) : m_bodies(bodies) {}
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			m_bodies[i]->integrateMotion();
+		}
+	}
+};
+
 void btDefaultSoftBodySolver::updateSoftBodies()
 {
+	btAlignedObjectArray<btSoftBody *> active;
 	for (int i = 0; i < m_softBodySet.size(); i++)
 	{
 		btSoftBody *psb = (btSoftBody *)m_softBodySet[i];
 		if (psb->isActive())
 		{
-			psb->integrateMotion();
+			active.push_back(psb);
 		}
 	}
+	// Each body only updates its own nodes and faces
+	if (active.size() > 0)
+	{
+		btSoftBody::parallelFor(0, active.size(), 1, btSoftBodyIntegrateMotionTask(&active[0]));
+	}
 }  // updateSoftBodies
 
 bool btDefaultSoftBodySolver::checkInitialized()
@@ -60,17 +82,199 @@ bool btDefaultSoftBodySolver::checkInitialized()
 	return true;
 }
 
+/* Union-find over m_softBodySet, the root of a set is its smallest index	*/
+static int btFindSoftBodyIsland(btAlignedObjectArray<int> &parent, int i)
+{
+	while (parent[i] != i)
+	{
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+static void btUniteSoftBodyIslands(btAlignedObjectArray<int> &parent, int a, int b)
+{
+	a = btFindSoftBodyIsland(parent, a);
+	b = btFindSoftBodyIsland(parent, b);
+	if (a < b)
+		parent[b] = a;
+	else if (b < a)
+		parent[a] = b;
+}
+
+/* Join body i with the previous soft body that writes to the same rigid body or multibody	*/
+static void btUniteSoftBodyIslands(btHashMap<btHashPtr, int> &owners, btAlignedObjectArray<int> &parent, const void *shared, int i)
+{
+	const int *owner = owners.find(shared);
+	if (owner)
+		btUniteSoftBodyIslands(parent, *owner, i);
+	else
+		owners.insert(shared, i);
+}
+
+/* Faces of a soft body, to find the body of a soft contact face	*/
+struct btSoftBodyFaceRange
+{
+	const btSoftBody::Face *m_begin;
+	const btSoftBody::Face *m_end;
+	int m_body;
+};
+
+struct btSoftBodyFaceRangeSortPredicate
+{
+	bool operator()(const btSoftBodyFaceRange &a, const btSoftBodyFaceRange &b) const
+	{
+		return a.m_begin < b.m_begin;
+	}
+};
+
+static int btFindSoftBodyOfFace(const btAlignedObjectArray<btSoftBodyFaceRange> &ranges, const btSoftBody::Face *face)
+{
+	int lo = 0, hi = ranges.size() - 1;
+	while (lo <= hi)
+	{
+		const int mid = (lo + hi) / 2;
+		if (face < ranges[mid].m_begin)
+			hi = mid - 1;
+		else if (face >= ranges[mid].m_end)
+			lo = mid + 1;
+		else
+			return ranges[mid].m_body;
+	}
+	return -1;
+}
+
+/* Merge the contact buffers of the soft bodies [iBegin,iEnd)	*/
+struct btSoftBodyMergeContactsTask : public btIParallelForBody
+{
+	btSoftBody *const *m_bodies;
+	btSoftBodyMergeContactsTask(btSoftBody *const *bodies) : m_bodies(bodies) {}
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			m_bodies[i]->mergeContacts();
+		}
+	}
+};
+
+/* Solve the islands [iBegin,iEnd), the bodies of an island in order	*/
+struct btSoftBodyIslandTask : public btIParallelForBody
+{
+	btSoftBody *const *m_bodies;  // Active bodies sorted by island
+	const int *m_islands;         // First body of each island, followed by the number of bodies
+	btSoftBodyIslandTask(btSoftBody *const *bodies, const int *islands) : m_bodies(bodies), m_islands(islands) {}
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int i = m_islands[iBegin]; i < m_islands[iEnd]; ++i)
+		{
+			m_bodies[i]->solveConstraints();
+		}
+	}
+};
+
 void btDefaultSoftBodySolver::solveConstraints(btScalar solverdt)
 {
 	// Solve constraints for non-solver softbodies
-	for (int i = 0; i < m_softBodySet.size(); ++i)
+	// Bodies that write to the same dynamic rigid body, multibody or to each other's nodes (soft contacts)
+	// are solved in order on one thread; the other islands share no written data and are solved in parallel,
+	// so the result does not depend on the number of threads.
+	const int nb = m_softBodySet.size();
+	int i, j, ni;
+	btAlignedObjectArray<int> parent;
+	btHashMap<btHashPtr, int> owners;
+	btAlignedObjectArray<btSoftBodyFaceRange> faceRanges;
+	int nactive = 0;
+	if (nb == 0)
+		return;
+	// The collision handlers may have run on several threads, their contacts are merged in a fixed order
+	btSoftBody::parallelFor(0, nb, 1, btSoftBodyMergeContactsTask(&m_softBodySet[0]));
+	parent.resize(nb);
+	for (i = 0; i < nb; ++i)
 	{
-		btSoftBody *psb = static_cast<btSoftBody *>(m_softBodySet[i]);
-		if (psb->isActive())
+		parent[i] = i;
+	}
+	for (i = 0; i < nb; ++i)
+	{
+		const btSoftBody *psb = m_softBodySet[i];
+		if (!psb->isActive())
+			continue;
+		++nactive;
+		for (j = 0, ni = psb->m_anchors.size(); j < ni; ++j)
 		{
-			psb->solveConstraints();
+			const btRigidBody *body = psb->m_anchors[j].m_body;
+			if (!body->isStaticOrKinematicObject())
+				btUniteSoftBodyIslands(owners, parent, body, i);
 		}
+		for (j = 0, ni = psb->m_rcontacts.size(); j < ni; ++j)
+		{
+			const btCollisionObject *colObj = psb->m_rcontacts[j].m_cti.m_colObj;
+			if (colObj->getInternalType() == btCollisionObject::CO_FEATHERSTONE_LINK)
+			{
+				const btMultiBodyLinkCollider *multibodyLinkCol = btMultiBodyLinkCollider::upcast(colObj);
+				if (multibodyLinkCol)
+					btUniteSoftBodyIslands(owners, parent, multibodyLinkCol->m_multiBody, i);
+			}
+			else if (!colObj->isStaticOrKinematicObject())
+			{
+				btUniteSoftBodyIslands(owners, parent, colObj, i);
+			}
+		}
+		if (psb->m_scontacts.size() > 0 && faceRanges.size() == 0)
+		{
+			for (j = 0; j < nb; ++j)
+			{
+				const btSoftBody *other = m_softBodySet[j];
+				if (other->m_faces.size() > 0)
+				{
+					btSoftBodyFaceRange range;
+					range.m_begin = &other->m_faces[0];
+					range.m_end = range.m_begin + other->m_faces.size();
+					range.m_body = j;
+					faceRanges.push_back(range);
+				}
+			}
+			faceRanges.quickSort(btSoftBodyFaceRangeSortPredicate());
+		}
+		for (j = 0, ni = psb->m_scontacts.size(); j < ni; ++j)
+		{
+			const int other = btFindSoftBodyOfFace(faceRanges, psb->m_scontacts[j].m_face);
+			if (other >= 0)
+				btUniteSoftBodyIslands(parent, other, i);
+		}
+	}
+	if (nactive == 0)
+		return;
+
+	// Active bodies grouped by island (ordered by their first body), in index order within an island
+	btAlignedObjectArray<btSoftBody *> bodies;
+	btAlignedObjectArray<int> islands;
+	btAlignedObjectArray<int> counts;
+	counts.resize(nb, 0);
+	for (i = 0; i < nb; ++i)
+	{
+		if (m_softBodySet[i]->isActive())
+			++counts[btFindSoftBodyIsland(parent, i)];
+	}
+	int n = 0;
+	for (i = 0; i < nb; ++i)
+	{
+		if (counts[i] > 0)
+		{
+			islands.push_back(n);
+			n += counts[i];
+			counts[i] = islands[islands.size() - 1];
+		}
+	}
+	islands.push_back(n);
+	bodies.resize(n);
+	for (i = 0; i < nb; ++i)
+	{
+		if (m_softBodySet[i]->isActive())
+			bodies[counts[btFindSoftBodyIsland(parent, i)]++] = m_softBodySet[i];
 	}
+	btSoftBody::parallelFor(0, islands.size() - 1, 1, btSoftBodyIslandTask(&bodies[0], &islands[0]));
 }  // btDefaultSoftBodySolver::solveConstraints
 
 void btDefaultSoftBodySolver::copySoftBodyToVertexBuffer(const btSoftBody *const softBody, btVertexBufferDescriptor *vertexBuffer)
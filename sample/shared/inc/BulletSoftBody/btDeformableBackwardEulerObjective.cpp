@@ -16,17 +16,20 @@
 #include "btDeformableBackwardEulerObjective.h"
 #include "btPreconditioner.h"
 #include "LinearMath/btQuickprof.h"
+#include "LinearMath/btThreads.h"
 
 btDeformableBackwardEulerObjective::btDeformableBackwardEulerObjective(btAlignedObjectArray<btSoftBody*>& softBodies, const TVStack& backup_v)
 	: m_softBodies(softBodies), m_projection(softBodies), m_backupVelocity(backup_v), m_implicit(false)
 {
 	m_massPreconditioner = new MassPreconditioner(m_softBodies);
 	m_KKTPreconditioner = new KKTPreconditioner(m_softBodies, m_projection, m_lf, m_dt, m_implicit);
+	m_blockJacobiPreconditioner = new BlockJacobiPreconditioner(m_softBodies, m_projection, m_lf, m_dt, m_implicit);
 	m_preconditioner = m_KKTPreconditioner;
 }
 
 btDeformableBackwardEulerObjective::~btDeformableBackwardEulerObjective()
 {
+	delete m_blockJacobiPreconditioner;
 	delete m_KKTPreconditioner;
 	delete m_massPreconditioner;
 }
@@ -66,6 +69,27 @@ void btDeformableBackwardEulerObjective::setDt(btScalar dt)
 	m_dt = dt;
 }
 
+// mass term of multiply for the nodes [iBegin,iEnd) of one soft body
+struct btDeformableMassMultiplyTask : public btIParallelForBody
+{
+	const btSoftBody* m_psb;
+	int m_offset;
+	const btAlignedObjectArray<btVector3>* m_x;
+	btAlignedObjectArray<btVector3>* m_b;
+	btDeformableMassMultiplyTask(const btSoftBody* psb, int offset, const btAlignedObjectArray<btVector3>* x, btAlignedObjectArray<btVector3>* b)
+		: m_psb(psb), m_offset(offset), m_x(x), m_b(b)
+	{
+	}
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int j = iBegin; j < iEnd; ++j)
+		{
+			const btSoftBody::Node& node = m_psb->m_nodes[j];
+			(*m_b)[m_offset + j] = (node.m_im == 0) ? btVector3(0, 0, 0) : (*m_x)[m_offset + j] / node.m_im;
+		}
+	}
+};
+
 void btDeformableBackwardEulerObjective::multiply(const TVStack& x, TVStack& b) const
 {
 	BT_PROFILE("multiply");
@@ -74,12 +98,8 @@ void btDeformableBackwardEulerObjective::multiply(const TVStack& x, TVStack& b)
 	for (int i = 0; i < m_softBodies.size(); ++i)
 	{
 		btSoftBody* psb = m_softBodies[i];
-		for (int j = 0; j < psb->m_nodes.size(); ++j)
-		{
-			const btSoftBody::Node& node = psb->m_nodes[j];
-			b[counter] = (node.m_im == 0) ? btVector3(0, 0, 0) : x[counter] / node.m_im;
-			++counter;
-		}
+		btSoftBody::parallelFor(0, psb->m_nodes.size(), 1024, btDeformableMassMultiplyTask(psb, counter, &x, &b));
+		counter += psb->m_nodes.size();
 	}
 
 	for (int i = 0; i < m_lf.size(); ++i)
@@ -34,7 +34,8 @@ public:
 	enum _
 	{
 		Mass_preconditioner,
-		KKT_preconditioner
+		KKT_preconditioner,
+		BlockJacobi_preconditioner
 	};
 
 	typedef btAlignedObjectArray<btVector3> TVStack;
@@ -48,6 +49,7 @@ public:
 	bool m_implicit;
 	MassPreconditioner* m_massPreconditioner;
 	KKTPreconditioner* m_KKTPreconditioner;
+	BlockJacobiPreconditioner* m_blockJacobiPreconditioner;
 
 	btDeformableBackwardEulerObjective(btAlignedObjectArray<btSoftBody*>& softBodies, const TVStack& backup_v);
 
@@ -103,6 +105,15 @@ public:
 		m_preconditioner->operator()(x, b);
 	}
 
+	// rebuild the block-Jacobi preconditioner for the current state if it is used
+	void updateBlockJacobiPreconditioner()
+	{
+		if (m_preconditioner == m_blockJacobiPreconditioner)
+		{
+			m_blockJacobiPreconditioner->reinitialize(true);
+		}
+	}
+
 	// reindex all the vertices
 	virtual void updateId()
 	{
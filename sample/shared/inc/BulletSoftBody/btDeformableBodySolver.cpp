@@ -40,6 +40,7 @@ void btDeformableBodySolver::solveDeformableConstraints(btScalar solverdt)
 		m_objective->applyDynamicFriction(m_residual);
 		if (m_useProjection)
 		{
+			m_objective->updateBlockJacobiPreconditioner();
 			computeStep(m_dv, m_residual);
 		}
 		else
@@ -83,6 +84,7 @@ void btDeformableBodySolver::solveDeformableConstraints(btScalar solverdt)
 			}
 			// todo xuchenhan@: this really only needs to be calculated once
 			m_objective->applyDynamicFriction(m_residual);
+			m_objective->updateBlockJacobiPreconditioner();
 			if (m_lineSearch)
 			{
 				btScalar inner_product = computeDescentStep(m_ddv, m_residual);
@@ -180,6 +180,10 @@ public:
 			case btDeformableBackwardEulerObjective::KKT_preconditioner:
 				m_objective->m_preconditioner = m_objective->m_KKTPreconditioner;
 				break;
+
+			case btDeformableBackwardEulerObjective::BlockJacobi_preconditioner:
+				m_objective->m_preconditioner = m_objective->m_blockJacobiPreconditioner;
+				break;
 			
 			default:
 				btAssert(false);
@@ -18,6 +18,7 @@
 
 #include "btSoftBody.h"
 #include <LinearMath/btHashMap.h>
+#include <LinearMath/btThreads.h>
 #include <iostream>
 
 enum btDeformableLagrangianForceType
@@ -42,6 +43,15 @@ public:
 	btAlignedObjectArray<btSoftBody*> m_softBodies;
 	const btAlignedObjectArray<btSoftBody::Node*>* m_nodes;
 
+	// Tetra forces evaluated in parallel: every tetra writes its 4 node terms to m_tetraNodeForces (or
+	// m_tetraNodeBlocks), then the terms are subtracted node by node in tetra order, which gives the same
+	// result as the serial loop over tetras.
+	btAlignedObjectArray<int> m_tetraOffsets;           // first tetra of each soft body, followed by the tetra count
+	btAlignedObjectArray<int> m_nodeTetraBegin;         // first term of each node index, followed by the term count
+	btAlignedObjectArray<int> m_nodeTetraTerms;         // 4*tetra+k of the terms of each node, in tetra order
+	TVStack m_tetraNodeForces;                          // 4 node terms per tetra
+	btAlignedObjectArray<btMatrix3x3> m_tetraNodeBlocks;  // 4 node 3x3 blocks per tetra
+
 	btDeformableLagrangianForce()
 	{
 	}
@@ -60,6 +70,22 @@ public:
 	// add elastic df
 	virtual void addScaledElasticForceDifferential(btScalar scale, const TVStack& dx, TVStack& df) = 0;
 
+	// add the 3x3 diagonal blocks of the damping df/dv, by default only their diagonal
+	virtual void buildDampingForceDifferentialDiagonalBlocks(btScalar scale, btAlignedObjectArray<btMatrix3x3>& blocks)
+	{
+		TVStack diag;
+		diag.resize(blocks.size(), btVector3(0, 0, 0));
+		buildDampingForceDifferentialDiagonal(scale, diag);
+		for (int i = 0; i < blocks.size(); ++i)
+		{
+			for (int d = 0; d < 3; ++d)
+				blocks[i][d][d] += diag[i][d];
+		}
+	}
+
+	// add the 3x3 diagonal blocks of the elastic df/dx (forces without them leave the blocks unchanged)
+	virtual void buildElasticForceDifferentialDiagonalBlocks(btScalar scale, btAlignedObjectArray<btMatrix3x3>& blocks) {}
+
 	// add all forces that are explicit in explicit solve
 	virtual void addScaledExplicitForce(btScalar scale, TVStack& force) = 0;
 
@@ -368,5 +394,109 @@ public:
 	{
 		return totalElasticEnergy(dt) + totalDampingEnergy(dt);
 	}
+
+	// number the tetras of all soft bodies and list the tetra terms of every node index
+	void updateTetraTerms()
+	{
+		int numTetras = 0;
+		int numIndices = 0;
+		m_tetraOffsets.resize(0);
+		for (int i = 0; i < m_softBodies.size(); ++i)
+		{
+			btSoftBody* psb = m_softBodies[i];
+			m_tetraOffsets.push_back(numTetras);
+			numTetras += psb->m_tetras.size();
+			for (int j = 0; j < psb->m_tetras.size(); ++j)
+			{
+				for (int k = 0; k < 4; ++k)
+					numIndices = btMax(numIndices, psb->m_tetras[j].m_n[k]->index + 1);
+			}
+		}
+		m_tetraOffsets.push_back(numTetras);
+		m_nodeTetraBegin.resize(0);
+		m_nodeTetraBegin.resize(numIndices + 1, 0);
+		m_nodeTetraTerms.resize(numTetras * 4);
+		for (int i = 0; i < m_softBodies.size(); ++i)
+		{
+			btSoftBody* psb = m_softBodies[i];
+			for (int j = 0; j < psb->m_tetras.size(); ++j)
+			{
+				for (int k = 0; k < 4; ++k)
+					++m_nodeTetraBegin[psb->m_tetras[j].m_n[k]->index + 1];
+			}
+		}
+		for (int n = 0; n < numIndices; ++n)
+		{
+			m_nodeTetraBegin[n + 1] += m_nodeTetraBegin[n];
+		}
+		btAlignedObjectArray<int> next;
+		next.copyFromArray(m_nodeTetraBegin);
+		for (int i = 0; i < m_softBodies.size(); ++i)
+		{
+			btSoftBody* psb = m_softBodies[i];
+			for (int j = 0; j < psb->m_tetras.size(); ++j)
+			{
+				for (int k = 0; k < 4; ++k)
+					m_nodeTetraTerms[next[psb->m_tetras[j].m_n[k]->index]++] = (m_tetraOffsets[i] + j) * 4 + k;
+			}
+		}
+		m_tetraNodeForces.resize(numTetras * 4);
+	}
+
+	// true if tetras were added or removed since updateTetraTerms
+	bool tetraTermsChanged() const
+	{
+		if (m_tetraOffsets.size() != m_softBodies.size() + 1)
+			return true;
+		for (int i = 0; i < m_softBodies.size(); ++i)
+		{
+			if (m_tetraOffsets[i + 1] - m_tetraOffsets[i] != m_softBodies[i]->m_tetras.size())
+				return true;
+		}
+		return false;
+	}
+
+	struct TetraGatherTask : public btIParallelForBody
+	{
+		const btDeformableLagrangianForce* m_force;
+		TVStack* m_df;
+		btAlignedObjectArray<btMatrix3x3>* m_blocks;
+		TetraGatherTask(const btDeformableLagrangianForce* force, TVStack* df, btAlignedObjectArray<btMatrix3x3>* blocks)
+			: m_force(force), m_df(df), m_blocks(blocks)
+		{
+		}
+		void forLoop(int iBegin, int iEnd) const
+		{
+			const int* begin = &m_force->m_nodeTetraBegin[0];
+			const int* terms = m_force->m_nodeTetraTerms.size() ? &m_force->m_nodeTetraTerms[0] : 0;
+			for (int n = iBegin; n < iEnd; ++n)
+			{
+				if (m_df)
+				{
+					btVector3& df = (*m_df)[n];
+					for (int t = begin[n]; t < begin[n + 1]; ++t)
+						df -= m_force->m_tetraNodeForces[terms[t]];
+				}
+				else
+				{
+					btMatrix3x3& block = (*m_blocks)[n];
+					for (int t = begin[n]; t < begin[n + 1]; ++t)
+						block -= m_force->m_tetraNodeBlocks[terms[t]];
+				}
+			}
+		}
+	};
+
+	// df[n] -= node terms of m_tetraNodeForces
+	void gatherTetraForces(TVStack& df) const
+	{
+		btSoftBody::parallelFor(0, m_nodeTetraBegin.size() - 1, 1024, TetraGatherTask(this, &df, 0));
+	}
+
+	// blocks[n] -= node terms of m_tetraNodeBlocks
+	void gatherTetraBlocks(btAlignedObjectArray<btMatrix3x3>& blocks) const
+	{
+		btSoftBody::parallelFor(0, m_nodeTetraBegin.size() - 1, 1024, TetraGatherTask(this, 0, &blocks));
+	}
 };
 #endif /* BT_DEFORMABLE_LAGRANGIAN_FORCE */
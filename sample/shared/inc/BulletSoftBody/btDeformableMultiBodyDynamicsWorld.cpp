@@ -63,6 +63,7 @@ btDeformableMultiBodyDynamicsWorld::btDeformableMultiBodyDynamicsWorld(btDispatc
 	m_implicit = false;
 	m_lineSearch = false;
 	m_useProjection = false;
+	m_useBlockJacobi = false;
 	m_ccdIterations = 5;
 	m_solverDeformableBodyIslandCallback = new DeformableBodyInplaceSolverIslandCallback(constraintSolver, dispatcher);
 }
@@ -81,6 +82,9 @@ void btDeformableMultiBodyDynamicsWorld::internalSingleStepSimulation(btScalar t
 	}
 	reinitialize(timeStep);
 
+	// Free the SDF cells evicted by the memory budget in the last step (GarbageCollect is left to the caller)
+	m_sbi.m_sparsesdf.ReleaseEvicted();
+
 	// add gravity to velocity of rigid and multi bodys
 	applyRigidBodyGravity(timeStep);
 
@@ -472,6 +476,10 @@ void btDeformableMultiBodyDynamicsWorld::reinitialize(btScalar timeStep)
 		m_deformableBodySolver->setStrainLimiting(false);
 		m_deformableBodySolver->setPreconditioner(btDeformableBackwardEulerObjective::KKT_preconditioner);
 	}
+	if (m_useBlockJacobi)
+	{
+		m_deformableBodySolver->setPreconditioner(btDeformableBackwardEulerObjective::BlockJacobi_preconditioner);
+	}
 }
 
 void btDeformableMultiBodyDynamicsWorld::debugDrawWorld()
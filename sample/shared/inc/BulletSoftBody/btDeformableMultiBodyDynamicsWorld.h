@@ -50,6 +50,7 @@ class btDeformableMultiBodyDynamicsWorld : public btMultiBodyDynamicsWorld
 	bool m_implicit;
 	bool m_lineSearch;
 	bool m_useProjection;
+	bool m_useBlockJacobi;
 	DeformableBodyInplaceSolverIslandCallback* m_solverDeformableBodyIslandCallback;
 
 	typedef void (*btSolverCallback)(btScalar time, btDeformableMultiBodyDynamicsWorld* world);
@@ -171,6 +172,13 @@ public:
 		m_useProjection = useProjection;
 	}
 
+	// precondition the linear solves with the inverse 3x3 node blocks of the system matrix
+	// (see BlockJacobiPreconditioner) instead of the mass or KKT diagonal
+	void setUseBlockJacobiPreconditioner(bool useBlockJacobi)
+	{
+		m_useBlockJacobi = useBlockJacobi;
+	}
+
 	void applyRepulsionForce(btScalar timeStep);
 
 	void performGeometricCollisions(btScalar timeStep);
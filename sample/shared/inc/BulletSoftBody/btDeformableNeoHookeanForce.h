@@ -268,93 +268,182 @@ public:
 		}
 	}
 
-	// The damping matrix is calculated using the time n state as described in https://www.math.ucla.edu/~jteran/papers/GSSJT15.pdf to allow line search
-	virtual void addScaledDampingForceDifferential(btScalar scale, const TVStack& dv, TVStack& df)
+	virtual void reinitialize(bool nodeUpdated)
 	{
-		if (m_mu_damp == 0 && m_lambda_damp == 0)
-			return;
-		int numNodes = getNumNodes();
-		btAssert(numNodes <= df.size());
-		btVector3 grad_N_hat_1st_col = btVector3(-1, -1, -1);
+		if (nodeUpdated)
+		{
+			updateTetraTerms();
+		}
+	}
+
+	enum
+	{
+		ElasticDifferential,  // node terms of the elastic force differential
+		DampingDifferential,  // node terms of the damping force differential
+		ElasticBlocks,        // node diagonal blocks of the elastic force differential
+		DampingBlocks         // node diagonal blocks of the damping force differential
+	};
+
+	struct TetraTermTask : public btIParallelForBody
+	{
+		btDeformableNeoHookeanForce* m_force;
+		int m_op;
+		int m_body;
+		btScalar m_scale;
+		const TVStack* m_dx;
+		TetraTermTask(btDeformableNeoHookeanForce* force, int op, int body, btScalar scale, const TVStack* dx)
+			: m_force(force), m_op(op), m_body(body), m_scale(scale), m_dx(dx)
+		{
+		}
+		void forLoop(int iBegin, int iEnd) const
+		{
+			if (m_op == ElasticDifferential || m_op == DampingDifferential)
+				m_force->computeTetraDifferentials(m_op, m_body, iBegin, iEnd, m_scale, *m_dx);
+			else
+				m_force->computeTetraBlocks(m_op, m_body, iBegin, iEnd, m_scale);
+		}
+	};
+
+	// compute the node terms of the tetras of all active soft bodies in parallel
+	void computeTetraTerms(int op, btScalar scale, const TVStack* dx)
+	{
+		if (tetraTermsChanged())
+		{
+			updateTetraTerms();
+		}
+		const bool blocks = (op == ElasticBlocks || op == DampingBlocks);
+		if (blocks)
+		{
+			m_tetraNodeBlocks.resize(m_tetraNodeForces.size());
+		}
 		for (int i = 0; i < m_softBodies.size(); ++i)
 		{
 			btSoftBody* psb = m_softBodies[i];
 			if (!psb->isActive())
 			{
+				// inactive bodies add nothing
+				for (int t = m_tetraOffsets[i] * 4; t < m_tetraOffsets[i + 1] * 4; ++t)
+				{
+					if (blocks)
+						m_tetraNodeBlocks[t].setValue(0, 0, 0, 0, 0, 0, 0, 0, 0);
+					else
+						m_tetraNodeForces[t].setZero();
+				}
 				continue;
 			}
-			for (int j = 0; j < psb->m_tetras.size(); ++j)
-			{
-				btSoftBody::Tetra& tetra = psb->m_tetras[j];
-				btSoftBody::Node* node0 = tetra.m_n[0];
-				btSoftBody::Node* node1 = tetra.m_n[1];
-				btSoftBody::Node* node2 = tetra.m_n[2];
-				btSoftBody::Node* node3 = tetra.m_n[3];
-				size_t id0 = node0->index;
-				size_t id1 = node1->index;
-				size_t id2 = node2->index;
-				size_t id3 = node3->index;
-				btMatrix3x3 dF = Ds(id0, id1, id2, id3, dv) * tetra.m_Dm_inverse;
-				btMatrix3x3 I;
-				I.setIdentity();
-				btMatrix3x3 dP = (dF + dF.transpose()) * m_mu_damp + I * (dF[0][0] + dF[1][1] + dF[2][2]) * m_lambda_damp;
-				//                firstPiolaDampingDifferential(psb->m_tetraScratchesTn[j], dF, dP);
-				//                btVector3 df_on_node0 = dP * (tetra.m_Dm_inverse.transpose()*grad_N_hat_1st_col);
-				btMatrix3x3 df_on_node123 = dP * tetra.m_Dm_inverse.transpose();
-				btVector3 df_on_node0 = df_on_node123 * grad_N_hat_1st_col;
-
-				// damping force differential
-				btScalar scale1 = scale * tetra.m_element_measure;
-				df[id0] -= scale1 * df_on_node0;
-				df[id1] -= scale1 * df_on_node123.getColumn(0);
-				df[id2] -= scale1 * df_on_node123.getColumn(1);
-				df[id3] -= scale1 * df_on_node123.getColumn(2);
-			}
+			btSoftBody::parallelFor(0, psb->m_tetras.size(), 256, TetraTermTask(this, op, i, scale, dx));
 		}
 	}
 
-	virtual void buildDampingForceDifferentialDiagonal(btScalar scale, TVStack& diagA) {}
-
-	virtual void addScaledElasticForceDifferential(btScalar scale, const TVStack& dx, TVStack& df)
+	void computeTetraDifferentials(int op, int body, int jBegin, int jEnd, btScalar scale, const TVStack& dx)
 	{
-		int numNodes = getNumNodes();
-		btAssert(numNodes <= df.size());
+		btSoftBody* psb = m_softBodies[body];
 		btVector3 grad_N_hat_1st_col = btVector3(-1, -1, -1);
-		for (int i = 0; i < m_softBodies.size(); ++i)
+		for (int j = jBegin; j < jEnd; ++j)
 		{
-			btSoftBody* psb = m_softBodies[i];
-			if (!psb->isActive())
+			btSoftBody::Tetra& tetra = psb->m_tetras[j];
+			size_t id0 = tetra.m_n[0]->index;
+			size_t id1 = tetra.m_n[1]->index;
+			size_t id2 = tetra.m_n[2]->index;
+			size_t id3 = tetra.m_n[3]->index;
+			btMatrix3x3 dF = Ds(id0, id1, id2, id3, dx) * tetra.m_Dm_inverse;
+			btMatrix3x3 dP;
+			if (op == DampingDifferential)
 			{
-				continue;
+				btMatrix3x3 I;
+				I.setIdentity();
+				dP = (dF + dF.transpose()) * m_mu_damp + I * (dF[0][0] + dF[1][1] + dF[2][2]) * m_lambda_damp;
 			}
-			for (int j = 0; j < psb->m_tetras.size(); ++j)
+			else
 			{
-				btSoftBody::Tetra& tetra = psb->m_tetras[j];
-				btSoftBody::Node* node0 = tetra.m_n[0];
-				btSoftBody::Node* node1 = tetra.m_n[1];
-				btSoftBody::Node* node2 = tetra.m_n[2];
-				btSoftBody::Node* node3 = tetra.m_n[3];
-				size_t id0 = node0->index;
-				size_t id1 = node1->index;
-				size_t id2 = node2->index;
-				size_t id3 = node3->index;
-				btMatrix3x3 dF = Ds(id0, id1, id2, id3, dx) * tetra.m_Dm_inverse;
-				btMatrix3x3 dP;
 				firstPiolaDifferential(psb->m_tetraScratches[j], dF, dP);
-				//                btVector3 df_on_node0 = dP * (tetra.m_Dm_inverse.transpose()*grad_N_hat_1st_col);
-				btMatrix3x3 df_on_node123 = dP * tetra.m_Dm_inverse.transpose();
-				btVector3 df_on_node0 = df_on_node123 * grad_N_hat_1st_col;
+			}
+			btMatrix3x3 df_on_node123 = dP * tetra.m_Dm_inverse.transpose();
+			btVector3 df_on_node0 = df_on_node123 * grad_N_hat_1st_col;
 
-				// elastic force differential
-				btScalar scale1 = scale * tetra.m_element_measure;
-				df[id0] -= scale1 * df_on_node0;
-				df[id1] -= scale1 * df_on_node123.getColumn(0);
-				df[id2] -= scale1 * df_on_node123.getColumn(1);
-				df[id3] -= scale1 * df_on_node123.getColumn(2);
+			// force differential
+			btScalar scale1 = scale * tetra.m_element_measure;
+			btVector3* terms = &m_tetraNodeForces[(m_tetraOffsets[body] + j) * 4];
+			terms[0] = scale1 * df_on_node0;
+			terms[1] = scale1 * df_on_node123.getColumn(0);
+			terms[2] = scale1 * df_on_node123.getColumn(1);
+			terms[3] = scale1 * df_on_node123.getColumn(2);
+		}
+	}
+
+	// The block of node a is the differential for dx = e_k at node a (k = 0,1,2), i.e. dF = e_k * g_a^T
+	// where g_a is the gradient of the shape function of node a.
+	void computeTetraBlocks(int op, int body, int jBegin, int jEnd, btScalar scale)
+	{
+		btSoftBody* psb = m_softBodies[body];
+		btMatrix3x3 I;
+		I.setIdentity();
+		for (int j = jBegin; j < jEnd; ++j)
+		{
+			btSoftBody::Tetra& tetra = psb->m_tetras[j];
+			const btMatrix3x3& Dm_inverse = tetra.m_Dm_inverse;
+			btVector3 g[4];
+			g[1] = Dm_inverse[0];
+			g[2] = Dm_inverse[1];
+			g[3] = Dm_inverse[2];
+			g[0] = -(g[1] + g[2] + g[3]);
+			btScalar scale1 = scale * tetra.m_element_measure;
+			btMatrix3x3* terms = &m_tetraNodeBlocks[(m_tetraOffsets[body] + j) * 4];
+			for (int a = 0; a < 4; ++a)
+			{
+				btMatrix3x3 block;
+				for (int k = 0; k < 3; ++k)
+				{
+					btMatrix3x3 dF;
+					dF.setValue(0, 0, 0, 0, 0, 0, 0, 0, 0);
+					dF[k] = g[a];
+					btMatrix3x3 dP;
+					if (op == DampingBlocks)
+						dP = (dF + dF.transpose()) * m_mu_damp + I * (dF[0][0] + dF[1][1] + dF[2][2]) * m_lambda_damp;
+					else
+						firstPiolaDifferential(psb->m_tetraScratches[j], dF, dP);
+					const btVector3 column = dP * g[a];
+					for (int r = 0; r < 3; ++r)
+						block[r][k] = scale1 * column[r];
+				}
+				terms[a] = block;
 			}
 		}
 	}
 
+	// The damping matrix is calculated using the time n state as described in https://www.math.ucla.edu/~jteran/papers/GSSJT15.pdf to allow line search
+	virtual void addScaledDampingForceDifferential(btScalar scale, const TVStack& dv, TVStack& df)
+	{
+		if (m_mu_damp == 0 && m_lambda_damp == 0)
+			return;
+		btAssert(getNumNodes() <= df.size());
+		computeTetraTerms(DampingDifferential, scale, &dv);
+		gatherTetraForces(df);
+	}
+
+	virtual void buildDampingForceDifferentialDiagonal(btScalar scale, TVStack& diagA) {}
+
+	virtual void buildDampingForceDifferentialDiagonalBlocks(btScalar scale, btAlignedObjectArray<btMatrix3x3>& blocks)
+	{
+		if (m_mu_damp == 0 && m_lambda_damp == 0)
+			return;
+		computeTetraTerms(DampingBlocks, scale, 0);
+		gatherTetraBlocks(blocks);
+	}
+
+	virtual void addScaledElasticForceDifferential(btScalar scale, const TVStack& dx, TVStack& df)
+	{
+		btAssert(getNumNodes() <= df.size());
+		computeTetraTerms(ElasticDifferential, scale, &dx);
+		gatherTetraForces(df);
+	}
+
+	virtual void buildElasticForceDifferentialDiagonalBlocks(btScalar scale, btAlignedObjectArray<btMatrix3x3>& blocks)
+	{
+		computeTetraTerms(ElasticBlocks, scale, 0);
+		gatherTetraBlocks(blocks);
+	}
+
 	void firstPiola(const btSoftBody::TetraScratch& s, btMatrix3x3& P)
 	{
 		btScalar c1 = (m_mu * (1. - 1. / (s.m_trace + 1.)));
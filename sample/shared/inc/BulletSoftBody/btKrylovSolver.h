@@ -22,11 +22,113 @@
 #include <LinearMath/btVector3.h>
 #include <LinearMath/btScalar.h>
 #include "LinearMath/btQuickprof.h"
+#include "LinearMath/btThreads.h"
+#include "btSoftBody.h"
+
+// The vector kernels below work on chunks of BT_KRYLOV_CHUNK_SIZE entries that are distributed over the
+// threads of the task scheduler (see btSoftBody::parallelFor). Reductions add the chunk results in chunk
+// order, so they do not depend on the number of threads.
+#define BT_KRYLOV_CHUNK_SIZE 1024
+#define BT_KRYLOV_CHUNK_GRAIN 4
+
+struct btKrylovKernel : public btIParallelForBody
+{
+	typedef btAlignedObjectArray<btVector3> TVStack;
+	enum
+	{
+		Dot,       // m_chunks[c] = sum(a.b)
+		MaxAbs,    // m_chunks[c] = max(|a|)
+		Sub,       // result = a - b
+		AddTo,     // result += s*a
+		MultAdd,   // result = s*a + b
+		ScaleAdd   // result = s*result + a
+	};
+	int m_op;
+	int m_size;
+	btScalar m_s;
+	const btVector3* m_a;
+	const btVector3* m_b;
+	btVector3* m_result;
+	btScalar* m_chunks;
+	btKrylovKernel(int op, int size, btScalar s, const btVector3* a, const btVector3* b, btVector3* result, btScalar* chunks)
+		: m_op(op), m_size(size), m_s(s), m_a(a), m_b(b), m_result(result), m_chunks(chunks)
+	{
+	}
+
+	static int numChunks(int size)
+	{
+		return (size + BT_KRYLOV_CHUNK_SIZE - 1) / BT_KRYLOV_CHUNK_SIZE;
+	}
+
+	void run() const
+	{
+		btSoftBody::parallelFor(0, numChunks(m_size), BT_KRYLOV_CHUNK_GRAIN, *this);
+	}
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int c = iBegin; c < iEnd; ++c)
+		{
+			const int begin = c * BT_KRYLOV_CHUNK_SIZE;
+			const int end = btMin(begin + BT_KRYLOV_CHUNK_SIZE, m_size);
+			int i;
+			switch (m_op)
+			{
+				case Dot:
+				{
+					// component-wise products, summed across components once per chunk
+					btVector3 sum(0, 0, 0);
+					for (i = begin; i < end; ++i)
+						sum += m_a[i] * m_b[i];
+					m_chunks[c] = sum[0] + sum[1] + sum[2];
+				}
+				break;
+				case MaxAbs:
+				{
+					btVector3 mx(0, 0, 0);
+					for (i = begin; i < end; ++i)
+						mx.setMax(m_a[i].absolute());
+					m_chunks[c] = btMax(mx[0], btMax(mx[1], mx[2]));
+				}
+				break;
+				case Sub:
+					for (i = begin; i < end; ++i)
+						m_result[i] = m_a[i] - m_b[i];
+					break;
+				case AddTo:
+					for (i = begin; i < end; ++i)
+						m_result[i] += m_s * m_a[i];
+					break;
+				case MultAdd:
+					for (i = begin; i < end; ++i)
+						m_result[i] = m_s * m_a[i] + m_b[i];
+					break;
+				case ScaleAdd:
+					for (i = begin; i < end; ++i)
+						m_result[i] = m_s * m_result[i] + m_a[i];
+					break;
+			}
+		}
+	}
+};
 
 template <class MatrixX>
 class btKrylovSolver
 {
 	typedef btAlignedObjectArray<btVector3> TVStack;
+	btAlignedObjectArray<btScalar> m_chunks;  // per chunk results of dot and norm
+
+	btScalar reduce(int op, const TVStack& a, const TVStack& b)
+	{
+		if (a.size() == 0)
+			return 0;
+		m_chunks.resize(btKrylovKernel::numChunks(a.size()));
+		btKrylovKernel(op, a.size(), 0, &a[0], &b[0], 0, &m_chunks[0]).run();
+		btScalar ans = m_chunks[0];
+		for (int c = 1; c < m_chunks.size(); ++c)
+			ans = (op == btKrylovKernel::Dot) ? ans + m_chunks[c] : btMax(ans, m_chunks[c]);
+		return ans;
+	}
 
 public:
 	int m_maxIterations;
@@ -48,10 +150,8 @@ public:
 		btAssert(a.size() == b.size());
 		TVStack c;
 		c.resize(a.size());
-		for (int i = 0; i < a.size(); ++i)
-		{
-			c[i] = a[i] - b[i];
-		}
+		if (a.size() > 0)
+			btKrylovKernel(btKrylovKernel::Sub, a.size(), 0, &a[0], &b[0], &c[0], 0).run();
 		return c;
 	}
 
@@ -62,31 +162,21 @@ public:
 
 	virtual SIMD_FORCE_INLINE btScalar norm(const TVStack& a)
 	{
-		btScalar ret = 0;
-		for (int i = 0; i < a.size(); ++i)
-		{
-			for (int d = 0; d < 3; ++d)
-			{
-				ret = btMax(ret, btFabs(a[i][d]));
-			}
-		}
-		return ret;
+		return reduce(btKrylovKernel::MaxAbs, a, a);
 	}
 
 	virtual SIMD_FORCE_INLINE btScalar dot(const TVStack& a, const TVStack& b)
 	{
-		btScalar ans(0);
-		for (int i = 0; i < a.size(); ++i)
-			ans += a[i].dot(b[i]);
-		return ans;
+		btAssert(a.size() == b.size());
+		return reduce(btKrylovKernel::Dot, a, b);
 	}
 
 	virtual SIMD_FORCE_INLINE void multAndAddTo(btScalar s, const TVStack& a, TVStack& result)
 	{
 		//        result += s*a
 		btAssert(a.size() == result.size());
-		for (int i = 0; i < a.size(); ++i)
-			result[i] += s * a[i];
+		if (a.size() > 0)
+			btKrylovKernel(btKrylovKernel::AddTo, a.size(), s, &a[0], 0, &result[0], 0).run();
 	}
 
 	virtual SIMD_FORCE_INLINE TVStack multAndAdd(btScalar s, const TVStack& a, const TVStack& b)
@@ -94,11 +184,19 @@ public:
 		// result = a*s + b
 		TVStack result;
 		result.resize(a.size());
-		for (int i = 0; i < a.size(); ++i)
-			result[i] = s * a[i] + b[i];
+		if (a.size() > 0)
+			btKrylovKernel(btKrylovKernel::MultAdd, a.size(), s, &a[0], &b[0], &result[0], 0).run();
 		return result;
 	}
 
+	virtual SIMD_FORCE_INLINE void scaleAndAddTo(btScalar s, const TVStack& a, TVStack& result)
+	{
+		// result = result*s + a, same as result = multAndAdd(s, result, a) without the temporary
+		btAssert(a.size() == result.size());
+		if (a.size() > 0)
+			btKrylovKernel(btKrylovKernel::ScaleAdd, a.size(), s, &a[0], 0, &result[0], 0).run();
+	}
+
 	virtual SIMD_FORCE_INLINE void setTolerance(btScalar tolerance)
 	{
 		m_tolerance = tolerance;
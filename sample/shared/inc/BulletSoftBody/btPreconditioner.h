@@ -282,4 +282,132 @@ public:
 #endif
 };
 
+// Inverse of the 3x3 diagonal block of A = M - dt*D (- dt^2*K in the implicit scheme) of every node,
+// built from the blocks reported by the forces (buildDampingForceDifferentialDiagonalBlocks and
+// buildElasticForceDifferentialDiagonalBlocks). The Lagrange multiplier rows are scaled by the inverse
+// diagonal of C * A_b^-1 * C^T as in KKTPreconditioner. Rebuilt for every linear solve.
+class BlockJacobiPreconditioner : public Preconditioner
+{
+	const btAlignedObjectArray<btSoftBody*>& m_softBodies;
+	const btDeformableContactProjection& m_projections;
+	const btAlignedObjectArray<btDeformableLagrangianForce*>& m_lf;
+	btAlignedObjectArray<btMatrix3x3> m_inv_A;
+	TVStack m_inv_S;
+	const btScalar& m_dt;
+	const bool& m_implicit;
+
+	struct NodeTask : public btIParallelForBody
+	{
+		BlockJacobiPreconditioner* m_p;
+		const TVStack* m_x;
+		TVStack* m_b;
+		NodeTask(BlockJacobiPreconditioner* p, const TVStack* x, TVStack* b) : m_p(p), m_x(x), m_b(b) {}
+		void forLoop(int iBegin, int iEnd) const
+		{
+			btAlignedObjectArray<btMatrix3x3>& inv_A = m_p->m_inv_A;
+			if (m_b)
+			{
+				// b = A_b^-1 * x
+				for (int i = iBegin; i < iEnd; ++i)
+					(*m_b)[i] = inv_A[i] * (*m_x)[i];
+				return;
+			}
+			// invert the blocks, falling back to the diagonal for singular blocks
+			for (int i = iBegin; i < iEnd; ++i)
+			{
+				btMatrix3x3& A = inv_A[i];
+				const btScalar det = A.determinant();
+				if (btFabs(det) > SIMD_EPSILON * btFabs(A[0][0] * A[1][1] * A[2][2]) && det != 0)
+				{
+					A = A.inverse();
+				}
+				else
+				{
+					A.setValue((A[0][0] == 0) ? 0 : 1 / A[0][0], 0, 0,
+							   0, (A[1][1] == 0) ? 0 : 1 / A[1][1], 0,
+							   0, 0, (A[2][2] == 0) ? 0 : 1 / A[2][2]);
+				}
+			}
+		}
+	};
+
+public:
+	BlockJacobiPreconditioner(const btAlignedObjectArray<btSoftBody*>& softBodies, const btDeformableContactProjection& projections, const btAlignedObjectArray<btDeformableLagrangianForce*>& lf, const btScalar& dt, const bool& implicit)
+		: m_softBodies(softBodies), m_projections(projections), m_lf(lf), m_dt(dt), m_implicit(implicit)
+	{
+	}
+
+	virtual void reinitialize(bool nodeUpdated)
+	{
+		BT_PROFILE("BlockJacobiPreconditioner::reinitialize");
+		int num_nodes = 0;
+		for (int i = 0; i < m_softBodies.size(); ++i)
+		{
+			num_nodes += m_softBodies[i]->m_nodes.size();
+		}
+		m_inv_A.resize(num_nodes);
+		btAlignedObjectArray<bool> fixed;
+		fixed.resize(num_nodes);
+		int counter = 0;
+		for (int i = 0; i < m_softBodies.size(); ++i)
+		{
+			btSoftBody* psb = m_softBodies[i];
+			for (int j = 0; j < psb->m_nodes.size(); ++j)
+			{
+				const btSoftBody::Node& node = psb->m_nodes[j];
+				const btScalar mass = (node.m_im == 0) ? 0 : 1 / node.m_im;
+				m_inv_A[counter].setValue(mass, 0, 0, 0, mass, 0, 0, 0, mass);
+				fixed[counter] = (node.m_im == 0);
+				++counter;
+			}
+		}
+		for (int i = 0; i < m_lf.size(); ++i)
+		{
+			// same terms as btDeformableBackwardEulerObjective::multiply
+			m_lf[i]->buildDampingForceDifferentialDiagonalBlocks(-m_dt, m_inv_A);
+			if (m_implicit || m_lf[i]->getForceType() == BT_MOUSE_PICKING_FORCE)
+			{
+				m_lf[i]->buildElasticForceDifferentialDiagonalBlocks(-m_dt * m_dt, m_inv_A);
+			}
+		}
+		for (int i = 0; i < num_nodes; ++i)
+		{
+			if (fixed[i])
+				m_inv_A[i].setValue(0, 0, 0, 0, 0, 0, 0, 0, 0);
+		}
+		btSoftBody::parallelFor(0, num_nodes, 1024, NodeTask(this, 0, 0));
+
+		m_inv_S.resize(m_projections.m_lagrangeMultipliers.size());
+		for (int c = 0; c < m_projections.m_lagrangeMultipliers.size(); ++c)
+		{
+			// S[k,k] = e_k^T * C A_b^-1 C^T * e_k
+			const LagrangeMultiplier& lm = m_projections.m_lagrangeMultipliers[c];
+			btVector3& t = m_inv_S[c];
+			t.setZero();
+			for (int j = 0; j < lm.m_num_constraints; ++j)
+			{
+				for (int i = 0; i < lm.m_num_nodes; ++i)
+				{
+					t[j] += lm.m_dirs[j].dot(m_inv_A[lm.m_indices[i]] * lm.m_dirs[j]) * lm.m_weights[i] * lm.m_weights[i];
+				}
+			}
+			for (int d = 0; d < 3; ++d)
+			{
+				t[d] = (t[d] == 0) ? 0.0 : 1.0 / t[d];
+			}
+		}
+	}
+
+	virtual void operator()(const TVStack& x, TVStack& b)
+	{
+		btAssert(b.size() == x.size());
+		btSoftBody::parallelFor(0, m_inv_A.size(), 1024, NodeTask(this, &x, &b));
+		int offset = m_inv_A.size();
+		for (int i = offset; i < b.size(); ++i)
+		{
+			b[i] = (i - offset < m_inv_S.size()) ? x[i] * m_inv_S[i - offset] : x[i];
+		}
+	}
+};
+
 #endif /* BT_PRECONDITIONER_H */
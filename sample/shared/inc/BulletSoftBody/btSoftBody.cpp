@@ -20,11 +20,18 @@ subject to the following restrictions:
 #include "LinearMath/btSerializer.h"
 #include "LinearMath/btImplicitQRSVD.h"
 #include "LinearMath/btAlignedAllocator.h"
+#include "LinearMath/btThreads.h"
 #include "BulletDynamics/Featherstone/btMultiBodyLinkCollider.h"
 #include "BulletDynamics/Featherstone/btMultiBodyConstraint.h"
 #include "BulletCollision/NarrowPhaseCollision/btGjkEpa2.h"
 #include "BulletCollision/CollisionShapes/btTriangleShape.h"
 #include <iostream>
+
+/* Grain sizes for parallelFor	*/
+static const int btSoftBodyNodeGrain = 1024;   // Nodes, faces and link slots
+static const int btSoftBodyChunkGrain = 64;    // Chunks of 4 links in a batch
+static const int btSoftBodyBoundsChunk = 4096;  // Nodes per partial bounds
+
 //
 static inline btDbvtNode* buildTreeBottomUp(btAlignedObjectArray<btDbvtNode*>& leafNodes, btAlignedObjectArray<btAlignedObjectArray<int> >& adj)
 {
@@ -224,6 +231,12 @@ void btSoftBody::initDefaults()
 	m_dampingCoefficient = 1.0;
 	m_sleepingThreshold = .04;
 	m_useSelfCollision = false;
+	m_useLinkSoA = false;
+#if BT_THREADSAFE
+	m_contactBuffers.resize(BT_MAX_THREAD_COUNT);
+#else
+	m_contactBuffers.resize(1);
+#endif
 	m_collisionFlags = 0;
 	m_softSoftCollision = false;
 	m_maxSpeedSquared = 0;
@@ -1176,6 +1189,7 @@ void btSoftBody::setRestLengthScale(btScalar restLengthScale)
 		l.m_c1 = l.m_rl * l.m_rl;
 	}
 	m_restLengthScale = restLengthScale;
+	m_linkSoA.invalidate();
 
 	if (getActivationState() == ISLAND_SLEEPING)
 		activate();
@@ -1238,6 +1252,7 @@ void btSoftBody::resetLinkRestLengths()
 		l.m_rl = (l.m_n[0]->m_x - l.m_n[1]->m_x).length();
 		l.m_c1 = l.m_rl * l.m_rl;
 	}
+	m_linkSoA.invalidate();
 }
 
 //
@@ -1484,6 +1499,7 @@ void btSoftBody::randomizeConstraints()
 		btSwap(m_faces[i], m_faces[NEXTRAND % ni]);
 	}
 #undef NEXTRAND
+	m_linkSoA.invalidate();
 }
 
 void btSoftBody::updateState(const btAlignedObjectArray<btVector3>& q, const btAlignedObjectArray<btVector3>& v)
@@ -1713,6 +1729,7 @@ int btSoftBody::generateClusters(int k, int maxiterations)
 //
 void btSoftBody::refine(ImplicitFn* ifn, btScalar accurary, bool cut)
 {
+	m_linkSoA.invalidate();
 	const Node* nbase = &m_nodes[0];
 	int ncount = m_nodes.size();
 	btSymMatrix<int> edges(ncount, -2);
@@ -1983,6 +2000,7 @@ bool btSoftBody::cutLink(const Node* node0, const Node* node1, btScalar position
 //
 bool btSoftBody::cutLink(int node0, int node1, btScalar position)
 {
+	m_linkSoA.invalidate();
 	bool done = false;
 	int i, ni;
 	//	const btVector3	d=m_nodes[node0].m_x-m_nodes[node1].m_x;
@@ -2096,6 +2114,41 @@ void btSoftBody::setSolver(eSolverPresets::_ preset)
 	}
 }
 
+/* Node integration of predictMotion	*/
+struct btSoftBodyIntegrateTask : public btIParallelForBody
+{
+	btSoftBody* m_psb;
+	btSoftBodyIntegrateTask(btSoftBody* psb) : m_psb(psb) {}
+	void forLoop(int iBegin, int iEnd) const
+	{
+		const btScalar sdt = m_psb->m_sst.sdt;
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			btSoftBody::Node& n = m_psb->m_nodes[i];
+			n.m_q = n.m_x;
+			btVector3 deltaV = n.m_f * n.m_im * sdt;
+			{
+				btScalar maxDisplacement = m_psb->m_worldInfo->m_maxDisplacement;
+				btScalar clampDeltaV = maxDisplacement / sdt;
+				for (int c = 0; c < 3; c++)
+				{
+					if (deltaV[c] > clampDeltaV)
+					{
+						deltaV[c] = clampDeltaV;
+					}
+					if (deltaV[c] < -clampDeltaV)
+					{
+						deltaV[c] = -clampDeltaV;
+					}
+				}
+			}
+			n.m_v += deltaV;
+			n.m_x += n.m_v * sdt;
+			n.m_f = btVector3(0, 0, 0);
+		}
+	}
+};
+
 void btSoftBody::predictMotion(btScalar dt)
 {
 	int i, ni;
@@ -2122,30 +2175,7 @@ void btSoftBody::predictMotion(btScalar dt)
 	addVelocity(m_worldInfo->m_gravity * m_sst.sdt);
 	applyForces();
 	/* Integrate            */
-	for (i = 0, ni = m_nodes.size(); i < ni; ++i)
-	{
-		Node& n = m_nodes[i];
-		n.m_q = n.m_x;
-		btVector3 deltaV = n.m_f * n.m_im * m_sst.sdt;
-		{
-			btScalar maxDisplacement = m_worldInfo->m_maxDisplacement;
-			btScalar clampDeltaV = maxDisplacement / m_sst.sdt;
-			for (int c = 0; c < 3; c++)
-			{
-				if (deltaV[c] > clampDeltaV)
-				{
-					deltaV[c] = clampDeltaV;
-				}
-				if (deltaV[c] < -clampDeltaV)
-				{
-					deltaV[c] = -clampDeltaV;
-				}
-			}
-		}
-		n.m_v += deltaV;
-		n.m_x += n.m_v * m_sst.sdt;
-		n.m_f = btVector3(0, 0, 0);
-	}
+	parallelFor(0, m_nodes.size(), btSoftBodyNodeGrain, btSoftBodyIntegrateTask(this));
 	/* Clusters                */
 	updateClusters();
 	/* Bounds                */
@@ -2198,6 +2228,14 @@ void btSoftBody::predictMotion(btScalar dt)
 	/* Clear contacts        */
 	m_rcontacts.resize(0);
 	m_scontacts.resize(0);
+	for (int i = 0, ni = m_contactBuffers.size(); i < ni; ++i)
+	{
+		ContactBuffer& buffer = m_contactBuffers[i];
+		buffer.m_rcontacts.resize(0);
+		buffer.m_scontacts.resize(0);
+		buffer.m_rchunks.resize(0);
+		buffer.m_schunks.resize(0);
+	}
 	/* Optimize dbvt's        */
 	m_ndbvt.optimizeIncremental(1);
 	m_fdbvt.optimizeIncremental(1);
@@ -2207,6 +2245,13 @@ void btSoftBody::predictMotion(btScalar dt)
 //
 void btSoftBody::solveConstraints()
 {
+	/* Contacts still in the collision buffers	*/
+	mergeContacts();
+	if (m_useLinkSoA && m_links.size() > 0)
+	{
+		solveConstraintsSoA();
+		return;
+	}
 	/* Apply clusters		*/
 	applyClusters(false);
 	/* Prepare links		*/
@@ -2943,33 +2988,106 @@ bool btSoftBody::checkDeformableFaceContact(const btCollisionObjectWrapper* colO
 	return true;
 }
 
-void btSoftBody::updateNormals()
+/* Element-wise loops of updateNormals	*/
+struct btSoftBodyNormalsTask : public btIParallelForBody
 {
-	const btVector3 zv(0, 0, 0);
-	int i, ni;
-
-	for (i = 0, ni = m_nodes.size(); i < ni; ++i)
+	enum
 	{
-		m_nodes[i].m_n = zv;
+		ClearNodes,      // Zero node normals
+		FaceNormals,     // Unnormalized face normals
+		NormalizeFaces,  // Normalize face normals
+		NormalizeNodes   // Normalize node normals
+	};
+	btSoftBody* m_psb;
+	int m_op;
+	btSoftBodyNormalsTask(btSoftBody* psb, int op) : m_psb(psb), m_op(op) {}
+	void forLoop(int iBegin, int iEnd) const
+	{
+		int i;
+		switch (m_op)
+		{
+			case ClearNodes:
+				for (i = iBegin; i < iEnd; ++i)
+				{
+					m_psb->m_nodes[i].m_n = btVector3(0, 0, 0);
+				}
+				break;
+			case FaceNormals:
+				for (i = iBegin; i < iEnd; ++i)
+				{
+					btSoftBody::Face& f = m_psb->m_faces[i];
+					f.m_normal = btCross(f.m_n[1]->m_x - f.m_n[0]->m_x,
+										 f.m_n[2]->m_x - f.m_n[0]->m_x);
+				}
+				break;
+			case NormalizeFaces:
+				for (i = iBegin; i < iEnd; ++i)
+				{
+					m_psb->m_faces[i].m_normal.safeNormalize();
+				}
+				break;
+			case NormalizeNodes:
+				for (i = iBegin; i < iEnd; ++i)
+				{
+					btSoftBody::Node& n = m_psb->m_nodes[i];
+					btScalar len = n.m_n.length();
+					if (len > SIMD_EPSILON)
+						n.m_n /= len;
+				}
+				break;
+		}
 	}
-	for (i = 0, ni = m_faces.size(); i < ni; ++i)
+};
+
+void btSoftBody::updateNormals()
+{
+	const int nn = m_nodes.size();
+	const int nf = m_faces.size();
+
+	parallelFor(0, nn, btSoftBodyNodeGrain, btSoftBodyNormalsTask(this, btSoftBodyNormalsTask::ClearNodes));
+	parallelFor(0, nf, btSoftBodyNodeGrain, btSoftBodyNormalsTask(this, btSoftBodyNormalsTask::FaceNormals));
+	/* Faces share nodes: sum in face order	*/
+	for (int i = 0; i < nf; ++i)
 	{
 		btSoftBody::Face& f = m_faces[i];
-		const btVector3 n = btCross(f.m_n[1]->m_x - f.m_n[0]->m_x,
-									f.m_n[2]->m_x - f.m_n[0]->m_x);
-		f.m_normal = n;
-		f.m_normal.safeNormalize();
-		f.m_n[0]->m_n += n;
-		f.m_n[1]->m_n += n;
-		f.m_n[2]->m_n += n;
+		f.m_n[0]->m_n += f.m_normal;
+		f.m_n[1]->m_n += f.m_normal;
+		f.m_n[2]->m_n += f.m_normal;
 	}
-	for (i = 0, ni = m_nodes.size(); i < ni; ++i)
+	parallelFor(0, nf, btSoftBodyNodeGrain, btSoftBodyNormalsTask(this, btSoftBodyNormalsTask::NormalizeFaces));
+	parallelFor(0, nn, btSoftBodyNodeGrain, btSoftBodyNormalsTask(this, btSoftBodyNormalsTask::NormalizeNodes));
+}
+
+/* Node bounds of chunks of btSoftBodyBoundsChunk nodes	*/
+struct btSoftBodyBoundsTask : public btIParallelForBody
+{
+	const btSoftBody* m_psb;
+	btVector3* m_bounds;  // mins, maxs per chunk
+	btSoftBodyBoundsTask(const btSoftBody* psb, btVector3* bounds) : m_psb(psb), m_bounds(bounds) {}
+	void forLoop(int iBegin, int iEnd) const
 	{
-		btScalar len = m_nodes[i].m_n.length();
-		if (len > SIMD_EPSILON)
-			m_nodes[i].m_n /= len;
+		const btSoftBody::tNodeArray& nodes = m_psb->m_nodes;
+		for (int c = iBegin; c < iEnd; ++c)
+		{
+			const int begin = c * btSoftBodyBoundsChunk;
+			const int end = btMin(begin + btSoftBodyBoundsChunk, nodes.size());
+			btVector3 mins = nodes[begin].m_x;
+			btVector3 maxs = nodes[begin].m_x;
+			for (int i = begin + 1; i < end; ++i)
+			{
+				for (int d = 0; d < 3; ++d)
+				{
+					if (nodes[i].m_x[d] > maxs[d])
+						maxs[d] = nodes[i].m_x[d];
+					if (nodes[i].m_x[d] < mins[d])
+						mins[d] = nodes[i].m_x[d];
+				}
+			}
+			m_bounds[c * 2] = mins;
+			m_bounds[c * 2 + 1] = maxs;
+		}
 	}
-}
+};
 
 //
 void btSoftBody::updateBounds()
@@ -3012,16 +3130,22 @@ void btSoftBody::updateBounds()
 	//    }
 	if (m_nodes.size())
 	{
-		btVector3 mins = m_nodes[0].m_x;
-		btVector3 maxs = m_nodes[0].m_x;
-		for (int i = 1; i < m_nodes.size(); ++i)
+		/* Bounds of fixed size chunks, combined in order	*/
+		const int nn = m_nodes.size();
+		const int nchunks = (nn + btSoftBodyBoundsChunk - 1) / btSoftBodyBoundsChunk;
+		btAlignedObjectArray<btVector3> chunkBounds;
+		chunkBounds.resize(nchunks * 2);
+		parallelFor(0, nchunks, 1, btSoftBodyBoundsTask(this, &chunkBounds[0]));
+		btVector3 mins = chunkBounds[0];
+		btVector3 maxs = chunkBounds[1];
+		for (int i = 1; i < nchunks; ++i)
 		{
 			for (int d = 0; d < 3; ++d)
 			{
-				if (m_nodes[i].m_x[d] > maxs[d])
-					maxs[d] = m_nodes[i].m_x[d];
-				if (m_nodes[i].m_x[d] < mins[d])
-					mins[d] = m_nodes[i].m_x[d];
+				if (chunkBounds[i * 2 + 1][d] > maxs[d])
+					maxs[d] = chunkBounds[i * 2 + 1][d];
+				if (chunkBounds[i * 2][d] < mins[d])
+					mins[d] = chunkBounds[i * 2][d];
 			}
 		}
 		const btScalar csm = getCollisionShape()->getMargin();
@@ -3158,6 +3282,7 @@ void btSoftBody::updateLinkConstants()
 		Material& m = *l.m_material;
 		l.m_c0 = (l.m_n[0]->m_im + l.m_n[1]->m_im) / m.m_kLST;
 	}
+	m_linkSoA.invalidate();
 }
 
 void btSoftBody::updateConstants()
@@ -4037,6 +4162,589 @@ void btSoftBody::VSolve_Links(btSoftBody* psb, btScalar kst)
 	}
 }
 
+#if defined(BT_USE_SSE) && !defined(BT_USE_DOUBLE_PRECISION)
+#define BT_SOFTBODY_LINK_SOA_SSE
+static SIMD_FORCE_INLINE __m128 btGatherLinkSoA(const btScalar* p, const int* i)
+{
+	return _mm_setr_ps(p[i[0]], p[i[1]], p[i[2]], p[i[3]]);
+}
+static SIMD_FORCE_INLINE void btScatterLinkSoA(btScalar* p, const int* i, __m128 v)
+{
+	ATTRIBUTE_ALIGNED16(btScalar t[4]);
+	_mm_store_ps(t, v);
+	p[i[0]] = t[0];
+	p[i[1]] = t[1];
+	p[i[2]] = t[2];
+	p[i[3]] = t[3];
+}
+#endif  //BT_USE_SSE
+
+//
+void btSoftBody::parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body)
+{
+#if BT_THREADSAFE
+	btITaskScheduler* scheduler = btGetTaskScheduler();
+	if (scheduler && scheduler->getNumThreads() > 1 && iEnd - iBegin > grainSize)
+	{
+		btParallelFor(iBegin, iEnd, grainSize, body);
+		return;
+	}
+#endif  //BT_THREADSAFE
+	if (iBegin < iEnd)
+	{
+		body.forLoop(iBegin, iEnd);
+	}
+}
+
+//
+static void btPSolveLinksSoA(btSoftBody::LinkSoA& s, int i, int end, btScalar kst)
+{
+	btScalar* x = &s.m_x[0][0];
+	btScalar* y = &s.m_x[1][0];
+	btScalar* z = &s.m_x[2][0];
+	const btScalar* im = &s.m_im[0];
+	const int* na = &s.m_na[0];
+	const int* nb = &s.m_nb[0];
+	const btScalar* c0 = &s.m_c0[0];
+	const btScalar* c1 = &s.m_c1[0];
+#ifdef BT_SOFTBODY_LINK_SOA_SSE
+	/* Batches: the 4 links share no node	*/
+	const __m128 vkst = _mm_set1_ps(kst);
+	const __m128 veps = _mm_set1_ps(SIMD_EPSILON);
+	const __m128 vzero = _mm_setzero_ps();
+	for (; i < end && i < s.m_serial; i += 4)
+	{
+		const int* ia = na + i;
+		const int* ib = nb + i;
+		__m128 ax = btGatherLinkSoA(x, ia), ay = btGatherLinkSoA(y, ia), az = btGatherLinkSoA(z, ia);
+		__m128 bx = btGatherLinkSoA(x, ib), by = btGatherLinkSoA(y, ib), bz = btGatherLinkSoA(z, ib);
+		const __m128 dx = _mm_sub_ps(bx, ax), dy = _mm_sub_ps(by, ay), dz = _mm_sub_ps(bz, az);
+		const __m128 len = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		const __m128 vc0 = _mm_load_ps(c0 + i);
+		const __m128 vc1 = _mm_load_ps(c1 + i);
+		const __m128 sum = _mm_add_ps(vc1, len);
+		const __m128 mask = _mm_and_ps(_mm_cmpgt_ps(vc0, vzero), _mm_cmpgt_ps(sum, veps));
+		const __m128 k = _mm_and_ps(mask, _mm_mul_ps(_mm_div_ps(_mm_sub_ps(vc1, len), _mm_mul_ps(vc0, sum)), vkst));
+		const __m128 ka = _mm_mul_ps(k, btGatherLinkSoA(im, ia));
+		const __m128 kb = _mm_mul_ps(k, btGatherLinkSoA(im, ib));
+		btScatterLinkSoA(x, ia, _mm_sub_ps(ax, _mm_mul_ps(dx, ka)));
+		btScatterLinkSoA(y, ia, _mm_sub_ps(ay, _mm_mul_ps(dy, ka)));
+		btScatterLinkSoA(z, ia, _mm_sub_ps(az, _mm_mul_ps(dz, ka)));
+		btScatterLinkSoA(x, ib, _mm_add_ps(bx, _mm_mul_ps(dx, kb)));
+		btScatterLinkSoA(y, ib, _mm_add_ps(by, _mm_mul_ps(dy, kb)));
+		btScatterLinkSoA(z, ib, _mm_add_ps(bz, _mm_mul_ps(dz, kb)));
+	}
+#endif  //BT_SOFTBODY_LINK_SOA_SSE
+	/* Remaining links one at a time (same arithmetic as PSolve_Links)	*/
+	for (; i < end; ++i)
+	{
+		if (c0[i] > 0)
+		{
+			const int a = na[i];
+			const int b = nb[i];
+			const btScalar dx = x[b] - x[a];
+			const btScalar dy = y[b] - y[a];
+			const btScalar dz = z[b] - z[a];
+			const btScalar len = dx * dx + dy * dy + dz * dz;
+			if (c1[i] + len > SIMD_EPSILON)
+			{
+				const btScalar k = ((c1[i] - len) / (c0[i] * (c1[i] + len))) * kst;
+				const btScalar ka = k * im[a];
+				const btScalar kb = k * im[b];
+				x[a] -= dx * ka;
+				y[a] -= dy * ka;
+				z[a] -= dz * ka;
+				x[b] += dx * kb;
+				y[b] += dy * kb;
+				z[b] += dz * kb;
+			}
+		}
+	}
+}
+
+//
+static void btVSolveLinksSoA(btSoftBody::LinkSoA& s, int i, int end, btScalar kst)
+{
+	btScalar* vx = &s.m_v[0][0];
+	btScalar* vy = &s.m_v[1][0];
+	btScalar* vz = &s.m_v[2][0];
+	const btScalar* im = &s.m_im[0];
+	const int* na = &s.m_na[0];
+	const int* nb = &s.m_nb[0];
+	const btScalar* c2 = &s.m_c2[0];
+	const btScalar* gx = &s.m_c3[0][0];
+	const btScalar* gy = &s.m_c3[1][0];
+	const btScalar* gz = &s.m_c3[2][0];
+#ifdef BT_SOFTBODY_LINK_SOA_SSE
+	const __m128 vkst = _mm_set1_ps(kst);
+	const __m128 vsign = _mm_set1_ps(-0.0f);
+	for (; i < end && i < s.m_serial; i += 4)
+	{
+		const int* ia = na + i;
+		const int* ib = nb + i;
+		const __m128 ax = btGatherLinkSoA(vx, ia), ay = btGatherLinkSoA(vy, ia), az = btGatherLinkSoA(vz, ia);
+		const __m128 bx = btGatherLinkSoA(vx, ib), by = btGatherLinkSoA(vy, ib), bz = btGatherLinkSoA(vz, ib);
+		const __m128 cx = _mm_load_ps(gx + i), cy = _mm_load_ps(gy + i), cz = _mm_load_ps(gz + i);
+		const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_sub_ps(ax, bx)), _mm_mul_ps(cy, _mm_sub_ps(ay, by))), _mm_mul_ps(cz, _mm_sub_ps(az, bz)));
+		const __m128 j = _mm_mul_ps(_mm_mul_ps(_mm_xor_ps(dot, vsign), _mm_load_ps(c2 + i)), vkst);
+		const __m128 ja = _mm_mul_ps(j, btGatherLinkSoA(im, ia));
+		const __m128 jb = _mm_mul_ps(j, btGatherLinkSoA(im, ib));
+		btScatterLinkSoA(vx, ia, _mm_add_ps(ax, _mm_mul_ps(cx, ja)));
+		btScatterLinkSoA(vy, ia, _mm_add_ps(ay, _mm_mul_ps(cy, ja)));
+		btScatterLinkSoA(vz, ia, _mm_add_ps(az, _mm_mul_ps(cz, ja)));
+		btScatterLinkSoA(vx, ib, _mm_sub_ps(bx, _mm_mul_ps(cx, jb)));
+		btScatterLinkSoA(vy, ib, _mm_sub_ps(by, _mm_mul_ps(cy, jb)));
+		btScatterLinkSoA(vz, ib, _mm_sub_ps(bz, _mm_mul_ps(cz, jb)));
+	}
+#endif  //BT_SOFTBODY_LINK_SOA_SSE
+	/* Remaining links one at a time (same arithmetic as VSolve_Links)	*/
+	for (; i < end; ++i)
+	{
+		const int a = na[i];
+		const int b = nb[i];
+		const btScalar dot = gx[i] * (vx[a] - vx[b]) + gy[i] * (vy[a] - vy[b]) + gz[i] * (vz[a] - vz[b]);
+		const btScalar j = -dot * c2[i] * kst;
+		const btScalar ja = j * im[a];
+		const btScalar jb = j * im[b];
+		vx[a] += gx[i] * ja;
+		vy[a] += gy[i] * ja;
+		vz[a] += gz[i] * ja;
+		vx[b] -= gx[i] * jb;
+		vy[b] -= gy[i] * jb;
+		vz[b] -= gz[i] * jb;
+	}
+}
+
+/* Solve the chunks [iBegin,iEnd) of 4 links of one batch	*/
+struct btLinkSoABatchTask : public btIParallelForBody
+{
+	btSoftBody::LinkSoA* m_soa;
+	btScalar m_kst;
+	bool m_velocities;
+	btLinkSoABatchTask(btSoftBody::LinkSoA* soa, btScalar kst, bool velocities)
+		: m_soa(soa), m_kst(kst), m_velocities(velocities)
+	{
+	}
+	void forLoop(int iBegin, int iEnd) const
+	{
+		if (m_velocities)
+			btVSolveLinksSoA(*m_soa, iBegin * 4, iEnd * 4, m_kst);
+		else
+			btPSolveLinksSoA(*m_soa, iBegin * 4, iEnd * 4, m_kst);
+	}
+};
+
+//
+void btSoftBody::PSolve_LinksSoA(btSoftBody* psb, btScalar kst, btScalar ti)
+{
+	BT_PROFILE("PSolve_LinksSoA");
+	LinkSoA& s = psb->m_linkSoA;
+	const btLinkSoABatchTask task(&s, kst, false);
+	for (int b = 0, nb = s.m_batches.size() - 1; b < nb; ++b)
+	{
+		parallelFor(s.m_batches[b] / 4, s.m_batches[b + 1] / 4, btSoftBodyChunkGrain, task);
+	}
+	btPSolveLinksSoA(s, s.m_serial, s.m_link.size(), kst);
+}
+
+//
+void btSoftBody::VSolve_LinksSoA(btSoftBody* psb, btScalar kst)
+{
+	BT_PROFILE("VSolve_LinksSoA");
+	LinkSoA& s = psb->m_linkSoA;
+	const btLinkSoABatchTask task(&s, kst, true);
+	for (int b = 0, nb = s.m_batches.size() - 1; b < nb; ++b)
+	{
+		parallelFor(s.m_batches[b] / 4, s.m_batches[b + 1] / 4, btSoftBodyChunkGrain, task);
+	}
+	btVSolveLinksSoA(s, s.m_serial, s.m_link.size(), kst);
+}
+
+//
+void btSoftBody::buildLinkSoA()
+{
+	static const int maxBatches = 64;
+	LinkSoA& s = m_linkSoA;
+	const int nn = m_nodes.size();
+	const int nl = m_links.size();
+	const Node* base = nn > 0 ? &m_nodes[0] : 0;
+	int i;
+
+	/* Greedy coloring: each link goes to the first batch not used by its nodes	*/
+	btAlignedObjectArray<unsigned long long> used;
+	btAlignedObjectArray<int> batch;
+	int counts[maxBatches + 1];
+	int offsets[maxBatches + 1];
+	used.resize(nn, 0);
+	batch.resize(nl);
+	for (i = 0; i <= maxBatches; ++i) counts[i] = 0;
+	for (i = 0; i < nl; ++i)
+	{
+		const Link& l = m_links[i];
+		const int a = int(l.m_n[0] - base);
+		const int b = int(l.m_n[1] - base);
+		const unsigned long long u = used[a] | used[b];
+		int c = s.m_batched ? 0 : maxBatches;
+		while (c < maxBatches && (u & (1ULL << c))) ++c;
+		if (c < maxBatches)
+		{
+			used[a] |= 1ULL << c;
+			used[b] |= 1ULL << c;
+		}
+		batch[i] = c;
+		++counts[c];
+	}
+
+	/* Batches padded to multiples of 4, then the links that did not fit in any batch	*/
+	int n = 0;
+	s.m_batches.resize(0);
+	for (i = 0; i < maxBatches; ++i)
+	{
+		offsets[i] = n;
+		if (counts[i] > 0)
+		{
+			s.m_batches.push_back(n);
+		}
+		n += (counts[i] + 3) & ~3;
+	}
+	s.m_serial = n;
+	s.m_batches.push_back(n);
+	offsets[maxBatches] = n;
+	n += counts[maxBatches];
+
+	/* Padding refers to the dummy node nn (1/mass 0) with c0 = 0	*/
+	s.m_na.resize(0);
+	s.m_na.resize(n, nn);
+	s.m_nb.resize(0);
+	s.m_nb.resize(n, nn);
+	s.m_link.resize(0);
+	s.m_link.resize(n, -1);
+	s.m_c0.resize(0);
+	s.m_c0.resize(n, 0);
+	s.m_c1.resize(0);
+	s.m_c1.resize(n, 0);
+	s.m_c2.resize(0);
+	s.m_c2.resize(n, 0);
+	for (int j = 0; j < 3; ++j)
+	{
+		s.m_c3[j].resize(0);
+		s.m_c3[j].resize(n, 0);
+	}
+	for (i = 0; i < nl; ++i)
+	{
+		const Link& l = m_links[i];
+		const int k = offsets[batch[i]]++;
+		s.m_na[k] = int(l.m_n[0] - base);
+		s.m_nb[k] = int(l.m_n[1] - base);
+		s.m_link[k] = i;
+		s.m_c0[k] = l.m_c0;
+		s.m_c1[k] = l.m_c1;
+	}
+
+	for (int j = 0; j < 3; ++j)
+	{
+		s.m_x[j].resize(nn + 1);
+		s.m_q[j].resize(nn + 1);
+		s.m_v[j].resize(nn + 1);
+		s.m_x[j][nn] = s.m_q[j][nn] = s.m_v[j][nn] = 0;
+	}
+	s.m_im.resize(nn + 1);
+	s.m_im[nn] = 0;
+	s.m_nodeCount = nn;
+	s.m_linkCount = nl;
+	s.m_nodeBase = base;
+}
+
+//
+void btSoftBody::syncLinkSoA(bool toNodes)
+{
+	LinkSoA& s = m_linkSoA;
+	for (int i = 0, ni = s.m_touched.size(); i < ni; ++i)
+	{
+		const int k = s.m_touched[i];
+		Node& n = m_nodes[k];
+		if (toNodes)
+		{
+			n.m_x.setValue(s.m_x[0][k], s.m_x[1][k], s.m_x[2][k]);
+			n.m_q.setValue(s.m_q[0][k], s.m_q[1][k], s.m_q[2][k]);
+			n.m_v.setValue(s.m_v[0][k], s.m_v[1][k], s.m_v[2][k]);
+		}
+		else
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				s.m_x[j][k] = n.m_x[j];
+				s.m_q[j][k] = n.m_q[j];
+				s.m_v[j][k] = n.m_v[j];
+			}
+		}
+	}
+}
+
+/* Element-wise node and link slot loops of solveConstraintsSoA	*/
+struct btLinkSoANodeTask : public btIParallelForBody
+{
+	enum
+	{
+		Gather,    // Nodes to SoA
+		Prepare,   // Link slot gradients
+		Update,    // x = q + v*dt
+		Velocity,  // v = (x - q)*c
+		Drift,     // v += (x - q)*c
+		Scatter    // SoA to nodes
+	};
+	btSoftBody* m_psb;
+	int m_op;
+	btScalar m_c;
+	bool m_drift;
+	bool m_positions;
+	btLinkSoANodeTask(btSoftBody* psb, int op, btScalar c = 0)
+		: m_psb(psb), m_op(op), m_c(c), m_drift(false), m_positions(false)
+	{
+	}
+	void forLoop(int iBegin, int iEnd) const
+	{
+		btSoftBody::LinkSoA& s = m_psb->m_linkSoA;
+		btSoftBody::tNodeArray& nodes = m_psb->m_nodes;
+		int i, j;
+		switch (m_op)
+		{
+			case Gather:
+			{
+				btScalar *x = &s.m_x[0][0], *y = &s.m_x[1][0], *z = &s.m_x[2][0];
+				btScalar *qx = &s.m_q[0][0], *qy = &s.m_q[1][0], *qz = &s.m_q[2][0];
+				btScalar *vx = &s.m_v[0][0], *vy = &s.m_v[1][0], *vz = &s.m_v[2][0];
+				btScalar* im = &s.m_im[0];
+				for (i = iBegin; i < iEnd; ++i)
+				{
+					const btSoftBody::Node& n = nodes[i];
+					x[i] = n.m_x.x();
+					y[i] = n.m_x.y();
+					z[i] = n.m_x.z();
+					qx[i] = n.m_q.x();
+					qy[i] = n.m_q.y();
+					qz[i] = n.m_q.z();
+					vx[i] = n.m_v.x();
+					vy[i] = n.m_v.y();
+					vz[i] = n.m_v.z();
+					im[i] = n.m_im;
+				}
+			}
+			break;
+			case Prepare:
+			{
+				const btScalar *qx = &s.m_q[0][0], *qy = &s.m_q[1][0], *qz = &s.m_q[2][0];
+				const int* na = &s.m_na[0];
+				const int* nb = &s.m_nb[0];
+				const btScalar* c0 = &s.m_c0[0];
+				btScalar* c2 = &s.m_c2[0];
+				btScalar *gx = &s.m_c3[0][0], *gy = &s.m_c3[1][0], *gz = &s.m_c3[2][0];
+				for (i = iBegin; i < iEnd; ++i)
+				{
+					if (s.m_link[i] < 0) continue;
+					const int a = na[i];
+					const int b = nb[i];
+					gx[i] = qx[b] - qx[a];
+					gy[i] = qy[b] - qy[a];
+					gz[i] = qz[b] - qz[a];
+					c2[i] = 1 / ((gx[i] * gx[i] + gy[i] * gy[i] + gz[i] * gz[i]) * c0[i]);
+				}
+			}
+			break;
+			case Update:
+				for (j = 0; j < 3; ++j)
+				{
+					btScalar* x = &s.m_x[j][0];
+					const btScalar* q = &s.m_q[j][0];
+					const btScalar* v = &s.m_v[j][0];
+					for (i = iBegin; i < iEnd; ++i)
+					{
+						x[i] = q[i] + v[i] * m_c;
+					}
+				}
+				break;
+			case Velocity:
+				for (j = 0; j < 3; ++j)
+				{
+					const btScalar* x = &s.m_x[j][0];
+					const btScalar* q = &s.m_q[j][0];
+					btScalar* v = &s.m_v[j][0];
+					for (i = iBegin; i < iEnd; ++i)
+					{
+						v[i] = (x[i] - q[i]) * m_c;
+					}
+				}
+				break;
+			case Drift:
+				for (j = 0; j < 3; ++j)
+				{
+					const btScalar* x = &s.m_x[j][0];
+					const btScalar* q = &s.m_q[j][0];
+					btScalar* v = &s.m_v[j][0];
+					for (i = iBegin; i < iEnd; ++i)
+					{
+						v[i] += (x[i] - q[i]) * m_c;
+					}
+				}
+				break;
+			case Scatter:
+				for (i = iBegin; i < iEnd; ++i)
+				{
+					btSoftBody::Node& n = nodes[i];
+					n.m_x.setValue(s.m_x[0][i], s.m_x[1][i], s.m_x[2][i]);
+					n.m_v.setValue(s.m_v[0][i], s.m_v[1][i], s.m_v[2][i]);
+					if (m_drift)
+					{
+						n.m_q.setValue(s.m_q[0][i], s.m_q[1][i], s.m_q[2][i]);
+					}
+					if (m_positions)
+					{
+						n.m_f = btVector3(0, 0, 0);
+					}
+				}
+				break;
+		}
+	}
+};
+
+//
+void btSoftBody::solveConstraintsSoA()
+{
+	LinkSoA& s = m_linkSoA;
+	const int nn = m_nodes.size();
+	int i, j, ni;
+
+	/* Apply clusters		*/
+	applyClusters(false);
+	/* Rebuild batches		*/
+	if (s.m_nodeCount != nn || s.m_linkCount != m_links.size() || s.m_nodeBase != &m_nodes[0])
+	{
+		buildLinkSoA();
+	}
+	const Node* base = &m_nodes[0];
+	/* Gather nodes			*/
+	parallelFor(0, nn, btSoftBodyNodeGrain, btLinkSoANodeTask(this, btLinkSoANodeTask::Gather));
+	/* Prepare links		*/
+	parallelFor(0, s.m_link.size(), btSoftBodyNodeGrain, btLinkSoANodeTask(this, btLinkSoANodeTask::Prepare));
+	/* Nodes used by the other solvers are copied back and forth around them	*/
+	s.m_touched.resize(0);
+	for (i = 0, ni = m_anchors.size(); i < ni; ++i)
+	{
+		s.m_touched.push_back(int(m_anchors[i].m_node - base));
+	}
+	for (i = 0, ni = m_rcontacts.size(); i < ni; ++i)
+	{
+		s.m_touched.push_back(int(m_rcontacts[i].m_node - base));
+	}
+	for (i = 0, ni = m_scontacts.size(); i < ni; ++i)
+	{
+		const SContact& c = m_scontacts[i];
+		s.m_touched.push_back(int(c.m_node - base));
+		for (j = 0; j < 3; ++j)
+		{
+			/* The face may belong to the other soft body	*/
+			const Node* n = c.m_face->m_n[j];
+			if (n >= base && n < base + nn)
+			{
+				s.m_touched.push_back(int(n - base));
+			}
+		}
+	}
+	/* Prepare anchors		*/
+	for (i = 0, ni = m_anchors.size(); i < ni; ++i)
+	{
+		Anchor& a = m_anchors[i];
+		const btVector3 ra = a.m_body->getWorldTransform().getBasis() * a.m_local;
+		a.m_c0 = ImpulseMatrix(m_sst.sdt,
+							   a.m_node->m_im,
+							   a.m_body->getInvMass(),
+							   a.m_body->getInvInertiaTensorWorld(),
+							   ra);
+		a.m_c1 = ra;
+		a.m_c2 = m_sst.sdt * a.m_node->m_im;
+		a.m_body->activate();
+	}
+	/* Solve velocities		*/
+	if (m_cfg.viterations > 0)
+	{
+		for (int isolve = 0; isolve < m_cfg.viterations; ++isolve)
+		{
+			for (int iseq = 0; iseq < m_cfg.m_vsequence.size(); ++iseq)
+			{
+				if (m_cfg.m_vsequence[iseq] == eVSolver::Linear)
+				{
+					VSolve_LinksSoA(this, 1);
+				}
+				else
+				{
+					syncLinkSoA(true);
+					getSolver(m_cfg.m_vsequence[iseq])(this, 1);
+					syncLinkSoA(false);
+				}
+			}
+		}
+		/* Update			*/
+		parallelFor(0, nn, btSoftBodyNodeGrain, btLinkSoANodeTask(this, btLinkSoANodeTask::Update, m_sst.sdt));
+	}
+	/* Solve positions		*/
+	if (m_cfg.piterations > 0)
+	{
+		for (int isolve = 0; isolve < m_cfg.piterations; ++isolve)
+		{
+			const btScalar ti = isolve / (btScalar)m_cfg.piterations;
+			for (int iseq = 0; iseq < m_cfg.m_psequence.size(); ++iseq)
+			{
+				if (m_cfg.m_psequence[iseq] == ePSolver::Linear)
+				{
+					PSolve_LinksSoA(this, 1, ti);
+				}
+				else
+				{
+					syncLinkSoA(true);
+					getSolver(m_cfg.m_psequence[iseq])(this, 1, ti);
+					syncLinkSoA(false);
+				}
+			}
+		}
+		const btScalar vc = m_sst.isdt * (1 - m_cfg.kDP);
+		parallelFor(0, nn, btSoftBodyNodeGrain, btLinkSoANodeTask(this, btLinkSoANodeTask::Velocity, vc));
+	}
+	/* Solve drift			*/
+	if (m_cfg.diterations > 0)
+	{
+		const btScalar vcf = m_cfg.kVCF * m_sst.isdt;
+		for (j = 0; j < 3; ++j)
+		{
+			s.m_q[j].copyFromArray(s.m_x[j]);
+		}
+		for (int idrift = 0; idrift < m_cfg.diterations; ++idrift)
+		{
+			for (int iseq = 0; iseq < m_cfg.m_dsequence.size(); ++iseq)
+			{
+				if (m_cfg.m_dsequence[iseq] == ePSolver::Linear)
+				{
+					PSolve_LinksSoA(this, 1, 0);
+				}
+				else
+				{
+					syncLinkSoA(true);
+					getSolver(m_cfg.m_dsequence[iseq])(this, 1, 0);
+					syncLinkSoA(false);
+				}
+			}
+		}
+		parallelFor(0, nn, btSoftBodyNodeGrain, btLinkSoANodeTask(this, btLinkSoANodeTask::Drift, vcf));
+	}
+	/* Scatter nodes		*/
+	btLinkSoANodeTask scatter(this, btLinkSoANodeTask::Scatter);
+	scatter.m_drift = m_cfg.diterations > 0;
+	scatter.m_positions = m_cfg.piterations > 0;
+	parallelFor(0, nn, btSoftBodyNodeGrain, scatter);
+	/* Apply clusters		*/
+	dampClusters();
+	applyClusters(true);
+}
+
 //
 btSoftBody::psolver_t btSoftBody::getSolver(ePSolver::_ solver)
 {
@@ -4081,13 +4789,144 @@ bool btSoftBody::useSelfCollision()
 	return m_useSelfCollision;
 }
 
+void btSoftBody::setLinkSoA(bool useLinkSoA, bool batched)
+{
+	m_useLinkSoA = useLinkSoA;
+	if (m_linkSoA.m_batched != batched)
+	{
+		m_linkSoA.m_batched = batched;
+		m_linkSoA.invalidate();
+	}
+}
+
+bool btSoftBody::useLinkSoA()
+{
+	return m_useLinkSoA;
+}
+
+/* Lock the soft bodies a collision handler writes to (joints, deformable contacts), in address order so that two pairs never wait on each other	*/
+static void btLockSoftBodies(btSoftBody* psa, btSoftBody* psb)
+{
+	if (psb < psa)
+		btSwap(psa, psb);
+	btMutexLock(&psa->m_collisionMutex);
+	if (psb != psa)
+		btMutexLock(&psb->m_collisionMutex);
+}
+
+static void btUnlockSoftBodies(btSoftBody* psa, btSoftBody* psb)
+{
+	if (psb != psa)
+		btMutexUnlock(&psb->m_collisionMutex);
+	btMutexUnlock(&psa->m_collisionMutex);
+}
+
+/* Contact buffer of the calling thread	*/
+static int btContactBufferIndex()
+{
+#if BT_THREADSAFE
+	return int(btGetCurrentThreadIndex());
+#else
+	return 0;
+#endif
+}
+
+/* Record the contacts [begin,end) of a contact buffer as a chunk	*/
+static void btPushContactChunk(btAlignedObjectArray<btSoftBody::ContactBuffer::Chunk>& chunks, int buffer, int begin, int end, const btCollisionObject* obj, int partId, int index)
+{
+	if (end > begin)
+	{
+		btSoftBody::ContactBuffer::Chunk chunk;
+		chunk.m_key[0] = obj->getWorldArrayIndex();
+		chunk.m_key[1] = partId;
+		chunk.m_key[2] = index;
+		chunk.m_buffer = buffer;
+		chunk.m_begin = begin;
+		chunk.m_end = end;
+		chunks.push_back(chunk);
+	}
+}
+
+struct btContactChunkSortPredicate
+{
+	bool operator()(const btSoftBody::ContactBuffer::Chunk& a, const btSoftBody::ContactBuffer::Chunk& b) const
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			if (a.m_key[i] != b.m_key[i])
+				return a.m_key[i] < b.m_key[i];
+		}
+		if (a.m_buffer != b.m_buffer)
+			return a.m_buffer < b.m_buffer;
+		return a.m_begin < b.m_begin;
+	}
+};
+
+//
+void btSoftBody::mergeContacts()
+{
+	btAlignedObjectArray<ContactBuffer::Chunk> rchunks;
+	btAlignedObjectArray<ContactBuffer::Chunk> schunks;
+	int i, j, ni;
+	for (i = 0, ni = m_contactBuffers.size(); i < ni; ++i)
+	{
+		const ContactBuffer& buffer = m_contactBuffers[i];
+		for (j = 0; j < buffer.m_rchunks.size(); ++j)
+		{
+			rchunks.push_back(buffer.m_rchunks[j]);
+		}
+		for (j = 0; j < buffer.m_schunks.size(); ++j)
+		{
+			schunks.push_back(buffer.m_schunks[j]);
+		}
+	}
+	if (rchunks.size() == 0 && schunks.size() == 0)
+		return;
+	/* Chunks of one pair are contiguous in the buffer of the thread that processed it	*/
+	rchunks.quickSort(btContactChunkSortPredicate());
+	schunks.quickSort(btContactChunkSortPredicate());
+	for (i = 0, ni = rchunks.size(); i < ni; ++i)
+	{
+		const ContactBuffer::Chunk& chunk = rchunks[i];
+		const btAlignedObjectArray<RContact>& contacts = m_contactBuffers[chunk.m_buffer].m_rcontacts;
+		for (j = chunk.m_begin; j < chunk.m_end; ++j)
+		{
+			m_rcontacts.push_back(contacts[j]);
+		}
+	}
+	for (i = 0, ni = schunks.size(); i < ni; ++i)
+	{
+		const ContactBuffer::Chunk& chunk = schunks[i];
+		const btAlignedObjectArray<SContact>& contacts = m_contactBuffers[chunk.m_buffer].m_scontacts;
+		for (j = chunk.m_begin; j < chunk.m_end; ++j)
+		{
+			m_scontacts.push_back(contacts[j]);
+		}
+	}
+	for (i = 0, ni = m_contactBuffers.size(); i < ni; ++i)
+	{
+		ContactBuffer& buffer = m_contactBuffers[i];
+		buffer.m_rcontacts.resize(0);
+		buffer.m_scontacts.resize(0);
+		buffer.m_rchunks.resize(0);
+		buffer.m_schunks.resize(0);
+	}
+}
+
 //
 void btSoftBody::defaultCollisionHandler(const btCollisionObjectWrapper* pcoWrap)
 {
-	switch (m_cfg.collisions & fCollision::RVSmask)
+	const int mode = m_cfg.collisions & fCollision::RVSmask;
+	/* CL_RS and SDF_RD only write to this body	*/
+	if (mode != fCollision::SDF_RS)
+		btMutexLock(&m_collisionMutex);
+	switch (mode)
 	{
 		case fCollision::SDF_RS:
 		{
+			const int ib = btContactBufferIndex();
+			ContactBuffer& buffer = m_contactBuffers[ib];
+			const int begin = buffer.m_rcontacts.size();
 			btSoftColliders::CollideSDF_RS docollide;
 			btRigidBody* prb1 = (btRigidBody*)btRigidBody::upcast(pcoWrap->getCollisionObject());
 			btTransform wtr = pcoWrap->getWorldTransform();
@@ -4105,12 +4944,32 @@ void btSoftBody::defaultCollisionHandler(const btCollisionObjectWrapper* pcoWrap
 			volume = btDbvtVolume::FromMM(mins, maxs);
 			volume.Expand(btVector3(basemargin, basemargin, basemargin));
 			docollide.psb = this;
+			docollide.m_contacts = &buffer.m_rcontacts;
 			docollide.m_colObj1Wrap = pcoWrap;
 			docollide.m_rigidBody = prb1;
 
 			docollide.dynmargin = basemargin + timemargin;
 			docollide.stamargin = basemargin;
-			m_ndbvt.collideTV(m_ndbvt.m_root, volume, docollide);
+			/* Nodes in the collider bounds, in tree order	*/
+			btAlignedObjectArray<Node*> nodes;
+			btSoftColliders::CollectNodes collect;
+			collect.nodes = &nodes;
+			m_ndbvt.collideTV(m_ndbvt.m_root, volume, collect);
+			/* Build their missing SDF cells on the worker threads before the contact tests	*/
+			btAlignedObjectArray<btVector3> points;
+			for (int i = 0, ni = nodes.size(); i < ni; ++i)
+			{
+				if (!nodes[i]->m_battach)
+					points.push_back(wtr.invXform(nodes[i]->m_x));
+			}
+			if (points.size() > 0)
+				m_worldInfo->m_sparsesdf.Prefetch(pcoWrap->getCollisionShape(), &points[0], points.size());
+			for (int i = 0, ni = nodes.size(); i < ni; ++i)
+			{
+				docollide.DoNode(*nodes[i]);
+			}
+			btPushContactChunk(buffer.m_rchunks, ib, begin, buffer.m_rcontacts.size(),
+							   pcoWrap->getCollisionObject(), pcoWrap->m_partId, pcoWrap->m_index);
 		}
 		break;
 		case fCollision::CL_RS:
@@ -4161,6 +5020,8 @@ void btSoftBody::defaultCollisionHandler(const btCollisionObjectWrapper* pcoWrap
 		}
 		break;
 	}
+	if (mode != fCollision::SDF_RS)
+		btMutexUnlock(&m_collisionMutex);
 }
 
 //
@@ -4168,7 +5029,12 @@ void btSoftBody::defaultCollisionHandler(btSoftBody* psb)
 {
 	BT_PROFILE("Deformable Collision");
 	const int cf = m_cfg.collisions & psb->m_cfg.collisions;
-	switch (cf & fCollision::SVSmask)
+	const int mode = cf & fCollision::SVSmask;
+	/* CL_SS writes to the joints of this body, VF_DD to the contacts of both	*/
+	btSoftBody* plocked = (mode == fCollision::VF_DD) ? psb : this;
+	if (mode != fCollision::VF_SS)
+		btLockSoftBodies(this, plocked);
+	switch (mode)
 	{
 		case fCollision::CL_SS:
 		{
@@ -4185,6 +5051,7 @@ void btSoftBody::defaultCollisionHandler(btSoftBody* psb)
 			//only self-collision for Cluster, not Vertex-Face yet
 			if (this != psb)
 			{
+				const int ib = btContactBufferIndex();
 				btSoftColliders::CollideVF_SS docollide;
 				/* common					*/
 				docollide.mrg = getCollisionShape()->getMargin() +
@@ -4192,22 +5059,30 @@ void btSoftBody::defaultCollisionHandler(btSoftBody* psb)
 				/* psb0 nodes vs psb1 faces	*/
 				docollide.psb[0] = this;
 				docollide.psb[1] = psb;
+				ContactBuffer* buffer = &m_contactBuffers[ib];
+				int begin = buffer->m_scontacts.size();
+				docollide.m_contacts = &buffer->m_scontacts;
 				docollide.psb[0]->m_ndbvt.collideTT(docollide.psb[0]->m_ndbvt.m_root,
 													docollide.psb[1]->m_fdbvt.m_root,
 													docollide);
+				btPushContactChunk(buffer->m_schunks, ib, begin, buffer->m_scontacts.size(), psb, -1, -1);
 				/* psb1 nodes vs psb0 faces	*/
 				docollide.psb[0] = psb;
 				docollide.psb[1] = this;
+				buffer = &psb->m_contactBuffers[ib];
+				begin = buffer->m_scontacts.size();
+				docollide.m_contacts = &buffer->m_scontacts;
 				docollide.psb[0]->m_ndbvt.collideTT(docollide.psb[0]->m_ndbvt.m_root,
 													docollide.psb[1]->m_fdbvt.m_root,
 													docollide);
+				btPushContactChunk(buffer->m_schunks, ib, begin, buffer->m_scontacts.size(), this, -1, -1);
 			}
 		}
 		break;
 		case fCollision::VF_DD:
 		{
 			if (!psb->m_softSoftCollision)
-				return;
+				break;
 			if (psb->isActive() || this->isActive())
 			{
 				if (this != psb)
@@ -4262,6 +5137,8 @@ void btSoftBody::defaultCollisionHandler(btSoftBody* psb)
 		{
 		}
 	}
+	if (mode != fCollision::VF_SS)
+		btUnlockSoftBodies(this, plocked);
 }
 
 void btSoftBody::geometricCollisionHandler(btSoftBody* psb)
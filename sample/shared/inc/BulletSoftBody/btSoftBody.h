@@ -42,6 +42,7 @@ static unsigned long seed = 243703;
 class btBroadphaseInterface;
 class btDispatcher;
 class btSoftBodySolver;
+class btIParallelForBody;
 
 /* btSoftBodyWorldInfo	*/
 struct btSoftBodyWorldInfo
@@ -757,6 +758,59 @@ public:
 		btScalar radmrg;  // radial margin
 		btScalar updmrg;  // Update margin
 	};
+	/* LinkSoA		*/
+	///Structure-of-arrays copy of the node fields used by the link solver and of the links as node index pairs.
+	///Links are grouped in batches that share no node, so that each batch can be solved 4 links at a time with SIMD
+	///and split across threads (see parallelFor).
+	struct LinkSoA
+	{
+		LinkSoA()
+			: m_serial(0),
+			  m_batched(true),
+			  m_nodeCount(-1),
+			  m_linkCount(-1),
+			  m_nodeBase(0)
+		{
+		}
+		// Rebuild before the next solve (links reordered, rest lengths or constants changed)
+		void invalidate() { m_nodeCount = -1; }
+		btAlignedObjectArray<btScalar> m_x[3];   // Positions (the entry after the last node is a dummy used for padding)
+		btAlignedObjectArray<btScalar> m_q[3];   // Previous step positions
+		btAlignedObjectArray<btScalar> m_v[3];   // Velocities
+		btAlignedObjectArray<btScalar> m_im;     // 1/mass
+		btAlignedObjectArray<int> m_na;          // First node index
+		btAlignedObjectArray<int> m_nb;          // Second node index
+		btAlignedObjectArray<int> m_link;        // Index in m_links, -1 for padding
+		btAlignedObjectArray<btScalar> m_c0;     // (ima+imb)*kLST, copied when built
+		btAlignedObjectArray<btScalar> m_c1;     // rl^2, copied when built
+		btAlignedObjectArray<btScalar> m_c2;     // |gradient|^2/c0
+		btAlignedObjectArray<btScalar> m_c3[3];  // gradient
+		int m_serial;                            // Links before this are in batches padded to 4, links from here on share nodes
+		btAlignedObjectArray<int> m_batches;     // First slot of each non-empty batch, followed by m_serial
+		btAlignedObjectArray<int> m_touched;     // Nodes used by the other solvers (anchors, contacts) in this step
+		bool m_batched;                          // Color links into batches; if false all links are serial in m_links order
+		int m_nodeCount;                         // m_nodes.size() when built
+		int m_linkCount;                         // m_links.size() when built
+		const Node* m_nodeBase;                  // &m_nodes[0] when built
+	};
+	/* ContactBuffer	*/
+	///Rigid and soft contacts found by the collision handlers on one thread (see defaultCollisionHandler).
+	///Each handler call appends its contacts as a chunk keyed by the other object, and mergeContacts moves the chunks of all
+	///threads to m_rcontacts/m_scontacts in key order, so the contact order does not depend on the dispatcher or the thread count.
+	struct ContactBuffer
+	{
+		struct Chunk
+		{
+			int m_key[3];  // World array index, part id and child index of the other object
+			int m_buffer;  // Index in m_contactBuffers
+			int m_begin;   // First contact
+			int m_end;     // One past the last contact
+		};
+		btAlignedObjectArray<RContact> m_rcontacts;
+		btAlignedObjectArray<SContact> m_scontacts;
+		btAlignedObjectArray<Chunk> m_rchunks;
+		btAlignedObjectArray<Chunk> m_schunks;
+	};
 	/// RayFromToCaster takes a ray from, ray to (instead of direction!)
 	struct RayFromToCaster : btDbvt::ICollide
 	{
@@ -827,6 +881,8 @@ public:
 	btAlignedObjectArray<DeformableFaceRigidContact> m_faceRigidContacts;
 	btAlignedObjectArray<DeformableFaceNodeContact> m_faceNodeContactsCCD;
 	tSContactArray m_scontacts;     // Soft contacts
+	btAlignedObjectArray<ContactBuffer> m_contactBuffers;  // Contacts not merged yet, one buffer per thread
+	btSpinMutex m_collisionMutex;   // Held by the collision handlers that write to this body
 	tJointArray m_joints;           // Joints
 	tMaterialArray m_materials;     // Materials
 	btScalar m_timeacc;             // Time accumulator
@@ -851,6 +907,8 @@ public:
 	btAlignedObjectArray<btScalar> m_z;  // vertical distance used in extrapolation
 	bool m_useSelfCollision;
 	bool m_softSoftCollision;
+	bool m_useLinkSoA;   // Solve links on the structure-of-arrays copy (see setLinkSoA)
+	LinkSoA m_linkSoA;  // Structure-of-arrays node/link data
 
 	btAlignedObjectArray<bool> m_clusterConnectivity;  //cluster connectivity, for self-collision
 
@@ -1098,8 +1156,24 @@ public:
 	/* defaultCollisionHandlers												*/
 	void defaultCollisionHandler(const btCollisionObjectWrapper* pcoWrap);
 	void defaultCollisionHandler(btSoftBody* psb);
+	///Move the contacts found by the collision handlers since the last call to m_rcontacts and m_scontacts.
+	///The SDF_RS and VF_SS handlers may run concurrently (btCollisionDispatcherMt) and write to per-thread buffers,
+	///the other modes are processed one pair at a time.
+	void mergeContacts();
 	void setSelfCollision(bool useSelfCollision);
 	bool useSelfCollision();
+	///Solve links with the structure-of-arrays storage and SIMD batches (for large cloth and ropes).
+	///Links are solved in a different order than m_links, so results are not bit-identical to the default solver.
+	///The copy is rebuilt when nodes or links are added or by the methods that change links (updateConstants, randomizeConstraints, cutLink...);
+	///call m_linkSoA.invalidate() after editing m_links directly.
+	///With batched false the links are solved one by one in m_links order with the same arithmetic as the default solver,
+	///which gives bit-identical results (for checking the SoA copy and its synchronization with m_nodes).
+	void setLinkSoA(bool useLinkSoA, bool batched = true);
+	bool useLinkSoA();
+	///Run body over [iBegin,iEnd) with btParallelFor when Bullet is built with BT_THREADSAFE, the task scheduler has more
+	///than one thread and the range is larger than grainSize; otherwise run it on the calling thread.
+	///Used for the node, face and link batch loops, which write disjoint data so the results do not depend on the split.
+	static void parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body);
 	void updateDeactivation(btScalar timeStep);
 	void setZeroVelocity();
 	bool wantsSleeping();
@@ -1218,6 +1292,11 @@ public:
 	static void PSolve_SContacts(btSoftBody* psb, btScalar, btScalar ti);
 	static void PSolve_Links(btSoftBody* psb, btScalar kst, btScalar ti);
 	static void VSolve_Links(btSoftBody* psb, btScalar kst);
+	static void PSolve_LinksSoA(btSoftBody* psb, btScalar kst, btScalar ti);
+	static void VSolve_LinksSoA(btSoftBody* psb, btScalar kst);
+	void buildLinkSoA();
+	void solveConstraintsSoA();
+	void syncLinkSoA(bool toNodes);
 	static psolver_t getSolver(ePSolver::_ solver);
 	static vsolver_t getSolver(eVSolver::_ solver);
 	void geometricCollisionHandler(btSoftBody* psb);
@@ -1601,6 +1601,17 @@ struct btSoftColliders
 		}
 	};
 	//
+	// CollectNodes
+	//
+	struct CollectNodes : btDbvt::ICollide
+	{
+		void Process(const btDbvtNode* leaf)
+		{
+			nodes->push_back((btSoftBody::Node*)leaf->data);
+		}
+		btAlignedObjectArray<btSoftBody::Node*>* nodes;
+	};
+	//
 	// CollideSDF_RS
 	//
 	struct CollideSDF_RS : btDbvt::ICollide
@@ -1639,13 +1650,14 @@ struct btSoftColliders
 					c.m_c2 = ima * psb->m_sst.sdt;
 					c.m_c3 = fv.length2() < (dn * fc * dn * fc) ? 0 : 1 - fc;
 					c.m_c4 = m_colObj1Wrap->getCollisionObject()->isStaticOrKinematicObject() ? psb->m_cfg.kKHR : psb->m_cfg.kCHR;
-					psb->m_rcontacts.push_back(c);
+					m_contacts->push_back(c);
 					if (m_rigidBody)
 						m_rigidBody->activate();
 				}
 			}
 		}
 		btSoftBody* psb;
+		btSoftBody::tRContactArray* m_contacts;  // Contact buffer of the calling thread
 		const btCollisionObjectWrapper* m_colObj1Wrap;
 		btRigidBody* m_rigidBody;
 		btScalar dynmargin;
@@ -1913,11 +1925,12 @@ struct btSoftColliders
 					c.m_friction = btMax(psb[0]->m_cfg.kDF, psb[1]->m_cfg.kDF);
 					c.m_cfm[0] = ma / ms * psb[0]->m_cfg.kSHR;
 					c.m_cfm[1] = mb / ms * psb[1]->m_cfg.kSHR;
-					psb[0]->m_scontacts.push_back(c);
+					m_contacts->push_back(c);
 				}
 			}
 		}
 		btSoftBody* psb[2];
+		btSoftBody::tSContactArray* m_contacts;  // Contact buffer of psb[0] for the calling thread
 		btScalar mrg;
 	};
 
@@ -77,6 +77,9 @@ void btSoftMultiBodyDynamicsWorld::predictUnconstraintMotion(btScalar timeStep)
 
 void btSoftMultiBodyDynamicsWorld::internalSingleStepSimulation(btScalar timeStep)
 {
+	// Free the SDF cells evicted by the memory budget in the last step (GarbageCollect is left to the caller)
+	m_sbi.m_sparsesdf.ReleaseEvicted();
+
 	// Let the solver grab the soft bodies and if necessary optimize for it
 	m_softBodySolver->optimize(getSoftBodyArray());
 
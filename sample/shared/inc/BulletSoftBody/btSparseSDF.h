@@ -19,6 +19,16 @@ subject to the following restrictions:
 
 #include "BulletCollision/CollisionDispatch/btCollisionObject.h"
 #include "BulletCollision/NarrowPhaseCollision/btGjkEpa2.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
+
+#if BT_THREADSAFE
+// Cells are looked up without a lock (see btSparseSdf), C++11 atomics order the loads after the stores that publish them
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+#include <atomic>
+#define BT_SPARSE_SDF_ATOMICS 1
+#endif
+#endif  //BT_THREADSAFE
 
 // Fast Hash
 
@@ -54,6 +64,13 @@ inline unsigned int HsiehHash(const char* data, int len)
 	return hash;
 }
 
+///Cache of signed distance cells, shared by the soft bodies of a world.
+///Cells are built lazily (or ahead of the queries by Prefetch) and kept in least recently used order; when the cache
+///holds m_clampCells cells the least recently used one is evicted, so the number of cells never exceeds the budget.
+///Evaluate and Prefetch may be called from several threads. A lookup that finds its cell takes no lock: the buckets
+///are read with acquire loads, evicted cells are only unlinked, and the uses are recorded in per thread lists.
+///ReleaseEvicted (or GarbageCollect) moves the used cells to the front of the LRU list and frees the evicted cells;
+///it and the other methods that change the cache must not run at the same time as Evaluate or Prefetch.
 template <const int CELLSIZE>
 struct btSparseSdf
 {
@@ -70,10 +87,49 @@ struct btSparseSdf
 	{
 		btScalar d[CELLSIZE + 1][CELLSIZE + 1][CELLSIZE + 1];
 		int c[3];
-		int puid;
+		int puid;      // GarbageCollect period of the last use
+		int stamp;     // ReleaseEvicted period of the last use (written by Evaluate without a lock)
 		unsigned hash;
+		bool evicted;  // Unlinked, freed by the next ReleaseEvicted
 		const btCollisionShape* pclient;
 		Cell* next;
+		Cell* lprev;  // More recently used cell
+		Cell* lnext;  // Less recently used cell, or next evicted cell
+	};
+	struct Stats
+	{
+		int hits;        // Evaluate found the cell
+		int misses;      // Evaluate had to build the cell
+		int prefetched;  // Cells built by Prefetch
+		int evictions;   // Cells freed by the budget or by GarbageCollect
+		int cells;       // Cells in the cache
+		size_t bytes;    // Memory used by the cells
+	};
+	struct ThreadData
+	{
+		btAlignedObjectArray<Cell*> touched;  // Cells used since the last ReleaseEvicted
+		int hits;
+		int misses;
+		int prefetched;
+		int nprobes;
+		int nqueries;
+		char pad[64];  // Keep the counters of two threads on different cache lines
+	};
+	struct BuildCellsTask : public btIParallelForBody
+	{
+		btSparseSdf* sdf;
+		Cell* const* pcells;
+		void forLoop(int iBegin, int iEnd) const
+		{
+			for (int i = iBegin; i < iEnd; ++i)
+			{
+				sdf->BuildCell(*pcells[i]);
+			}
+		}
+	};
+	enum
+	{
+		NUMSHARDS = 64  // Locks for the insertion into the hash buckets
 	};
 	//
 	// Fields
@@ -87,7 +143,18 @@ struct btSparseSdf
 	int m_clampCells;
 	int nprobes;
 	int nqueries;
+	int m_stamp;
+	Cell* m_lruHead;                         // Most recently used cell
+	Cell* m_lruTail;                         // Least recently used cell
+	Cell* m_evicted;                         // Cells evicted since the last ReleaseEvicted
+	Stats m_stats;                           // Evictions since the last GarbageCollect
+	btAlignedObjectArray<ThreadData> m_threads;  // Lookups since the last GarbageCollect, per thread
+	btSpinMutex m_shards[NUMSHARDS];         // Bucket i is changed under m_shards[i % NUMSHARDS]
+	btSpinMutex m_mutex;                     // LRU list, cell count and evicted cells
 
+	btSparseSdf() : m_lruHead(0), m_lruTail(0), m_evicted(0)
+	{
+	}
 	~btSparseSdf()
 	{
 		Reset();
@@ -100,9 +167,14 @@ struct btSparseSdf
 	void Initialize(int hashsize = 2383, int clampCells = 256 * 1024)
 	{
 		//avoid a crash due to running out of memory, so clamp the maximum number of cells allocated
-		//if this limit is reached, the SDF is reset (at the cost of some performance during the reset)
+		//if this limit is reached, the least recently used cells are freed
 		m_clampCells = clampCells;
 		cells.resize(hashsize, 0);
+#if BT_THREADSAFE
+		m_threads.resize(BT_MAX_THREAD_COUNT);
+#else
+		m_threads.resize(1);
+#endif
 		m_defaultVoxelsz = 0.25;
 		Reset();
 	}
@@ -113,6 +185,38 @@ struct btSparseSdf
 		m_defaultVoxelsz = sz;
 	}
 
+	///Limit the memory used by the cells (about 300 bytes per cell with the default CELLSIZE)
+	void setMemoryBudget(size_t bytes)
+	{
+		btMutexLock(&m_mutex);
+		m_clampCells = btMax(1, int(bytes / sizeof(Cell)));
+		MergeTouched();
+		while (ncells > m_clampCells)
+		{
+			Evict(m_lruTail);
+		}
+		FreeEvicted();
+		btMutexUnlock(&m_mutex);
+	}
+
+	///Counters since the last GarbageCollect, for profiling
+	Stats getStats()
+	{
+		btMutexLock(&m_mutex);
+		Stats stats = m_stats;
+		for (int i = 0; i < m_threads.size(); ++i)
+		{
+			const ThreadData& td = m_threads[i];
+			stats.hits += td.hits;
+			stats.misses += td.misses;
+			stats.prefetched += td.prefetched;
+		}
+		stats.cells = ncells;
+		stats.bytes = size_t(ncells) * sizeof(Cell);
+		btMutexUnlock(&m_mutex);
+		return (stats);
+	}
+
 	void Reset()
 	{
 		for (int i = 0, ni = cells.size(); i < ni; ++i)
@@ -126,72 +230,121 @@ struct btSparseSdf
 				pc = pn;
 			}
 		}
+		for (int i = 0; i < m_threads.size(); ++i)
+		{
+			m_threads[i].touched.resize(0);
+		}
+		FreeEvicted();
 		voxelsz = m_defaultVoxelsz;
 		puid = 0;
+		m_stamp = 0;
 		ncells = 0;
 		nprobes = 1;
 		nqueries = 1;
+		m_lruHead = m_lruTail = 0;
+		ResetStats();
 	}
 	//
 	void GarbageCollect(int lifetime = 256)
 	{
+		/* Cells not used for lifetime calls are at the end of the LRU list	*/
 		const int life = puid - lifetime;
-		for (int i = 0; i < cells.size(); ++i)
+		btMutexLock(&m_mutex);
+		MergeTouched();
+		while (m_lruTail && m_lruTail->puid < life)
 		{
-			Cell*& root = cells[i];
-			Cell* pp = 0;
-			Cell* pc = root;
-			while (pc)
-			{
-				Cell* pn = pc->next;
-				if (pc->puid < life)
-				{
-					if (pp)
-						pp->next = pn;
-					else
-						root = pn;
-					delete pc;
-					pc = pp;
-					--ncells;
-				}
-				pp = pc;
-				pc = pn;
-			}
+			Evict(m_lruTail);
+		}
+		FreeEvicted();
+		for (int i = 0; i < m_threads.size(); ++i)
+		{
+			nprobes += m_threads[i].nprobes;
+			nqueries += m_threads[i].nqueries;
 		}
 		//printf("GC[%d]: %d cells, PpQ: %f\r\n",puid,ncells,nprobes/(btScalar)nqueries);
 		nqueries = 1;
 		nprobes = 1;
+		ResetStats();
 		++puid;  ///@todo: Reset puid's when int range limit is reached	*/
-		/* else setup a priority list...						*/
+		btMutexUnlock(&m_mutex);
+	}
+	///Move the cells used since the last call to the front of the LRU list and free the evicted cells.
+	///Call it between collision passes; the soft body worlds call it once per step and GarbageCollect does it too.
+	void ReleaseEvicted()
+	{
+		btMutexLock(&m_mutex);
+		MergeTouched();
+		FreeEvicted();
+		btMutexUnlock(&m_mutex);
 	}
 	//
 	int RemoveReferences(btCollisionShape* pcs)
 	{
 		int refcount = 0;
-		for (int i = 0; i < cells.size(); ++i)
+		btMutexLock(&m_mutex);
+		Cell* pc = m_lruHead;
+		while (pc)
 		{
-			Cell*& root = cells[i];
-			Cell* pp = 0;
-			Cell* pc = root;
-			while (pc)
+			Cell* pn = pc->lnext;
+			if (pc->pclient == pcs)
 			{
-				Cell* pn = pc->next;
-				if (pc->pclient == pcs)
-				{
-					if (pp)
-						pp->next = pn;
-					else
-						root = pn;
-					delete pc;
-					pc = pp;
-					++refcount;
-				}
-				pp = pc;
-				pc = pn;
+				Retire(pc);
+				++refcount;
 			}
+			pc = pn;
 		}
+		MergeTouched();
+		FreeEvicted();
+		btMutexUnlock(&m_mutex);
 		return (refcount);
 	}
+	///Build the missing cells that contain the points x (in the local space of shape), on the task scheduler threads.
+	///The soft body collision handlers call this with the nodes inside the collider bounds before testing them,
+	///so that Evaluate finds the cells instead of building them one at a time.
+	void Prefetch(const btCollisionShape* shape, const btVector3* x, int count)
+	{
+		BT_PROFILE("btSparseSdf::Prefetch");
+		ThreadData& td = m_threads[ThreadIndex()];
+		btAlignedObjectArray<Cell*> missing;
+		int i, j;
+		for (i = 0; i < count; ++i)
+		{
+			const btVector3 scx = x[i] / voxelsz;
+			const int cx = Decompose(scx.x()).b;
+			const int cy = Decompose(scx.y()).b;
+			const int cz = Decompose(scx.z()).b;
+			const unsigned h = Hash(cx, cy, cz, shape);
+			if (Find(h, cx, cy, cz, shape, td.nprobes))
+				continue;
+			/* Neighbouring points are usually in the same cell	*/
+			for (j = missing.size() - 1; j >= 0; --j)
+			{
+				const Cell* c = missing[j];
+				if ((c->hash == h) && (c->c[0] == cx) && (c->c[1] == cy) && (c->c[2] == cz))
+					break;
+			}
+			if (j < 0)
+				missing.push_back(NewCell(h, cx, cy, cz, shape));
+		}
+		if (missing.size() == 0)
+			return;
+		BuildCellsTask task;
+		task.sdf = this;
+		task.pcells = &missing[0];
+#if BT_THREADSAFE
+		btITaskScheduler* scheduler = btGetTaskScheduler();
+		if (scheduler && scheduler->getNumThreads() > 1 && missing.size() > 1)
+			btParallelFor(0, missing.size(), 1, task);
+		else
+#endif  //BT_THREADSAFE
+			task.forLoop(0, missing.size());
+		for (i = 0; i < missing.size(); ++i)
+		{
+			/* Another thread may have built the same cell meanwhile	*/
+			if (Insert(missing[i]) == missing[i])
+				++td.prefetched;
+		}
+	}
 	//
 	btScalar Evaluate(const btVector3& x,
 					  const btCollisionShape* shape,
@@ -204,53 +357,23 @@ struct btSparseSdf
 		const IntFrac iy = Decompose(scx.y());
 		const IntFrac iz = Decompose(scx.z());
 		const unsigned h = Hash(ix.b, iy.b, iz.b, shape);
-		Cell*& root = cells[static_cast<int>(h % cells.size())];
-		Cell* c = root;
-		++nqueries;
-		while (c)
+		ThreadData& td = m_threads[ThreadIndex()];
+		++td.nqueries;
+		Cell* c = Find(h, ix.b, iy.b, iz.b, shape, td.nprobes);
+		if (c)
 		{
-			++nprobes;
-			if ((c->hash == h) &&
-				(c->c[0] == ix.b) &&
-				(c->c[1] == iy.b) &&
-				(c->c[2] == iz.b) &&
-				(c->pclient == shape))
-			{
-				break;
-			}
-			else
-			{
-				// printf("c->hash/c[0][1][2]=%d,%d,%d,%d\n", c->hash, c->c[0], c->c[1],c->c[2]);
-				//printf("h,ixb,iyb,izb=%d,%d,%d,%d\n", h,ix.b, iy.b, iz.b);
-
-				c = c->next;
-			}
+			++td.hits;
 		}
-		if (!c)
+		else
 		{
-			++nprobes;
-			++ncells;
-			//int sz = sizeof(Cell);
-			if (ncells > m_clampCells)
-			{
-				//static int numResets = 0;
-				//numResets++;
-				//printf("numResets=%d\n",numResets);
-				Reset();
-			}
-
-			c = new Cell();
-			c->next = root;
-			root = c;
-			c->pclient = shape;
-			c->hash = h;
-			c->c[0] = ix.b;
-			c->c[1] = iy.b;
-			c->c[2] = iz.b;
-			BuildCell(*c);
+			/* Build the cell without a lock, then insert it unless another thread did	*/
+			Cell* nc = NewCell(h, ix.b, iy.b, iz.b, shape);
+			BuildCell(*nc);
+			++td.misses;
+			c = Insert(nc);
 		}
-		c->puid = puid;
-		/* Extract infos		*/
+		Touch(c, td);
+		/* Extract infos (an evicted cell is not freed before ReleaseEvicted)	*/
 		const int o[] = {ix.i, iy.i, iz.i};
 		const btScalar d[] = {c->d[o[0] + 0][o[1] + 0][o[2] + 0],
 							  c->d[o[0] + 1][o[1] + 0][o[2] + 0],
@@ -286,6 +409,206 @@ struct btSparseSdf
 		return (Lerp(d0, d1, iz.f) - margin);
 	}
 	//
+	Cell* NewCell(unsigned h, int x, int y, int z, const btCollisionShape* shape) const
+	{
+		Cell* c = new Cell();
+		c->pclient = shape;
+		c->hash = h;
+		c->c[0] = x;
+		c->c[1] = y;
+		c->c[2] = z;
+		c->evicted = false;
+		c->next = c->lprev = c->lnext = 0;
+		return (c);
+	}
+	/* Lock free: cells are published with a release store after they are built	*/
+	Cell* Find(unsigned h, int x, int y, int z, const btCollisionShape* shape, int& probes) const
+	{
+		Cell* c = Load(&cells[static_cast<int>(h % cells.size())]);
+		while (c)
+		{
+			++probes;
+			if ((c->hash == h) &&
+				(c->c[0] == x) &&
+				(c->c[1] == y) &&
+				(c->c[2] == z) &&
+				(c->pclient == shape))
+			{
+				break;
+			}
+			c = Load(&c->next);
+		}
+		return (c);
+	}
+	/* Add a built cell unless another thread added the same one first, and return the cell in the cache	*/
+	Cell* Insert(Cell* c)
+	{
+		const int i = static_cast<int>(c->hash % cells.size());
+		btSpinMutex& shard = m_shards[i % NUMSHARDS];
+		int probes = 0;
+		btMutexLock(&shard);
+		Cell* pc = Find(c->hash, c->c[0], c->c[1], c->c[2], c->pclient, probes);
+		if (pc)
+		{
+			btMutexUnlock(&shard);
+			delete c;
+			return (pc);
+		}
+		c->puid = puid;
+		c->stamp = m_stamp;
+		c->next = cells[i];
+		Store(&cells[i], c);
+		btMutexUnlock(&shard);
+		btMutexLock(&m_mutex);
+		c->lprev = 0;
+		c->lnext = m_lruHead;
+		if (m_lruHead)
+			m_lruHead->lprev = c;
+		else
+			m_lruTail = c;
+		m_lruHead = c;
+		++ncells;
+		while (ncells > m_clampCells)
+		{
+			Evict(m_lruTail);
+		}
+		btMutexUnlock(&m_mutex);
+		return (c);
+	}
+	/* Record the first use of a cell since the last ReleaseEvicted	*/
+	void Touch(Cell* c, ThreadData& td)
+	{
+		if (Load(&c->stamp) == m_stamp)
+			return;
+		Store(&c->stamp, m_stamp);
+		td.touched.push_back(c);
+	}
+	/* Move the recorded cells to the front of the LRU list (m_mutex held)	*/
+	void MergeTouched()
+	{
+		for (int i = 0; i < m_threads.size(); ++i)
+		{
+			btAlignedObjectArray<Cell*>& touched = m_threads[i].touched;
+			for (int j = 0, nj = touched.size(); j < nj; ++j)
+			{
+				Cell* c = touched[j];
+				if (c->evicted)
+					continue;
+				c->puid = puid;
+				if (c == m_lruHead)
+					continue;
+				c->lprev->lnext = c->lnext;
+				if (c->lnext)
+					c->lnext->lprev = c->lprev;
+				else
+					m_lruTail = c->lprev;
+				c->lprev = 0;
+				c->lnext = m_lruHead;
+				m_lruHead->lprev = c;
+				m_lruHead = c;
+			}
+			touched.resize(0);
+		}
+		++m_stamp;
+	}
+	/* Remove from the hash and the LRU list (m_mutex held)	*/
+	void Unlink(Cell* c)
+	{
+		const int i = static_cast<int>(c->hash % cells.size());
+		btSpinMutex& shard = m_shards[i % NUMSHARDS];
+		btMutexLock(&shard);
+		Cell** pp = &cells[i];
+		while (*pp != c)
+		{
+			pp = &(*pp)->next;
+		}
+		/* A lookup that is at c can still follow c->next	*/
+		Store(pp, c->next);
+		btMutexUnlock(&shard);
+		if (c->lprev)
+			c->lprev->lnext = c->lnext;
+		else
+			m_lruHead = c->lnext;
+		if (c->lnext)
+			c->lnext->lprev = c->lprev;
+		else
+			m_lruTail = c->lprev;
+		--ncells;
+	}
+	/* Unlink now, free at the next ReleaseEvicted (other threads may be reading the cell)	*/
+	void Retire(Cell* c)
+	{
+		Unlink(c);
+		c->evicted = true;
+		c->lprev = 0;
+		c->lnext = m_evicted;
+		m_evicted = c;
+	}
+	//
+	void Evict(Cell* c)
+	{
+		Retire(c);
+		++m_stats.evictions;
+	}
+	//
+	void FreeEvicted()
+	{
+		while (m_evicted)
+		{
+			Cell* pn = m_evicted->lnext;
+			delete m_evicted;
+			m_evicted = pn;
+		}
+	}
+	//
+	void ResetStats()
+	{
+		m_stats.hits = 0;
+		m_stats.misses = 0;
+		m_stats.prefetched = 0;
+		m_stats.evictions = 0;
+		m_stats.cells = 0;
+		m_stats.bytes = 0;
+		for (int i = 0; i < m_threads.size(); ++i)
+		{
+			ThreadData& td = m_threads[i];
+			td.hits = 0;
+			td.misses = 0;
+			td.prefetched = 0;
+			td.nprobes = 0;
+			td.nqueries = 0;
+		}
+	}
+	//
+	static inline int ThreadIndex()
+	{
+#if BT_THREADSAFE
+		return int(btGetCurrentThreadIndex());
+#else
+		return 0;
+#endif
+	}
+	//
+	template <class T>
+	static inline T Load(const T* p)
+	{
+#if BT_SPARSE_SDF_ATOMICS
+		return reinterpret_cast<const std::atomic<T>*>(p)->load(std::memory_order_acquire);
+#else
+		return *p;
+#endif
+	}
+	//
+	template <class T>
+	static inline void Store(T* p, T v)
+	{
+#if BT_SPARSE_SDF_ATOMICS
+		reinterpret_cast<std::atomic<T>*>(p)->store(v, std::memory_order_release);
+#else
+		*p = v;
+#endif
+	}
+	//
 	void BuildCell(Cell& c)
 	{
 		const btVector3 org = btVector3((btScalar)c.c[0],
@@ -25,7 +25,8 @@ int gTotalBytesAlignedAllocs = 0;  //detect memory leaks
 static void *btAllocDefault(size_t size)
 {
   char* data = (char*) malloc(size);
-  memset(data,0,size);//keep msan happy
+  if (data)
+    memset(data,0,size);//keep msan happy
   return data;
 }
 
@@ -66,18 +67,20 @@ static inline void *btAlignedAllocDefault(size_t size, int alignment)
 {
 	void *ret;
 	char *real;
+	// btAlignPointer only works for powers of two; the original pointer is stored in front of the aligned block
+	btAssert(alignment > 0 && (alignment & (alignment - 1)) == 0);
 	real = (char *)sAllocFunc(size + sizeof(void *) + (alignment - 1));
 	if (real)
 	{
 		ret = btAlignPointer(real + sizeof(void *), alignment);
 		*((void **)(ret)-1) = (void *)(real);
+		//keep msan happy
+		memset((char *)ret, 0, size);
 	}
 	else
 	{
 		ret = (void *)(real);
 	}
-  //keep msan happy
-  memset((char*) ret, 0, size);
 	return (ret);
 }
 
@@ -7,11 +7,15 @@
 #include <string.h>  //memset
 #ifdef USE_SIMD
 #include <emmintrin.h>
-#ifdef BT_ALLOW_SSE4
+#if defined(BT_ALLOW_SSE4) && defined(_MSC_VER)
 #include <intrin.h>
 #endif  //BT_ALLOW_SSE4
 #endif  //USE_SIMD
 
+#if defined(BT_ALLOW_SSE4) && !defined(_MSC_VER)
+#include <cpuid.h>  //__get_cpuid
+#endif
+
 #if defined BT_USE_NEON
 #define ARM_NEON_GCC_COMPATIBILITY 1
 #include <arm_neon.h>
@@ -55,14 +59,34 @@ public:
 			int cpuInfo[4];
 			memset(cpuInfo, 0, sizeof(cpuInfo));
 			unsigned long long sseExt = 0;
+#ifdef _MSC_VER
 			__cpuid(cpuInfo, 1);
+#else
+			unsigned int eax, ebx, ecx, edx;
+			if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+			{
+				cpuInfo[0] = (int)eax;
+				cpuInfo[1] = (int)ebx;
+				cpuInfo[2] = (int)ecx;
+				cpuInfo[3] = (int)edx;
+			}
+#endif  //_MSC_VER
 
 			bool osUsesXSAVE_XRSTORE = cpuInfo[2] & (1 << 27) || false;
 			bool cpuAVXSuport = cpuInfo[2] & (1 << 28) || false;
 
 			if (osUsesXSAVE_XRSTORE && cpuAVXSuport)
 			{
+#ifdef _MSC_VER
 				sseExt = _xgetbv(0);
+#else
+				// _xgetbv needs -mxsave with GCC, so read XCR0 directly
+				unsigned int xcr0Lo, xcr0Hi;
+				__asm__ __volatile__("xgetbv"
+									 : "=a"(xcr0Lo), "=d"(xcr0Hi)
+									 : "c"(0));
+				sseExt = ((unsigned long long)xcr0Hi << 32) | xcr0Lo;
+#endif  //_MSC_VER
 			}
 			const int OSXSAVEFlag = (1UL << 27);
 			const int AVXFlag = ((1UL << 28) | OSXSAVEFlag);
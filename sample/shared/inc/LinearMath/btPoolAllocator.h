@@ -18,8 +18,11 @@ subject to the following restrictions:
 #include "btScalar.h"
 #include "btAlignedAllocator.h"
 #include "btThreads.h"
+#include "btAlignedObjectArray.h"
 
 ///The btPoolAllocator class allows to efficiently allocate a large pool of objects, instead of dynamically allocating them separately.
+///A growable pool adds another chunk of maxElements objects when it runs out, instead of returning NULL (which makes the caller fall back to btAlignedAlloc).
+///Chunks are kept until the pool is destroyed, so the pool settles at its high-water mark and stops allocating.
 class btPoolAllocator
 {
 	int m_elemSize;
@@ -28,28 +31,54 @@ class btPoolAllocator
 	void* m_firstFree;
 	unsigned char* m_pool;
 	btSpinMutex m_mutex;  // only used if BT_THREADSAFE
+	int m_chunkElements;
+	bool m_growable;
+	int m_highWaterCount;
+	int m_failedCount;
+	btAlignedObjectArray<unsigned char*> m_chunks;  // chunks added after m_pool
 
-public:
-	btPoolAllocator(int elemSize, int maxElements)
-		: m_elemSize(elemSize),
-		  m_maxElements(maxElements)
+	unsigned char* allocateChunk()
 	{
-		m_pool = (unsigned char*)btAlignedAlloc(static_cast<unsigned int>(m_elemSize * m_maxElements), 16);
+		unsigned char* chunk = (unsigned char*)btAlignedAlloc(static_cast<unsigned int>(m_elemSize * m_chunkElements), 16);
 
-		unsigned char* p = m_pool;
-		m_firstFree = p;
-		m_freeCount = m_maxElements;
-		int count = m_maxElements;
+		unsigned char* p = chunk;
+		int count = m_chunkElements;
 		while (--count)
 		{
 			*(void**)p = (p + m_elemSize);
 			p += m_elemSize;
 		}
-		*(void**)p = 0;
+		*(void**)p = m_firstFree;
+		m_firstFree = chunk;
+		m_freeCount += m_chunkElements;
+		return chunk;
+	}
+
+	bool inChunk(const unsigned char* chunk, const void* ptr) const
+	{
+		return (const unsigned char*)ptr >= chunk && (const unsigned char*)ptr < chunk + m_chunkElements * m_elemSize;
+	}
+
+public:
+	btPoolAllocator(int elemSize, int maxElements, bool growable = false)
+		: m_elemSize(elemSize),
+		  m_maxElements(maxElements),
+		  m_freeCount(0),
+		  m_firstFree(0),
+		  m_chunkElements(maxElements),
+		  m_growable(growable),
+		  m_highWaterCount(0),
+		  m_failedCount(0)
+	{
+		m_pool = allocateChunk();
 	}
 
 	~btPoolAllocator()
 	{
+		for (int i = 0; i < m_chunks.size(); i++)
+		{
+			btAlignedFree(m_chunks[i]);
+		}
 		btAlignedFree(m_pool);
 	}
 
@@ -68,6 +97,33 @@ public:
 		return m_maxElements;
 	}
 
+	///largest number of elements in use at the same time
+	int getHighWaterCount() const
+	{
+		return m_highWaterCount;
+	}
+
+	///number of allocate calls that returned NULL, each of which made the caller fall back to the heap
+	int getFailedCount() const
+	{
+		return m_failedCount;
+	}
+
+	int getChunkCount() const
+	{
+		return 1 + m_chunks.size();
+	}
+
+	bool isGrowable() const
+	{
+		return m_growable;
+	}
+
+	void setGrowable(bool growable)
+	{
+		m_growable = growable;
+	}
+
 	void* allocate(int size)
 	{
 		// release mode fix
@@ -75,11 +131,21 @@ public:
 		btMutexLock(&m_mutex);
 		btAssert(!size || size <= m_elemSize);
 		//btAssert(m_freeCount>0);  // should return null if all full
+		if (NULL == m_firstFree && m_growable)
+		{
+			m_chunks.push_back(allocateChunk());
+			m_maxElements += m_chunkElements;
+		}
 		void* result = m_firstFree;
 		if (NULL != m_firstFree)
 		{
 			m_firstFree = *(void**)m_firstFree;
 			--m_freeCount;
+			m_highWaterCount = btMax(m_highWaterCount, m_maxElements - m_freeCount);
+		}
+		else
+		{
+			++m_failedCount;
 		}
 		btMutexUnlock(&m_mutex);
 		return result;
@@ -89,10 +155,19 @@ public:
 	{
 		if (ptr)
 		{
-			if (((unsigned char*)ptr >= m_pool && (unsigned char*)ptr < m_pool + m_maxElements * m_elemSize))
+			if (inChunk(m_pool, ptr))
 			{
 				return true;
 			}
+			// m_chunks may be growing on another thread
+			bool found = false;
+			btMutexLock(&m_mutex);
+			for (int i = 0; i < m_chunks.size() && !found; i++)
+			{
+				found = inChunk(m_chunks[i], ptr);
+			}
+			btMutexUnlock(&m_mutex);
+			return found;
 		}
 		return false;
 	}
@@ -101,7 +176,7 @@ public:
 	{
 		if (ptr)
 		{
-			btAssert((unsigned char*)ptr >= m_pool && (unsigned char*)ptr < m_pool + m_maxElements * m_elemSize);
+			btAssert(validPtr(ptr));
 
 			btMutexLock(&m_mutex);
 			*(void**)ptr = m_firstFree;
@@ -116,6 +191,7 @@ public:
 		return m_elemSize;
 	}
 
+	///address of the first chunk
 	unsigned char* getPoolAddress()
 	{
 		return m_pool;
@@ -275,6 +275,49 @@ inline int btIsDoublePrecision()
 				#define btLikely(_c)  _c
 				#define btUnlikely(_c) _c
 
+			#elif (defined (__GNUC__) && defined (__x86_64__) && (!defined (BT_USE_DOUBLE_PRECISION)) && (!defined (__BT_DISABLE_SSE__)))
+				//GCC/Clang on x86-64 (Linux etc.): SSE2 is part of the x86-64 baseline, so it is always available
+				//Bullet and the application have to be compiled with the same setting, because it changes the layout of btVector3 etc.
+				//define __BT_DISABLE_SSE__ in the build system to get the scalar version
+				#define BT_USE_SIMD_VECTOR3
+				#define BT_USE_SSE
+				//BT_USE_SSE_IN_API is enabled on x86-64, because malloc and operator new return 16-byte aligned memory there
+				#define BT_USE_SSE_IN_API
+				#if defined (__clang__) || (__GNUC__ >= 5)
+					//the SSE4.1/FMA3 solver kernels are compiled for that target only, see BT_USE_FMA3_RUNTIME_DISPATCH below
+					#define BT_ALLOW_SSE4
+					#define BT_SSE4_FMA3_TARGET __attribute__ ((target ("sse4.1,fma")))
+				#endif
+				// include appropriate SSE level
+				#if defined (__SSE4_1__)
+					#include <smmintrin.h>
+				#elif defined (__SSSE3__)
+					#include <tmmintrin.h>
+				#elif defined (__SSE3__)
+					#include <pmmintrin.h>
+				#else
+					#include <emmintrin.h>
+				#endif
+
+				#define SIMD_FORCE_INLINE inline __attribute__ ((always_inline))
+				#define ATTRIBUTE_ALIGNED16(a) a __attribute__ ((aligned (16)))
+				#define ATTRIBUTE_ALIGNED64(a) a __attribute__ ((aligned (64)))
+				#define ATTRIBUTE_ALIGNED128(a) a __attribute__ ((aligned (128)))
+				#ifndef assert
+				#include <assert.h>
+				#endif
+
+				#if defined(DEBUG) || defined (_DEBUG)
+					#define btAssert assert
+				#else
+					#define btAssert(x)
+				#endif
+
+				//btFullAssert is optional, slows down a lot
+				#define btFullAssert(x)
+				#define btLikely(_c)  _c
+				#define btUnlikely(_c) _c
+
 			#else//__APPLE__
 
 				#define SIMD_FORCE_INLINE inline
@@ -304,6 +347,14 @@ inline int btIsDoublePrecision()
 	#endif	//__CELLOS_LV2__
 #endif//_WIN32
 
+///Compilers that need a per-function target to emit SSE4.1/FMA3 code (GCC/Clang) define this above
+#ifndef BT_SSE4_FMA3_TARGET
+#define BT_SSE4_FMA3_TARGET
+#endif
+
+///The SSE4.1/FMA3 solver kernels round differently from the SSE2 ones, so choosing them from the CPU at runtime (btCpuFeatureUtility)
+///makes the results depend on the machine. The solver only does so when the build system defines BT_USE_FMA3_RUNTIME_DISPATCH
+
 
 ///The btScalar type abstracts floating point numbers, to easily switch between double and single floating point precision.
 #if defined(BT_USE_DOUBLE_PRECISION)
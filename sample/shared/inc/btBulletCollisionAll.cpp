@@ -1,12 +1,16 @@
 #include "BulletCollision/BroadphaseCollision/btAxisSweep3.cpp"
 #include "BulletCollision/BroadphaseCollision/btDbvt.cpp"
 #include "BulletCollision/BroadphaseCollision/btOverlappingPairCache.cpp"
+#include "BulletCollision/BroadphaseCollision/btOpenAddressingPairCache.cpp"
 #include "BulletCollision/BroadphaseCollision/btBroadphaseProxy.cpp"
 #include "BulletCollision/BroadphaseCollision/btDbvtBroadphase.cpp"
 #include "BulletCollision/BroadphaseCollision/btQuantizedBvh.cpp"
+#include "BulletCollision/BroadphaseCollision/btQuantizedBvh4.cpp"
 #include "BulletCollision/BroadphaseCollision/btCollisionAlgorithm.cpp"
 #include "BulletCollision/BroadphaseCollision/btDispatcher.cpp"
 #include "BulletCollision/BroadphaseCollision/btSimpleBroadphase.cpp"
+#include "BulletCollision/BroadphaseCollision/btSortAndSweepBroadphase.cpp"
+#include "BulletCollision/BroadphaseCollision/btHashedGridBroadphase.cpp"
 #include "BulletCollision/CollisionDispatch/SphereTriangleDetector.cpp"
 #include "BulletCollision/CollisionDispatch/btCompoundCollisionAlgorithm.cpp"
 #include "BulletCollision/CollisionDispatch/btHashedSimplePairCache.cpp"
@@ -53,6 +53,9 @@ subject to the following restrictions:
 #include "BulletCollision/BroadphaseCollision/btSimpleBroadphase.h"
 #include "BulletCollision/BroadphaseCollision/btAxisSweep3.h"
 #include "BulletCollision/BroadphaseCollision/btDbvtBroadphase.h"
+#include "BulletCollision/BroadphaseCollision/btOpenAddressingPairCache.h"
+#include "BulletCollision/BroadphaseCollision/btSortAndSweepBroadphase.h"
+#include "BulletCollision/BroadphaseCollision/btHashedGridBroadphase.h"
 
 ///Math library & Utils
 #include "LinearMath/btQuaternion.h"
@@ -184,6 +184,7 @@ public:
 
 	// 設定ファイル読み込み・書き込み
 	int Load(const string& path);
+	int Load(istream &in);
 	int Save(const string& path = "");
 
 	// 項目リストを指定して設定保存
@@ -284,6 +285,16 @@ inline int rxINI::Load(const string& path)
 
 	m_strPath = path;
 
+	return Load(in);
+}
+
+/*!
+ * ストリームからデータ取得(ファイルの一部だけを設定として読む場合など)
+ * @param[in] in 入力ストリーム
+ * @return 
+ */
+inline int rxINI::Load(istream &in)
+{
 	string buf;
 	string cur_header;
 	string name = "", value = "";
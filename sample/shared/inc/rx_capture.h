@@ -0,0 +1,512 @@
+/*!
+  @file rx_capture.h
+
+  @brief 描画ループを止めない画面キャプチャ(スクリーンショット,連番画像,動画用ストリーム)
+		 - glReadPixelsの読み出し先をピクセルバッファオブジェクト(PBO)のリングにして，
+		   GPUからの転送が終わった数フレーム後にマップしてCPU側へコピーする
+		 - ファイルへの書き出しは専用のスレッドで行う(書き出しが追いつかない場合は描画側が待つのでフレームは落とさない)
+		 - 保存形式は連番BMPのほか，全フレームを1つのファイルに連結したPPM(P6)ストリームとY4M(YUV4MPEG2, 4:4:4)
+		   例) ffmpeg -i capture.y4m -pix_fmt yuv420p capture.mp4
+		       ffmpeg -f image2pipe -c:v ppm -framerate 30 -i capture.ppm -pix_fmt yuv420p capture.mp4
+
+  @author Makoto Fujisawa
+  @date 2026-10
+*/
+// FILE --rx_capture.h--
+
+#ifndef _RX_CAPTURE_H_
+#define _RX_CAPTURE_H_
+
+
+//-----------------------------------------------------------------------------
+// インクルードファイル
+//-----------------------------------------------------------------------------
+#include <cstdio>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// OpenGL
+#include <GL/glew.h>
+
+#include "rx_bitmap.h"
+
+
+//-----------------------------------------------------------------------------
+// 定義
+//-----------------------------------------------------------------------------
+// 連続キャプチャの保存形式
+enum
+{
+	RX_CAPTURE_BMP = 0,	//!< 連番BMP(1フレーム1ファイル)
+	RX_CAPTURE_PPM,		//!< PPM(P6)を連結したストリーム
+	RX_CAPTURE_Y4M,		//!< YUV4MPEG2(4:4:4, BT.601)
+};
+
+
+//-----------------------------------------------------------------------------
+// 画面キャプチャクラス
+//  - Capture以外はOpenGLコンテキストを持つスレッド(描画ループ)から呼ぶ
+//  - 読み出すのはバックバッファなので，バッファのスワップ前(ImGUIなどを描く前)にCaptureを呼ぶ
+//-----------------------------------------------------------------------------
+class rxFrameCapture
+{
+protected:
+	// 書き出しスレッドへのコマンド
+	enum
+	{
+		CMD_FRAME = 0,		//!< 連続キャプチャの1フレーム
+		CMD_SCREENSHOT,		//!< スクリーンショット(BMP)
+		CMD_OPEN,			//!< 連続キャプチャの開始(ストリームを開く)
+		CMD_CLOSE,			//!< 連続キャプチャの終了(ストリームを閉じる)
+	};
+	struct Command
+	{
+		int cmd;
+		int format, fps;				//!< 保存形式とフレームレート(CMD_OPEN)
+		int w, h;						//!< 画像サイズ
+		int repeat;						//!< 同じ画像を書き出す回数(CMD_FRAME)
+		std::string fn;					//!< ファイル名(連番BMPの場合は接頭辞)
+		std::vector<unsigned char> pix;	//!< RGB画素値(下の行から, 行間の詰め物なし)
+	};
+
+	// PBOのリングの要素
+	struct Slot
+	{
+		GLuint pbo;
+		GLsync fence;			//!< 読み出し完了の同期オブジェクト(ARB_syncが使えない場合は0)
+		int size;				//!< PBOの確保サイズ
+		bool busy;				//!< 読み出し中(まだマップしていない)
+		int w, h;
+		int repeat;				//!< 連続キャプチャのフレームとして書き出す回数(0ならスクリーンショットのみ)
+		std::string shot;		//!< スクリーンショットのファイル名(空ならなし)
+	};
+
+	// PBOのリング
+	std::vector<Slot> m_vSlots;
+	int m_iHead, m_iTail, m_iBusy;		//!< 次に書き込むスロット，最も古い読み出し中のスロット，読み出し中のスロット数
+	bool m_bPBO, m_bSync;				//!< PBO/ARB_syncが使えるかどうか
+
+	// 連続キャプチャの状態
+	bool m_bRecording;
+	int m_iFormat, m_iW, m_iH;
+	int m_iFrames;						//!< 書き出しを要求したフレーム数(繰り返し分も含む)
+	std::string m_strShot;				//!< 次のCaptureで保存するスクリーンショットのファイル名
+
+	// 書き出しスレッド
+	std::thread m_Thread;
+	std::mutex m_Mutex;
+	std::condition_variable m_cvWork, m_cvSpace;
+	std::deque<Command> m_dQueue;						//!< 書き出し待ちのコマンド
+	std::vector< std::vector<unsigned char> > m_vPool;	//!< 使い終わった画素バッファ(再利用)
+	size_t m_iMaxQueue;									//!< 書き出し待ちの最大数(超えたら描画側が待つ)
+	bool m_bQuit;
+	std::atomic<int> m_iWritten;						//!< 書き出したフレーム数
+	int m_iStalls;										//!< 書き出しが追いつかずに描画側が待った回数
+
+	// 書き出しスレッド内でのみ使う
+	FILE *m_fpStream;
+	int m_iStreamFormat, m_iStreamFps;
+	int m_iStreamIndex;						//!< 連番BMPの次の番号
+	bool m_bStreamHeader;					//!< Y4Mのヘッダを書き込んだかどうか
+	std::string m_strStreamName;
+	std::vector<unsigned char> m_vConv;		//!< PPM/Y4M用の並べ替え/変換バッファ
+
+public:
+	rxFrameCapture() : m_iHead(0), m_iTail(0), m_iBusy(0), m_bPBO(false), m_bSync(false),
+		m_bRecording(false), m_iFormat(RX_CAPTURE_BMP), m_iW(0), m_iH(0), m_iFrames(0),
+		m_iMaxQueue(32), m_bQuit(false), m_iWritten(0), m_iStalls(0),
+		m_fpStream(0), m_iStreamFormat(RX_CAPTURE_BMP), m_iStreamFps(30), m_iStreamIndex(0), m_bStreamHeader(false) {}
+	~rxFrameCapture(){ stopThread(); }
+
+	/*!
+	 * 初期化(OpenGLの初期化後に呼ぶ)
+	 *  - PBOが使えない環境では読み出しは同期的になるが，ファイルへの書き出しは別スレッドで行う
+	 * @param[in] nbuf PBOの数(読み出しから書き出しまでの遅延フレーム数+1)
+	 * @param[in] max_queue 書き出し待ちの最大フレーム数
+	 */
+	void Init(int nbuf = 3, int max_queue = 32)
+	{
+		m_bPBO = (GLEW_VERSION_2_1 || GLEW_ARB_pixel_buffer_object);
+		m_bSync = m_bPBO && (GLEW_VERSION_3_2 || GLEW_ARB_sync);
+		if(!m_bPBO){
+			std::cout << "pixel buffer objects are not supported, the frame capture reads pixels synchronously" << std::endl;
+		}
+
+		m_vSlots.resize(nbuf < 2 ? 2 : nbuf);
+		for(size_t i = 0; i < m_vSlots.size(); ++i){
+			Slot &s = m_vSlots[i];
+			s.pbo = 0; s.fence = 0; s.size = 0; s.busy = false; s.w = s.h = 0; s.repeat = 0;
+			if(m_bPBO) glGenBuffers(1, &s.pbo);
+		}
+		m_iHead = m_iTail = m_iBusy = 0;
+		m_iMaxQueue = (max_queue < 1 ? 1 : max_queue);
+
+		if(!m_Thread.joinable()){
+			m_bQuit = false;
+			m_Thread = std::thread(&rxFrameCapture::run, this);
+		}
+	}
+
+	/*!
+	 * 後始末(連続キャプチャを終了して書き出し待ちをすべて書き出す)
+	 */
+	void Release(void)
+	{
+		Stop();
+		flush();
+		stopThread();
+		for(size_t i = 0; i < m_vSlots.size(); ++i){
+			if(m_vSlots[i].pbo) glDeleteBuffers(1, &m_vSlots[i].pbo);
+		}
+		m_vSlots.clear();
+	}
+
+	/*!
+	 * 連続キャプチャの開始
+	 * @param[in] fn 保存ファイル名(RX_CAPTURE_BMPの場合は連番の前に付ける接頭辞)
+	 * @param[in] format 保存形式(RX_CAPTURE_*)
+	 * @param[in] fps フレームレート(Y4Mのヘッダに書き込む)
+	 */
+	void Start(const std::string &fn, int format, int fps = 30)
+	{
+		if(m_bRecording) Stop();
+
+		Command c;
+		c.cmd = CMD_OPEN; c.format = format; c.fps = (fps < 1 ? 1 : fps); c.w = c.h = 0; c.repeat = 0; c.fn = fn;
+		push(c);
+
+		m_bRecording = true;
+		m_iFormat = format;
+		m_iW = m_iH = 0;
+		m_iFrames = 0;
+	}
+
+	/*!
+	 * 連続キャプチャの終了(読み出し中のフレームを書き出し待ちに入れてからストリームを閉じる)
+	 */
+	void Stop(void)
+	{
+		if(!m_bRecording) return;
+		flush();
+
+		Command c;
+		c.cmd = CMD_CLOSE; c.format = m_iFormat; c.fps = 0; c.w = c.h = 0; c.repeat = 0;
+		push(c);
+		m_bRecording = false;
+	}
+
+	/*!
+	 * 次のCaptureでスクリーンショットをBMPで保存する
+	 * @param[in] fn ファイル名
+	 */
+	void Screenshot(const std::string &fn){ m_strShot = fn; }
+
+	/*!
+	 * バックバッファの読み出し(毎フレーム呼ぶ)
+	 *  - repeat=0で連続キャプチャもスクリーンショットもない場合は読み出し中のPBOの確認だけを行う
+	 *  - 読み出し結果は数フレーム後(PBOのリングを一周する前, ARB_syncが使える場合はGPUの転送が終わり次第)に書き出しスレッドへ渡す
+	 * @param[in] w,h 画像サイズ
+	 * @param[in] repeat 連続キャプチャのフレームとして書き出す回数(描画がフレームレートに追いつかない場合に同じ画像を繰り返す)
+	 */
+	void Capture(int w, int h, int repeat = 1)
+	{
+		if(m_vSlots.empty()) return;
+
+		// GPUの転送が終わったものを書き出しスレッドへ
+		while(m_iBusy && ready(m_vSlots[m_iTail])) retrieve();
+
+		if(!m_bRecording) repeat = 0;
+		if(repeat <= 0 && m_strShot.empty()) return;
+
+		// 連続キャプチャ(PPM/Y4M)のストリームの途中で画像サイズは変えられない
+		if(repeat > 0){
+			if(!m_iW){
+				m_iW = w; m_iH = h;
+			}
+			else if((w != m_iW || h != m_iH) && m_iFormat != RX_CAPTURE_BMP){
+				std::cout << "the window size has changed, the frame capture stopped (" << m_iFrames << " frames)" << std::endl;
+				Stop();
+				repeat = 0;
+				if(m_strShot.empty()) return;
+			}
+			m_iFrames += repeat;
+		}
+
+		// 空いているスロットがなければ最も古いものを待つ
+		Slot &s = m_vSlots[m_iHead];
+		if(s.busy) retrieve();
+
+		s.w = w; s.h = h; s.repeat = repeat; s.shot = m_strShot;
+		m_strShot.clear();
+
+		GLint align;
+		glGetIntegerv(GL_PACK_ALIGNMENT, &align);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadBuffer(GL_BACK);
+		if(m_bPBO){
+			// PBOへの読み出しはGPU側で非同期に行われる
+			int size = 3*w*h;
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+			if(s.size != size){
+				glBufferData(GL_PIXEL_PACK_BUFFER, size, 0, GL_STREAM_READ);
+				s.size = size;
+			}
+			glReadPixels(0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, 0);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			if(m_bSync) s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+			s.busy = true;
+			m_iBusy++;
+			m_iHead = (m_iHead+1)%m_vSlots.size();
+		}
+		else{
+			std::vector<unsigned char> pix = buffer(3*w*h);
+			glReadPixels(0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, &pix[0]);
+			send(s, pix);
+		}
+		glPixelStorei(GL_PACK_ALIGNMENT, align);
+	}
+
+	//! 連続キャプチャ中かどうか
+	bool IsRecording(void) const { return m_bRecording; }
+
+	//! 書き出しを要求したフレーム数(連続キャプチャの開始から)
+	int GetFrames(void) const { return m_iFrames; }
+
+	//! 書き出したフレーム数(スクリーンショットも含む)
+	int GetWritten(void) const { return m_iWritten; }
+
+	//! 書き出しが追いつかずに描画側が待った回数
+	int GetStalls(void) const { return m_iStalls; }
+
+	//! 書き出し待ちのフレーム数
+	int GetQueued(void)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return (int)m_dQueue.size();
+	}
+
+protected:
+	//! スロットの読み出しが終わっているかどうか(ARB_syncが使えない場合はリングが一周するまで待つ)
+	bool ready(Slot &s)
+	{
+		if(!s.fence) return false;
+		GLenum r = glClientWaitSync(s.fence, 0, 0);
+		return (r == GL_ALREADY_SIGNALED || r == GL_CONDITION_SATISFIED);
+	}
+
+	//! 読み出し中のスロットをすべて書き出しスレッドへ渡す
+	void flush(void)
+	{
+		while(m_iBusy) retrieve();
+	}
+
+	//! 最も古い読み出し中のスロットをマップしてCPU側へコピー(転送が終わっていなければ待つ)
+	void retrieve(void)
+	{
+		Slot &s = m_vSlots[m_iTail];
+		if(s.fence){
+			glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			glDeleteSync(s.fence);
+			s.fence = 0;
+		}
+
+		int size = 3*s.w*s.h;
+		std::vector<unsigned char> pix = buffer(size);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+		const unsigned char *src = (const unsigned char*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+		if(src){
+			std::copy(src, src+size, pix.begin());
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		if(src) send(s, pix);
+
+		s.busy = false;
+		m_iBusy--;
+		m_iTail = (m_iTail+1)%m_vSlots.size();
+	}
+
+	//! 読み出した画像を書き出しスレッドへ渡す
+	void send(const Slot &s, std::vector<unsigned char> &pix)
+	{
+		for(int k = 0; k < 2; ++k){
+			if(k == 0 ? s.shot.empty() : s.repeat <= 0) continue;
+
+			Command c;
+			c.cmd = (k == 0 ? CMD_SCREENSHOT : CMD_FRAME);
+			c.format = m_iFormat; c.fps = 0; c.w = s.w; c.h = s.h; c.repeat = s.repeat;
+			if(k == 0) c.fn = s.shot;
+			if(k == 0 && s.repeat > 0) c.pix = pix; else c.pix.swap(pix);
+			push(c);
+		}
+	}
+
+	//! 画素バッファの取得(使い終わったものがあれば再利用)
+	std::vector<unsigned char> buffer(int size)
+	{
+		std::vector<unsigned char> pix;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if(!m_vPool.empty()){
+				pix.swap(m_vPool.back());
+				m_vPool.pop_back();
+			}
+		}
+		pix.resize(size);
+		return pix;
+	}
+
+	//! 書き出し待ちにコマンドを追加(いっぱいなら空くまで待つ, cの中身は書き出し待ちへ移す)
+	void push(Command &c)
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		if(m_dQueue.size() >= m_iMaxQueue){
+			m_iStalls++;
+			m_cvSpace.wait(lock, [this]{ return m_dQueue.size() < m_iMaxQueue; });
+		}
+		m_dQueue.push_back(Command());
+		std::swap(m_dQueue.back(), c);
+		m_cvWork.notify_one();
+	}
+
+	//! 書き出しスレッドの終了(書き出し待ちはすべて書き出す)
+	void stopThread(void)
+	{
+		if(!m_Thread.joinable()) return;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_bQuit = true;
+		}
+		m_cvWork.notify_one();
+		m_Thread.join();
+	}
+
+	//! 書き出しスレッド
+	void run(void)
+	{
+		for(;;){
+			Command c;
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_cvWork.wait(lock, [this]{ return m_bQuit || !m_dQueue.empty(); });
+				if(m_dQueue.empty()) break;
+				std::swap(c, m_dQueue.front());
+				m_dQueue.pop_front();
+			}
+			m_cvSpace.notify_one();
+
+			write(c);
+
+			if(!c.pix.empty()){
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_vPool.push_back(std::vector<unsigned char>());
+				m_vPool.back().swap(c.pix);
+			}
+		}
+		if(m_fpStream){
+			fclose(m_fpStream);
+			m_fpStream = 0;
+		}
+	}
+
+	//! コマンドの実行(書き出しスレッド)
+	void write(Command &c)
+	{
+		switch(c.cmd){
+		case CMD_OPEN:
+			m_iStreamFormat = c.format;
+			m_iStreamFps = c.fps;
+			m_iStreamIndex = 0;
+			m_bStreamHeader = false;	// Y4Mのヘッダは最初のフレームで画像サイズが分かってから書き込む
+			m_strStreamName = c.fn;
+			if(c.format != RX_CAPTURE_BMP){
+				if((m_fpStream = fopen(c.fn.c_str(), "wb")) == NULL){
+					fprintf(stderr, "capture error : cannot open %s file\n", c.fn.c_str());
+				}
+			}
+			break;
+
+		case CMD_CLOSE:
+			if(m_fpStream){
+				fclose(m_fpStream);
+				m_fpStream = 0;
+			}
+			break;
+
+		case CMD_SCREENSHOT:
+			// glReadPixelsの結果は下の行からなので上下反転せずにそのままBMPとして書き込める
+			WriteBitmapFile(c.fn, &c.pix[0], c.w, c.h, 3, RX_BMP_WINDOWS_V3, 3*c.w, false, true);
+			m_iWritten++;
+			break;
+
+		case CMD_FRAME:
+			if(m_iStreamFormat == RX_CAPTURE_BMP){
+				for(int k = 0; k < c.repeat; ++k){
+					char fn[32];
+					sprintf(fn, "%05d.bmp", m_iStreamIndex++);
+					WriteBitmapFile(m_strStreamName+fn, &c.pix[0], c.w, c.h, 3, RX_BMP_WINDOWS_V3, 3*c.w, false, true);
+				}
+			}
+			else if(m_fpStream){
+				if(m_iStreamFormat == RX_CAPTURE_PPM){
+					convertPPM(c.pix, c.w, c.h);
+				}
+				else{
+					if(!m_bStreamHeader){
+						fprintf(m_fpStream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", c.w, c.h, m_iStreamFps);
+						m_bStreamHeader = true;
+					}
+					convertY4M(c.pix, c.w, c.h);
+				}
+				for(int k = 0; k < c.repeat; ++k){
+					fwrite(&m_vConv[0], 1, m_vConv.size(), m_fpStream);
+				}
+			}
+			m_iWritten += c.repeat;
+			break;
+		}
+	}
+
+	//! PPM(P6)の1フレーム(ヘッダ+上の行からのRGB)
+	void convertPPM(const std::vector<unsigned char> &pix, int w, int h)
+	{
+		char header[64];
+		int n = sprintf(header, "P6\n%d %d\n255\n", w, h);
+		int wstep = 3*w;
+		m_vConv.resize(n+wstep*h);
+		std::copy(header, header+n, m_vConv.begin());
+		for(int j = 0; j < h; ++j){
+			std::copy(pix.begin()+(h-1-j)*wstep, pix.begin()+(h-j)*wstep, m_vConv.begin()+n+j*wstep);
+		}
+	}
+
+	//! Y4Mの1フレーム("FRAME"+上の行からのY,Cb,Cr平面, BT.601の制限範囲)
+	void convertY4M(const std::vector<unsigned char> &pix, int w, int h)
+	{
+		const char header[] = "FRAME\n";
+		int n = sizeof(header)-1, wh = w*h;
+		m_vConv.resize(n+3*wh);
+		std::copy(header, header+n, m_vConv.begin());
+		unsigned char *y = &m_vConv[n], *cb = y+wh, *cr = cb+wh;
+		for(int j = 0; j < h; ++j){
+			const unsigned char *src = &pix[3*w*(h-1-j)];
+			for(int i = 0; i < w; ++i, src += 3){
+				int r = src[0], g = src[1], b = src[2], k = j*w+i;
+				y[k]  = (unsigned char)(16+((66*r+129*g+25*b+128) >> 8));
+				cb[k] = (unsigned char)(128+((-38*r-74*g+112*b+128) >> 8));
+				cr[k] = (unsigned char)(128+((112*r-94*g-18*b+128) >> 8));
+			}
+		}
+	}
+};
+
+
+#endif // #ifndef _RX_CAPTURE_H_
@@ -0,0 +1,90 @@
+/*!
+  @file rx_fixedstep.h
+
+  @brief 固定時間ステップでのシミュレーション実行管理(描画ループとの分離)
+		 - 経過した実時間を蓄積し，固定幅dtのステップを何回進めるべきかを返す
+		 - 1フレームあたりのステップ数には上限を設け，追いつけなかった分は次フレーム以降に持ち越す
+
+  @author Makoto Fujisawa
+  @date 2026-10
+*/
+// FILE --rx_fixedstep.h--
+
+#ifndef _RX_FIXEDSTEP_H_
+#define _RX_FIXEDSTEP_H_
+
+
+//-----------------------------------------------------------------------------
+// 固定時間ステップ管理クラス
+//-----------------------------------------------------------------------------
+class rxFixedStep
+{
+	double m_fAccum;		//!< まだ計算していない時間(追いつくべき時間,catch-up debt)
+	double m_fMaxDebt;		//!< 持ち越せる時間の上限(これを超えた分は切り捨てる)
+	double m_fDropped;		//!< 上限を超えて切り捨てた時間の累計
+	int m_iMaxSubsteps;		//!< 1フレームで進める最大ステップ数
+	int m_iLastSteps;		//!< 直近のUpdateで進めたステップ数
+
+public:
+	//! コンストラクタ
+	rxFixedStep(int max_substeps = 10, double max_debt = 0.25)
+	{
+		m_iMaxSubsteps = max_substeps;
+		m_fMaxDebt = max_debt;
+		Reset();
+	}
+
+	//! 蓄積時間のリセット
+	void Reset(void)
+	{
+		m_fAccum = 0.0;
+		m_fDropped = 0.0;
+		m_iLastSteps = 0;
+	}
+
+	/*!
+	 * 経過時間を蓄積して，このフレームで進めるべきステップ数を返す
+	 * @param[in] elapsed 前フレームからの経過時間(実時間)
+	 * @param[in] dt 1ステップの時間幅
+	 * @return 進めるべきステップ数(0～最大サブステップ数)
+	 */
+	int Update(double elapsed, double dt)
+	{
+		m_iLastSteps = 0;
+		if(dt <= 0.0) return 0;
+
+		m_fAccum += elapsed;
+		if(m_fAccum > m_fMaxDebt){
+			// 処理が重すぎて追いつけない場合に無限に遅れが溜まらないようにする
+			m_fDropped += m_fAccum-m_fMaxDebt;
+			m_fAccum = m_fMaxDebt;
+		}
+
+		int n = (int)(m_fAccum/dt);
+		if(n > m_iMaxSubsteps) n = m_iMaxSubsteps;
+		m_fAccum -= n*dt;
+		m_iLastSteps = n;
+		return n;
+	}
+
+	//! 1フレームで進める最大ステップ数
+	void SetMaxSubsteps(int n){ m_iMaxSubsteps = (n < 1 ? 1 : n); }
+	int GetMaxSubsteps(void) const { return m_iMaxSubsteps; }
+	int* GetMaxSubstepsR(void){ return &m_iMaxSubsteps; }
+
+	//! 持ち越せる時間の上限
+	void SetMaxDebt(double t){ m_fMaxDebt = t; }
+	double GetMaxDebt(void) const { return m_fMaxDebt; }
+
+	//! まだ計算していない時間(1ステップ分未満ならdtとの比が描画時の補間係数になる)
+	double GetDebt(void) const { return m_fAccum; }
+
+	//! 上限を超えて切り捨てた時間の累計
+	double GetDropped(void) const { return m_fDropped; }
+
+	//! 直近のUpdateで進めたステップ数
+	int GetLastSteps(void) const { return m_iLastSteps; }
+};
+
+
+#endif // #ifndef _RX_FIXEDSTEP_H_
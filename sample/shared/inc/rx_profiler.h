@@ -0,0 +1,497 @@
+/*!
+  @file rx_profiler.h
+
+  @brief 階層的なフレームプロファイラ
+		 - RX_PROFILE("名前")で囲んだスコープの実時間をスレッドごとの階層構造で集計する
+		 - BulletのBT_PROFILE(btQuickprof)もrxProfiler::Enter/Leaveを登録すれば同じ階層に入る
+		 - AddCounter/SetCounterで区間以外の値(キャッシュのヒット数など)もフレームごとに集計する
+		 - 数フレーム分の記録をChrome(chrome://tracing, Perfetto)のトレース形式(JSON)で保存できる
+		 - 時間計測はrx_timer.hのRX_GET_TIME(Windows:QueryPerformanceCounter, それ以外:CLOCK_MONOTONIC)
+
+  @author Makoto Fujisawa
+  @date 2026-10
+*/
+// FILE --rx_profiler.h--
+
+#ifndef _RX_PROFILER_H_
+#define _RX_PROFILER_H_
+
+
+//-----------------------------------------------------------------------------
+// インクルードファイル
+//-----------------------------------------------------------------------------
+#include <cstdio>
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+#include "rx_timer.h"
+
+
+//-----------------------------------------------------------------------------
+// プロファイラクラス
+//  - Enter/Leaveはどのスレッドから呼んでもよい(スレッドごとに入れ子を管理する)
+//  - EndFrameは描画ループから1フレームに1回呼ぶ(有効な間はEndFrameを呼ばないと記録が溜まり続ける)
+//-----------------------------------------------------------------------------
+class rxProfiler
+{
+public:
+	//! 計測区間1つ分の記録
+	struct Event
+	{
+		const char* name;	//!< 区間名(文字列リテラルなどプログラム終了まで有効なもの)
+		RXTIME begin, end;	//!< 開始・終了時刻
+		int depth;			//!< 入れ子の深さ(0が最上位)
+		int thread;			//!< スレッド番号
+	};
+
+	//! 集計結果(スレッドごとの呼び出し階層の1ノード)
+	struct Node
+	{
+		std::string name;	//!< 区間名(深さ0はスレッド名)
+		int depth;			//!< 表示上の深さ(0:スレッド, 1以降:区間)
+		int parent;			//!< 親ノード(-1:なし)
+		double time;		//!< 直近のフレームでの合計時間[s]
+		double avg;			//!< 平滑化した時間[s]
+		int count;			//!< 直近のフレームでの呼び出し回数
+		std::vector<int> children;
+	};
+
+	//! カウンタ1つ分の集計結果
+	struct Counter
+	{
+		std::string name;	//!< カウンタ名
+		double value;		//!< 直近のフレームでの値(AddCounterは合計，SetCounterは最後の値)
+		double avg;			//!< 平滑化した値
+		bool last;			//!< SetCounterのカウンタ(値が入らなかったフレームも前の値のまま)
+		bool set;			//!< 直近のフレームで値が入ったか
+	};
+
+protected:
+	//! スレッドごとの状態(開いている区間のスタック)
+	struct ThreadState
+	{
+		int index;
+		std::vector<std::pair<const char*, RXTIME> > stack;
+		ThreadState() : index(-1) {}
+	};
+
+	std::atomic<bool> m_bEnabled;		//!< 計測ON/OFF
+	std::atomic<int> m_iNumThreads;		//!< これまでに計測したスレッド数
+	double m_fT2S;						//!< 時間単位から秒への変換係数
+	RXTIME m_tOrigin;					//!< トレース出力時の時刻の原点
+
+	std::mutex m_mutex;							//!< m_vEvents,m_vThreadNames用
+	std::vector<Event> m_vEvents;				//!< 完了した区間(次のEndFrameまで)
+	std::vector<std::string> m_vThreadNames;	//!< スレッド名
+	std::vector<std::pair<const char*, double> > m_vAdds;	//!< AddCounterの値(次のEndFrameまで)
+	std::map<std::string, double> m_mSets;		//!< SetCounterの値(次のEndFrameまで)
+
+	// 集計(EndFrameを呼ぶスレッドからのみ触る)
+	std::vector<Event> m_vWork;					//!< 集計中の区間
+	std::vector<Event> m_vPending;				//!< 親の区間が終わっていないので次のフレームに回す区間
+	std::vector<Node> m_vNodes;					//!< 集計結果
+	std::map<std::string, int> m_mNodes;		//!< スレッド番号と区間名の経路 -> ノード
+	std::vector<int> m_vOrder;					//!< 表示順(深さ優先)
+	std::vector<Counter> m_vCounters;			//!< カウンタの集計結果(登録順)
+	std::map<std::string, int> m_mCounters;		//!< カウンタ名 -> m_vCountersのインデックス
+	double m_fSmooth;							//!< 平滑化係数(新しい値の重み)
+
+	// トレース出力
+	std::vector<Event> m_vTrace;				//!< 記録中の区間
+	int m_iTraceFrames;							//!< 残り記録フレーム数
+	std::string m_strTraceFile;					//!< 出力ファイル名
+
+public:
+	//! プロファイラ本体(全スレッドで共有)
+	static rxProfiler& Instance(void)
+	{
+		static rxProfiler p;
+		return p;
+	}
+
+	//! 区間の開始(btSetCustomEnterProfileZoneFuncに渡せる形式)
+	static void Enter(const char* name)
+	{
+		rxProfiler &p = Instance();
+		ThreadState &ts = threadState();
+		ts.stack.push_back(std::make_pair(name, p.m_bEnabled ? RX_GET_TIME() : (RXTIME)-1));
+	}
+
+	//! 区間の終了(btSetCustomLeaveProfileZoneFuncに渡せる形式)
+	static void Leave(void)
+	{
+		rxProfiler &p = Instance();
+		ThreadState &ts = threadState();
+		if(ts.stack.empty()) return;
+
+		std::pair<const char*, RXTIME> z = ts.stack.back();
+		ts.stack.pop_back();
+		if(z.second < 0 || !p.m_bEnabled) return;	// 開始時に計測OFFだった区間
+
+		Event e;
+		e.name = z.first;
+		e.begin = z.second;
+		e.end = RX_GET_TIME();
+		e.depth = (int)ts.stack.size();
+		e.thread = p.threadIndex(ts);
+
+		std::lock_guard<std::mutex> lock(p.m_mutex);
+		p.m_vEvents.push_back(e);
+	}
+
+	//! カウンタにこのフレームの値を足す(ステップごとの回数など, どのスレッドから呼んでもよい)
+	static void AddCounter(const char* name, double value)
+	{
+		rxProfiler &p = Instance();
+		if(!p.m_bEnabled) return;
+		std::lock_guard<std::mutex> lock(p.m_mutex);
+		p.m_vAdds.push_back(std::make_pair(name, value));
+	}
+
+	//! カウンタにこのフレームの値を設定する(キャッシュの大きさなど, フレーム内で最後の値を使う)
+	static void SetCounter(const char* name, double value)
+	{
+		rxProfiler &p = Instance();
+		if(!p.m_bEnabled) return;
+		std::lock_guard<std::mutex> lock(p.m_mutex);
+		p.m_mSets[name] = value;
+	}
+
+	//! 現在のスレッドに名前をつける(集計・トレースでの表示用)
+	static void SetThreadName(const std::string &name)
+	{
+		rxProfiler &p = Instance();
+		int i = p.threadIndex(threadState());
+		std::lock_guard<std::mutex> lock(p.m_mutex);
+		p.m_vThreadNames[i] = name;
+	}
+
+	//! 計測ON/OFF
+	void SetEnabled(bool on){ m_bEnabled = on; }
+	bool IsEnabled(void) const { return m_bEnabled; }
+
+	/*!
+	 * 1フレーム分の区間を集計(描画ループから1フレームに1回呼ぶ)
+	 *  - 別スレッドの区間はこのフレームまでに終了したものが入る
+	 */
+	void EndFrame(void)
+	{
+		std::vector<std::string> names;
+		std::vector<std::pair<const char*, double> > adds;
+		std::map<std::string, double> sets;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_vWork.swap(m_vEvents);
+			names = m_vThreadNames;
+			adds.swap(m_vAdds);
+			sets.swap(m_mSets);
+		}
+		m_vWork.insert(m_vWork.end(), m_vPending.begin(), m_vPending.end());
+		m_vPending.clear();
+
+		aggregate(m_vWork, names);
+		aggregateCounters(adds, sets);
+
+		// トレース用に記録
+		if(m_iTraceFrames > 0){
+			m_vTrace.insert(m_vTrace.end(), m_vWork.begin(), m_vWork.end());
+			if(--m_iTraceFrames == 0){
+				writeTrace(m_strTraceFile, names);
+				m_vTrace.clear();
+			}
+		}
+
+		m_vWork.clear();
+	}
+
+	/*!
+	 * 次のnフレーム分の区間をChromeのトレース形式で保存する
+	 * @param[in] file 出力ファイル名(chrome://tracingやPerfettoで読み込める)
+	 * @param[in] n 記録するフレーム数
+	 */
+	void CaptureTrace(const std::string &file, int n)
+	{
+		m_strTraceFile = file;
+		m_vTrace.clear();
+		m_iTraceFrames = n;
+		m_bEnabled = true;
+	}
+
+	//! トレースを記録中かどうか
+	bool IsCapturing(void) const { return m_iTraceFrames > 0; }
+
+	//! 集計結果
+	const std::vector<Node>& GetNodes(void) const { return m_vNodes; }
+
+	//! 集計結果の表示順(深さ優先, GetNodesのインデックス)
+	const std::vector<int>& GetOrder(void) const { return m_vOrder; }
+
+	//! カウンタの集計結果(最初に値が入った順)
+	const std::vector<Counter>& GetCounters(void) const { return m_vCounters; }
+
+	//! 集計結果のクリア
+	void Clear(void)
+	{
+		m_vNodes.clear();
+		m_mNodes.clear();
+		m_vOrder.clear();
+		m_vCounters.clear();
+		m_mCounters.clear();
+	}
+
+protected:
+	rxProfiler() : m_bEnabled(false), m_iNumThreads(0), m_fSmooth(0.1), m_iTraceFrames(0)
+	{
+		m_fT2S = RX_GET_TIME2SEC();
+		m_tOrigin = RX_GET_TIME();
+	}
+	rxProfiler(const rxProfiler &);
+	rxProfiler& operator=(const rxProfiler &);
+
+	static ThreadState& threadState(void)
+	{
+		static thread_local ThreadState ts;
+		return ts;
+	}
+
+	//! スレッド番号(初めて呼ばれたときに割り当てる)
+	int threadIndex(ThreadState &ts)
+	{
+		if(ts.index < 0){
+			ts.index = m_iNumThreads++;
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if((int)m_vThreadNames.size() <= ts.index) m_vThreadNames.resize(ts.index+1);
+			if(m_vThreadNames[ts.index].empty()) m_vThreadNames[ts.index] = "thread "+toString(ts.index);
+		}
+		return ts.index;
+	}
+
+	//! 記録の並べ替え用(スレッド,開始時刻,深さの順)
+	static bool lessEvent(const Event &a, const Event &b)
+	{
+		if(a.thread != b.thread) return a.thread < b.thread;
+		if(a.begin != b.begin) return a.begin < b.begin;
+		return a.depth < b.depth;
+	}
+
+	//! ノードの取得(なければ追加)
+	int node(const std::string &key, const std::string &name, int depth, int parent)
+	{
+		std::map<std::string, int>::iterator i = m_mNodes.find(key);
+		if(i != m_mNodes.end()) return i->second;
+
+		Node n;
+		n.name = name;
+		n.depth = depth;
+		n.parent = parent;
+		n.time = n.avg = 0.0;
+		n.count = 0;
+		int idx = (int)m_vNodes.size();
+		m_vNodes.push_back(n);
+		if(parent >= 0) m_vNodes[parent].children.push_back(idx);
+		m_mNodes[key] = idx;
+		return idx;
+	}
+
+	/*!
+	 * 1フレーム分の区間をスレッドごとの呼び出し階層に集計
+	 *  - 最上位の区間がまだ終わっていない子区間はm_vPendingに移して次のフレームで集計する
+	 * @param[inout] events 区間(並べ替えて，集計したものだけを残す)
+	 * @param[in] names スレッド名
+	 */
+	void aggregate(std::vector<Event> &events, const std::vector<std::string> &names)
+	{
+		for(size_t i = 0; i < m_vNodes.size(); ++i){
+			m_vNodes[i].time = 0.0;
+			m_vNodes[i].count = 0;
+		}
+
+		std::sort(events.begin(), events.end(), lessEvent);
+
+		// 各スレッドで最後に終わった最上位の区間より後に始まった子区間は，まだ終わっていない最上位の区間に属する
+		std::map<int, RXTIME> top_end;
+		for(size_t i = 0; i < events.size(); ++i){
+			if(events[i].depth == 0) top_end[events[i].thread] = events[i].end;
+		}
+		size_t m = 0;
+		for(size_t i = 0; i < events.size(); ++i){
+			const Event &e = events[i];
+			std::map<int, RXTIME>::iterator t = top_end.find(e.thread);
+			if(e.depth > 0 && (t == top_end.end() || e.begin >= t->second)){
+				m_vPending.push_back(e);
+			}
+			else{
+				events[m++] = e;
+			}
+		}
+		events.resize(m);
+
+		// 同じスレッドの区間は入れ子になっているので，深さから親を決める
+		std::vector<int> stack;
+		std::vector<std::string> keys;
+		int thread = -1;
+		for(size_t i = 0; i < events.size(); ++i){
+			const Event &e = events[i];
+			if(e.thread != thread){
+				thread = e.thread;
+				std::string key = toString(thread);
+				std::string name = (thread < (int)names.size() ? names[thread] : key);
+				stack.assign(1, node(key, name, 0, -1));
+				keys.assign(1, key);
+			}
+			if((int)stack.size() > e.depth+1){
+				stack.resize(e.depth+1);
+				keys.resize(e.depth+1);
+			}
+
+			std::string key = keys.back()+"/"+e.name;
+			int n = node(key, e.name, (int)stack.size(), stack.back());
+			m_vNodes[n].time += (double)(e.end-e.begin)*m_fT2S;
+			m_vNodes[n].count++;
+			stack.push_back(n);
+			keys.push_back(key);
+		}
+
+		// スレッドの時間は最上位の区間の合計
+		for(size_t i = 0; i < m_vNodes.size(); ++i){
+			Node &n = m_vNodes[i];
+			if(n.parent >= 0 && m_vNodes[n.parent].depth == 0){
+				m_vNodes[n.parent].time += n.time;
+			}
+		}
+		for(size_t i = 0; i < m_vNodes.size(); ++i){
+			Node &n = m_vNodes[i];
+			n.avg = (n.avg == 0.0 ? n.time : n.avg+m_fSmooth*(n.time-n.avg));
+		}
+
+		// 表示順
+		m_vOrder.clear();
+		for(size_t i = 0; i < m_vNodes.size(); ++i){
+			if(m_vNodes[i].parent < 0) order((int)i);
+		}
+	}
+
+	/*!
+	 * 1フレーム分のカウンタの集計
+	 *  - 値が入らなかったAddCounterのカウンタは0，SetCounterのカウンタは前の値のままにする
+	 */
+	void aggregateCounters(const std::vector<std::pair<const char*, double> > &adds, const std::map<std::string, double> &sets)
+	{
+		for(size_t i = 0; i < m_vCounters.size(); ++i){
+			m_vCounters[i].set = false;
+		}
+		for(size_t i = 0; i < adds.size(); ++i){
+			Counter &c = counter(adds[i].first);
+			if(!c.set) c.value = 0.0;
+			c.value += adds[i].second;
+			c.set = true;
+		}
+		for(std::map<std::string, double>::const_iterator i = sets.begin(); i != sets.end(); ++i){
+			Counter &c = counter(i->first);
+			c.value = i->second;
+			c.last = true;
+			c.set = true;
+		}
+		for(size_t i = 0; i < m_vCounters.size(); ++i){
+			Counter &c = m_vCounters[i];
+			if(!c.set && !c.last) c.value = 0.0;
+			c.avg = (c.avg == 0.0 ? c.value : c.avg+m_fSmooth*(c.value-c.avg));
+		}
+	}
+
+	//! カウンタの取得(なければ追加)
+	Counter& counter(const std::string &name)
+	{
+		std::map<std::string, int>::iterator i = m_mCounters.find(name);
+		if(i != m_mCounters.end()) return m_vCounters[i->second];
+		Counter c;
+		c.name = name;
+		c.value = c.avg = 0.0;
+		c.last = c.set = false;
+		m_mCounters[name] = (int)m_vCounters.size();
+		m_vCounters.push_back(c);
+		return m_vCounters.back();
+	}
+
+	void order(int i)
+	{
+		m_vOrder.push_back(i);
+		for(size_t j = 0; j < m_vNodes[i].children.size(); ++j){
+			order(m_vNodes[i].children[j]);
+		}
+	}
+
+	/*!
+	 * 記録した区間をChromeのトレース形式(JSON)で出力
+	 * @param[in] file 出力ファイル名
+	 * @param[in] names スレッド名
+	 */
+	void writeTrace(const std::string &file, const std::vector<std::string> &names)
+	{
+		FILE* fp = fopen(file.c_str(), "w");
+		if(!fp){
+			std::cout << "rxProfiler : cannot open " << file << std::endl;
+			return;
+		}
+
+		fprintf(fp, "{\"traceEvents\":[\n");
+		for(size_t i = 0; i < names.size(); ++i){
+			fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n", (int)i, escape(names[i]).c_str());
+		}
+		for(size_t i = 0; i < m_vTrace.size(); ++i){
+			const Event &e = m_vTrace[i];
+			double ts = (double)(e.begin-m_tOrigin)*m_fT2S*1.0e6;
+			double dur = (double)(e.end-e.begin)*m_fT2S*1.0e6;
+			fprintf(fp, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+					escape(e.name).c_str(), e.thread, ts, dur, (i+1 < m_vTrace.size() ? "," : ""));
+		}
+		fprintf(fp, "],\"displayTimeUnit\":\"ms\"}\n");
+		fclose(fp);
+
+		std::cout << "rxProfiler : " << m_vTrace.size() << " events were saved to " << file << std::endl;
+	}
+
+	//! JSON文字列用のエスケープ
+	static std::string escape(const std::string &s)
+	{
+		std::string r;
+		for(size_t i = 0; i < s.size(); ++i){
+			if(s[i] == '"' || s[i] == '\\') r += '\\';
+			r += s[i];
+		}
+		return r;
+	}
+
+	//! 数値から文字列への変換
+	template<class T>
+	static std::string toString(const T &x)
+	{
+		std::stringstream ss;
+		ss << x;
+		return ss.str();
+	}
+};
+
+
+//-----------------------------------------------------------------------------
+// スコープの計測
+//-----------------------------------------------------------------------------
+class rxProfileScope
+{
+public:
+	rxProfileScope(const char* name){ rxProfiler::Enter(name); }
+	~rxProfileScope(){ rxProfiler::Leave(); }
+};
+
+#define RX_PROFILE_CAT2(a, b) a##b
+#define RX_PROFILE_CAT(a, b) RX_PROFILE_CAT2(a, b)
+
+//! スコープの終わりまでを区間nameとして計測
+#define RX_PROFILE(name) rxProfileScope RX_PROFILE_CAT(rx_profile_, __LINE__)(name)
+
+
+#endif // #ifndef _RX_PROFILER_H_
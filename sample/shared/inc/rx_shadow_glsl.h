@@ -16,6 +16,8 @@
 // インクルードファイル
 //-----------------------------------------------------------------------------
 
+#include <cstring>
+
 // OpenGL
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -181,6 +183,11 @@ protected:
 
 	rxGLSL m_glslShading;	//!< GLSLシェーダ
 
+	bool m_bDepthValid;				//!< シャドウマップが作成済みかどうか
+	float m_fLightProj[16];			//!< シャドウマップ作成時の光源プロジェクション行列
+	float m_fLightModelview[16];	//!< シャドウマップ作成時の光源モデルビュー行列
+	bool m_bSelfShading;			//!< シャドウマップ作成時のself_shading
+
 public:
 	//! デフォルトコンストラクタ
 	ShadowMap()
@@ -188,6 +195,8 @@ public:
 		m_iFBODepth = 0;
 		m_iTexDepth = 0;
 		m_fDepthSize[0] = m_fDepthSize[1] = 512;
+		m_bDepthValid = false;
+		m_bSelfShading = false;
 	}
 
 	//! デストラクタ
@@ -210,6 +219,7 @@ public:
 
 		m_fDepthSize[0] = w;
 		m_fDepthSize[1] = h;
+		m_bDepthValid = false;
 	
 		// デプス値テクスチャ
 		glActiveTexture(GL_TEXTURE7);
@@ -248,12 +258,48 @@ public:
 	}
 
 
+	/*!
+	 * シャドウマップを次の描画で必ず作り直す
+	 */
+	void InvalidateDepth(void){ m_bDepthValid = false; }
+
+	/*!
+	 * 光源のプロジェクション行列とモデルビュー行列の積(光源視錐台でのカリング用)
+	 * @param[in] light 光源
+	 * @param[out] mvp 変換行列(列優先)
+	 */
+	void CalLightMatrix(const Frustum &light, float mvp[16])
+	{
+		glMatrixMode(GL_PROJECTION);
+		glPushMatrix();
+		glLoadIdentity();
+		gluPerspective(light.fov, (double)light.w/(double)light.h, light.near, light.far);
+		gluLookAt(light.origin[0], light.origin[1], light.origin[2], 
+				  light.lookat[0], light.lookat[1], light.lookat[2], 
+				  light.up[0], light.up[1], light.up[2]);
+		glGetFloatv(GL_PROJECTION_MATRIX, mvp);
+		glPopMatrix();
+		glMatrixMode(GL_MODELVIEW);
+	}
+
 	/*!
 	 * 影付きでシーン描画
 	 * @param[in] light 光源
 	 * @param[in] fpDraw 描画関数のポインタ
 	 */
 	void RenderSceneWithShadow(Frustum &light, void (*fpDraw)(void*), void* func_obj, bool self_shading = false)
+	{
+		RenderSceneWithShadow(light, fpDraw, fpDraw, func_obj, true, self_shading);
+	}
+
+	/*!
+	 * 影付きでシーン描画(シャドウマップ生成とカメラからの描画で別の描画関数を使う)
+	 * @param[in] light 光源
+	 * @param[in] fpDepth シャドウマップ生成用の描画関数のポインタ(デプスのみなので材質などの設定は不要)
+	 * @param[in] fpDraw カメラからの描画関数のポインタ
+	 * @param[in] update_depth falseなら前回のシャドウマップを再利用する(光源が変わった場合は作り直す)
+	 */
+	void RenderSceneWithShadow(Frustum &light, void (*fpDepth)(void*), void (*fpDraw)(void*), void* func_obj, bool update_depth, bool self_shading = false)
 	{
 		float light_proj[16], camera_proj[16];
 		float light_modelview[16], camera_modelview[16];
@@ -294,45 +340,66 @@ public:
 		glGetIntegerv(GL_VIEWPORT, viewport);
 
 
-		//
-		// 光源からレンダリングしてシャドウマップを生成
-		//
-		glBindFramebuffer(GL_FRAMEBUFFER, m_iFBODepth);	// FBOにレンダリング
+		// 光源や設定が前回と同じでシーンも変わっていなければシャドウマップを作り直さない
+		if(!update_depth && m_bDepthValid && m_bSelfShading == self_shading && 
+		   !memcmp(m_fLightProj, light_proj, sizeof(light_proj)) && !memcmp(m_fLightModelview, light_modelview, sizeof(light_modelview))){
+			glEnable(GL_TEXTURE_2D);
+			glDisable(GL_LIGHTING);
+		}
+		else{
+			//
+			// 光源からレンダリングしてシャドウマップを生成
+			//
+			glBindFramebuffer(GL_FRAMEBUFFER, m_iFBODepth);	// FBOにレンダリング
 
-		// カラー，デプスバッファのクリア
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		//glClearDepth(1.0f);
+			// カラー，デプスバッファのクリア
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			//glClearDepth(1.0f);
 
-		// ビューポートをシャドウマップの大きさに変更
-		glViewport(0, 0, m_fDepthSize[0], m_fDepthSize[1]);
+			// ビューポートをシャドウマップの大きさに変更
+			glViewport(0, 0, m_fDepthSize[0], m_fDepthSize[1]);
 	
-		// 光源を視点として設定
-		glMatrixMode(GL_PROJECTION);
-		glLoadMatrixf(light_proj);
-		glMatrixMode(GL_MODELVIEW);
-		glLoadMatrixf(light_modelview);
+			// 光源を視点として設定
+			glMatrixMode(GL_PROJECTION);
+			glLoadMatrixf(light_proj);
+			glMatrixMode(GL_MODELVIEW);
+			glLoadMatrixf(light_modelview);
 	
-		// デプス値以外の色のレンダリングを無効にする
-		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE); 
+			// デプス値以外の色のレンダリングを無効にする
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE); 
 	
-		glPolygonOffset(1.1f, 40.0f);
-		glEnable(GL_POLYGON_OFFSET_FILL);
+			glPolygonOffset(1.1f, 40.0f);
+			glEnable(GL_POLYGON_OFFSET_FILL);
 
-		glEnable(GL_TEXTURE_2D);	
+			glEnable(GL_TEXTURE_2D);	
 	
-		glDisable(GL_LIGHTING);
-		if(self_shading){
-			glDisable(GL_CULL_FACE);
-		}
-		else{
-			glEnable(GL_CULL_FACE);
-			glCullFace(GL_FRONT);
-		}
+			glDisable(GL_LIGHTING);
+			if(self_shading){
+				glDisable(GL_CULL_FACE);
+			}
+			else{
+				glEnable(GL_CULL_FACE);
+				glCullFace(GL_FRONT);
+			}
 
-		glUseProgram(0);
-		fpDraw(func_obj);
+			glUseProgram(0);
+			fpDepth(func_obj);
+
+			glDisable(GL_POLYGON_OFFSET_FILL);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+			// 無効にした色のレンダリングを有効にする
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE); 
+
+			// 元のビューポート行列に戻す
+			glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
 
-		glDisable(GL_POLYGON_OFFSET_FILL);
+			memcpy(m_fLightProj, light_proj, sizeof(light_proj));
+			memcpy(m_fLightModelview, light_modelview, sizeof(light_modelview));
+			m_bSelfShading = self_shading;
+			m_bDepthValid = true;
+		}
 	
 	
 		const float bias[16] = { 0.5, 0.0, 0.0, 0.0, 
@@ -367,14 +434,6 @@ public:
 		//rot[12] = 0.0f;               rot[13] = 0.0f;               rot[14] = 0.0f;                 rot[15] = 1.0f;
 		//glMultTransposeMatrixf(rot);
 		//glTranslatef(-camera_modelview[12], -camera_modelview[13], -camera_modelview[14]);
-	
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-		// 無効にした色のレンダリングを有効にする
-		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE); 
-
-		// 元のビューポート行列に戻す
-		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
 
 		// 退避させておいた視点行列を元に戻す
 		glMatrixMode(GL_PROJECTION);
@@ -36,6 +36,7 @@
 	#endif
 #else
 	#include <ctime>
+	#include <time.h>
 #endif
  
 #ifdef WIN32
@@ -71,9 +72,16 @@
 #endif
 
 #else
-	#define RXTIME clock_t
-	inline RXTIME RX_GET_TIME(void){ return clock(); }
-	inline double RX_GET_TIME2SEC(void){ return (1.0/CLOCKS_PER_SEC); }
+	// clock()はプロセスのCPU時間(全スレッドの合計)で分解能も粗いので，
+	// 実時間を測るためにCLOCK_MONOTONIC(時刻変更の影響を受けない単調増加時計)をナノ秒単位で用いる
+	#define RXTIME long long
+	inline RXTIME RX_GET_TIME(void)
+	{
+		timespec t;
+		clock_gettime(CLOCK_MONOTONIC, &t);
+		return (RXTIME)t.tv_sec*1000000000LL+t.tv_nsec;
+	}
+	inline double RX_GET_TIME2SEC(void){ return 1.0e-9; }
 #endif
  
 
@@ -0,0 +1,1068 @@
+/*!
+  @file headless.cpp
+
+  @brief ウィンドウなし(GLFW/OpenGL不要)でbtcubeのシーンを計算するバッチ実行用メインファイル
+		 - 描画ループを介さないのでCPUが許す限りの速さでステップを進める
+		 - 指定したステップ間隔で各剛体の状態をCSVファイルに出力する
+
+  @author Makoto Fujisawa
+  @date   2026-10
+*/
+
+#ifdef _DEBUG
+#pragma comment (lib, "LinearMath_vs2010_x64_debug.lib")
+#pragma comment (lib, "BulletCollision_vs2010_x64_debug.lib")
+#pragma comment (lib, "BulletDynamics_vs2010_x64_debug.lib")
+#pragma comment (lib, "BulletSoftBody_vs2010_x64_debug.lib")
+#else
+#pragma comment (lib, "LinearMath_vs2010_x64_release.lib")
+#pragma comment (lib, "BulletCollision_vs2010_x64_release.lib")
+#pragma comment (lib, "BulletDynamics_vs2010_x64_release.lib")
+#pragma comment (lib, "BulletSoftBody_vs2010_x64_release.lib")
+#endif
+
+//-----------------------------------------------------------------------------
+// Include Files
+//-----------------------------------------------------------------------------
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <atomic>
+
+#include "../scene.h"
+#include "../scenefile.h"
+#include "../statefile.h"
+#include "../meshcache.h"
+
+// 接触マニフォールドと衝突アルゴリズムのメモリプール
+#include <LinearMath/btPoolAllocator.h>
+
+// 時間計測
+#include "rx_timer.h"
+
+using namespace std;
+
+
+//-----------------------------------------------------------------------------
+// グローバル変数
+//-----------------------------------------------------------------------------
+int g_nsteps = 10000;			//!< 計算するステップ数
+float g_dt = 0.002;				//!< 時間ステップ幅(GUI版と同じ値)
+int g_interval = 100;			//!< 状態出力のステップ間隔(0で出力なし)
+string g_output = "state.csv";	//!< 状態出力ファイル名
+string g_convert;				//!< シーンファイルをバイナリ形式に変換して保存するファイル名
+int g_nrays = 0;				//!< 1ステップごとにまとめて投げるレイの数(0でなし)
+int g_nrollbacks = 0;			//!< 途中の状態に戻して後半を再計算する回数(0でなし)
+string g_record;				//!< 剛体の状態を毎ステップ記録するファイル名(statefile.h)
+string g_resume;				//!< 計算を再開する状態ファイル名
+int g_from = -1;				//!< 再開するステップ数(-1で記録された最後のステップ)
+int g_bpbench = 0;				//!< ブロードフェーズのベンチマークの箱の数(0でなし)
+int g_bvhbench = 0;				//!< 三角形メッシュのBVHのベンチマークの三角形の数(0でなし)
+int g_softbench = 0;			//!< 布のベンチマークの1辺の節点の数(0でなし)
+string g_compare;				//!< 毎ステップの剛体の状態を比べる状態ファイル名(別のビルドで記録したもの)
+double g_tol = 1.0e-3;			//!< -compareで許容する位置の差
+
+std::atomic<long long> g_nallocs(0);	//!< Bullet内でのヒープ確保の回数(btAlignedAllocSetCustomで数える)
+
+
+//-----------------------------------------------------------------------------
+// 関数
+//-----------------------------------------------------------------------------
+/*!
+* 使い方の表示
+*/
+void usage(const char* prog)
+{
+	printf("usage: %s [-n steps] [-dt dt] [-i interval] [-o output.csv] [-mt scheduler] [-t threads] [-scene file] [-convert file] [-rays n] [-rollback n] [-record file] [-resume file [-from step]] [-broadphase type] [-bpbench n] [-bvhbench n] [-softbench n] [-meshcache dir] [-compare file [-tol x]]\n", prog);
+	printf("  -n  : number of simulation steps (default: %d)\n", g_nsteps);
+	printf("  -dt : time step size (default: %g)\n", g_dt);
+	printf("  -i  : output interval in steps, 0 to disable output (default: %d)\n", g_interval);
+	printf("  -o  : output file for per-body state (default: %s)\n", g_output.c_str());
+	printf("  -mt : use btDiscreteDynamicsWorldMt with the given task scheduler (sequential, bullet, openmp, tbb, ppl)\n");
+	printf("  -t  : number of threads for -mt, 0 for the scheduler maximum (default: %d)\n", g_numthreads);
+	printf("  -scene   : scene description file (text or binary), the built-in scene if omitted\n");
+	printf("  -convert : save the scene file given by -scene in the binary format and exit\n");
+	printf("  -rays    : cast n rays per step with rayTestBatch like a lidar and report the query time\n");
+	printf("             (the sap broadphase keeps its raycast accelerator only with -rays)\n");
+	printf("  -rollback: save the world at the middle step, then restore it and replay the rest n times to check that the results match\n");
+	printf("  -record  : write the body states of every step to a state file (keyframes + changed bodies only)\n");
+	printf("  -resume  : set the body states from a state file recorded with the same scene and continue from there\n");
+	printf("  -from    : step to resume from, the last recorded step if omitted\n");
+	printf("  -broadphase : broadphase of the world (sap, axis3, dbvt, grid) (default: %s)\n", GetBroadphaseName(g_broadphasetype));
+	printf("  -bpbench : move n boxes at random and compare the time of the broadphases per frame,\n");
+	printf("             then add and remove n pairs per frame in the pair caches, then exit\n");
+	printf("  -meshcache: directory of the cached bvhs of the triangle meshes in the scene, none to disable (default: %s)\n", g_meshcache.Dir().c_str());
+	printf("  -softbench: drop an n x n cloth on a sphere and compare the link solvers (default, SoA serial, SoA batched),\n");
+	printf("              then drop 4 cloths on spheres with the serial and the multithreaded collision dispatcher, then exit\n");
+	printf("  -compare : compare the body states of every step with a state file recorded by another build (e.g. the scalar build) and report the difference\n");
+	printf("  -tol     : largest position difference allowed by -compare, fails with exit code 2 if exceeded (default: %g)\n", g_tol);
+	printf("  -bvhbench: build the bvh of a terrain of n triangles and compare the build and query times of the builders and layouts, then exit\n");
+}
+
+/*!
+* コマンドライン引数の解析
+* @return 正しく解析できたらtrue
+*/
+bool parseargs(int argc, char *argv[])
+{
+	for(int i = 1; i < argc; ++i){
+		string opt = argv[i];
+		if(opt != "-n" && opt != "-dt" && opt != "-i" && opt != "-o" && opt != "-mt" && opt != "-t" && opt != "-scene" && opt != "-convert" && opt != "-rays" && opt != "-rollback" &&
+		   opt != "-record" && opt != "-resume" && opt != "-from" && opt != "-broadphase" && opt != "-bpbench" && opt != "-bvhbench" && opt != "-softbench" && opt != "-meshcache" &&
+		   opt != "-compare" && opt != "-tol"){
+			if(opt != "-h" && opt != "--help") fprintf(stderr, "unknown option %s\n", argv[i]);
+			return false;
+		}
+		if(i+1 >= argc){
+			fprintf(stderr, "missing value for %s\n", argv[i]);
+			return false;
+		}
+		if(opt == "-n")       g_nsteps = atoi(argv[++i]);
+		else if(opt == "-dt") g_dt = (float)atof(argv[++i]);
+		else if(opt == "-i")  g_interval = atoi(argv[++i]);
+		else if(opt == "-o")  g_output = argv[++i];
+		else if(opt == "-t")  g_numthreads = atoi(argv[++i]);
+		else if(opt == "-scene") g_scenefile = argv[++i];
+		else if(opt == "-convert") g_convert = argv[++i];
+		else if(opt == "-rays") g_nrays = atoi(argv[++i]);
+		else if(opt == "-rollback") g_nrollbacks = atoi(argv[++i]);
+		else if(opt == "-record") g_record = argv[++i];
+		else if(opt == "-resume") g_resume = argv[++i];
+		else if(opt == "-from") g_from = atoi(argv[++i]);
+		else if(opt == "-bpbench") g_bpbench = atoi(argv[++i]);
+		else if(opt == "-bvhbench") g_bvhbench = atoi(argv[++i]);
+		else if(opt == "-softbench") g_softbench = atoi(argv[++i]);
+		else if(opt == "-compare") g_compare = argv[++i];
+		else if(opt == "-tol") g_tol = atof(argv[++i]);
+		else if(opt == "-meshcache"){
+			string dir = argv[++i];
+			g_meshcache.SetDir(dir == "none" ? "" : dir);
+		}
+		else if(opt == "-broadphase"){
+			string name = argv[++i];
+			g_broadphasetype = -1;
+			for(int j = 0; j < RX_BROADPHASE_NUM; ++j){
+				if(name == GetBroadphaseName(j)) g_broadphasetype = j;
+			}
+			if(g_broadphasetype < 0){
+				fprintf(stderr, "unknown broadphase %s\n", name.c_str());
+				return false;
+			}
+		}
+		else if(opt == "-mt"){
+			string name = argv[++i];
+			g_worldtype = RX_WORLD_MT;
+			g_scheduler = -1;
+			for(int j = 0; j < RX_SCHED_NUM; ++j){
+				if(name == GetTaskSchedulerName(j)) g_scheduler = j;
+			}
+			if(g_scheduler < 0){
+				fprintf(stderr, "unknown task scheduler %s\n", name.c_str());
+				return false;
+			}
+		}
+	}
+	if(!g_convert.empty() && g_scenefile.empty()){
+		fprintf(stderr, "-convert needs -scene\n");
+		return false;
+	}
+	return (g_nsteps > 0 && g_dt > 0.0f && g_interval >= 0 && g_nrays >= 0 && g_nrollbacks >= 0 && g_bpbench >= 0 && g_bvhbench >= 0 && g_softbench >= 0 && g_tol >= 0.0);
+}
+
+/*!
+* ブロードフェーズのベンチマーク
+*  - 同じ大きさの箱n個を立方体の領域内でランダムな速度で動かし(壁で反射)，毎フレーム全AABBの更新(setAabb)と
+*    ペアの計算(calculateOverlappingPairs)にかかる時間を計測する．ワールドは作らない
+*  - 箱の密度は一定(1辺1の箱が平均して数個の箱と重なる)なので，nを変えるとブロードフェーズだけの計算量の伸びがわかる
+* @param[in] bp ブロードフェーズ
+* @param[in] n 箱の数
+* @param[in] nframes 計測するフレーム数
+* @param[out] npairs 最後のフレームの重なっているペアの数
+* @return 1フレームあたりの時間[s]
+*/
+double bpbench(btBroadphaseInterface* bp, int n, int nframes, int &npairs)
+{
+	const btScalar size = 0.5;		// 箱の半分の大きさ
+	const btScalar side = btPow(btScalar(n)/0.2, btScalar(1.0/3.0));	// 領域の1辺の長さ
+	const btScalar dt = 1.0/60.0;
+
+	// 同じ乱数列で比べる
+	srand(12345);
+	btAlignedObjectArray<btVector3> pos, vel;
+	btAlignedObjectArray<btBroadphaseProxy*> proxies;
+	pos.resize(n);
+	vel.resize(n);
+	proxies.resize(n);
+	const btVector3 half(size, size, size);
+	for(int i = 0; i < n; ++i){
+		for(int k = 0; k < 3; ++k){
+			pos[i][k] = side*rand()/(btScalar)RAND_MAX;
+			vel[i][k] = 10.0*(rand()/(btScalar)RAND_MAX-0.5);
+		}
+		proxies[i] = bp->createProxy(pos[i]-half, pos[i]+half, BOX_SHAPE_PROXYTYPE, 0, btBroadphaseProxy::DefaultFilter, btBroadphaseProxy::AllFilter, 0);
+	}
+	bp->calculateOverlappingPairs(0);
+
+	rxTimer timer;
+	double time = 0.0;
+	for(int f = 0; f < nframes; ++f){
+		for(int i = 0; i < n; ++i){
+			pos[i] += vel[i]*dt;
+			for(int k = 0; k < 3; ++k){
+				if(pos[i][k] < 0 || pos[i][k] > side) vel[i][k] = -vel[i][k];
+			}
+		}
+
+		timer.Start();
+		for(int i = 0; i < n; ++i){
+			bp->setAabb(proxies[i], pos[i]-half, pos[i]+half, 0);
+		}
+		bp->calculateOverlappingPairs(0);
+		timer.Stop();
+		time += timer.GetTime(0);
+		timer.Reset();
+	}
+	npairs = bp->getOverlappingPairCache()->getNumOverlappingPairs();
+
+	for(int i = 0; i < n; ++i){
+		bp->destroyProxy(proxies[i], 0);
+	}
+	return time/nframes;
+}
+
+/*!
+* 番号の差がdのプロキシのペア(ペアキャッシュのベンチマーク用)
+*/
+void makepairs(btAlignedObjectArray<btBroadphaseProxy> &proxies, int d, btAlignedObjectArray<btBroadphasePair> &pairs)
+{
+	const int n = proxies.size();
+	for(int i = 0; i < n; ++i) pairs[i] = btBroadphasePair(proxies[i], proxies[(i+d)%n]);
+}
+
+/*!
+* ペアキャッシュの追加・削除のベンチマーク(ブロードフェーズなし)
+*  - n個のプロキシで，番号の差がf, f+1, ..., f+K-1のペア(n*K個)をキャッシュに入れておき，
+*    毎フレーム差がfのn個をremoveOverlappingPairsでまとめて消し，差がf+Kのn個をaddOverlappingPairsでまとめて追加する
+*  - ペアの1/Kが毎フレーム入れ替わる(物体が激しく動くシーンのペアの出入り)
+* @param[in] cache ペアキャッシュ
+* @param[in] n プロキシの数
+* @param[in] nframes 計測するフレーム数
+* @param[out] tadd,tremove 1フレームあたりの追加・削除の時間[s]
+* @return 最後のペアの数
+*/
+int churnbench(btOverlappingPairCache* cache, int n, int nframes, double &tadd, double &tremove)
+{
+	const int K = 4;
+	const int M = btMin(64, (n-1)/2);	// 差は1～M(n/2未満なので同じペアが2回現れない)
+
+	btAlignedObjectArray<btBroadphaseProxy> proxies;
+	proxies.resize(n);
+	for(int i = 0; i < n; ++i){
+		proxies[i].m_uniqueId = i+1;
+		proxies[i].m_collisionFilterGroup = btBroadphaseProxy::DefaultFilter;
+		proxies[i].m_collisionFilterMask = btBroadphaseProxy::AllFilter;
+	}
+
+	btAlignedObjectArray<btBroadphasePair> pairs;
+	pairs.resize(n);
+	for(int k = 0; k < K; ++k){
+		makepairs(proxies, 1+k, pairs);
+		cache->addOverlappingPairs(&pairs[0], n);
+	}
+
+	rxTimer timer;
+	tadd = tremove = 0.0;
+	for(int f = 0; f < nframes; ++f){
+		makepairs(proxies, 1+f%M, pairs);
+		timer.Start();
+		cache->removeOverlappingPairs(&pairs[0], n, 0);
+		timer.Stop();
+		tremove += timer.GetTime(0);
+		timer.Reset();
+
+		makepairs(proxies, 1+(f+K)%M, pairs);
+		timer.Start();
+		cache->addOverlappingPairs(&pairs[0], n);
+		timer.Stop();
+		tadd += timer.GetTime(0);
+		timer.Reset();
+	}
+	tadd /= nframes;
+	tremove /= nframes;
+	return cache->getNumOverlappingPairs();
+}
+
+/*!
+* 三角形の数を数えるコールバック(BVHのベンチマーク用)
+*/
+struct rxTriangleCounter : public btTriangleCallback
+{
+	int m_count;
+	rxTriangleCounter() : m_count(0){}
+	virtual void processTriangle(btVector3* triangle, int partId, int triangleIndex){ m_count++; }
+};
+
+/*!
+* 三角形メッシュのBVHのベンチマーク
+*  - 起伏のある地形のメッシュにAABBとレイ(半分は垂直,半分は斜め)を投げ，
+*    見つかった三角形の数とクエリにかかる時間を計測する．ワールドは作らない
+*  - 構築の方法(btQuantizedBvh::BUILD_MEAN/BUILD_SAH)とクエリに使う木(2分木/btQuantizedBvh4)の組み合わせを比べる
+* @param[in] n 三角形の数(の目安)
+* @param[in] mode 構築方法
+* @param[in] wide btQuantizedBvh4でクエリするならtrue
+* @param[out] tbuild 構築時間[s]
+* @param[out] taabb,tray AABB,レイのクエリ全体の時間[s]
+* @param[out] ntris 見つかった三角形の数(AABB+レイ)
+*/
+void bvhbench(int n, btQuantizedBvh::btBuildMode mode, bool wide, double &tbuild, double &taabb, double &tray, int &ntris)
+{
+	const int nqueries = 10000;
+
+	// 格子状の頂点の高さを正弦波と乱数でずらした地形
+	int m = (int)btSqrt(btScalar(n)/2)+1;
+	if(m < 2) m = 2;
+	srand(12345);
+	btAlignedObjectArray<btVector3> vertices;
+	btAlignedObjectArray<int> indices;
+	vertices.resize(m*m);
+	for(int j = 0; j < m; ++j){
+		for(int i = 0; i < m; ++i){
+			btScalar h = 2.0*btSin(0.1*i)*btCos(0.13*j)+0.2*rand()/(btScalar)RAND_MAX;
+			vertices[j*m+i].setValue(i, h, j);
+		}
+	}
+	for(int j = 0; j < m-1; ++j){
+		for(int i = 0; i < m-1; ++i){
+			int v = j*m+i;
+			indices.push_back(v); indices.push_back(v+1); indices.push_back(v+m);
+			indices.push_back(v+1); indices.push_back(v+m+1); indices.push_back(v+m);
+		}
+	}
+	btTriangleIndexVertexArray mesh(indices.size()/3, &indices[0], 3*sizeof(int), vertices.size(), vertices[0].m_floats, sizeof(btVector3));
+
+	rxTimer timer;
+	btBvhTriangleMeshShape* shape = new btBvhTriangleMeshShape(&mesh, true, false);
+	btOptimizedBvh* bvh = new btOptimizedBvh;
+	timer.Start();
+	bvh->build(&mesh, true, shape->getLocalAabbMin(), shape->getLocalAabbMax(), mode);
+	timer.Stop();
+	tbuild = timer.GetTime(0);
+	timer.Reset();
+	shape->setOptimizedBvh(bvh);
+	shape->setUseQuantizedBvh4(wide);
+
+	// 同じ乱数列のクエリで比べる
+	rxTriangleCounter counter;
+	btScalar side = m-1;
+	srand(54321);
+	timer.Start();
+	for(int q = 0; q < nqueries; ++q){
+		btVector3 c(side*rand()/(btScalar)RAND_MAX, 1.0, side*rand()/(btScalar)RAND_MAX);
+		btVector3 e(1.0+2.0*rand()/(btScalar)RAND_MAX, 3.0, 1.0+2.0*rand()/(btScalar)RAND_MAX);
+		shape->processAllTriangles(&counter, c-e, c+e);
+	}
+	timer.Stop();
+	taabb = timer.GetTime(0);
+	timer.Reset();
+
+	timer.Start();
+	for(int q = 0; q < nqueries; ++q){
+		btVector3 from(side*rand()/(btScalar)RAND_MAX, 10.0, side*rand()/(btScalar)RAND_MAX);
+		btVector3 to = (q%2 == 0) ? from-btVector3(0, 20, 0) : btVector3(side*rand()/(btScalar)RAND_MAX, -10.0, side*rand()/(btScalar)RAND_MAX);
+		shape->performRaycast(&counter, from, to);
+	}
+	timer.Stop();
+	tray = timer.GetTime(0);
+	ntris = counter.m_count;
+
+	delete shape;
+	delete bvh;
+}
+
+/*!
+* 布(btSoftBody)のベンチマーク
+*  - n×n節点の布を静止した球の上に落とし，角の1点を箱にアンカーで固定してnstepsステップ計算する
+*  - リンクの解き方(btSoftBody::setLinkSoA)だけを変えて，1ステップの時間と節点の位置を比べる．ワールドはこの中で作る
+*  - -mtのときは衝突判定にbtCollisionDispatcherMtを使い，布の計算もタスクスケジューラのスレッドで分ける
+* @param[in] n 1辺の節点の数
+* @param[in] mode 0:m_nodesのまま(デフォルト), 1:SoAで1本ずつ(m_linksの順), 2:SoAでバッチごとにSIMD
+* @param[in] nsteps ステップ数
+* @param[out] x1,x 1ステップ後と最後の節点の位置
+* @return 1ステップあたりの時間[s]
+*/
+double softbench(int n, int mode, int nsteps, btAlignedObjectArray<btVector3> &x1, btAlignedObjectArray<btVector3> &x)
+{
+	const btScalar dt = 1.0/60.0;
+
+	btSoftBodyRigidBodyCollisionConfiguration config;
+	btCollisionDispatcher* dispatcher = (g_worldtype == RX_WORLD_MT ? new btCollisionDispatcherMt(&config, 40) : new btCollisionDispatcher(&config));
+	btDbvtBroadphase broadphase;
+	btSequentialImpulseConstraintSolver solver;
+	btSoftRigidDynamicsWorld* world = new btSoftRigidDynamicsWorld(dispatcher, &broadphase, &solver, &config);
+	world->setGravity(btVector3(0, -9.8, 0));
+	btSoftBodyWorldInfo &info = world->getWorldInfo();
+	info.m_gravity = btVector3(0, -9.8, 0);
+	info.m_sparsesdf.Initialize();
+
+	// 布(4隅は固定しない)
+	btSoftBody* cloth = btSoftBodyHelpers::CreatePatch(info, btVector3(-2, 2, -2), btVector3(2, 2, -2), btVector3(-2, 2, 2), btVector3(2, 2, 2), n, n, 0, true);
+	cloth->m_cfg.piterations = 4;
+	cloth->m_cfg.viterations = 1;
+	cloth->m_cfg.diterations = 1;
+	cloth->m_cfg.m_vsequence.push_back(btSoftBody::eVSolver::Linear);
+	cloth->m_cfg.m_dsequence.push_back(btSoftBody::ePSolver::Linear);
+	cloth->m_cfg.kDP = 0.001;
+	cloth->m_cfg.kDF = 0.5;
+	cloth->getCollisionShape()->setMargin(0.02);
+	cloth->setTotalMass(2.0);
+	cloth->setLinkSoA(mode != 0, mode == 2);
+	world->addSoftBody(cloth);
+
+	// 布の下の球(剛体との接触)と角の節点の下に吊るす箱(アンカー．最初は布に触れないように離しておく)
+	btSphereShape sphere(0.8);
+	btRigidBody* ball = new btRigidBody(0, 0, &sphere);
+	ball->setWorldTransform(btTransform(btQuaternion::getIdentity(), btVector3(0, 0.9, 0)));
+	world->addRigidBody(ball);
+	btBoxShape box(btVector3(0.1, 0.1, 0.1));
+	btVector3 inertia;
+	box.calculateLocalInertia(1.0, inertia);
+	btRigidBody* weight = new btRigidBody(1.0, 0, &box, inertia);
+	weight->setWorldTransform(btTransform(btQuaternion::getIdentity(), cloth->m_nodes[n*n-1].m_x-btVector3(0, 0.3, 0)));
+	world->addRigidBody(weight);
+	cloth->appendAnchor(n*n-1, weight);
+
+	rxTimer timer;
+	double time = 0.0;
+	for(int i = 0; i < nsteps; ++i){
+		timer.Start();
+		world->stepSimulation(dt, 1, dt);
+		timer.Stop();
+		time += timer.GetTime(0);
+		timer.Reset();
+
+		if(i == 0 || i == nsteps-1){
+			btAlignedObjectArray<btVector3> &dst = (i == 0 ? x1 : x);
+			dst.resize(cloth->m_nodes.size());
+			for(int j = 0; j < cloth->m_nodes.size(); ++j) dst[j] = cloth->m_nodes[j].m_x;
+		}
+	}
+
+	world->removeSoftBody(cloth);
+	world->removeRigidBody(weight);
+	world->removeRigidBody(ball);
+	delete cloth;
+	delete weight;
+	delete ball;
+	delete world;
+	delete dispatcher;
+	return time/nsteps;
+}
+
+/*!
+* 布の衝突判定のチェック(btCollisionDispatcherMtで並列に呼ばれるソフトボディの衝突ハンドラ用)
+*  - n×n節点の布4枚を少しずつずらして重ね，静止した球と床の上に落とす(布どうし，布と剛体が接触する)
+*  - 剛体どうしの接触があるとマニフォールドの順番がスレッドで変わるので，動く剛体は置かない
+* @param[in] n 1辺の節点の数
+* @param[in] mt trueならbtCollisionDispatcherMt，falseならbtCollisionDispatcher
+* @param[in] clusters trueならクラスタ(CL_RS, CL_SS)，falseなら節点(SDF_RS, VF_SS)で衝突判定
+* @param[in] nsteps ステップ数
+* @param[out] x 最後の全節点の位置
+* @param[out] stats btSparseSdfのカウンタ(GarbageCollectを呼ばないので全ステップの合計)
+* @return 1ステップあたりの時間[s]
+*/
+double softcollide(int n, bool mt, bool clusters, int nsteps, btAlignedObjectArray<btVector3> &x, btSparseSdf<3>::Stats &stats)
+{
+	const btScalar dt = 1.0/60.0;
+
+	btSoftBodyRigidBodyCollisionConfiguration config;
+	btCollisionDispatcher* dispatcher = (mt ? new btCollisionDispatcherMt(&config, 40) : new btCollisionDispatcher(&config));
+	btDbvtBroadphase broadphase;
+	btSequentialImpulseConstraintSolver solver;
+	btSoftRigidDynamicsWorld* world = new btSoftRigidDynamicsWorld(dispatcher, &broadphase, &solver, &config);
+	world->setGravity(btVector3(0, -9.8, 0));
+	btSoftBodyWorldInfo &info = world->getWorldInfo();
+	info.m_gravity = btVector3(0, -9.8, 0);
+	info.m_sparsesdf.Initialize();
+
+	// 布(隣の布と半分ずつ重なる)
+	btAlignedObjectArray<btSoftBody*> cloths;
+	for(int k = 0; k < 4; ++k){
+		btVector3 c((k%2 ? 0.75 : -0.75), 1.5+0.3*k, (k/2 ? 0.75 : -0.75));
+		btSoftBody* cloth = btSoftBodyHelpers::CreatePatch(info, c+btVector3(-1.5, 0, -1.5), c+btVector3(1.5, 0, -1.5), c+btVector3(-1.5, 0, 1.5), c+btVector3(1.5, 0, 1.5), n, n, 0, true);
+		cloth->m_cfg.piterations = 4;
+		cloth->m_cfg.kDF = 0.5;
+		cloth->getCollisionShape()->setMargin(0.05);
+		cloth->setTotalMass(1.0);
+		if(clusters){
+			cloth->generateClusters(16);
+			cloth->m_cfg.collisions = btSoftBody::fCollision::CL_RS | btSoftBody::fCollision::CL_SS;
+		}
+		else{
+			cloth->m_cfg.collisions = btSoftBody::fCollision::SDF_RS | btSoftBody::fCollision::VF_SS;
+		}
+		world->addSoftBody(cloth);
+		cloths.push_back(cloth);
+	}
+
+	// 静止した球(3x3)と床
+	btSphereShape sphere(0.4);
+	btBoxShape ground(btVector3(5, 0.5, 5));
+	btAlignedObjectArray<btRigidBody*> bodies;
+	for(int k = 0; k < 10; ++k){
+		btRigidBody* body = new btRigidBody(0, 0, (k < 9 ? (btCollisionShape*)&sphere : &ground));
+		btVector3 pos = (k < 9 ? btVector3(1.2*(k%3-1), 0.4, 1.2*(k/3-1)) : btVector3(0, -0.5, 0));
+		body->setWorldTransform(btTransform(btQuaternion::getIdentity(), pos));
+		world->addRigidBody(body);
+		bodies.push_back(body);
+	}
+
+	rxTimer timer;
+	double time = 0.0;
+	for(int i = 0; i < nsteps; ++i){
+		timer.Start();
+		world->stepSimulation(dt, 1, dt);
+		timer.Stop();
+		time += timer.GetTime(0);
+		timer.Reset();
+	}
+	stats = info.m_sparsesdf.getStats();
+
+	x.resize(0);
+	for(int k = 0; k < cloths.size(); ++k){
+		for(int j = 0; j < cloths[k]->m_nodes.size(); ++j) x.push_back(cloths[k]->m_nodes[j].m_x);
+		world->removeSoftBody(cloths[k]);
+		delete cloths[k];
+	}
+	for(int k = 0; k < bodies.size(); ++k){
+		world->removeRigidBody(bodies[k]);
+		delete bodies[k];
+	}
+	delete world;
+	delete dispatcher;
+	return time/nsteps;
+}
+
+/*!
+* 節点の位置の差の最大値と重心の差(布のベンチマーク用)
+*  - 解く順番が違うと布の折れ方が変わって節点の差は大きくなるが，全体の動き(重心)はほぼ同じになる
+*/
+double maxdiff(const btAlignedObjectArray<btVector3> &a, const btAlignedObjectArray<btVector3> &b, double &dcenter)
+{
+	double d = 0.0;
+	btVector3 c(0, 0, 0);
+	for(int i = 0; i < a.size() && i < b.size(); ++i){
+		d = btMax(d, (double)(a[i]-b[i]).length());
+		c += a[i]-b[i];
+	}
+	dcenter = (a.size() ? c.length()/a.size() : 0.0);
+	return d;
+}
+
+/*!
+* ライダーを模したレイの設定
+*  - ワールドの中心の上から全方位に放射状に投げる(仰角方向32本×方位角方向n/32本)
+* @param[in] n レイの数
+* @param[out] from,to レイの始点と終点
+*/
+void setlidarrays(int n, btAlignedObjectArray<btVector3> &from, btAlignedObjectArray<btVector3> &to)
+{
+	const int rows = 32;
+	const int cols = (n+rows-1)/rows;
+	const btVector3 origin(0.0, 5.0, 0.0);
+	const btScalar range = 100.0;
+	from.resize(n);
+	to.resize(n);
+	for(int i = 0; i < n; ++i){
+		// 同じ行のレイを隣り合わせにしてパケット(4本)内の方向をそろえる
+		btScalar phi = SIMD_PI*((i/cols)+0.5)/rows-SIMD_HALF_PI;
+		btScalar theta = SIMD_2_PI*(i%cols)/cols;
+		from[i] = origin;
+		to[i] = origin+range*btVector3(btCos(phi)*btCos(theta), btSin(phi), btCos(phi)*btSin(theta));
+	}
+}
+
+/*!
+* 全剛体の状態(位置,姿勢,速度,角速度,アクティブ状態)をファイルに出力
+* @param[in] fp 出力先ファイル
+* @param[in] step,t 現在のステップ数と時刻
+*/
+void writestate(FILE* fp, int step, double t)
+{
+	const int n = g_dynamicsworld->getNumCollisionObjects();
+	for(int i = 0; i < n; ++i){
+		btCollisionObject* obj = g_dynamicsworld->getCollisionObjectArray()[i];
+		btRigidBody* body = btRigidBody::upcast(obj);
+		if(!body) continue;
+
+		const btTransform &trans = body->getCenterOfMassTransform();
+		btVector3 p = trans.getOrigin();
+		btQuaternion q = trans.getRotation();
+		btVector3 v = body->getLinearVelocity();
+		btVector3 w = body->getAngularVelocity();
+		fprintf(fp, "%d,%.6f,%d,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%d\n", step, t, i,
+				p[0], p[1], p[2], q[0], q[1], q[2], q[3], v[0], v[1], v[2], w[0], w[1], w[2], body->isActive() ? 1 : 0);
+	}
+}
+
+/*!
+* 全剛体の状態(位置,姿勢,速度,角速度)のハッシュ値(FNV-1a)
+*  - 再計算した結果がビット単位で一致するかの確認用
+*/
+unsigned long long statehash(void)
+{
+	unsigned long long h = 14695981039346656037ULL;
+	const int n = g_dynamicsworld->getNumCollisionObjects();
+	for(int i = 0; i < n; ++i){
+		btRigidBody* body = btRigidBody::upcast(g_dynamicsworld->getCollisionObjectArray()[i]);
+		if(!body) continue;
+
+		// btVector3の4番目の要素は使われないので3要素ずつ並べる
+		const btTransform &trans = body->getCenterOfMassTransform();
+		const btVector3* v[6] = { &trans.getBasis()[0], &trans.getBasis()[1], &trans.getBasis()[2], &trans.getOrigin(),
+								  &body->getLinearVelocity(), &body->getAngularVelocity() };
+		btScalar x[18];
+		for(int j = 0; j < 6; ++j){
+			x[3*j] = v[j]->x(); x[3*j+1] = v[j]->y(); x[3*j+2] = v[j]->z();
+		}
+		const unsigned char* c = (const unsigned char*)x;
+		for(size_t j = 0; j < sizeof(x); ++j){
+			h = (h^c[j])*1099511628211ULL;
+		}
+	}
+	return h;
+}
+
+/*!
+* 拘束ソルバ(btSequentialImpulseConstraintSolver)が使っている1行分の計算の種類
+*  - SIMD版はSSE2．BT_USE_FMA3_RUNTIME_DISPATCH付きでビルドしたBulletではsetupSolverFunctionsが最初のステップでCPUに合わせてSSE4.1/FMA3を選ぶ
+*/
+const char* rowsolvername(void)
+{
+	btSequentialImpulseConstraintSolver* solver = dynamic_cast<btSequentialImpulseConstraintSolver*>(g_dynamicsworld->getConstraintSolver());
+	if(!solver) return "unknown";
+	btSingleConstraintRowSolver f = solver->getActiveConstraintRowSolverGeneric();
+#ifdef USE_SIMD
+#ifdef BT_ALLOW_SSE4
+	if(f == solver->getSSE4_1ConstraintRowSolverGeneric()) return "sse4.1/fma3";
+#endif
+	if(f == solver->getSSE2ConstraintRowSolverGeneric()) return "sse2";
+#endif
+	return (f == solver->getScalarConstraintRowSolverGeneric() ? "scalar" : "unknown");
+}
+
+/*!
+* 別のビルド(スカラー版など)で記録した状態との比較(-compare)
+*  - 毎ステップ全剛体の状態を記録と比べ，ビット単位で一致しなくなった最初のステップと
+*    位置の差が許容値(g_tol)を超えた最初のステップ，差の最大値を記録する
+*/
+struct rxCompare
+{
+	rxStateFile file;
+	vector<rxStateBody> ref;	//!< 記録された状態(剛体の番号順)
+	int last;					//!< refに入っている状態のステップ
+	int steps;					//!< 比べたステップ数
+	int first, over;			//!< ビット単位で一致しなくなった/許容値を超えた最初のステップ
+	double dpos, drot;			//!< 位置，回転行列の要素の差の最大値
+	bool ended;					//!< 記録が終わった
+
+	rxCompare() : last(-1), steps(0), first(-1), over(-1), dpos(0.0), drot(0.0), ended(false){}
+
+	void Check(int step)
+	{
+		// 記録が途中で終わっていたらそれ以降は比べない
+		if(ended) return;
+		int s = file.Get(step, ref, last);
+		if(s != step){
+			ended = true;
+			return;
+		}
+		last = s;
+		steps++;
+
+		double dp = 0.0;
+		bool diff = false;
+		const int n = g_dynamicsworld->getNumCollisionObjects();
+		for(int i = 0; i < n; ++i){
+			rxStateBody b;
+			GetBodyState(g_dynamicsworld->getCollisionObjectArray()[i], b);
+			if(!memcmp(&b, &ref[i], sizeof(rxStateBody))) continue;
+
+			diff = true;
+			for(int k = 0; k < 3; ++k) dp = btMax(dp, (double)btFabs(b.pos[k]-ref[i].pos[k]));
+			for(int k = 0; k < 9; ++k) drot = btMax(drot, (double)btFabs(b.basis[k]-ref[i].basis[k]));
+		}
+		if(diff && first < 0) first = step;
+		if(dp > g_tol && over < 0) over = step;
+		dpos = btMax(dpos, dp);
+	}
+};
+
+
+/*!
+* Bulletのヒープ確保を数えるメモリ確保関数(btAlignedAllocSetCustom用)
+*  - タスクスケジューラのスレッドからも呼ばれるのでカウンタはatomicにする
+*/
+void* countalloc(size_t size)
+{
+	g_nallocs++;
+	return malloc(size);
+}
+void countfree(void* ptr)
+{
+	free(ptr);
+}
+
+/*!
+* メモリプールの使用状況の表示
+* @param[in] name 表示名
+* @param[in] pool メモリプール
+*/
+void printpool(const char* name, const btPoolAllocator* pool)
+{
+	if(!pool) return;
+	cout << "  " << name << " : " << pool->getUsedCount() << " used, " << pool->getHighWaterCount() << " peak, "
+		 << pool->getMaxCount() << " capacity (" << pool->getChunkCount() << " chunks), "
+		 << pool->getFailedCount() << " heap fallbacks" << endl;
+}
+
+
+/*!
+ * メインルーチン
+ * @param[in] argc コマンドライン引数の数
+ * @param[in] argv コマンドライン引数
+ */
+int main(int argc, char *argv[])
+{
+	if(!parseargs(argc, argv)){
+		usage(argv[0]);
+		return 1;
+	}
+
+	// シーンファイルのバイナリ形式への変換
+	if(!g_convert.empty()){
+		rxSceneFile scene;
+		if(!scene.Open(g_scenefile) || !scene.SaveBinary(g_convert)) return 1;
+		cout << "saved " << scene.NumBodies() << " bodies to " << g_convert << endl;
+		return 0;
+	}
+
+	// ブロードフェーズのベンチマーク(-mtのスケジューラのスレッドでbtSortAndSweepBroadphase/btHashedGridBroadphaseを並列化する)
+	if(g_bpbench){
+		int nthreads = 1;
+		if(g_worldtype == RX_WORLD_MT){
+			g_scheduler = SetTaskScheduler(g_scheduler, g_numthreads);
+			nthreads = btGetTaskScheduler()->getNumThreads();
+		}
+		const int nframes = 100;
+		cout << "broadphase benchmark : " << g_bpbench << " boxes, " << nframes << " frames, " << nthreads << " threads" << endl;
+		for(int k = 0; k < 6; ++k){
+			btBroadphaseInterface* bp = 0;
+			btOverlappingPairCache* paircache = 0;
+			const char* name = 0;
+			if(k == 0){ bp = new btDbvtBroadphase(); name = "btDbvtBroadphase"; }
+			if(k == 1){ bp = new btSortAndSweepBroadphase(0, true); name = "btSortAndSweepBroadphase"; }
+			if(k == 2){
+				// ペアキャッシュの比較(デフォルトはbtHashedOverlappingPairCache)
+				paircache = new btOpenAddressingPairCache();
+				bp = new btSortAndSweepBroadphase(paircache, true);
+				name = "btSortAndSweepBroadphase + btOpenAddressingPairCache";
+			}
+			if(k == 3){ bp = new btSortAndSweepBroadphase(); name = "btSortAndSweepBroadphase + raycast accelerator"; }
+			if(k == 4){ bp = new btHashedGridBroadphase(0, true); name = "btHashedGridBroadphase"; }
+			if(k == 5){
+				// 16bit版は16383個まで
+				if(g_bpbench >= 16384) continue;
+				btScalar side = btPow(btScalar(g_bpbench)/0.2, btScalar(1.0/3.0));
+				bp = new btAxisSweep3(btVector3(-1, -1, -1), btVector3(side+1, side+1, side+1), g_bpbench+1);
+				name = "btAxisSweep3";
+			}
+			int npairs = 0;
+			double t = bpbench(bp, g_bpbench, nframes, npairs);
+			printf("  %-56s : %9.3f [ms/frame], %d pairs\n", name, 1000.0*t, npairs);
+			delete bp;
+			delete paircache;
+		}
+
+		// ペアの出入りが多いときのペアキャッシュの比較(btOpenAddressingPairCacheはまとめた追加・削除を並列に行う)
+		if(g_bpbench >= 8){
+			cout << "pair cache churn : " << g_bpbench << " proxies, " << 4*g_bpbench << " pairs, " << g_bpbench << " added and removed per frame" << endl;
+			for(int k = 0; k < 2; ++k){
+				btOverlappingPairCache* cache = (k == 0 ? (btOverlappingPairCache*)new btHashedOverlappingPairCache() : new btOpenAddressingPairCache());
+				double tadd, tremove;
+				int npairs = churnbench(cache, g_bpbench, nframes, tadd, tremove);
+				printf("  %-56s : add %8.3f, remove %8.3f [ms/frame], %d pairs\n", (k == 0 ? "btHashedOverlappingPairCache" : "btOpenAddressingPairCache"), 1000.0*tadd, 1000.0*tremove, npairs);
+				delete cache;
+			}
+		}
+		return 0;
+	}
+
+	// 三角形メッシュのBVHのベンチマーク(-mtのスケジューラのスレッドでSAHでの構築を並列化する．構築方法は木ごとにbtOptimizedBvh::buildの引数で指定する)
+	if(g_bvhbench){
+		int nthreads = 1;
+		if(g_worldtype == RX_WORLD_MT){
+			g_scheduler = SetTaskScheduler(g_scheduler, g_numthreads);
+			nthreads = btGetTaskScheduler()->getNumThreads();
+		}
+		cout << "bvh benchmark : " << g_bvhbench << " triangles, " << nthreads << " threads" << endl;
+		for(int k = 0; k < 4; ++k){
+			btQuantizedBvh::btBuildMode mode = (k < 2 ? btQuantizedBvh::BUILD_MEAN : btQuantizedBvh::BUILD_SAH);
+			bool wide = (k%2 == 1);
+			double tbuild, taabb, tray;
+			int ntris = 0;
+			bvhbench(g_bvhbench, mode, wide, tbuild, taabb, tray, ntris);
+			printf("  %-4s + %-15s : build %8.3f [ms], aabb %8.3f [ms], ray %8.3f [ms], %d triangles\n",
+				   (mode == btQuantizedBvh::BUILD_SAH ? "SAH" : "mean"), (wide ? "btQuantizedBvh4" : "binary"), 1000.0*tbuild, 1000.0*taabb, 1000.0*tray, ntris);
+		}
+		return 0;
+	}
+
+	// 布のリンクの解き方の比較(SoAで1本ずつ解いた結果はデフォルトとビット単位で一致するはず)
+	if(g_softbench){
+		int nthreads = 1;
+		if(g_worldtype == RX_WORLD_MT){
+			g_scheduler = SetTaskScheduler(g_scheduler, g_numthreads);
+			nthreads = btGetTaskScheduler()->getNumThreads();
+		}
+		const int nsteps = 200;
+		cout << "soft body benchmark : " << g_softbench << "x" << g_softbench << " cloth, " << nsteps << " steps, " << nthreads << " threads" << endl;
+		const char* names[3] = { "default (m_nodes)", "SoA serial", "SoA batched" };
+		btAlignedObjectArray<btVector3> x1[3], x[3];
+		bool identical = true;
+		for(int k = 0; k < 3; ++k){
+			double t = softbench(g_softbench, k, nsteps, x1[k], x[k]);
+			printf("  %-18s : %8.3f [ms/step]", names[k], 1000.0*t);
+			if(k){
+				bool same = (x[k].size() == x[0].size() && !memcmp(&x[k][0], &x[0][0], x[0].size()*sizeof(btVector3)));
+				double dc1, dc;
+				double d1 = maxdiff(x1[k], x1[0], dc1), d = maxdiff(x[k], x[0], dc);
+				printf(", node difference after 1 step %g, after %d steps %g (center %g)%s", d1, nsteps, d, dc, (same ? " (bit-identical)" : ""));
+				if(k == 1 && !same) identical = false;
+			}
+			printf("\n");
+		}
+		if(!identical){
+			cout << "SoA serial differs from the default solver" << endl;
+			return 2;
+		}
+
+		// 衝突ハンドラをbtCollisionDispatcherMtから並列に呼んでも節点の衝突はビット単位で一致するはず
+		// (クラスタの衝突はジョイントを追加する順番がスレッドで変わるので差だけを表示する)
+		if(!btGetTaskScheduler()) btSetTaskScheduler(btGetSequentialTaskScheduler());
+		const int ncsteps = 150, nc = 16;
+		cout << "soft body collision : 4 " << nc << "x" << nc << " cloths on 9 spheres, " << ncsteps << " steps, btCollisionDispatcher vs btCollisionDispatcherMt" << endl;
+		for(int k = 0; k < 2; ++k){
+			btAlignedObjectArray<btVector3> xs, xm;
+			btSparseSdf<3>::Stats ss, sm;
+			double ts = softcollide(nc, false, k == 1, ncsteps, xs, ss);
+			double tm = softcollide(nc, true, k == 1, ncsteps, xm, sm);
+			bool same = (xs.size() == xm.size() && !memcmp(&xs[0], &xm[0], xs.size()*sizeof(btVector3)));
+			double dc;
+			double d = maxdiff(xm, xs, dc);
+			printf("  %-18s : %8.3f / %8.3f [ms/step], node difference %g%s\n", (k ? "CL_RS + CL_SS" : "SDF_RS + VF_SS"), 1000.0*ts, 1000.0*tm, d, (same ? " (bit-identical)" : ""));
+			if(!k){
+				printf("  %-18s : %d hits, %d misses, %d prefetched, %d evictions, %d cells (%.1f KB)\n", "btSparseSdf", sm.hits, sm.misses, sm.prefetched, sm.evictions, sm.cells, sm.bytes/1024.0);
+				if(!same) identical = false;
+			}
+		}
+		if(!identical){
+			cout << "btCollisionDispatcherMt differs from btCollisionDispatcher" << endl;
+			return 2;
+		}
+		return 0;
+	}
+
+	FILE* fp = 0;
+	if(g_interval > 0){
+		if((fp = fopen(g_output.c_str(), "w")) == NULL){
+			fprintf(stderr, "failed to open %s\n", g_output.c_str());
+			return 1;
+		}
+		fprintf(fp, "step,time,index,px,py,pz,qx,qy,qz,qw,vx,vy,vz,wx,wy,wz,active\n");
+	}
+
+	// GUI版と同じシーンを構築(レイを投げるときだけsapにレイ判定用の木を持たせる)
+	g_raycastaccel = (g_nrays > 0);
+	btAlignedAllocSetCustom(countalloc, countfree);
+	InitBullet();
+	cout << "bodies : " << g_dynamicsworld->getNumCollisionObjects() << endl;
+
+	// 状態ファイルから剛体の状態を設定して，そのステップから計算を続ける
+	rxTimer timer;
+	int step0 = 0;
+	if(!g_resume.empty()){
+		rxStateFile state;
+		timer.Start();
+		if(state.Open(g_resume)) step0 = state.Apply(g_dynamicsworld, g_from < 0 ? state.LastStep() : g_from);
+		timer.Stop();
+		if(!state.IsOpen() || step0 < 0){
+			fprintf(stderr, "failed to resume from %s (the scene must be the same as when it was recorded)\n", g_resume.c_str());
+			return 1;
+		}
+		cout << "resume : step " << step0 << " of " << g_resume << " (" << state.NumChunks() << " chunks) loaded in " << 1000.0*timer.GetTime(0) << " [ms]" << endl;
+		timer.Reset();
+	}
+
+	// 別のビルドで記録した状態との比較
+	rxCompare compare;
+	if(!g_compare.empty()){
+		if(!compare.file.Open(g_compare)) return 1;
+		if(compare.file.Header().nbodies != g_dynamicsworld->getNumCollisionObjects()){
+			fprintf(stderr, "%s was recorded with a different scene\n", g_compare.c_str());
+			return 1;
+		}
+		compare.Check(step0);
+	}
+
+	// 剛体の状態の記録(最初の状態はキーフレームになる)
+	rxStateWriter recorder;
+	double record_time = 0.0;
+	if(!g_record.empty()){
+		if(!recorder.Open(g_record, g_dynamicsworld, g_dt)) return 1;
+		recorder.Write(g_dynamicsworld, step0);
+	}
+
+	if(fp) writestate(fp, step0, step0*(double)g_dt);
+
+	// レイと結果の配列はステップ間で使い回す
+	btAlignedObjectArray<btVector3> ray_from, ray_to;
+	btCollisionWorld::BatchedQueryResults ray_results;
+	if(g_nrays) setlidarrays(g_nrays, ray_from, ray_to);
+	double ray_time = 0.0;
+	long long ray_hits = 0;
+
+	// 出力にかかる時間は除いてステップ計算の時間だけを計測する
+	double sim_time = 0.0;
+	long long nallocs = 0;
+	rxBulletState rollback_state;
+	double save_time = 0.0;
+	for(int i = 1; i <= g_nsteps; ++i){
+		// 後半のステップ(接触が落ち着いた状態)でのヒープ確保の回数を数える
+		if(i == g_nsteps/2+1) nallocs = g_nallocs;
+
+		timer.Start();
+		// 1回の呼び出しでg_dtだけ実際に計算を進める(内部の固定ステップ幅もg_dtにする)
+		StepBullet(g_dt, 1, g_dt);
+		timer.Stop();
+		sim_time += timer.GetTime(0);
+		timer.Reset();
+
+		if(g_nrays){
+			timer.Start();
+			g_dynamicsworld->rayTestBatch(&ray_from[0], &ray_to[0], g_nrays, ray_results);
+			timer.Stop();
+			ray_time += timer.GetTime(0);
+			timer.Reset();
+			for(int j = 0; j < g_nrays; ++j){
+				if(ray_results.m_collisionObjects[j]) ray_hits++;
+			}
+		}
+
+		if(fp && i%g_interval == 0) writestate(fp, step0+i, (step0+i)*(double)g_dt);
+
+		if(compare.file.IsOpen()) compare.Check(step0+i);
+
+		if(recorder.IsOpen()){
+			timer.Start();
+			recorder.Write(g_dynamicsworld, step0+i);
+			timer.Stop();
+			record_time += timer.GetTime(0);
+			timer.Reset();
+		}
+
+		// ロールバック用に途中の状態を保存
+		if(g_nrollbacks && i == g_nsteps/2){
+			timer.Start();
+			SaveBulletState(rollback_state);
+			timer.Stop();
+			save_time = timer.GetTime(0);
+			timer.Reset();
+		}
+	}
+
+	nallocs = g_nallocs-nallocs;
+
+	if(recorder.IsOpen()){
+		cout << "record : " << recorder.NumChunks() << " chunks, " << (recorder.NumChunks() ? (double)recorder.NumRecords()/recorder.NumChunks() : 0.0) << " bodies per step, "
+			 << recorder.NumBytes()/(1024.0*1024.0) << " [MB] to " << g_record << " in " << record_time << " [s]" << endl;
+		if(!recorder.Close()) cout << "record : failed to write " << g_record << endl;
+	}
+
+	if(fp){
+		fclose(fp);
+		cout << "saved the body states to " << g_output << endl;
+	}
+
+	// 記録との比較の結果(記録が足りない場合や許容値を超えた場合は終了コード2．記録の書き込みに失敗した場合は1)
+	int status = (recorder.Failed() ? 1 : 0);
+	if(compare.file.IsOpen()){
+		cout << "compare : " << compare.steps << " steps with " << g_compare << " (solver rows : " << rowsolvername() << ")" << endl;
+		if(compare.first < 0){
+			cout << "  bit-identical in all steps" << endl;
+		}
+		else{
+			cout << "  bit-identical up to step " << compare.first-1 << endl;
+		}
+		cout << "  max difference : position " << compare.dpos << ", rotation " << compare.drot << endl;
+		if(compare.over >= 0){
+			cout << "  position difference exceeds " << g_tol << " at step " << compare.over << endl;
+			status = 2;
+		}
+		else if(compare.steps < g_nsteps+1){
+			cout << "  " << g_compare << " ends at step " << compare.last << endl;
+			status = 2;
+		}
+		else{
+			cout << "  within the tolerance " << g_tol << endl;
+		}
+	}
+	cout << "steps  : " << g_nsteps << " (dt = " << g_dt << ")" << endl;
+	cout << "time   : " << sim_time << " [s]" << endl;
+	cout << "speed  : " << (sim_time > 0.0 ? g_nsteps/sim_time : 0.0) << " [steps/s]" << endl;
+	if(g_nrays){
+		double nrays = (double)g_nrays*g_nsteps;
+		cout << "rays   : " << g_nrays << " per step, " << 100.0*ray_hits/nrays << " [%] hit" << endl;
+		cout << "ray time : " << ray_time << " [s] (" << (ray_time > 0.0 ? nrays/ray_time : 0.0) << " [rays/s])" << endl;
+	}
+
+	// ヒープ確保の回数と接触マニフォールド/衝突アルゴリズムのメモリプールの使用状況
+	int nlast = g_nsteps-g_nsteps/2;
+	cout << "allocs : " << nallocs << " in the last " << nlast << " steps (" << (double)nallocs/nlast << " per step)" << endl;
+	btCollisionDispatcher* dispatcher = static_cast<btCollisionDispatcher*>(g_dynamicsworld->getDispatcher());
+	cout << "pools  :" << endl;
+	printpool("manifolds ", dispatcher->getInternalManifoldPool());
+	printpool("algorithms", dispatcher->getCollisionConfiguration()->getCollisionAlgorithmPool());
+
+	// 途中の状態に戻して後半を再計算し，最終状態が一致するか確認(決定性のチェック)
+	if(g_nrollbacks){
+		if(!rollback_state.valid){
+			cout << "rollback : the world does not support snapshots" << endl;
+		}
+		else{
+			unsigned long long hash = statehash();
+			int nmatch = 0;
+			double restore_time = 0.0;
+			for(int k = 0; k < g_nrollbacks; ++k){
+				timer.Start();
+				bool ok = RestoreBulletState(rollback_state);
+				timer.Stop();
+				restore_time += timer.GetTime(0);
+				timer.Reset();
+				if(!ok) break;
+
+				for(int i = g_nsteps/2+1; i <= g_nsteps; ++i){
+					StepBullet(g_dt, 1, g_dt);
+				}
+				if(statehash() == hash) nmatch++;
+			}
+			cout << "rollback : " << nmatch << "/" << g_nrollbacks << " replays of " << nlast << " steps matched" << endl;
+			cout << "snapshot : " << rollback_state.world.size()/1024.0 << " [KB], save " << 1000.0*save_time << " [ms], restore "
+				 << 1000.0*restore_time/g_nrollbacks << " [ms]" << endl;
+		}
+	}
+
+	CleanBullet();
+
+	return status;
+}
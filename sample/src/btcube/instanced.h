@@ -0,0 +1,394 @@
+/*!
+  @file instanced.h
+
+  @brief Bullet剛体のインスタンス描画
+		 - 箱,球,円筒の剛体を基本形状と状態(描画色)ごとにまとめ，1グループ1回のインスタンス描画で描く
+		 - 各剛体の位置・姿勢と大きさは1フレームに1回だけ1つのバッファにまとめて転送する
+		 - GL_ARB_draw_instanced/GL_ARB_instanced_arraysが使えない環境(GL2.1)では従来の1剛体ずつの描画を使う
+		 - utils.h(MeshVBO,形状生成関数,シャドウマップ用シェーダ)の後にインクルードすること
+
+  @author Makoto Fujisawa
+  @date   2026-10
+*/
+
+#ifndef _INSTANCED_H_
+#define _INSTANCED_H_
+
+
+//-----------------------------------------------------------------------------
+// インクルードファイル
+//-----------------------------------------------------------------------------
+#include "simthread.h"
+
+
+//-----------------------------------------------------------------------------
+// インスタンス描画用シェーダ
+//  - 頂点シェーダ以外はシャドウマップのシェーダ(rx_shadow_glsl.h)と同じ
+//-----------------------------------------------------------------------------
+const char instanced_vs[] = RXSTR(
+// インスタンスごとの変換(剛体の位置・姿勢と形状の大きさ)
+attribute vec4 inst_m0;
+attribute vec4 inst_m1;
+attribute vec4 inst_m2;
+attribute vec4 inst_m3;
+attribute vec3 inst_scale;
+
+// フラグメントシェーダに値を渡すための変数
+varying vec4 vPos;
+varying vec3 vNrm;
+varying vec4 vShadowCoord;	//!< シャドウデプスマップの参照用座標
+
+void main(void)
+{
+	mat4 m = mat4(inst_m0, inst_m1, inst_m2, inst_m3);
+
+	// 大きさは頂点に，その逆数は法線に掛ける(非一様スケール対策)
+	vec4 p = m*vec4(gl_Vertex.xyz*inst_scale, 1.0);
+	vec3 n = (m*vec4(gl_Normal/inst_scale, 0.0)).xyz;
+
+	// フラグメントシェーダでの計算用(モデルビュー変換のみ)
+	vPos = gl_ModelViewMatrix*p;					// 頂点位置
+	vNrm = normalize(gl_NormalMatrix*n);			// 頂点法線
+	vShadowCoord = gl_TextureMatrix[7]*vPos;		// 影用座標値(光源中心座標)
+
+	// 描画用
+	gl_Position = gl_ProjectionMatrix*vPos;	// 頂点位置
+	gl_FrontColor = gl_Color;				// 頂点色
+	gl_TexCoord[0] = gl_TextureMatrix[0]*gl_MultiTexCoord0;		// 頂点テクスチャ座標
+}
+);
+
+//! シャドウマップ生成(デプスのみ)用
+const char instanced_depth_fs[] = RXSTR(
+void main(void)
+{
+	gl_FragColor = vec4(1.0);
+}
+);
+
+
+//-----------------------------------------------------------------------------
+// 剛体のインスタンス描画クラス
+//-----------------------------------------------------------------------------
+class rxInstancedBodies
+{
+public:
+	//! インスタンス描画する基本形状
+	enum
+	{
+		RX_INST_CUBE = 0,	//!< 辺の長さ1の立方体
+		RX_INST_SPHERE,		//!< 直径1の球
+		RX_INST_CYLINDER,	//!< 直径1,長さ1の円筒(z軸方向)
+		RX_INST_MESHES,
+	};
+	static const int NSTATES = 3;	//!< 剛体の状態数(RX_BODY_*)
+	static const int NKEYS = RX_INST_MESHES*NSTATES;
+	static const int NFLOATS = 19;	//!< 1インスタンスのデータ(変換行列16+大きさ3)
+
+	//! インスタンス属性の位置(glVertexPointerなどの組み込み属性と重ならないように8から)
+	enum
+	{
+		RX_ATTRIB_M0 = 8,
+		RX_ATTRIB_SCALE = 12,
+	};
+
+protected:
+	bool m_bSupported;				//!< インスタンス描画が使えるかどうか
+
+	MeshVBO m_vbo[RX_INST_MESHES];	//!< 基本形状のVBO
+	GLenum m_iMode[RX_INST_MESHES];	//!< 基本形状のポリゴンの種類
+	int m_iElem[RX_INST_MESHES];	//!< 1ポリゴンの頂点数
+
+	GLuint m_iProgLit;				//!< 影付き描画用
+	GLuint m_iProgDepth;			//!< シャドウマップ生成用
+
+	GLuint m_iInstVBO;				//!< インスタンスデータ
+	vector<GLfloat> m_vInst;		//!< インスタンスデータ(グループごとに連続)
+	int m_iStart[NKEYS];			//!< 各グループの開始インスタンス
+	int m_iCount[NKEYS];			//!< 各グループのインスタンス数
+	vector<char> m_vInstanced;		//!< スナップショットの各剛体をインスタンス描画するかどうか
+	vector<int> m_vKey;				//!< 作業用 : 各剛体のグループ
+
+public:
+	rxInstancedBodies() : m_bSupported(false), m_iProgLit(0), m_iProgDepth(0), m_iInstVBO(0)
+	{
+		for(int k = 0; k < NKEYS; ++k) m_iStart[k] = m_iCount[k] = 0;
+	}
+
+	//! インスタンス描画が使えるかどうか
+	bool IsSupported(void) const { return m_bSupported; }
+
+	//! 直前のBuildでi番目の剛体をインスタンス描画に含めたかどうか
+	bool IsInstanced(int i) const { return i < (int)m_vInstanced.size() && m_vInstanced[i]; }
+
+	/*!
+	 * 初期化(OpenGLコンテキスト作成後に呼ぶ)
+	 * @return インスタンス描画が使えればtrue
+	 */
+	bool Init(void)
+	{
+		m_bSupported = false;
+		if(!GLEW_ARB_draw_instanced || !GLEW_ARB_instanced_arrays){
+			cout << "instanced drawing is not supported (GL_ARB_draw_instanced, GL_ARB_instanced_arrays), using fixed-function drawing" << endl;
+			return false;
+		}
+
+		// 基本形状
+		int nvrts, ntris;
+		vector<glm::vec3> vrts, nrms;
+		vector<int> tris;
+		MakeCubeWithFaceNormal(nvrts, vrts, nrms, ntris, tris, 1.0);
+		CreateVBO(m_vbo[RX_INST_CUBE], (GLfloat*)&vrts[0], nvrts, 3, &tris[0], ntris, 4, (GLfloat*)&nrms[0], nvrts);
+		m_iMode[RX_INST_CUBE] = GL_QUADS; m_iElem[RX_INST_CUBE] = 4;
+
+		vrts.clear(); nrms.clear(); tris.clear();
+		MakeSphere(nvrts, vrts, nrms, ntris, tris, 0.5, 32, 16);
+		CreateVBO(m_vbo[RX_INST_SPHERE], (GLfloat*)&vrts[0], nvrts, 3, &tris[0], ntris, 3, (GLfloat*)&nrms[0], nvrts);
+		m_iMode[RX_INST_SPHERE] = GL_TRIANGLES; m_iElem[RX_INST_SPHERE] = 3;
+
+		vrts.clear(); nrms.clear(); tris.clear();
+		MakeCylinder(nvrts, vrts, nrms, ntris, tris, 0.5, 0.5, 1.0, 16, true);
+		CreateVBO(m_vbo[RX_INST_CYLINDER], (GLfloat*)&vrts[0], nvrts, 3, &tris[0], ntris, 3, (GLfloat*)&nrms[0], nvrts);
+		m_iMode[RX_INST_CYLINDER] = GL_TRIANGLES; m_iElem[RX_INST_CYLINDER] = 3;
+
+		// シェーダ
+		m_iProgLit = createProgram(instanced_vs, shadow_fs, "instanced");
+		m_iProgDepth = createProgram(instanced_vs, instanced_depth_fs, "instanced depth");
+		if(!m_iProgLit || !m_iProgDepth) return false;
+
+		glGenBuffers(1, &m_iInstVBO);
+
+		m_bSupported = true;
+		return true;
+	}
+
+	/*!
+	 * スナップショットから剛体をグループ分けしてインスタンスデータを転送(1フレームに1回)
+	 * @param[in] snap ワールドのスナップショット
+	 */
+	void Build(const rxWorldSnapshot &snap)
+	{
+		const int n = (int)snap.bodies.size();
+		m_vInstanced.assign(n, 0);
+		m_vKey.resize(n);
+		for(int k = 0; k < NKEYS; ++k) m_iCount[k] = 0;
+		if(!m_bSupported) return;
+
+		// 各剛体のグループ(基本形状と状態)
+		for(int i = 0; i < n; ++i){
+			int mesh = classify(snap.bodies[i].shape, 0, 0);
+			m_vKey[i] = -1;
+			if(mesh < 0) continue;
+			m_vKey[i] = mesh*NSTATES+snap.bodies[i].state;
+			m_iCount[m_vKey[i]]++;
+			m_vInstanced[i] = 1;
+		}
+
+		int total = 0;
+		for(int k = 0; k < NKEYS; ++k){
+			m_iStart[k] = total;
+			total += m_iCount[k];
+		}
+		m_vInst.resize(total*NFLOATS);
+		if(!total) return;
+
+		// グループごとに連続するように詰める
+		int fill[NKEYS];
+		for(int k = 0; k < NKEYS; ++k) fill[k] = m_iStart[k];
+		for(int i = 0; i < n; ++i){
+			int k = m_vKey[i];
+			if(k < 0) continue;
+			const rxBodySnapshot &b = snap.bodies[i];
+
+			btTransform local;
+			btVector3 scale;
+			classify(b.shape, &local, &scale);
+
+			btTransform trans;
+			trans.setFromOpenGLMatrix(b.m);
+			btScalar m[16];
+			(trans*local).getOpenGLMatrix(m);
+
+			GLfloat* dst = &m_vInst[(fill[k]++)*NFLOATS];
+			for(int j = 0; j < 16; ++j) dst[j] = (GLfloat)m[j];
+			for(int j = 0; j < 3; ++j) dst[16+j] = (GLfloat)scale[j];
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, m_iInstVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*m_vInst.size(), &m_vInst[0], GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	/*!
+	 * インスタンス描画
+	 * - シャドウマップのデプスパス(色の書き込みなし)と影付き描画パス(シャドウマップのシェーダ使用中)に対応
+	 * @param[in] difs 剛体の状態ごとの拡散色(デプスパスでは使わないので0でもよい)
+	 * @return 描画したらtrue(現在のパスに対応していない場合はfalseで，全剛体を従来の方法で描画する)
+	 */
+	bool Draw(const GLfloat* difs[NSTATES])
+	{
+		if(!m_bSupported) return false;
+
+		// 現在のパスの判定
+		GLboolean cmask[4];
+		glGetBooleanv(GL_COLOR_WRITEMASK, cmask);
+		GLint cur = 0;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &cur);
+
+		GLuint prog = 0;
+		GLfloat shadow_ambient = 0.0f;
+		if(!cmask[0]){
+			prog = m_iProgDepth;
+		}
+		else if(cur){
+			GLint loc = glGetUniformLocation(cur, "shadow_ambient");
+			if(loc < 0) return false;
+			glGetUniformfv(cur, loc, &shadow_ambient);
+			prog = m_iProgLit;
+		}
+		else{
+			return false;
+		}
+
+		if(m_vInst.empty()) return true;
+
+		glUseProgram(prog);
+		if(prog == m_iProgLit){
+			glUniform1i(glGetUniformLocation(prog, "tex"), 0);
+			glUniform1i(glGetUniformLocation(prog, "depth_tex"), 7);
+			glUniform1f(glGetUniformLocation(prog, "shadow_ambient"), shadow_ambient);
+			BindPlainTexture(glm::vec3(0.0));
+		}
+
+		for(int a = 0; a < 5; ++a){
+			glEnableVertexAttribArray(RX_ATTRIB_M0+a);
+			glVertexAttribDivisorARB(RX_ATTRIB_M0+a, 1);
+		}
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_NORMAL_ARRAY);
+
+		const GLsizei stride = sizeof(GLfloat)*NFLOATS;
+		for(int mesh = 0; mesh < RX_INST_MESHES; ++mesh){
+			const MeshVBO &vbo = m_vbo[mesh];
+			glBindBuffer(GL_ARRAY_BUFFER, vbo.vrts);
+			glVertexPointer(3, GL_FLOAT, 0, 0);
+			glBindBuffer(GL_ARRAY_BUFFER, vbo.nrms);
+			glNormalPointer(GL_FLOAT, 0, 0);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo.tris);
+
+			for(int s = 0; s < NSTATES; ++s){
+				int k = mesh*NSTATES+s;
+				if(!m_iCount[k]) continue;
+
+				// グループの先頭インスタンスを指すように属性のオフセットをずらす
+				glBindBuffer(GL_ARRAY_BUFFER, m_iInstVBO);
+				const char* base = (const char*)0+stride*m_iStart[k];
+				for(int c = 0; c < 4; ++c){
+					glVertexAttribPointer(RX_ATTRIB_M0+c, 4, GL_FLOAT, GL_FALSE, stride, base+sizeof(GLfloat)*4*c);
+				}
+				glVertexAttribPointer(RX_ATTRIB_SCALE, 3, GL_FLOAT, GL_FALSE, stride, base+sizeof(GLfloat)*16);
+
+				if(difs) glMaterialfv(GL_FRONT, GL_DIFFUSE, difs[s]);
+				glDrawElementsInstancedARB(m_iMode[mesh], vbo.ntris*m_iElem[mesh], GL_UNSIGNED_INT, 0, m_iCount[k]);
+			}
+		}
+
+		glDisableClientState(GL_VERTEX_ARRAY);
+		glDisableClientState(GL_NORMAL_ARRAY);
+		for(int a = 0; a < 5; ++a){
+			glVertexAttribDivisorARB(RX_ATTRIB_M0+a, 0);
+			glDisableVertexAttribArray(RX_ATTRIB_M0+a);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+		glUseProgram(cur);
+		return true;
+	}
+
+protected:
+	/*!
+	 * 衝突形状からインスタンス描画に使う基本形状と変換を求める(DrawBulletShapeと同じ対応)
+	 * @param[in] shape 衝突形状
+	 * @param[out] local 基本形状の向きを合わせるための変換(0なら計算しない)
+	 * @param[out] scale 基本形状の大きさ(0なら計算しない)
+	 * @return 基本形状(RX_INST_*)，インスタンス描画しない形状なら-1
+	 */
+	static int classify(const btCollisionShape* shape, btTransform* local, btVector3* scale)
+	{
+		if(local) local->setIdentity();
+		switch(shape->getShapeType()){
+		case BOX_SHAPE_PROXYTYPE:
+			{
+				const btBoxShape* box = static_cast<const btBoxShape*>(shape);
+				if(box->getUserIndex() == 99) return -1;	// 床として描画するもの
+				if(scale) *scale = 2*box->getHalfExtentsWithMargin();
+			}
+			return RX_INST_CUBE;
+
+		case SPHERE_SHAPE_PROXYTYPE:
+			{
+				btScalar d = 2*static_cast<const btSphereShape*>(shape)->getRadius();
+				if(scale) *scale = btVector3(d, d, d);
+			}
+			return RX_INST_SPHERE;
+
+		case CYLINDER_SHAPE_PROXYTYPE:
+			{
+				const btCylinderShape* cylinder = static_cast<const btCylinderShape*>(shape);
+				btScalar d = 2*cylinder->getRadius();
+				int up_axis = cylinder->getUpAxis();
+				if(scale) *scale = btVector3(d, d, cylinder->getHalfExtentsWithMargin()[up_axis]*2);
+				if(local && up_axis == 0){ // x軸方向
+					local->setRotation(btQuaternion(btVector3(0, 1, 0), SIMD_HALF_PI));
+				}
+				else if(local && up_axis == 1){ // y軸方向
+					local->setRotation(btQuaternion(btVector3(1, 0, 0), SIMD_HALF_PI));
+				}
+			}
+			return RX_INST_CYLINDER;
+
+		default:
+			return -1;
+		}
+	}
+
+	/*!
+	 * インスタンス属性の位置を固定してGLSLプログラムを作成
+	 * @return GLSLプログラム(失敗したら0)
+	 */
+	static GLuint createProgram(const char* vs, const char* fs, const string &name)
+	{
+		vector<char> vs1, fs1;
+		CreateGLSLShaderString(vs, vs1);
+		CreateGLSLShaderString(fs, fs1);
+
+		printf("compile the vertex shader : %s\n", name.c_str());
+		GLuint v = CompileGLSLShader(GL_VERTEX_SHADER, &vs1[0]);
+		printf("compile the fragment shader : %s\n", name.c_str());
+		GLuint f = CompileGLSLShader(GL_FRAGMENT_SHADER, &fs1[0]);
+		if(!v || !f) return 0;
+
+		GLuint prog = glCreateProgram();
+		glAttachShader(prog, v);
+		glAttachShader(prog, f);
+		glBindAttribLocation(prog, RX_ATTRIB_M0+0, "inst_m0");
+		glBindAttribLocation(prog, RX_ATTRIB_M0+1, "inst_m1");
+		glBindAttribLocation(prog, RX_ATTRIB_M0+2, "inst_m2");
+		glBindAttribLocation(prog, RX_ATTRIB_M0+3, "inst_m3");
+		glBindAttribLocation(prog, RX_ATTRIB_SCALE, "inst_scale");
+		glLinkProgram(prog);
+
+		GLint linked = GL_FALSE;
+		glGetProgramiv(prog, GL_LINK_STATUS, &linked);
+		if(linked == GL_FALSE){
+			cout << "failed to link " << name << endl;
+			glDeleteProgram(prog);
+			return 0;
+		}
+		return prog;
+	}
+};
+
+
+#endif // #ifndef _INSTANCED_H_
@@ -35,6 +35,16 @@
 // Include Files
 //-----------------------------------------------------------------------------
 #include "utils.h"
+#include "scene.h"
+#include "simthread.h"
+#include "instanced.h"
+#include "shadowcaster.h"
+
+// プロファイラ
+#include "rx_profiler.h"
+
+// 画面キャプチャ
+#include "rx_capture.h"
 
 // ImGUI
 #include "imgui.h"
@@ -60,473 +70,199 @@ int g_winh = 1024;							//!< 描画ウィンドウの高さ
 rxTrackball g_view;							//!< 視点移動用トラックボール
 float g_bgcolor[3] = { 1, 1, 1 };			//!< 背景色
 bool g_animation_on = false;				//!< アニメーションON/OFF
-int g_currentstep = 0;						//!< 現在のステップ数
 
 // シャドウマッピング
 ShadowMap g_shadowmap;
 int g_shadowmap_res = 1024;
+rxShadowCasters g_shadowcasters;	//!< デプスパスで描画するオブジェクト
+
+// 剛体のインスタンス描画
+rxInstancedBodies g_instanced;
+bool g_use_instancing = true;	//!< falseなら1剛体ずつ描画する
+
+// プロファイラ
+bool g_profiler_on = false;		//!< 計測と結果表示のON/OFF
+
+// 画面キャプチャ(PBOによる非同期読み出しと書き出しスレッド)
+rxFrameCapture g_capture;
+int g_capture_format = RX_CAPTURE_Y4M;	//!< 連続キャプチャの保存形式(RX_CAPTURE_*)
+int g_capture_fps = 30;					//!< 連続キャプチャのフレームレート
+bool g_capture_simtime = true;			//!< シミュレーション時間で1/fps秒ごとに記録(falseなら描画したフレームをすべて記録)
+int g_capture_step0 = 0;				//!< 連続キャプチャを開始したときのステップ数
+int g_capture_frames = 0;				//!< g_capture_step0から記録したフレーム数
+
+// ソフトボディ描画用VBO(毎フレーム書き換える)
+GLuint g_softvbo = 0;	//!< 頂点座標と法線(sv_vrts,sv_nrmsを続けて格納)
+GLuint g_softibo = 0;	//!< 三角形の頂点インデックス(sv_idxs)
 
 // 物理シミュレーション関連定数/変数
 float g_dt = 0.002;	//!< 時間ステップ幅
+int g_maxsubsteps = 10;	//!< 1フレーム(スレッドのループ1回)あたりの最大ステップ数
 
-// Bullet
-btDynamicsWorld* g_dynamicsworld;	//!< Bulletワールド
-btAlignedObjectArray<btCollisionShape*>	g_collisionshapes;		//!< 剛体オブジェクトの形状を格納する動的配列
-btTypedConstraint* g_constraint; // キューブ同士の結合
+// シミュレーションスレッド
+rxSimThread g_sim;				//!< ワールドの計算と描画用スナップショットの公開
+bool g_use_simthread = true;	//!< falseならメインループ内で計算する(デバッグ用)
+rxBulletState g_savedstate;		//!< "save state"で保存したワールドの状態
 
-// マウスピック
+// マウスピック(ピック用の拘束などはシミュレーション側で実行されるコマンドの中でのみ触る)
 btVector3 g_pickpos;
 btRigidBody *g_pickbody = 0;
 btPoint2PointConstraint *g_pickconstraint = 0;
 btSoftBody::Node *g_picknode = 0;
 double g_pickdist = 0.0;
 
-// 車の構造体
-struct {
-	btRigidBody* flontRightWheel;
-	btRigidBody* flontLeftWheel;
-	btRigidBody* rearRightWheel;
-	btRigidBody* rearLeftWheel;
-	btHinge2Constraint* flontRightJoint;
-	btHinge2Constraint* flontLeftJoint;
-	btHingeConstraint* rearRightJoint;
-	btHingeConstraint* rearLeftJoint;
-}typedef car_t;
-
-car_t g_carWheels; // 車を保持する
-float g_targetStearingAngle = 0; // タイヤの目標角度
-
-// 衝突応答のためのグループ
-enum CollisionGroup {
-	RX_COL_NOTHING = 0, // 0000
-	RX_COL_GROUND = 1,  // 0001
-	RX_COL_GROUP1 = 2,  // 0010
-	RX_COL_GROUP2 = 4,  // 0100
-	RX_COL_GROUP3 = 8,  // 1000
-	RX_COL_ALL = 15,	// 1111
+// マウスピックの状態(ピックの成否はシミュレーション側で判定されるので描画側は結果を待つ)
+enum
+{
+	RX_PICK_NONE = 0,	//!< ピックしていない
+	RX_PICK_PENDING,	//!< 判定待ち
+	RX_PICK_HIT,		//!< オブジェクトをピック中
+	RX_PICK_MISS,		//!< 何もない所をクリック(視点移動)
 };
+std::atomic<int> g_pickstate(RX_PICK_NONE);
+double g_pickx = 0.0, g_picky = 0.0;	//!< ボタンを押したときのマウス座標
+int g_pickmods = 0;						//!< ボタンを押したときの修飾キー
+bool g_viewdrag = false;				//!< マウスドラッグによる視点移動中
 
 
 //-----------------------------------------------------------------------------
-// Bullet用関数
+// アプリケーション制御関数
 //-----------------------------------------------------------------------------
 /*!
-* Bullet剛体(btRigidBody)の作成
-* @param[in] mass 質量
-* @param[in] init_tras 初期位置・姿勢
-* @param[in] shape 形状
-* @return 作成したbtRigidBody
+* アニメーションN/OFF
+* @param[in] on trueでON, falseでOFF
 */
-btRigidBody* CreateRigidBody(double mass, const btTransform& init_trans, btCollisionShape* shape, int myGroup, int targetGroup, btDynamicsWorld* world = 0, int index = 0)
+bool switchanimation(int on)
 {
-	//btAssert((!shape || shape->getShapeType() != INVALID_SHAPE_PROXYTYPE));
-
-	// 質量が0ならば静的な(static)オブジェクトとして設定，
-	bool isDynamic = (mass != 0.0);
-
-	btVector3 inertia(0, 0, 0);
-	if (isDynamic)
-		shape->calculateLocalInertia(mass, inertia);
-
-	btDefaultMotionState* motion_state = new btDefaultMotionState(init_trans);
-
-	btRigidBody::btRigidBodyConstructionInfo rb_info(mass, motion_state, shape, inertia);
-
-	btRigidBody* body = new btRigidBody(rb_info);
-
-	body->setUserIndex(index);
-
-	if (mass <= 1e-10) {
-		// Kinematicオブジェクトとして設定(stepSimulationしても運動の計算を行わないようにする)
-		body->setCollisionFlags(body->getCollisionFlags() | btCollisionObject::CF_KINEMATIC_OBJECT);
-		// 常にスリープ状態にする
-		body->setActivationState(DISABLE_DEACTIVATION);
-	}
-
-	if (world) {
-		world->addRigidBody(body, myGroup, targetGroup);
-	}
-
-	return body;
+	g_animation_on = (on == -1) ? !g_animation_on : (on ? true : false);
+	g_sim.SetAnimation(g_animation_on);
+	return g_animation_on;
 }
 
 /*!
-* Bullet剛体(btRigidBody)の作成
-* @param[in] mass 質量
-* @param[in] init_tras 初期位置・姿勢
-* @param[in] shape 形状
-* @return 作成したbtRigidBody
+* シミュレーションスレッドを使うかどうか
+* - Bulletのタスクスケジューラは設定したスレッド(メインスレッド)からステップを進める必要があるので
+*   マルチスレッド版のワールドではメインループ内で計算する(並列化はスケジューラのワーカースレッドで行われる)
 */
-btRigidBody* CreateRigidBody(double mass, const btTransform& init_trans, btCollisionShape* shape, btDynamicsWorld* world = 0, int index = 0)
+bool usesimthread(void)
 {
-	return CreateRigidBody(mass, init_trans, shape, RX_COL_ALL, RX_COL_ALL, world, index);
+	return g_use_simthread && g_worldtype != RX_WORLD_MT;
 }
 
-
 /*!
-* 立方体を任意の位置に追加
+* 現在の画面描画を画像ファイルとして保存(連番)
+* @param[in] stp 現在のステップ数(ファイル名として使用)
 */
-btRigidBody* SetRigidCube(btVector3 pos, btVector3 size, float mass)
+void savedisplay(const int &stp)
 {
-	btTransform trans;	// 剛体オブジェクトの位置姿勢を格納する変数(行列)
-	trans.setIdentity();// 位置姿勢行列の初期化
-
-	// ----- 立方体オブジェクト追加 -----
-	// 形状設定
-	btCollisionShape* box_shape = new btBoxShape(size);
-	g_collisionshapes.push_back(box_shape); // 最後に破棄(delete)するために形状データを格納しておく
-
-	// 初期位置・姿勢
-	btQuaternion qrot(0, 0, 0, 1);
-	trans.setIdentity();// 位置姿勢行列の初期化
-	trans.setOrigin(pos);
-	trans.setRotation(qrot);	// 四元数を行列に変換して姿勢行列に掛け合わせる
-
-	// 剛体オブジェクト生成
-	btRigidBody* body1 = CreateRigidBody(mass, trans, box_shape, RX_COL_GROUP1, RX_COL_GROUP1 | RX_COL_GROUND, g_dynamicsworld, 0);
-	// ----- ここまで (立方体オブジェクト追加) -----
-
-
-	// すり抜け防止用Swept sphereの設定(CCD:Continuous Collision Detection)
-	body1->setCcdMotionThreshold(size.norm());
-	body1->setCcdSweptSphereRadius(0.05 * size.norm());
-
-	return body1;
-}
-
-btRigidBody* SetStaticCube(btVector3 pos, btVector3 size) {
-	return SetRigidCube(pos, size, 0.0);
-}
-
-btRigidBody* SetStaticCube(btVector3 pos) {
-	const btScalar CUBE_HALF_EXTENTS = 0.2;	// 立方体の変の長さの半分(中心から辺までの距離)
-	return SetRigidCube(pos, btVector3(CUBE_HALF_EXTENTS, CUBE_HALF_EXTENTS, CUBE_HALF_EXTENTS), 0.0);
-}
-
-btRigidBody* SetRigidCube(btVector3 pos, btVector3 size) {
-	return SetRigidCube(pos, size, 1.0);
-}
-
-btRigidBody* SetRigidCube(btVector3 pos) {
-	const btScalar CUBE_HALF_EXTENTS = 0.2;	// 立方体の変の長さの半分(中心から辺までの距離)
-	return SetRigidCube(pos, btVector3(CUBE_HALF_EXTENTS, CUBE_HALF_EXTENTS, CUBE_HALF_EXTENTS),1.0);
+	static int nsave = 1;
+	string fn = CreateFileName("img_", ".bmp", (stp == -1 ? nsave++ : stp), 5);
+	g_capture.Screenshot(fn);	// 読み出しとファイルへの書き出しは次のフレームの描画後に非同期で行う
+	std::cout << "saving the screen image to " << fn << std::endl;
 }
 
 /*!
-* 球体を任意の位置に追加
+* 連続キャプチャの開始/終了
+*  - 保存先は連番BMPならframe_00000.bmp,...，それ以外はcapture.ppm/capture.y4m
 */
-btRigidBody* SetRigidSphere(btVector3 pos)
+void switchcapture(void)
 {
-	btTransform trans;	// 剛体オブジェクトの位置姿勢を格納する変数(行列)
-	trans.setIdentity();// 位置姿勢行列の初期化
-
-	const btScalar Capsule_HALF_EXTENTS = 0.2;	// 球の変の長さの半分(中心から辺までの距離)
-
-	// ----- 球体オブジェクト追加 -----
-	// 形状設定
-	btCollisionShape* Capsule_shape = new btSphereShape(Capsule_HALF_EXTENTS);
-	g_collisionshapes.push_back(Capsule_shape); // 最後に破棄(delete)するために形状データを格納しておく
-
-	// 初期位置・姿勢
-	btQuaternion qrot(0, 0, 0, 1);
-	trans.setIdentity();// 位置姿勢行列の初期化
-	trans.setOrigin(pos);
-	trans.setRotation(qrot);	// 四元数を行列に変換して姿勢行列に掛け合わせる
-
-	// 剛体オブジェクト生成
-	btRigidBody* body1 = CreateRigidBody(1.0, trans, Capsule_shape, RX_COL_GROUP2, RX_COL_GROUP2 | RX_COL_GROUND, g_dynamicsworld, 0);
-	// ----- ここまで (球オブジェクト追加) -----
-
-
-	// すり抜け防止用Swept sphereの設定(CCD:Continuous Collision Detection)
-	body1->setCcdMotionThreshold(Capsule_HALF_EXTENTS);
-	body1->setCcdSweptSphereRadius(0.05 * Capsule_HALF_EXTENTS);
-
-	return body1;
-}
-
-void throughSphere(btVector3 pos, btVector3 dir, float spd) 
-{
-
-	// 剛体オブジェクト生成
-	btRigidBody* body1 = SetRigidSphere(pos);
-	// ----- ここまで (球オブジェクト追加) -----
-
-	// 反発係数の設定
-	body1->setRestitution(10.0);
+	if(g_capture.IsRecording()){
+		g_capture.Stop();
+		std::cout << "stopped the frame capture (" << g_capture.GetFrames() << " frames)" << std::endl;
+		return;
+	}
 
-	// 初速度を与える
-	body1->setLinearVelocity(dir.normalize() * spd);
+	const char* names[] = { "frame_", "capture.ppm", "capture.y4m" };
+	g_capture.Start(names[g_capture_format], g_capture_format, g_capture_fps);
+	g_capture_step0 = g_sim.Snapshot().step;
+	g_capture_frames = 0;
+	std::cout << "started the frame capture to " << names[g_capture_format] << (g_capture_format == RX_CAPTURE_BMP ? "*.bmp" : "") << std::endl;
 }
 
 /*!
-* 円筒を任意の位置に追加
+* 現在の描画を連続キャプチャのフレームとして何回記録するか
+*  - シミュレーション時間に合わせる場合は前の記録から1/fps秒進むごとに1フレーム
+*    (描画が追いつかずに数フレーム分進んでいたら同じ画像を繰り返し，止まっていれば記録しない)
+* @param[in] snap 描画したスナップショット
 */
-btRigidBody* SetRigidCylinder(btVector3 pos, btVector3 size)
+int capturerepeat(const rxWorldSnapshot &snap)
 {
-	btTransform trans;	// 剛体オブジェクトの位置姿勢を格納する変数(行列)
-	trans.setIdentity();// 位置姿勢行列の初期化
-
-	// ----- 球体オブジェクト追加 -----
-	// 形状設定
-	btCollisionShape* cylinder_shape = new btCylinderShape(size);
-	g_collisionshapes.push_back(cylinder_shape); // 最後に破棄(delete)するために形状データを格納しておく
-
-	// 初期位置・姿勢
-	btQuaternion qrot(0, 0, 0, 1);
-	trans.setIdentity();// 位置姿勢行列の初期化
-	trans.setOrigin(pos);
-	trans.setRotation(qrot);	// 四元数を行列に変換して姿勢行列に掛け合わせる
-
-	// 剛体オブジェクト生成
-	btRigidBody* body1 = CreateRigidBody(1.0, trans, cylinder_shape, g_dynamicsworld, 0);
-	// ----- ここまで (球オブジェクト追加) -----
-
-
-	// すり抜け防止用Swept sphereの設定(CCD:Continuous Collision Detection)
-	body1->setCcdMotionThreshold(size.norm());
-	body1->setCcdSweptSphereRadius(0.05 * size.norm());
-
-	return body1;
-}
-
-btRigidBody* SetRigidCylinder(btVector3 pos) {
-	const btScalar CYLINDER_HALF_EXTENTS = 0.2;	// 球の変の長さの半分(中心から辺までの距離)
-	return SetRigidCylinder(pos, btVector3(CYLINDER_HALF_EXTENTS, CYLINDER_HALF_EXTENTS, CYLINDER_HALF_EXTENTS));
-}
-
-btRigidBody* SetRigidCylinderX(btVector3 pos, btVector3 size)
-{
-	btTransform trans;	// 剛体オブジェクトの位置姿勢を格納する変数(行列)
-	trans.setIdentity();// 位置姿勢行列の初期化
-
-	// ----- 球体オブジェクト追加 -----
-	// 形状設定
-	btCollisionShape* cylinder_shape = new btCylinderShapeX(size);
-	g_collisionshapes.push_back(cylinder_shape); // 最後に破棄(delete)するために形状データを格納しておく
-
-	// 初期位置・姿勢
-	btQuaternion qrot(0, 0, 0, 1);
-	trans.setIdentity();// 位置姿勢行列の初期化
-	trans.setOrigin(pos);
-	trans.setRotation(qrot);	// 四元数を行列に変換して姿勢行列に掛け合わせる
-
-	// 剛体オブジェクト生成
-	btRigidBody* body1 = CreateRigidBody(20.0, trans, cylinder_shape, RX_COL_GROUP2, RX_COL_GROUP2 | RX_COL_GROUND, g_dynamicsworld, 0);
-	// ----- ここまで (球オブジェクト追加) -----
-
-
-	// すり抜け防止用Swept sphereの設定(CCD:Continuous Collision Detection)
-	body1->setCcdMotionThreshold(size.norm());
-	body1->setCcdSweptSphereRadius(0.05 * size.norm());
-
-	return body1;
-}
-
-// 車のオブジェクトを生成
-car_t cleateCarObject(btVector3 pos) {
-	const btVector3 bodySize = btVector3(0.3, 0.1, 0.4);
-	const btVector3 wheelSize = btVector3(0.08, 0.2, 0.2);
-	
-	// 本体を追加
-	btRigidBody* body = SetRigidCube(pos, bodySize, 1);
-
-	// 車輪を追加
-	btVector3 wheel0Pos = btVector3(bodySize[0] + wheelSize[0], 0, bodySize[2] - 0.1);
-	btVector3 wheel1Pos = btVector3(-(bodySize[0] + wheelSize[0]), 0, bodySize[2] - 0.1);
-	btVector3 wheel2Pos = btVector3(bodySize[0] + wheelSize[0], 0, -(bodySize[2] - 0.1));
-	btVector3 wheel3Pos = btVector3(-(bodySize[0] + wheelSize[0]), 0, -(bodySize[2] - 0.1));
-	btRigidBody* wheel0 = SetRigidCylinderX(pos + wheel0Pos, wheelSize);
-	btRigidBody* wheel1 = SetRigidCylinderX(pos + wheel1Pos, wheelSize);
-	btRigidBody* wheel2 = SetRigidCylinderX(pos + wheel2Pos, wheelSize);
-	btRigidBody* wheel3 = SetRigidCylinderX(pos + wheel3Pos, wheelSize);
-
-	// タイヤの摩擦を決定
-	wheel0->setRestitution(1);
-	wheel1->setRestitution(1);
-	wheel2->setRestitution(1);
-	wheel3->setRestitution(1);
-
-	// 本体と車体をくっつける
-	btHinge2Constraint* constraintb0 = new btHinge2Constraint(*body, *wheel0, pos + wheel0Pos, btVector3(0, 1, 0), btVector3(1, 0, 0));
-	btHinge2Constraint* constraintb1 = new btHinge2Constraint(*body, *wheel1, pos + wheel1Pos, btVector3(0, 1, 0), btVector3(1, 0, 0));
-	btHingeConstraint* constraintb2 = new btHingeConstraint(*body, *wheel2, wheel2Pos, btVector3(0, 0, 0), btVector3(1, 0, 0), btVector3(1, 0, 0));
-	btHingeConstraint* constraintb3 = new btHingeConstraint(*body, *wheel3, wheel3Pos, btVector3(0, 0, 0), btVector3(1, 0, 0), btVector3(1, 0, 0));
-	g_dynamicsworld->addConstraint(constraintb0);
-	g_dynamicsworld->addConstraint(constraintb1);
-	g_dynamicsworld->addConstraint(constraintb2);
-	g_dynamicsworld->addConstraint(constraintb3);
-
-	// 前輪の設定
-	constraintb0->setLowerLimit(btRadians(-30.0));
-	constraintb0->setUpperLimit(btRadians( 30.0));
-	constraintb0->setLinearLowerLimit(btVector3(0, 0, 0));
-	constraintb0->setLinearUpperLimit(btVector3(0, 0, 0));
-	(constraintb0->getRotationalLimitMotor(0))->m_enableMotor = true;
-	(constraintb0->getRotationalLimitMotor(2))->m_enableMotor = true;
-	constraintb1->setLowerLimit(btRadians(-30.0));
-	constraintb1->setUpperLimit(btRadians( 30.0));
-	constraintb1->setLinearLowerLimit(btVector3(0, 0, 0));
-	constraintb1->setLinearUpperLimit(btVector3(0, 0, 0));
-	(constraintb1->getRotationalLimitMotor(0))->m_enableMotor = true;
-	(constraintb1->getRotationalLimitMotor(2))->m_enableMotor = true;
-	// モータをつける
-	constraintb2->enableAngularMotor(true, btRadians(0.0), 1.0);
-	constraintb3->enableAngularMotor(true, btRadians(0.0), 1.0);
-
-	return car_t{ wheel0, wheel1, wheel2, wheel3, constraintb0, constraintb1, constraintb2, constraintb3 };
+	if(!g_capture_simtime) return 1;
+	if(snap.step < g_capture_step0){	// リセットされた
+		g_capture_step0 = snap.step;
+		g_capture_frames = 0;
+	}
+	double t = (snap.step-g_capture_step0)*g_dt;
+	int n = (int)(t*g_capture_fps)+1-g_capture_frames;
+	if(n < 0) n = 0;
+	g_capture_frames += n;
+	return n;
 }
-
 /*!
-* 剛体オブジェクトの追加
+* 視点の初期化
 */
-void SetRigidBodies(void)
+void resetview(void)
 {
-	btTransform trans;	// 剛体オブジェクトの位置姿勢を格納する変数(行列)
-	trans.setIdentity();// 位置姿勢行列の初期化
-
-	const btScalar CUBE_HALF_EXTENTS = 0.2;	// 立方体の変の長さの半分(中心から辺までの距離)
-	const btScalar GROUND_HEIGHT = 0.0;		// 地面の高さ
-
-	// ----- 地面(質量0のx-z平面上で平べったい直方体で表現)の追加 -----
-	btCollisionShape *ground_shape = new btBoxShape(btVector3(20, CUBE_HALF_EXTENTS, 20));	// 形状
-	g_collisionshapes.push_back(ground_shape); // 最後に破棄(delete)するために形状データを格納しておく
-
-	ground_shape->setUserIndex(99); // 99とした場合のみ描画時にテクスチャ付き平面として描画．床を傾けたい等の場合は99にしないこと．
-	trans.setOrigin(btVector3(0, GROUND_HEIGHT-CUBE_HALF_EXTENTS, 0));	// 上の面がy=0になるように設定
-	
-	// 剛体オブジェクト(Static)生成
-	btRigidBody* body0 = CreateRigidBody(0.0, trans, ground_shape, g_dynamicsworld, 99);
-	// ----- ここまで (地面の追加) -----
-
-
-	// ----- 立方体オブジェクト追加 -----
-	SetRigidCube(btVector3(0, GROUND_HEIGHT + 10.0 * CUBE_HALF_EXTENTS, 0));
-	SetStaticCube(btVector3(1, 1, 1));
-
-	// ----- 立方体同士の拘束 -----
-	btRigidBody* body1 = SetRigidCube(btVector3(1, GROUND_HEIGHT + 10 * CUBE_HALF_EXTENTS, 0));
-	btRigidBody* body2 = SetRigidCube(btVector3(1, GROUND_HEIGHT + 10 * CUBE_HALF_EXTENTS, 0));
-
-	// body0を空間上に拘束
-	btVector3 pivot0(-CUBE_HALF_EXTENTS, -CUBE_HALF_EXTENTS, -CUBE_HALF_EXTENTS);
-	btTypedConstraint* joint01 = new btPoint2PointConstraint(*body1, pivot0);
-	g_dynamicsworld->addConstraint(joint01);
-
-	// body1をbody1に拘束
-	btVector3 pivot1( CUBE_HALF_EXTENTS,  CUBE_HALF_EXTENTS,  CUBE_HALF_EXTENTS);
-	btVector3 pivot2(-CUBE_HALF_EXTENTS, -CUBE_HALF_EXTENTS, -CUBE_HALF_EXTENTS);
-	btTypedConstraint* joint12 = new btPoint2PointConstraint(*body1, *body2, pivot1, pivot2);
-	joint12->enableFeedback(true);
-	btJointFeedback* feedback = new btJointFeedback();
-	joint12->setJointFeedback(feedback);
-	g_constraint = joint12;
-	g_dynamicsworld->addConstraint(joint12);
-
-	// 車の追加
-	g_carWheels = cleateCarObject(btVector3(0, 0.5, 0));
+	double q[4] = { 1, 0, 0, 0 };
+	g_view.SetQuaternion(q);
+	//g_view.SetRotation(20.0, 1.0, 0.0, 0.0);
+	g_view.SetScaling(-7.0);
+	g_view.SetTranslation(0.0, -2.0);
 }
-
 /*!
-* Bullet初期化
+* ピック中の拘束をワールドから外す
 */
-void InitBullet(void)
+void releasepick(void)
 {
-	// 衝突検出方法の選択(デフォルトを選択)
-	btDefaultCollisionConfiguration *config = new btDefaultCollisionConfiguration();
-	btCollisionDispatcher *dispatcher = new btCollisionDispatcher(config);
-
-	// ブロードフェーズ法の設定(Dynamic AABB tree method)
-	btAxisSweep3* broadphase = new btAxisSweep3(btVector3(-100, -100, -100), btVector3(100, 100, 100));
-
-	// 拘束(剛体間リンク)のソルバ設定
-	btSequentialImpulseConstraintSolver* solver = new btSequentialImpulseConstraintSolver();
-
-	// Bulletのワールド作成
-	g_dynamicsworld = new btDiscreteDynamicsWorld(dispatcher, broadphase, solver, config);
-
-	// 重力加速度の設定(OpenGLに合わせてy軸方向を上下方向にする)
-	g_dynamicsworld->setGravity(btVector3(0, -9.8, 0));
-
-	SetRigidBodies();
+	if(g_pickconstraint){
+		g_dynamicsworld->removeConstraint(g_pickconstraint);
+		delete g_pickconstraint;
+	}
+	g_pickconstraint = 0;
+	g_pickbody = 0;
+	g_picknode = 0;
+	g_pickstate = RX_PICK_NONE;
 }
-
-
 /*!
-* 設定したBulletの剛体オブジェクト，ワールドの破棄
+* ワールドを作り直す(ワールドの設定を変えたとき)
 */
-void CleanBullet(void)
+void rebuild(void)
 {
-	// 剛体オブジェクトの破棄
-	for(int i = g_dynamicsworld->getNumCollisionObjects()-1; i >= 0; --i){
-		btCollisionObject* obj = g_dynamicsworld->getCollisionObjectArray()[i];
-		btRigidBody* body = btRigidBody::upcast(obj);
-		if(body && body->getMotionState()){
-			delete body->getMotionState();
-		}
-		g_dynamicsworld->removeCollisionObject( obj );
-		delete obj;
-	}
-
-	// 形状の破棄
-	for(int j = 0; j < (int)g_collisionshapes.size(); ++j){
-		btCollisionShape* shape = g_collisionshapes[j];
-		g_collisionshapes[j] = 0;
-		delete shape;
-	}
-	g_collisionshapes.clear();
-
-	// ワールド破棄
-	delete g_dynamicsworld->getBroadphase();
-	delete g_dynamicsworld;
-}
-
+	// ワールドを作り直す間はシミュレーションスレッドを止める
+	g_sim.Stop();
 
+	releasepick();
+	CleanBullet();
 
+	// 破棄した形状のVBOを捨てる(アドレスが新しい形状で再利用されることがあるため)
+	ClearMeshCache();
+	g_shadowcasters.Invalidate();
 
-//-----------------------------------------------------------------------------
-// アプリケーション制御関数
-//-----------------------------------------------------------------------------
-/*!
-* アニメーションN/OFF
-* @param[in] on trueでON, falseでOFF
-*/
-bool switchanimation(int on)
-{
-	g_animation_on = (on == -1) ? !g_animation_on : (on ? true : false);
-	return g_animation_on;
-}
+	InitBullet();
 
-/*!
-* 現在の画面描画を画像ファイルとして保存(連番)
-* @param[in] stp 現在のステップ数(ファイル名として使用)
-*/
-void savedisplay(const int &stp)
-{
-	static int nsave = 1;
-	string fn = CreateFileName("img_", ".bmp", (stp == -1 ? nsave++ : stp), 5);
-	saveFrameBuffer(fn, g_winw, g_winh);
-	std::cout << "saved the screen image to " << fn << std::endl;
-}
-/*!
-* 視点の初期化
-*/
-void resetview(void)
-{
-	double q[4] = { 1, 0, 0, 0 };
-	g_view.SetQuaternion(q);
-	//g_view.SetRotation(20.0, 1.0, 0.0, 0.0);
-	g_view.SetScaling(-7.0);
-	g_view.SetTranslation(0.0, -2.0);
+	// 古いワールドを参照するスナップショットを新しいもので置き換える
+	g_sim.Reset();
+	if(usesimthread()) g_sim.Start();
 }
 /*!
 * シミュレーションのリセット
+* - 剛体・拘束がInitBullet直後と同じなら保存しておいた初期状態に戻す(ワールドを作り直すより速い)
+* - 剛体を追加した，拘束がちぎれたなどで戻せない場合は作り直す
 */
 void reset(void)
 {
-	CleanBullet();
-	InitBullet();
-	g_currentstep = 0;
+	g_sim.Stop();
+
+	releasepick();
+	if(!RestoreBulletState(g_initstate)){
+		rebuild();
+		return;
+	}
+
+	// ステップ数と描画用のスナップショットを初期状態に合わせる
+	g_sim.Reset();
+	if(usesimthread()) g_sim.Start();
 }
 
 
@@ -565,22 +301,147 @@ void Init(void)
 	// シャドウマップ初期化
 	g_shadowmap.InitShadow(g_shadowmap_res, g_shadowmap_res);
 
+	// プロファイラ(BulletのBT_PROFILEも同じ階層で計測する)
+	btSetCustomEnterProfileZoneFunc(rxProfiler::Enter);
+	btSetCustomLeaveProfileZoneFunc(rxProfiler::Leave);
+	rxProfiler::SetThreadName("main");
+
+	// 画面キャプチャの初期化(PBOと書き出しスレッド)
+	g_capture.Init();
+
+	// インスタンス描画の初期化(使えない環境ではg_use_instancingをfalseにする)
+	g_use_instancing = g_instanced.Init();
+
 	// Bullet初期化
 	InitBullet();
 
+	// シミュレーションスレッドの初期化
+	g_sim.SetDt(g_dt);
+	g_sim.Reset();
+	g_sim.SetMaxSubsteps(g_maxsubsteps);
 	switchanimation(1);
+	if(usesimthread()) g_sim.Start();
 }
 
 
 //-----------------------------------------------------------------------------
 // OpenGL/GLFWコールバック関数
 //-----------------------------------------------------------------------------
+/*!
+* スナップショット中のソフトボディの頂点・法線・インデックスをVBOに転送
+*  - 1フレームに1回だけ転送してデプスパスと描画パスで共有する
+*  - 毎回バッファを確保し直すことで前のフレームの描画完了を待たずに書き込めるようにする
+* @param[in] snap ワールドのスナップショット
+*/
+void UpdateSoftBodyVBO(const rxWorldSnapshot &snap)
+{
+	if(snap.sv_vrts.empty()) return;
+	if(!g_softvbo){
+		glGenBuffers(1, &g_softvbo);
+		glGenBuffers(1, &g_softibo);
+	}
+
+	// btVector3の並びをそのまま転送(描画時にストライドを指定)
+	GLsizeiptr n = sizeof(btVector3)*snap.sv_vrts.size();
+	glBindBuffer(GL_ARRAY_BUFFER, g_softvbo);
+	glBufferData(GL_ARRAY_BUFFER, 2*n, 0, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, n, &snap.sv_vrts[0]);
+	glBufferSubData(GL_ARRAY_BUFFER, n, n, &snap.sv_nrms[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	if(!snap.sv_idxs.empty()){
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_softibo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int)*snap.sv_idxs.size(), &snap.sv_idxs[0], GL_STREAM_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+}
+
+/*!
+* スナップショット中のソフトボディの描画(UpdateSoftBodyVBOで転送済みのVBOを使う)
+* @param[in] snap ワールドのスナップショット
+* @param[in] list 描画するソフトボディの番号(0なら全て)
+* @param[in] material falseならテクスチャの設定を省く(シャドウマップのデプスパス用)
+*/
+void DrawSoftBodySnapshot(const rxWorldSnapshot &snap, const vector<int> *list = 0, bool material = true)
+{
+	int n = (list ? (int)list->size() : (int)snap.softs.size());
+	if(!n || !g_softvbo) return;
+
+#ifdef USE_GLSL_SHADOW
+	if(material) BindPlainTexture(glm::vec3(0.0));
+#endif
+
+#ifdef BT_USE_DOUBLE_PRECISION
+	const GLenum type = GL_DOUBLE;
+#else
+	const GLenum type = GL_FLOAT;
+#endif
+
+	glBindBuffer(GL_ARRAY_BUFFER, g_softvbo);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, type, sizeof(btVector3), 0);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glNormalPointer(type, sizeof(btVector3), (void*)(sizeof(btVector3)*snap.sv_vrts.size()));
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_softibo);
+
+	for(int i = 0; i < n; ++i){
+		const rxSoftSnapshot &soft = snap.softs[list ? (*list)[i] : i];
+		if(soft.lines){
+			glDrawArrays(GL_LINE_STRIP, soft.start, soft.num);
+		}
+		else{
+			glDrawElements(GL_TRIANGLES, soft.inum, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int)*soft.istart));
+		}
+	}
+
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+/*!
+* シャドウマップ生成用のオブジェクト描画
+*  - 光源視錐台内のオブジェクト(g_shadowcasters)の形状だけを描画する(色・材質の設定はしない)
+* @param[in] x 描画するスナップショット(rxWorldSnapshot)へのポインタ
+*/
+void DrawBulletObjectsDepth(void* x)
+{
+	RX_PROFILE("shadow pass");
+	if(!x) return;
+	const rxWorldSnapshot &snap = *(const rxWorldSnapshot*)x;
+
+	// 通常の描画と同じく両面をデプスに書き込む(ソフトボディや地面の平面は裏面がないため)
+	glDisable(GL_CULL_FACE);
+
+	DrawSoftBodySnapshot(snap, &g_shadowcasters.Softs(), false);
+
+	if(g_use_instancing) g_instanced.Draw(0);
+
+	btVector3 world_min = snap.world_min, world_max = snap.world_max;
+	const vector<int> &bodies = g_shadowcasters.Bodies();
+	for(size_t i = 0; i < bodies.size(); ++i){
+		const rxBodySnapshot &b = snap.bodies[bodies[i]];
+		glPushMatrix();
+#ifdef BT_USE_DOUBLE_PRECISION
+		glMultMatrixd(b.m);
+#else
+		glMultMatrixf(b.m);
+#endif
+		DrawBulletShape(b.shape, world_min, world_max, false);
+		glPopMatrix();
+	}
+}
+
 /*!
 * Bulletのオブジェクトの描画シーン描画
-* @param[in] x クラスのメンバ関数(static)を渡すときに用いるポインタ(グローバル関数の場合は使わないので0でOK)
+*  - ワールドは別スレッドで計算中なので直接参照せずにスナップショットを描画する
+* @param[in] x 描画するスナップショット(rxWorldSnapshot)へのポインタ
 */
-void DrawBulletObjects(void* x = 0)
+void DrawBulletObjects(void* x)
 {
+	RX_PROFILE("draw");
+
 	static const GLfloat difr[] = { 1.0, 0.4, 0.4, 1.0 };	// 拡散色 : 赤
 	static const GLfloat difg[] = { 0.4, 0.6, 0.4, 1.0 };	// 拡散色 : 緑
 	static const GLfloat difb[] = { 0.4, 0.4, 1.0, 1.0 };	// 拡散色 : 青
@@ -601,71 +462,46 @@ void DrawBulletObjects(void* x = 0)
 	glEnable(GL_LIGHTING);
 	glDisable(GL_CULL_FACE);
 
-	if(g_dynamicsworld){
-		btScalar m[16];
-		btMatrix3x3	rot;
-		rot.setIdentity();
-
-		// Bulletワールドから剛体オブジェクト情報を取得してOpenGLで描画
-		const int n = g_dynamicsworld->getNumCollisionObjects();	// オブジェクト数の取得
-		for(int i = 0; i < n; ++i){
+	if(!x) return;
+	const rxWorldSnapshot &snap = *(const rxWorldSnapshot*)x;
 
-			// btCollisionObject → btRigidBodyへのキャストで剛体オブジェクトを取得
-			btCollisionObject* obj = g_dynamicsworld->getCollisionObjectArray()[i];
+	// ソフトボディの描画
+	glMaterialfv(GL_FRONT, GL_DIFFUSE, difb);
+	DrawSoftBodySnapshot(snap);
 
-			// 形状取得
-			btCollisionShape* shape = obj->getCollisionShape();
-			int shapetype = shape->getShapeType();
-
-			if(shapetype == SOFTBODY_SHAPE_PROXYTYPE){
-				btSoftBody* body = btSoftBody::upcast(obj);
-
-				glMaterialfv(GL_FRONT, GL_DIFFUSE, difb);
-
-				// draw a softbody
-				DrawBulletSoftBody(body);
-			}
-			else{
-				btRigidBody* body = btRigidBody::upcast(obj);
-				if(body && body->getMotionState()){
-					// btRigidBodyからMotion Stateを取得して，OpenGLの変換行列として位置・姿勢情報を得る
-					btDefaultMotionState* ms = (btDefaultMotionState*)body->getMotionState();
-					ms->m_graphicsWorldTrans.getOpenGLMatrix(m);
-					rot = ms->m_graphicsWorldTrans.getBasis();
-				}
-				else{
-					obj->getWorldTransform().getOpenGLMatrix(m);
-					rot = obj->getWorldTransform().getBasis();
-				}
+	// 箱,球,円筒の剛体は形状と状態ごとにまとめてインスタンス描画
+	static const GLfloat* difs[] = { difb, difr, difg };	// RX_BODY_DYNAMIC,SLEEPING,STATIC
+	bool instanced = (g_use_instancing && g_instanced.Draw(difs));
 
-				if (body && !body->isActive()) {
-					// スリープ中のオブジェクトは赤で描画
-					glMaterialfv(GL_FRONT, GL_DIFFUSE, difr);
-				}
-				else if(body && body->getInvMass() > 1e-6){
-					// Dynamicボディは青で描画
-					glMaterialfv(GL_FRONT, GL_DIFFUSE, difb);
-				}
-				else{	// Kinematicボディの場合は緑で描画
-					glMaterialfv(GL_FRONT, GL_DIFFUSE, difg);
-				}
+	// 剛体オブジェクトの描画(インスタンス描画しなかったもの)
+	btVector3 world_min = snap.world_min, world_max = snap.world_max;
+	for(size_t i = 0; i < snap.bodies.size(); ++i){
+		if(instanced && g_instanced.IsInstanced((int)i)) continue;
+		const rxBodySnapshot &b = snap.bodies[i];
 
-				btVector3 world_min, world_max;
-				g_dynamicsworld->getBroadphase()->getBroadphaseAabb(world_min, world_max);
+		if(b.state == RX_BODY_SLEEPING){
+			// スリープ中のオブジェクトは赤で描画
+			glMaterialfv(GL_FRONT, GL_DIFFUSE, difr);
+		}
+		else if(b.state == RX_BODY_DYNAMIC){
+			// Dynamicボディは青で描画
+			glMaterialfv(GL_FRONT, GL_DIFFUSE, difb);
+		}
+		else{	// Kinematicボディの場合は緑で描画
+			glMaterialfv(GL_FRONT, GL_DIFFUSE, difg);
+		}
 
-				glPushMatrix();
+		glPushMatrix();
 #ifdef BT_USE_DOUBLE_PRECISION
-				glMultMatrixd(m);
+		glMultMatrixd(b.m);
 #else
-				glMultMatrixf(m);
+		glMultMatrixf(b.m);
 #endif
 
-				// 形状描画
-				DrawBulletShape(shape, world_min, world_max);
+		// 形状描画
+		DrawBulletShape(b.shape, world_min, world_max);
 
-				glPopMatrix();
-			}
-		}
+		glPopMatrix();
 	}
 }
 
@@ -675,6 +511,11 @@ void DrawBulletObjects(void* x = 0)
 */
 void Display(void)
 {
+	RX_PROFILE("display");
+
+	// シミュレーションスレッドが公開した最新のスナップショット
+	const rxWorldSnapshot &snap = g_sim.Snapshot();
+
 	// ビューポート,透視変換行列,モデルビュー変換行列の設定
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
@@ -698,82 +539,35 @@ void Display(void)
 	glEnable(GL_LIGHTING);
 
 	// 影なしでのオブジェクト描画
-	//DrawBulletObjects();
+	//DrawBulletObjects((void*)&snap);
+
+	// インスタンス描画用のデータとソフトボディの頂点はデプスパスと描画パスで共有するので先に1回だけ転送する
+	if(g_use_instancing) g_instanced.Build(snap);
+	UpdateSoftBodyVBO(snap);
 
 	// シャドウマップを使って影付きでオブジェクト描画
+	//  - デプスパスは光源視錐台内のオブジェクトだけを描画し，それらが動いていなければ前のシャドウマップを使う
 	glm::vec3 light_pos(LIGHT0_POS[0], LIGHT0_POS[1], LIGHT0_POS[2]);
 	ShadowMap::Frustum light = CalFrustum(80, 0.02, 20.0, g_shadowmap_res, g_shadowmap_res, light_pos, glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, 1.0, 0.0));
-	g_shadowmap.RenderSceneWithShadow(light, DrawBulletObjects, 0);
-
-	int num_manifolds = g_dynamicsworld->getDispatcher()->getNumManifolds(); // 衝突候補のペアの数
-	for (int i = 0; i < num_manifolds; ++i) {	// 各ペアを調べていく
-		// 衝突点を格納するためのキャッシュ(manifold)から情報を取得
-		btPersistentManifold* manifold = g_dynamicsworld->getDispatcher()->getManifoldByIndexInternal(i);
-		btCollisionObject* obA = const_cast<btCollisionObject*>(manifold->getBody0()); // 衝突ペアのうちのオブジェクトA
-		btCollisionObject* obB = const_cast<btCollisionObject*>(manifold->getBody1()); // 衝突ペアのうちのオブジェクトB
-
-		// 各オブジェクトのユーザーインデックス(練習問題7で使います)
-		int user_idx0 = obA->getUserIndex();
-		int user_idx1 = obB->getUserIndex();
-
-		int num_contacts = manifold->getNumContacts(); // オブジェクト間の衝突点数
-				
-		for (int j = 0; j < num_contacts; ++j) {
-			btManifoldPoint& pt = manifold->getContactPoint(j); // 衝突点キャッシュから衝突点座標を取得
-			if (pt.getDistance() <= 0.0f) { // 衝突点間の距離がゼロ以下なら実際に衝突している
-				// オブジェクトAの衝突点座標(const変数にしない場合の例)
-				btVector3& ptA = const_cast<btVector3&>(pt.getPositionWorldOnA());
-
-				// オブジェクトBの衝突点座標と法線(const変数として取得する場合の例)
-				const btVector3& ptB = pt.getPositionWorldOnB();
-				const btVector3& normalOnB = pt.m_normalWorldOnB;
-
-				// ここに衝突点情報を格納するor衝突点描画するコードを書く
-				glPushMatrix();
-					glTranslatef(ptB[0], ptB[1], ptB[2]);
-					glScalef(0.1, 0.1, 0.1);
-					glColor3d(1, 0, 0);
-					DrawSphereVBO();
-				glPopMatrix();
-			}
-		}
+	GLfloat light_mvp[16];
+	g_shadowmap.CalLightMatrix(light, light_mvp);
+	bool update_shadow = g_shadowcasters.Build(snap, light_mvp, g_use_instancing ? &g_instanced : 0);
+	g_shadowmap.RenderSceneWithShadow(light, DrawBulletObjectsDepth, DrawBulletObjects, (void*)&snap, update_shadow);
+
+	// 衝突点の描画(衝突点の抽出はスナップショット作成時にシミュレーション側で行う)
+	for(size_t i = 0; i < snap.contacts.size(); ++i){
+		const btVector3& ptB = snap.contacts[i];
+		glPushMatrix();
+			glTranslatef(ptB[0], ptB[1], ptB[2]);
+			glScalef(0.1, 0.1, 0.1);
+			glColor3d(1, 0, 0);
+			DrawSphereVBO();
+		glPopMatrix();
 	}
 
 	glPopMatrix();
 }
 
-/*!
-* タイマーコールバック関数
-*/
-void Timer(void)
-{
-	if(g_animation_on){
-		if(g_dynamicsworld){
-			// シミュレーションを1ステップ進める
-			g_dynamicsworld->stepSimulation(g_dt, 1);
-		}
-		g_currentstep++;
-	}
-
-	const double gain = 1;
-	(g_carWheels.flontLeftJoint->getRotationalLimitMotor(2))->m_targetVelocity = gain * (btRadians(g_targetStearingAngle) - g_carWheels.flontLeftJoint->getAngle1());
-	(g_carWheels.flontRightJoint->getRotationalLimitMotor(2))->m_targetVelocity = gain * (btRadians(g_targetStearingAngle) - g_carWheels.flontRightJoint->getAngle1());
-
-	// 拘束がちぎれないか確認
-	if(g_constraint) {
-		btJointFeedback* f = g_constraint->getJointFeedback();
-		// 力を取得
-		btVector3 force1 = f->m_appliedForceBodyA;
-		btVector3 force2 = f->m_appliedForceBodyB;
-		// 力はベクトルなので、スカラーを取得し、ちぎれないか確認
-		if (force1.norm() > 1000.0 || force2.norm() > 1000.0) {
-			g_dynamicsworld->removeConstraint(g_constraint);
-			delete g_constraint;
-			g_constraint = 0;
-		}
-	}
-}
-
 
 /*!
 * キーボードイベント処理関数
@@ -797,7 +591,7 @@ void Keyboard(GLFWwindow* window, int key, int scancode, int action, int mods)
 			switchanimation(-1);
 			break;
 		case GLFW_KEY_SPACE: // スペースキーでアニメーションを1ステップだけ進める
-			g_animation_on = true; Timer(); g_animation_on = false;
+			g_sim.StepOnce();
 			break;
 
 		case GLFW_KEY_R: // Rキーでシーン(シミュレーション)リセット
@@ -808,7 +602,8 @@ void Keyboard(GLFWwindow* window, int key, int scancode, int action, int mods)
 			{
 				float theta = (rand() % 3141) / 500.0f;
 				float rad = (rand() % 5000) / 500.0f;
-				SetRigidCube(btVector3(rad * cos(theta), 1, rad * sin(theta)));
+				btVector3 pos(rad * cos(theta), 1, rad * sin(theta));
+				g_sim.Push([pos](){ SetRigidCube(pos); });
 			}
 			break;
 
@@ -816,7 +611,8 @@ void Keyboard(GLFWwindow* window, int key, int scancode, int action, int mods)
 			{
 				float theta = (rand() % 3141) / 500.0f;
 				float rad = (rand() % 5000) / 500.0f;
-				SetRigidSphere(btVector3(rad * cos(theta), 1, rad * sin(theta)));
+				btVector3 pos(rad * cos(theta), 1, rad * sin(theta));
+				g_sim.Push([pos](){ SetRigidSphere(pos); });
 			}
 			break;
 
@@ -824,36 +620,39 @@ void Keyboard(GLFWwindow* window, int key, int scancode, int action, int mods)
 			{
 				float theta = (rand() % 3141) / 500.0f;
 				float rad = (rand() % 5000) / 500.0f;
-				SetRigidCylinder(btVector3(rad * cos(theta), 1, rad * sin(theta)));
+				btVector3 pos(rad * cos(theta), 1, rad * sin(theta));
+				g_sim.Push([pos](){ SetRigidCylinder(pos); });
 			}
 		case  GLFW_KEY_RIGHT:
 			{
-				g_targetStearingAngle = 30;
+				g_sim.Push([](){ g_targetStearingAngle = 30; });
 			}
 		break;
 			
 		case GLFW_KEY_LEFT:
 			{
-				g_targetStearingAngle = -30;
+				g_sim.Push([](){ g_targetStearingAngle = -30; });
 			}
 		break;
 
 		case  GLFW_KEY_UP:
-		{
+		g_sim.Push([](){
+			if(!g_carWheels.flontLeftJoint) return;
 			(g_carWheels.flontLeftJoint->getRotationalLimitMotor(0))->m_targetVelocity = btRadians(360.0);
 			(g_carWheels.flontRightJoint->getRotationalLimitMotor(0))->m_targetVelocity = btRadians(360.0);
 			g_carWheels.rearLeftJoint->setMotorTargetVelocity(btRadians(360.0));
 			g_carWheels.rearRightJoint->setMotorTargetVelocity(btRadians(360.0));
-		}
+		});
 		break;
 
 		case  GLFW_KEY_DOWN:
-		{
+		g_sim.Push([](){
+			if(!g_carWheels.flontLeftJoint) return;
 			(g_carWheels.flontLeftJoint->getRotationalLimitMotor(0))->m_targetVelocity = btRadians(-720.0);
 			(g_carWheels.flontRightJoint->getRotationalLimitMotor(0))->m_targetVelocity = btRadians(-720.0);
 			g_carWheels.rearLeftJoint->setMotorTargetVelocity(btRadians(-720.0));
 			g_carWheels.rearRightJoint->setMotorTargetVelocity(btRadians(-720.0));
-		}
+		});
 		break;
 
 		// Tキーで球を投げる
@@ -863,7 +662,8 @@ void Keyboard(GLFWwindow* window, int key, int scancode, int action, int mods)
 			glm::vec3 eye_pos(0.0), eye_dir(0.0);
 			g_view.CalLocalPos(eye_pos, glm::vec3(0.0));
 			g_view.CalLocalRot(eye_dir, glm::vec3(0.0, 0.0, -1.0));
-			throughSphere(btVector3(eye_pos[0], eye_pos[1], eye_pos[2]), btVector3(eye_dir[0], eye_dir[1], eye_dir[2]), 32);
+			btVector3 pos(eye_pos[0], eye_pos[1], eye_pos[2]), dir(eye_dir[0], eye_dir[1], eye_dir[2]);
+			g_sim.Push([pos, dir](){ throughSphere(pos, dir, 32); });
 		}
 
 		break;
@@ -874,106 +674,163 @@ void Keyboard(GLFWwindow* window, int key, int scancode, int action, int mods)
 	}
 }
 
+//-----------------------------------------------------------------------------
+// マウスピック(シミュレーション側でコマンドとして実行される)
+//-----------------------------------------------------------------------------
 /*!
-* マウスイベント処理関数
-* @param[in] window コールバック関数を呼んだウィンドウハンドル
-* @param[in] button マウスボタン(GLFW_MOUSE_BUTTON_LEFT,GLFW_MOUSE_BUTTON_MIDDLE,GLFW_MOUSE_BUTTON_RIGHT)
-* @param[in] action マウスボタンの状態(GLFW_PRESS, GLFW_RELEASE)
-* @param[in] mods 修飾キー(CTRL,SHIFT,ALT) -> https://www.glfw.org/docs/latest/group__mods.html
+* 光線と交差するオブジェクトをピックする
+* - 結果はg_pickstateに書き込む(ボタンが既に離されていた場合はそのまま)
+* @param[in] ray_from,ray_to 光線の始点と終点
 */
-void Mouse(GLFWwindow* window, int button, int action, int mods)
+void PickStart(btVector3 ray_from, btVector3 ray_to)
 {
-	if(ImGui::GetIO().WantCaptureMouse) return;	// ImGUIウィンドウ上でのマウスイベント時
-	double x, y;
-	glfwGetCursorPos(window, &x, &y);
-	if(button == GLFW_MOUSE_BUTTON_LEFT){
-		if(action == GLFW_PRESS){
-			g_picknode = 0;
-			glm::vec3 ray_from0, ray_to0;
-			glm::vec3 init_pos(0, 0, 0);
-			g_view.CalLocalPos(ray_from0, init_pos);
-			g_view.GetRayTo(x, y, FOV, ray_to0);
+	g_picknode = 0;
 
-			btVector3 ray_from = btVector3(ray_from0[0], ray_from0[1], ray_from0[2]);
-			btVector3 ray_to = btVector3(ray_to0[0], ray_to0[1], ray_to0[2]);
+	btCollisionWorld::ClosestRayResultCallback ray_callback(ray_from, ray_to);
+	g_dynamicsworld->rayTest(ray_from, ray_to, ray_callback);
 
-			btCollisionWorld::ClosestRayResultCallback ray_callback(ray_from, ray_to);
-			g_dynamicsworld->rayTest(ray_from, ray_to, ray_callback);
+	if(ray_callback.hasHit()){
+		const btCollisionObject* obj = ray_callback.m_collisionObject;
 
-			if(ray_callback.hasHit()){
-				const btCollisionObject* obj = ray_callback.m_collisionObject;
+		// 光線と衝突した剛体
+		btRigidBody* body = const_cast<btRigidBody*>(btRigidBody::upcast(obj));
 
-				// 光線と衝突した剛体
-				btRigidBody* body = const_cast<btRigidBody*>(btRigidBody::upcast(obj));
+		// 衝突点座標(ジョイントになる位置座標)
+		btVector3 picked_pos = ray_callback.m_hitPointWorld;
 
-				// 衝突点座標(ジョイントになる位置座標)
-				btVector3 picked_pos = ray_callback.m_hitPointWorld;
+		if(body){
+			if(!(body->isStaticObject() || body->isKinematicObject())){
+				g_pickbody = body;
+				g_pickpos = picked_pos;
 
-				if(body){
-					if(!(body->isStaticObject() || body->isKinematicObject())){
-						g_pickbody = body;
-						g_pickpos = picked_pos;
+				// 選択された剛体の座標系でのピック位置
+				btVector3 local_pos = body->getCenterOfMassTransform().inverse()*picked_pos;
 
-						// 選択された剛体の座標系でのピック位置
-						btVector3 local_pos = body->getCenterOfMassTransform().inverse()*picked_pos;
+				g_pickbody->setActivationState(DISABLE_DEACTIVATION); // 必要！
 
-						g_pickbody->setActivationState(DISABLE_DEACTIVATION); // 必要！
-
-						if(g_pickconstraint){
-							g_dynamicsworld->removeConstraint(g_pickconstraint);
-							delete g_pickconstraint;
-						}
-						g_pickconstraint = new btPoint2PointConstraint(*body, local_pos);
-						g_dynamicsworld->addConstraint(g_pickconstraint, true);
+				if(g_pickconstraint){
+					g_dynamicsworld->removeConstraint(g_pickconstraint);
+					delete g_pickconstraint;
+				}
+				g_pickconstraint = new btPoint2PointConstraint(*body, local_pos);
+				g_dynamicsworld->addConstraint(g_pickconstraint, true);
 
-						g_pickconstraint->m_setting.m_impulseClamp = 30.0;
-						g_pickconstraint->m_setting.m_tau = 0.001f;
+				g_pickconstraint->m_setting.m_impulseClamp = 30.0;
+				g_pickconstraint->m_setting.m_tau = 0.001f;
 
-						g_pickdist = (g_pickpos-ray_from).length();
-					}
-				} 
-				else{
-					// 光線と衝突したbtSoftBody
-					btSoftBody* body = const_cast<btSoftBody*>(btSoftBody::upcast(obj));
-					btSoftBody::sRayCast res;
-					body->rayTest(ray_from, ray_to, res);
-					if(res.fraction < 1.0){
-						btVector3 impact = ray_from+(ray_to-ray_from)*res.fraction;
-						cout << impact << endl;
-						if(res.feature == btSoftBody::eFeature::Face){
-							btSoftBody::Face& face = res.body->m_faces[res.index];
-
-							// 衝突点に最も近いノードを探索
-							btSoftBody::Node* node = face.m_n[0];
-							for(int i = 1; i < 3; ++i){
-								if((node->m_x-impact).length2() >(face.m_n[i]->m_x-impact).length2()){
-									node = face.m_n[i];
-								}
-							}
-							g_picknode = node;
-							g_pickdist = (g_picknode->m_x - ray_from).length();
+				g_pickdist = (g_pickpos-ray_from).length();
+			}
+		} 
+		else{
+			// 光線と衝突したbtSoftBody
+			btSoftBody* body = const_cast<btSoftBody*>(btSoftBody::upcast(obj));
+			btSoftBody::sRayCast res;
+			body->rayTest(ray_from, ray_to, res);
+			if(res.fraction < 1.0){
+				btVector3 impact = ray_from+(ray_to-ray_from)*res.fraction;
+				cout << impact << endl;
+				if(res.feature == btSoftBody::eFeature::Face){
+					btSoftBody::Face& face = res.body->m_faces[res.index];
+
+					// 衝突点に最も近いノードを探索
+					btSoftBody::Node* node = face.m_n[0];
+					for(int i = 1; i < 3; ++i){
+						if((node->m_x-impact).length2() >(face.m_n[i]->m_x-impact).length2()){
+							node = face.m_n[i];
 						}
 					}
+					g_picknode = node;
+					g_pickdist = (g_picknode->m_x - ray_from).length();
 				}
 			}
+		}
+	}
 
-			if(!g_pickconstraint && !g_picknode){
-				// マウスドラッグによる視点移動
-				g_view.Start(x, y, mods);
-			}
+	int expected = RX_PICK_PENDING;
+	g_pickstate.compare_exchange_strong(expected, (g_pickconstraint || g_picknode) ? RX_PICK_HIT : RX_PICK_MISS);
+}
+
+/*!
+* ピックしたオブジェクトを光線上の同じ距離の位置へ引っ張る
+* @param[in] ray_from,dir 光線の始点と方向(正規化済み)
+*/
+void PickMove(btVector3 ray_from, btVector3 dir)
+{
+	btVector3 new_pivot = ray_from+dir*g_pickdist;
+
+	if(g_pickconstraint){
+		g_pickconstraint->setPivotB(new_pivot);
+	}
+	else if(g_picknode){
+		//g_picknode->m_x = new_pivot;
+		g_picknode->m_f += (new_pivot-g_picknode->m_x)*10.0;
+	}
+
+	g_pickpos = new_pivot;
+}
+
+/*!
+* ピックの解除
+*/
+void PickEnd(void)
+{
+	if(g_pickconstraint){
+		g_dynamicsworld->removeConstraint(g_pickconstraint);
+		delete g_pickconstraint;
+		g_pickconstraint = 0;
+		g_pickbody = 0;
+	}
+	g_picknode = 0;
+}
+
+/*!
+* マウス座標から視点を始点とする光線を計算
+* @param[in] x,y マウス座標(スクリーン座標系)
+* @param[out] ray_from,ray_to 光線の始点と終点
+*/
+void CalRay(double x, double y, btVector3 &ray_from, btVector3 &ray_to)
+{
+	glm::vec3 ray_from0, ray_to0;
+	glm::vec3 init_pos(0, 0, 0);
+	g_view.CalLocalPos(ray_from0, init_pos);
+	g_view.GetRayTo(x, y, FOV, ray_to0);
+
+	ray_from = btVector3(ray_from0[0], ray_from0[1], ray_from0[2]);
+	ray_to = btVector3(ray_to0[0], ray_to0[1], ray_to0[2]);
+}
+
+
+/*!
+* マウスイベント処理関数
+* @param[in] window コールバック関数を呼んだウィンドウハンドル
+* @param[in] button マウスボタン(GLFW_MOUSE_BUTTON_LEFT,GLFW_MOUSE_BUTTON_MIDDLE,GLFW_MOUSE_BUTTON_RIGHT)
+* @param[in] action マウスボタンの状態(GLFW_PRESS, GLFW_RELEASE)
+* @param[in] mods 修飾キー(CTRL,SHIFT,ALT) -> https://www.glfw.org/docs/latest/group__mods.html
+*/
+void Mouse(GLFWwindow* window, int button, int action, int mods)
+{
+	if(ImGui::GetIO().WantCaptureMouse) return;	// ImGUIウィンドウ上でのマウスイベント時
+	double x, y;
+	glfwGetCursorPos(window, &x, &y);
+	if(button == GLFW_MOUSE_BUTTON_LEFT){
+		if(action == GLFW_PRESS){
+			btVector3 ray_from, ray_to;
+			CalRay(x, y, ray_from, ray_to);
+
+			// ピックの判定はシミュレーション側で行い，何もピックされなければ
+			// 最初のドラッグ時にこの位置からマウスドラッグによる視点移動を始める
+			g_pickx = x; g_picky = y; g_pickmods = mods;
+			g_pickstate = RX_PICK_PENDING;
+			g_sim.Push([ray_from, ray_to](){ PickStart(ray_from, ray_to); });
 		}
 		else if(action == GLFW_RELEASE){
-			if(g_pickconstraint){
-				g_dynamicsworld->removeConstraint(g_pickconstraint);
-				delete g_pickconstraint;
-				g_pickconstraint = 0;
-				g_pickbody = 0;
-			}
-			else if(g_picknode){
-				g_picknode = 0;
+			int state = g_pickstate.exchange(RX_PICK_NONE);
+			if(state == RX_PICK_HIT || state == RX_PICK_PENDING){
+				g_sim.Push([](){ PickEnd(); });
 			}
-			else{
+			if(g_viewdrag){
 				g_view.Stop(x, y);
+				g_viewdrag = false;
 			}
 		}
 	}
@@ -993,31 +850,21 @@ void Motion(GLFWwindow* window, double x, double y)
 	}
 
 	if(glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS){
-		if(g_pickconstraint || g_picknode){
-			glm::vec3 ray_from0, ray_to0;
-			glm::vec3 init_pos(0, 0, 0);
-			g_view.CalLocalPos(ray_from0, init_pos);
-			g_view.GetRayTo(x, y, FOV, ray_to0);
-
-			btVector3 ray_from = btVector3(ray_from0[0], ray_from0[1], ray_from0[2]);
-			btVector3 new_ray_to = btVector3(ray_to0[0], ray_to0[1], ray_to0[2]);
+		int state = g_pickstate;
+		if(state == RX_PICK_HIT){
+			btVector3 ray_from, new_ray_to;
+			CalRay(x, y, ray_from, new_ray_to);
 
 			btVector3 dir = new_ray_to-ray_from;
 			dir.normalize();
 
-			btVector3 new_pivot = ray_from+dir*g_pickdist;
-
-			if(g_pickconstraint){
-				g_pickconstraint->setPivotB(new_pivot);
-			}
-			else if(g_picknode){
-				//g_picknode->m_x = new_pivot;
-				g_picknode->m_f += (new_pivot-g_picknode->m_x)*10.0;
-			}
-
-			g_pickpos = new_pivot;
+			g_sim.Push([ray_from, dir](){ PickMove(ray_from, dir); });
 		}
-		else{
+		else if(state == RX_PICK_MISS){
+			if(!g_viewdrag){
+				g_view.Start(g_pickx, g_picky, g_pickmods);
+				g_viewdrag = true;
+			}
 			g_view.Motion(x, y);
 		}
 	}
@@ -1047,20 +894,116 @@ void SetImGUI(GLFWwindow* window)
 {
 	ImGui::Text("simulation:");
 	if(ImGui::Button("start/stop")){ switchanimation(-1); } ImGui::SameLine();
-	if(ImGui::Button("run a step")){ g_animation_on = true; Timer(); g_animation_on = false; }
+	if(ImGui::Button("run a step")){ g_sim.StepOnce(); }
 	if(ImGui::Button("reset")){ reset(); }
+	if(ImGui::Button("save state")){ g_sim.Push([](){ SaveBulletState(g_savedstate); }); } ImGui::SameLine();
+	if(ImGui::Button("load state")){ g_sim.Push([](){ if(!g_pickconstraint) RestoreBulletState(g_savedstate); }); }
+	ImGui::Text("scene: %s", g_scenefile.empty() ? "(built-in)" : g_scenefile.c_str());
 	ImGui::Separator();
-	ImGui::InputFloat("dt", &(g_dt), 0.001f, 0.01f, "%.3f");
+	if(ImGui::InputFloat("dt", &(g_dt), 0.001f, 0.01f, "%.3f")){ g_sim.SetDt(g_dt); }
+	if(ImGui::InputInt("max substeps", &g_maxsubsteps)){
+		if(g_maxsubsteps < 1) g_maxsubsteps = 1;
+		g_sim.SetMaxSubsteps(g_maxsubsteps);
+	}
+	if(ImGui::Checkbox("simulation thread", &g_use_simthread)){
+		if(usesimthread()) g_sim.Start(); else g_sim.Stop();
+	}
+	const rxWorldSnapshot &snap = g_sim.Snapshot();
+	ImGui::Text("step: %d", snap.step);
+	ImGui::Text("steps/tick: %d, debt: %.1f ms (dropped %.2f s)", snap.last_steps, 1000.0*snap.debt, snap.dropped);
 	ImGui::Separator();
+	// ワールドの設定(変更するとシーンをリセットして作り直す)
+	if(ImGui::Combo("broadphase", &g_broadphasetype, "sap\0axis3\0dbvt\0grid\0\0")){ rebuild(); }
+	if(g_broadphasetype == RX_BROADPHASE_SAP){
+		if(ImGui::Checkbox("raycast accelerator", &g_raycastaccel)){ rebuild(); }
+	}
+	bool mt = (g_worldtype == RX_WORLD_MT);
+	if(ImGui::Checkbox("multithreaded world", &mt)){
+		g_worldtype = (mt ? RX_WORLD_MT : RX_WORLD_SINGLE);
+		rebuild();
+	}
+	if(mt){
+		if(ImGui::Combo("scheduler", &g_scheduler, "sequential\0bullet\0openmp\0tbb\0ppl\0\0")){ rebuild(); }
+		if(ImGui::InputInt("threads (0:max)", &g_numthreads)){
+			if(g_numthreads < 0) g_numthreads = 0;
+			rebuild();
+		}
+	}
+	ImGui::Separator();
+	if(g_instanced.IsSupported()){
+		ImGui::Checkbox("instanced drawing", &g_use_instancing);
+	}
+	if(ImGui::Checkbox("profiler", &g_profiler_on)){
+		rxProfiler::Instance().SetEnabled(g_profiler_on);
+		rxProfiler::Instance().Clear();
+	}
 	if(ImGui::Button("reset viewpos")){ resetview(); } 
 	if(ImGui::Button("save screenshot")){ savedisplay(-1); }
+	if(!g_capture.IsRecording()){
+		ImGui::Combo("capture format", &g_capture_format, "bmp sequence\0ppm stream\0y4m stream\0\0");
+		if(ImGui::InputInt("capture fps", &g_capture_fps)){
+			if(g_capture_fps < 1) g_capture_fps = 1;
+		}
+		ImGui::Checkbox("capture in simulation time", &g_capture_simtime);
+		if(ImGui::Button("start capture")){ switchcapture(); }
+	}
+	else{
+		if(ImGui::Button("stop capture")){ switchcapture(); }
+		ImGui::Text("frames: %d (written %d, queued %d, stalls %d)", g_capture.GetFrames(), g_capture.GetWritten(), g_capture.GetQueued(), g_capture.GetStalls());
+	}
 	if(ImGui::Button("quit")){ glfwSetWindowShouldClose(window, GL_TRUE); }
 	ImGui::TextColored(ImVec4(1.0f,0.0f,0.0f,1.0f), "Goal");
 }
 
+/*!
+* プロファイラの結果表示(スレッドごとの呼び出し階層と平滑化した時間)
+*/
+void SetImGUIProfiler(void)
+{
+	rxProfiler &prof = rxProfiler::Instance();
+	if(prof.IsCapturing()){
+		ImGui::Text("capturing trace...");
+	}
+	else if(ImGui::Button("save trace (120 frames)")){
+		prof.CaptureTrace("btcube_trace.json", 120);
+	}
+	ImGui::Separator();
+
+	const vector<rxProfiler::Node> &nodes = prof.GetNodes();
+	const vector<int> &order = prof.GetOrder();
+	for(size_t i = 0; i < order.size(); ++i){
+		const rxProfiler::Node &n = nodes[order[i]];
+		if(n.depth == 0){
+			ImGui::TextColored(ImVec4(0.5f, 0.8f, 1.0f, 1.0f), "[%s] %7.3f ms", n.name.c_str(), 1000.0*n.avg);
+		}
+		else{
+			ImGui::Text("%*s%-*s %7.3f ms  x%d", 2*n.depth, "", 36-2*n.depth, n.name.c_str(), 1000.0*n.avg, n.count);
+		}
+	}
+
+	// カウンタ(AddCounter/SetCounter, フレームごとの値と平滑化した値)
+	const vector<rxProfiler::Counter> &counters = prof.GetCounters();
+	if(!counters.empty()){
+		ImGui::Separator();
+		for(size_t i = 0; i < counters.size(); ++i){
+			const rxProfiler::Counter &c = counters[i];
+			ImGui::Text("%-38s %10.0f  (avg %.1f)", c.name.c_str(), c.value, c.avg);
+		}
+	}
+}
+
 void Clean()
 {
+	g_capture.Release();
+	g_sim.Stop();
 	CleanBullet();
+
+	ClearMeshCache();
+	if(g_softvbo){
+		glDeleteBuffers(1, &g_softvbo);
+		glDeleteBuffers(1, &g_softibo);
+		g_softvbo = g_softibo = 0;
+	}
 }
 
 
@@ -1073,6 +1016,9 @@ void Clean()
  */
 int main(int argc, char *argv[])
 {
+	// コマンドライン引数でシーンファイルを指定(なければSetRigidBodiesで作るシーン)
+	if(argc > 1) g_scenefile = argv[1];
+
 	if(!glfwInit()) return 1;
 	glfwSetErrorCallback(glfw_error_callback);
 
@@ -1114,27 +1060,37 @@ int main(int argc, char *argv[])
 	ImGui_ImplOpenGL2_Init();
 
 	// Settings for timer
-	float cur_time = 0.0f, last_time = 0.0f, elapsed_time = 0.0f;
+	double cur_time = 0.0, last_time = 0.0, elapsed_time = 0.0;
 	glfwSetTime(0.0);	// Initialize the glfw timer
 
 	// Main loop
 	while(!glfwWindowShouldClose(window))
 	{
+		rxProfiler::Enter("frame");
+
 		// Poll and handle events (inputs, window resize, etc.)
 		glfwPollEvents();
 
 		// OpenGL Rendering & Animation function
 		Display();
 
+		// 画面キャプチャ(ImGUIを描く前のバックバッファを読み出す)
+		rxProfiler::Enter("capture");
+		g_capture.Capture(g_winw, g_winh, g_capture.IsRecording() ? capturerepeat(g_sim.Snapshot()) : 0);
+		rxProfiler::Leave();
+
 		// Timer
+		//  - 通常はシミュレーションスレッドが実時間に合わせてステップを進める
+		//  - スレッドを使わない場合はここで経過した実時間分だけ固定幅g_dtのステップを進める
 		cur_time = glfwGetTime();
 		elapsed_time = cur_time-last_time;
-		if(elapsed_time >= g_dt){
-			Timer();
-			last_time = glfwGetTime();
+		last_time = cur_time;
+		if(!g_sim.IsRunning()){
+			g_sim.Tick(elapsed_time);
 		}
 
 		// Start the ImGui frame
+		rxProfiler::Enter("imgui");
 		ImGui_ImplOpenGL2_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
 		ImGui::NewFrame();
@@ -1145,12 +1101,25 @@ int main(int argc, char *argv[])
 		ImGui::Separator();
 		SetImGUI(window);
 		ImGui::End();
+		if(g_profiler_on){
+			ImGui::Begin("Profiler", &g_profiler_on);
+			SetImGUIProfiler();
+			ImGui::End();
+			if(!g_profiler_on) rxProfiler::Instance().SetEnabled(false);
+		}
 
 		// Rendering of the ImGUI frame in opengl canvas
 		ImGui::Render();
 		ImGui_ImplOpenGL2_RenderDrawData(ImGui::GetDrawData());
+		rxProfiler::Leave();
 
+		rxProfiler::Enter("swap buffers");
 		glfwSwapBuffers(window);
+		rxProfiler::Leave();
+
+		// 1フレーム分の計測結果の集計
+		rxProfiler::Leave();
+		rxProfiler::Instance().EndFrame();
 	}
 
 	// Cleanup
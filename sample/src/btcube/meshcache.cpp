@@ -0,0 +1,368 @@
+/*!
+  @file meshcache.cpp
+
+  @brief 三角形メッシュの衝突判定用データのキャッシュ
+
+		 形状の作成(rxMeshCache::CreateShape)
+		 ----------------------------------------------------------------------
+		 1. 元のファイル(OBJ)をメモリマップしてハッシュを計算し，構築の設定(スケール，btScalarの大きさなど)と合わせてキーにする
+		 2. <ディレクトリ>/<キー>.rxmeshがあればコピーオンライトでメモリマップし，ヘッダのキーとヘッダ以降のハッシュを確認する
+			- 頂点・三角形はマップしたまま参照し，BVHはbtOptimizedBvh::deSerializeInPlaceでマップした領域をそのまま使う
+			  (書き換わるのはBVHのオブジェクト部分のページだけ)
+			- 内部エッジの情報はbtTriangleInfoMap::deSerializeFlatでコピーする(ハッシュ表の再構築はしない)
+		 3. なければOBJファイルを読み込んでBVHと内部エッジの情報(btGenerateInternalEdgeInfo)を構築し，プロセスごとの一時ファイルに書いてから名前を変える
+		 ----------------------------------------------------------------------
+		 - 同じ内容のメッシュはファイル名が違ってもキャッシュを共有する．古いキャッシュファイルは削除しない
+		 - バイトオーダーは変換しないので，キャッシュは作ったのと同じ種類のマシンでのみ使う(キーとヘッダにはbtScalarの大きさも入れる)
+
+  @author Makoto Fujisawa
+  @date   2026-10
+*/
+
+//-----------------------------------------------------------------------------
+// Include Files
+//-----------------------------------------------------------------------------
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifdef WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#include "meshcache.h"
+
+// 内部エッジの情報(btGenerateInternalEdgeInfo)
+#include <BulletCollision/CollisionDispatch/btInternalEdgeUtility.h>
+
+// OBJファイルの読み込み
+#include "rx_obj.h"
+
+// 時間計測
+#include "rx_timer.h"
+
+using namespace std;
+
+
+//-----------------------------------------------------------------------------
+// グローバル変数
+//-----------------------------------------------------------------------------
+rxMeshCache g_meshcache;
+
+
+//-----------------------------------------------------------------------------
+// ハッシュ
+//-----------------------------------------------------------------------------
+/*!
+* 64ビットのハッシュ値
+*  - FNV-1aを8バイト単位にして上位ビットを下位に戻す混合を加えたもの(数百MBのファイルでも読み込みの時間に比べて無視できる速さ)
+*  - 暗号学的な強さはないので，キャッシュの取り違えや壊れたファイルの検出にだけ使う
+* @param[in] data データ
+* @param[in] size バイト数
+* @param[in] h 前のデータまでのハッシュ値(続けて計算する場合)
+*/
+static unsigned long long hash64(const void* data, size_t size, unsigned long long h = 14695981039346656037ULL)
+{
+	const unsigned char* c = (const unsigned char*)data;
+	size_t n = size/8;
+	for(size_t i = 0; i < n; ++i, c += 8){
+		unsigned long long w;
+		memcpy(&w, c, 8);
+		h = (h^w)*0x9E3779B97F4A7C15ULL;
+		h ^= h >> 32;
+	}
+	for(size_t i = 8*n; i < size; ++i, ++c){
+		h = (h^*c)*1099511628211ULL;
+	}
+	return h;
+}
+
+//! 値のハッシュ(キーに設定を加える)
+template<class T>
+static unsigned long long hashvalue(const T &v, unsigned long long h)
+{
+	return hash64(&v, sizeof(T), h);
+}
+
+
+//-----------------------------------------------------------------------------
+// rxMeshCacheクラスの実装
+//-----------------------------------------------------------------------------
+/*!
+* OBJファイルの三角形メッシュから静的な剛体用の形状を作る
+*  - 形状は内部エッジの情報(btTriangleInfoMap)を持つので，剛体にCF_CUSTOM_MATERIAL_CALLBACKを設定して
+*    gContactAddedCallbackでbtAdjustInternalEdgeContactsを呼ぶと三角形の境界での引っかかりがなくなる(rxSceneFile::Build)
+*  - 形状の破棄は呼び出し側で行う．メッシュのデータはClearまで残る
+* @param[in] fn OBJファイル名
+* @param[in] scale 頂点座標に掛けるスケール
+* @return 形状(読み込めなければ0)
+*/
+btBvhTriangleMeshShape* rxMeshCache::CreateShape(const string &fn, const btVector3 &scale)
+{
+	rxTimer timer;
+	timer.Start();
+
+	// キー : 元のファイルの内容と，キャッシュの中身が変わる設定
+	unsigned long long key;
+	{
+		rxMappedFile src;
+		if(!src.Open(fn)){
+			cout << "[rxMeshCache] cannot open " << fn << endl;
+			return 0;
+		}
+		key = hash64(src.Data(), src.Size());
+	}
+	const int version = RX_MESHCACHE_VERSION;
+	const int sizes[4] = { (int)sizeof(btScalar), (int)sizeof(void*), (int)sizeof(btOptimizedBvh), (int)sizeof(btQuantizedBvhNode) };
+	const float s[3] = { (float)scale[0], (float)scale[1], (float)scale[2] };
+	key = hashvalue(version, key);
+	key = hashvalue(sizes, key);
+	key = hashvalue(s, key);
+
+	char name[32];
+	sprintf(name, "%016llx.rxmesh", key);
+	string cache = m_strDir.empty() ? "" : m_strDir+"/"+name;
+
+	rxMesh* m = new rxMesh;
+	btBvhTriangleMeshShape* shape = 0;
+	if(!cache.empty() && load(m, cache, key)){
+		// BVHはキャッシュファイル内のものを使う
+		const rxMeshCacheHeader* h = (const rxMeshCacheHeader*)m->map.Data();
+		btOptimizedBvh* bvh = btOptimizedBvh::deSerializeInPlace(m->map.WritableData()+h->bvh_offset, h->bvh_size, false);
+		if(bvh){
+			shape = new btBvhTriangleMeshShape(m->mesh, true, false);
+			shape->setOptimizedBvh(bvh);
+			m_iHits++;
+		}
+		else{
+			cout << "[rxMeshCache] " << cache << " has an invalid bvh" << endl;
+			delete m;
+			m = new rxMesh;
+		}
+	}
+	if(!shape){
+		if(!build(m, fn, scale)){
+			delete m;
+			return 0;
+		}
+		shape = new btBvhTriangleMeshShape(m->mesh, true, true);
+		m->info = new btTriangleInfoMap;
+		btGenerateInternalEdgeInfo(shape, m->info);
+		m_iMisses++;
+		if(!cache.empty()) save(m, shape, cache, key);
+	}
+	shape->setTriangleInfoMap(m->info);
+	m_vMeshes.push_back(m);
+
+	timer.Stop();
+	m_fTime += timer.GetTime(0);
+	return shape;
+}
+
+/*!
+* 読み込んだメッシュの破棄(統計も0に戻す)
+*  - メッシュを参照する形状(CreateShapeで作ったもの)は先に破棄しておくこと
+*/
+void rxMeshCache::Clear(void)
+{
+	for(size_t i = 0; i < m_vMeshes.size(); ++i){
+		delete m_vMeshes[i];
+	}
+	m_vMeshes.clear();
+	m_iHits = m_iMisses = 0;
+	m_fTime = 0.0;
+}
+
+/*!
+* 頂点・三角形の配列からBulletの三角形メッシュを作成
+*  - btScalarがdoubleでも頂点はfloatのまま参照する
+*/
+static btTriangleIndexVertexArray* createmesh(const float* vrts, int nverts, const int* tris, int ntris)
+{
+	btIndexedMesh im;
+	im.m_numTriangles = ntris;
+	im.m_triangleIndexBase = (const unsigned char*)tris;
+	im.m_triangleIndexStride = 3*sizeof(int);
+	im.m_numVertices = nverts;
+	im.m_vertexBase = (const unsigned char*)vrts;
+	im.m_vertexStride = 3*sizeof(float);
+	im.m_indexType = PHY_INTEGER;
+	im.m_vertexType = PHY_FLOAT;
+
+	btTriangleIndexVertexArray* mesh = new btTriangleIndexVertexArray();
+	mesh->addIndexedMesh(im, PHY_INTEGER);
+	return mesh;
+}
+
+/*!
+* キャッシュファイルの読み込み
+*  - 頂点・三角形・BVHはマップしたファイルを直接参照する(m->mapはメッシュを破棄するまで開いたまま)
+* @param[out] m メッシュ
+* @param[in] cache キャッシュファイル名
+* @param[in] key 期待するキー
+* @return キャッシュが使えればtrue(ファイルがない，キーが違う，壊れている場合はfalse)
+*/
+bool rxMeshCache::load(rxMesh* m, const string &cache, unsigned long long key)
+{
+	if(!m->map.Open(cache, true)) return false;
+
+	const char* data = m->map.Data();
+	const size_t size = m->map.Size();
+	const rxMeshCacheHeader* h = (const rxMeshCacheHeader*)data;
+	bool ok = (size >= sizeof(rxMeshCacheHeader) && !memcmp(h->magic, RX_MESHCACHE_MAGIC, sizeof(RX_MESHCACHE_MAGIC)) && h->version == RX_MESHCACHE_VERSION);
+	ok = ok && (h->key[0] == (unsigned int)key && h->key[1] == (unsigned int)(key >> 32) && h->scalar_size == (int)sizeof(btScalar));
+	ok = ok && (h->nverts >= 0 && h->ntris >= 0 && h->bvh_offset%16 == 0 && h->bvh_size > 0 && h->info_size > 0);
+	ok = ok && ((unsigned long long)sizeof(rxMeshCacheHeader)+12ULL*h->nverts+12ULL*h->ntris <= (unsigned long long)h->bvh_offset);
+	ok = ok && ((unsigned long long)h->bvh_offset+h->bvh_size <= (unsigned long long)h->info_offset && (unsigned long long)h->info_offset+h->info_size <= size);
+	if(ok){
+		unsigned long long check = hash64(data+sizeof(rxMeshCacheHeader), size-sizeof(rxMeshCacheHeader));
+		ok = (h->check[0] == (unsigned int)check && h->check[1] == (unsigned int)(check >> 32));
+		if(!ok) cout << "[rxMeshCache] " << cache << " is corrupted, rebuilding" << endl;
+	}
+	if(ok){
+		// 三角形の頂点番号の範囲はハッシュで保証されるので確認しない
+		const float* vrts = (const float*)(data+sizeof(rxMeshCacheHeader));
+		const int* tris = (const int*)(vrts+3*h->nverts);
+		m->info = new btTriangleInfoMap;
+		ok = m->info->deSerializeFlat(data+h->info_offset, h->info_size);
+		if(ok){
+			m->mesh = createmesh(vrts, h->nverts, tris, h->ntris);
+			m->mesh->setPremadeAabb(btVector3(h->aabb_min[0], h->aabb_min[1], h->aabb_min[2]), btVector3(h->aabb_max[0], h->aabb_max[1], h->aabb_max[2]));
+		}
+	}
+	if(!ok){
+		delete m->info;
+		m->info = 0;
+		m->map.Close();
+	}
+	return ok;
+}
+
+/*!
+* OBJファイルを読み込んで頂点と三角形の配列を作る
+* @param[out] m メッシュ(m->vrts, m->tris, m->mesh)
+* @param[in] fn OBJファイル名
+* @param[in] scale 頂点座標に掛けるスケール
+*/
+bool rxMeshCache::build(rxMesh* m, const string &fn, const btVector3 &scale)
+{
+	rxOBJ obj;
+	vector<glm::vec3> vrts, nrms;
+	vector<rxFace> plys;
+	rxMTL mats;
+	if(!obj.Read(fn, vrts, nrms, plys, mats, true) || vrts.empty()){
+		cout << "[rxMeshCache] cannot read " << fn << endl;
+		return false;
+	}
+
+	m->vrts.resize(3*vrts.size());
+	for(size_t i = 0; i < vrts.size(); ++i){
+		for(int k = 0; k < 3; ++k) m->vrts[3*i+k] = (float)(vrts[i][k]*scale[k]);
+	}
+	m->tris.reserve(3*plys.size());
+	for(size_t i = 0; i < plys.size(); ++i){
+		const vector<int> &v = plys[i].vert_idx;
+		if(v.size() != 3) continue;
+		if(v[0] < 0 || v[1] < 0 || v[2] < 0 || v[0] >= (int)vrts.size() || v[1] >= (int)vrts.size() || v[2] >= (int)vrts.size()) continue;
+		m->tris.push_back(v[0]); m->tris.push_back(v[1]); m->tris.push_back(v[2]);
+	}
+	if(m->tris.empty()){
+		cout << "[rxMeshCache] " << fn << " has no triangles" << endl;
+		return false;
+	}
+	m->mesh = createmesh(&m->vrts[0], (int)vrts.size(), &m->tris[0], (int)m->tris.size()/3);
+	return true;
+}
+
+/*!
+* キャッシュファイルの書き込み
+*  - 他のプロセスが書き込み途中のファイルを読まないように，プロセスごとの一時ファイルに書いてから名前を変える
+* @param[in] m メッシュ
+* @param[in] shape 構築した形状(BVHとAABBを保存する)
+* @param[in] cache キャッシュファイル名
+* @param[in] key キー
+*/
+bool rxMeshCache::save(const rxMesh* m, btBvhTriangleMeshShape* shape, const string &cache, unsigned long long key) const
+{
+	const btOptimizedBvh* bvh = shape->getOptimizedBvh();
+#ifdef WIN32
+	_mkdir(m_strDir.c_str());
+#else
+	mkdir(m_strDir.c_str(), 0755);
+#endif
+
+	rxMeshCacheHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, RX_MESHCACHE_MAGIC, sizeof(RX_MESHCACHE_MAGIC));
+	h.version = RX_MESHCACHE_VERSION;
+	h.key[0] = (unsigned int)key;
+	h.key[1] = (unsigned int)(key >> 32);
+	h.nverts = (int)m->vrts.size()/3;
+	h.ntris = (int)m->tris.size()/3;
+	h.scalar_size = (int)sizeof(btScalar);
+	for(int k = 0; k < 3; ++k){
+		h.aabb_min[k] = shape->getLocalAabbMin()[k];
+		h.aabb_max[k] = shape->getLocalAabbMax()[k];
+	}
+	size_t bvh_offset = (sizeof(h)+sizeof(float)*m->vrts.size()+sizeof(int)*m->tris.size()+15) & ~(size_t)15;
+	size_t bvh_size = bvh->calculateSerializeBufferSize();
+	size_t info_offset = (bvh_offset+bvh_size+15) & ~(size_t)15;
+	size_t info_size = m->info->calculateFlatBufferSize();
+	size_t size = info_offset+info_size;
+	if(size > 0x7fffffff){
+		cout << "[rxMeshCache] " << cache << " : the mesh is too large to cache" << endl;
+		return false;
+	}
+	h.bvh_offset = (int)bvh_offset;
+	h.bvh_size = (int)bvh_size;
+	h.info_offset = (int)info_offset;
+	h.info_size = (int)info_size;
+
+	// ファイル全体をメモリ上で作ってからハッシュを計算して書き込む(serializeInPlaceは16バイト境界のバッファが必要)
+	char* buf = (char*)btAlignedAlloc(size, 16);
+	memset(buf, 0, size);
+	memcpy(buf+sizeof(h), &m->vrts[0], sizeof(float)*m->vrts.size());
+	memcpy(buf+sizeof(h)+sizeof(float)*m->vrts.size(), &m->tris[0], sizeof(int)*m->tris.size());
+	bool ok = bvh->serializeInPlace(buf+bvh_offset, (unsigned)bvh_size, false) && m->info->serializeFlat(buf+info_offset, (unsigned)info_size);
+	if(ok){
+		unsigned long long check = hash64(buf+sizeof(h), size-sizeof(h));
+		h.check[0] = (unsigned int)check;
+		h.check[1] = (unsigned int)(check >> 32);
+		memcpy(buf, &h, sizeof(h));
+
+		// 一時ファイルの名前はプロセスごとに変える(同時に同じメッシュを保存するプロセスが互いのファイルを置き換えないように)
+		FILE* fp = 0;
+		string tmp;
+		for(int i = 0; i < 16 && !fp; ++i){
+			ostringstream ss;
+#ifdef WIN32
+			ss << cache << "." << _getpid() << "." << i << ".tmp";
+#else
+			ss << cache << "." << getpid() << "." << i << ".tmp";
+#endif
+			tmp = ss.str();
+			fp = fopen(tmp.c_str(), "wbx");	// 既にあれば開かない
+		}
+		ok = (fp && fwrite(buf, 1, size, fp) == size);
+		if(fp){
+			ok = (fclose(fp) == 0) && ok;
+			if(ok){
+#ifdef WIN32
+				remove(cache.c_str());	// Windowsのrenameは上書きしない
+#endif
+				ok = (rename(tmp.c_str(), cache.c_str()) == 0);
+			}
+			if(!ok) remove(tmp.c_str());
+		}
+	}
+	btAlignedFree(buf);
+
+	if(!ok) cout << "[rxMeshCache] cannot write " << cache << endl;
+	return ok;
+}
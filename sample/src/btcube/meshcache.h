@@ -0,0 +1,109 @@
+/*!
+  @file meshcache.h
+
+  @brief 三角形メッシュ(OBJファイル)の衝突判定用データのキャッシュ
+		 - btBvhTriangleMeshShapeのBVH(btOptimizedBvh)と内部エッジの情報(btTriangleInfoMap)の構築は大きなメッシュでは数秒かかるので，
+		   頂点・三角形と一緒に1つのファイルに保存しておき，次回からはファイルをメモリマップしてそのまま使う
+		 - キャッシュファイルの名前は元のファイルの内容と構築の設定のハッシュ値なので，メッシュを編集すると自動的に作り直す
+		 - OpenGL/GLFWに依存しないのでヘッドレス版からも使う
+
+  @author Makoto Fujisawa
+  @date   2026-10
+*/
+
+#ifndef _MESHCACHE_H_
+#define _MESHCACHE_H_
+
+
+//-----------------------------------------------------------------------------
+// インクルードファイル
+//-----------------------------------------------------------------------------
+#include <string>
+#include <vector>
+
+#include "scene.h"
+#include "scenefile.h"
+
+
+//-----------------------------------------------------------------------------
+// 定義
+//-----------------------------------------------------------------------------
+//! ファイル識別子とバージョン
+#define RX_MESHCACHE_MAGIC "RXMESHC"
+#define RX_MESHCACHE_VERSION 2
+
+// キャッシュファイル(<ディレクトリ>/<キーの16進数>.rxmesh)
+//  - シーンファイルのバイナリ形式と同じく詰め物なしでそのまま書き込む(リトルエンディアン)．ヘッダのAABBだけは8バイト境界に置いたdouble
+//  - ヘッダ，頂点(float x 3)，三角形(int x 3)，BVH(btOptimizedBvh::serializeInPlace)，
+//    内部エッジの情報(btTriangleInfoMap::serializeFlat)の順に並べる．BVHはメモリマップしたまま使うので16バイト境界に置く
+
+//! ヘッダ(104バイト)
+struct rxMeshCacheHeader
+{
+	char magic[8];				//!< RX_MESHCACHE_MAGIC
+	int version;				//!< RX_MESHCACHE_VERSION
+	unsigned int key[2];		//!< 元のファイルの内容と構築の設定のハッシュ(下位,上位32ビット)
+	unsigned int check[2];		//!< ヘッダ以降のハッシュ(書き込みの途中で終わったファイルや壊れたファイルの検出)
+	int nverts, ntris;			//!< 頂点と三角形の数
+	int bvh_offset, bvh_size;	//!< BVHの位置と大きさ
+	int info_offset, info_size;	//!< 内部エッジの情報の位置と大きさ
+	int scalar_size;			//!< sizeof(btScalar)(BVHと内部エッジの情報はbtScalarのまま保存するので，読み込む側と違えば使わない)
+	double aabb_min[3], aabb_max[3];	//!< 形状のローカル座標でのAABB(読み込み時に全三角形を走査しないように．btScalarがdoubleでも丸めずに保存する)
+};
+
+
+//-----------------------------------------------------------------------------
+// 三角形メッシュのキャッシュ
+//-----------------------------------------------------------------------------
+class rxMeshCache
+{
+	//! 読み込んだメッシュ(形状が参照するので形状を破棄するまで保持する)
+	struct rxMesh
+	{
+		rxMappedFile map;					//!< キャッシュファイル(ヒットした場合は頂点・三角形・BVHはこの中)
+		std::vector<float> vrts;			//!< 頂点(キャッシュがなかった場合)
+		std::vector<int> tris;				//!< 三角形の頂点番号(キャッシュがなかった場合)
+		btTriangleIndexVertexArray* mesh;
+		btTriangleInfoMap* info;
+		rxMesh() : mesh(0), info(0){}
+		~rxMesh(){ delete mesh; delete info; }
+	};
+	std::vector<rxMesh*> m_vMeshes;
+
+	std::string m_strDir;		//!< キャッシュファイルを置くディレクトリ(空ならキャッシュしない)
+
+	// 統計
+	int m_iHits, m_iMisses;
+	double m_fTime;				//!< CreateShapeにかかった時間の合計[s]
+
+public:
+	rxMeshCache() : m_strDir("meshcache"), m_iHits(0), m_iMisses(0), m_fTime(0.0){}
+	~rxMeshCache(){ Clear(); }
+
+	// OBJファイルの三角形メッシュから静的な剛体用の形状を作る(キャッシュがあれば読み込み，なければ構築して保存)
+	btBvhTriangleMeshShape* CreateShape(const std::string &fn, const btVector3 &scale);
+
+	// 読み込んだメッシュの破棄(CreateShapeで作った形状を破棄した後に呼ぶ)
+	void Clear(void);
+
+	void SetDir(const std::string &dir){ m_strDir = dir; }
+	const std::string& Dir(void) const { return m_strDir; }
+
+	int NumHits(void) const { return m_iHits; }
+	int NumMisses(void) const { return m_iMisses; }
+	double Time(void) const { return m_fTime; }
+
+protected:
+	bool load(rxMesh* m, const std::string &cache, unsigned long long key);
+	bool build(rxMesh* m, const std::string &fn, const btVector3 &scale);
+	bool save(const rxMesh* m, btBvhTriangleMeshShape* shape, const std::string &cache, unsigned long long key) const;
+
+private:
+	rxMeshCache(const rxMeshCache&);
+	rxMeshCache& operator=(const rxMeshCache&);
+};
+
+extern rxMeshCache g_meshcache;	//!< シーンの三角形メッシュのキャッシュ(CleanBulletで破棄)
+
+
+#endif // #ifndef _MESHCACHE_H_
@@ -0,0 +1,708 @@
+/*!
+  @file scene.cpp
+
+  @brief Bulletワールドとシーン(剛体オブジェクト)の構築
+
+  @author Makoto Fujisawa
+  @date   2026-10
+*/
+
+//-----------------------------------------------------------------------------
+// Include Files
+//-----------------------------------------------------------------------------
+#include "scene.h"
+#include "scenefile.h"
+#include "meshcache.h"
+
+// 時間計測
+#include "rx_timer.h"
+
+// プロファイラ(ステップごとのカウンタ)
+#include "rx_profiler.h"
+
+using namespace std;
+
+
+//-----------------------------------------------------------------------------
+// グローバル変数
+//-----------------------------------------------------------------------------
+// Bullet
+btDynamicsWorld* g_dynamicsworld;	//!< Bulletワールド
+btAlignedObjectArray<btCollisionShape*>	g_collisionshapes;		//!< 剛体オブジェクトの形状を格納する動的配列
+btTypedConstraint* g_constraint; // キューブ同士の結合
+
+car_t g_carWheels; // 車を保持する
+float g_targetStearingAngle = 0; // タイヤの目標角度
+
+// ワールドの設定
+int g_worldtype = RX_WORLD_SINGLE;	//!< ワールドの種類
+int g_broadphasetype = RX_BROADPHASE_SAP;	//!< ブロードフェーズの種類
+bool g_raycastaccel = false;		//!< btSortAndSweepBroadphaseにレイ/AABB判定用のbtDbvtBroadphaseを持たせるか
+int g_scheduler = RX_SCHED_BULLET;	//!< タスクスケジューラの種類
+int g_numthreads = 0;				//!< スレッド数(0でスケジューラの最大数)
+string g_scenefile;					//!< シーンファイル(空ならSetRigidBodiesで作るシーン)
+
+rxBulletState g_initstate;			//!< InitBullet直後のワールドの状態
+
+// ワールドを構成するオブジェクト(CleanBulletで破棄)
+btCollisionConfiguration* g_config = 0;
+btCollisionDispatcher* g_dispatcher = 0;
+btBroadphaseInterface* g_broadphase = 0;
+btConstraintSolver* g_solver = 0;
+btConstraintSolver* g_solver_mt = 0;	//!< 大きな島用の並列ソルバ(RX_WORLD_MTのみ)
+
+// 剛体数がこれ以上ならRX_BROADPHASE_AXIS3でもbtDbvtBroadphaseを使う
+const int RX_DBVT_BODIES = 4096;
+
+// Bullet組み込みのタスクスケジューラ(ワーカースレッドを持つので必要になったときに作り，CleanBulletで破棄する)
+btITaskScheduler* g_bullet_scheduler = 0;
+
+
+//-----------------------------------------------------------------------------
+// Bullet用関数
+//-----------------------------------------------------------------------------
+/*!
+* Bullet剛体(btRigidBody)の作成
+* @param[in] mass 質量
+* @param[in] init_tras 初期位置・姿勢
+* @param[in] shape 形状
+* @return 作成したbtRigidBody
+*/
+btRigidBody* CreateRigidBody(double mass, const btTransform& init_trans, btCollisionShape* shape, int myGroup, int targetGroup, btDynamicsWorld* world, int index)
+{
+	//btAssert((!shape || shape->getShapeType() != INVALID_SHAPE_PROXYTYPE));
+
+	// 質量が0ならば静的な(static)オブジェクトとして設定，
+	bool isDynamic = (mass != 0.0);
+
+	btVector3 inertia(0, 0, 0);
+	if (isDynamic)
+		shape->calculateLocalInertia(mass, inertia);
+
+	btDefaultMotionState* motion_state = new btDefaultMotionState(init_trans);
+
+	btRigidBody::btRigidBodyConstructionInfo rb_info(mass, motion_state, shape, inertia);
+
+	btRigidBody* body = new btRigidBody(rb_info);
+
+	body->setUserIndex(index);
+
+	if (mass <= 1e-10) {
+		// Kinematicオブジェクトとして設定(stepSimulationしても運動の計算を行わないようにする)
+		body->setCollisionFlags(body->getCollisionFlags() | btCollisionObject::CF_KINEMATIC_OBJECT);
+		// 常にスリープ状態にする
+		body->setActivationState(DISABLE_DEACTIVATION);
+	}
+
+	if (world) {
+		world->addRigidBody(body, myGroup, targetGroup);
+	}
+
+	return body;
+}
+
+/*!
+* Bullet剛体(btRigidBody)の作成
+* @param[in] mass 質量
+* @param[in] init_tras 初期位置・姿勢
+* @param[in] shape 形状
+* @return 作成したbtRigidBody
+*/
+btRigidBody* CreateRigidBody(double mass, const btTransform& init_trans, btCollisionShape* shape, btDynamicsWorld* world, int index)
+{
+	return CreateRigidBody(mass, init_trans, shape, RX_COL_ALL, RX_COL_ALL, world, index);
+}
+
+
+/*!
+* 立方体を任意の位置に追加
+*/
+btRigidBody* SetRigidCube(btVector3 pos, btVector3 size, float mass)
+{
+	btTransform trans;	// 剛体オブジェクトの位置姿勢を格納する変数(行列)
+	trans.setIdentity();// 位置姿勢行列の初期化
+
+	// ----- 立方体オブジェクト追加 -----
+	// 形状設定
+	btCollisionShape* box_shape = new btBoxShape(size);
+	g_collisionshapes.push_back(box_shape); // 最後に破棄(delete)するために形状データを格納しておく
+
+	// 初期位置・姿勢
+	btQuaternion qrot(0, 0, 0, 1);
+	trans.setIdentity();// 位置姿勢行列の初期化
+	trans.setOrigin(pos);
+	trans.setRotation(qrot);	// 四元数を行列に変換して姿勢行列に掛け合わせる
+
+	// 剛体オブジェクト生成
+	btRigidBody* body1 = CreateRigidBody(mass, trans, box_shape, RX_COL_GROUP1, RX_COL_GROUP1 | RX_COL_GROUND, g_dynamicsworld, 0);
+	// ----- ここまで (立方体オブジェクト追加) -----
+
+
+	// すり抜け防止用Swept sphereの設定(CCD:Continuous Collision Detection)
+	body1->setCcdMotionThreshold(size.norm());
+	body1->setCcdSweptSphereRadius(0.05 * size.norm());
+
+	return body1;
+}
+
+btRigidBody* SetStaticCube(btVector3 pos, btVector3 size) {
+	return SetRigidCube(pos, size, 0.0);
+}
+
+btRigidBody* SetStaticCube(btVector3 pos) {
+	const btScalar CUBE_HALF_EXTENTS = 0.2;	// 立方体の変の長さの半分(中心から辺までの距離)
+	return SetRigidCube(pos, btVector3(CUBE_HALF_EXTENTS, CUBE_HALF_EXTENTS, CUBE_HALF_EXTENTS), 0.0);
+}
+
+btRigidBody* SetRigidCube(btVector3 pos, btVector3 size) {
+	return SetRigidCube(pos, size, 1.0);
+}
+
+btRigidBody* SetRigidCube(btVector3 pos) {
+	const btScalar CUBE_HALF_EXTENTS = 0.2;	// 立方体の変の長さの半分(中心から辺までの距離)
+	return SetRigidCube(pos, btVector3(CUBE_HALF_EXTENTS, CUBE_HALF_EXTENTS, CUBE_HALF_EXTENTS),1.0);
+}
+
+/*!
+* 球体を任意の位置に追加
+*/
+btRigidBody* SetRigidSphere(btVector3 pos)
+{
+	btTransform trans;	// 剛体オブジェクトの位置姿勢を格納する変数(行列)
+	trans.setIdentity();// 位置姿勢行列の初期化
+
+	const btScalar Capsule_HALF_EXTENTS = 0.2;	// 球の変の長さの半分(中心から辺までの距離)
+
+	// ----- 球体オブジェクト追加 -----
+	// 形状設定
+	btCollisionShape* Capsule_shape = new btSphereShape(Capsule_HALF_EXTENTS);
+	g_collisionshapes.push_back(Capsule_shape); // 最後に破棄(delete)するために形状データを格納しておく
+
+	// 初期位置・姿勢
+	btQuaternion qrot(0, 0, 0, 1);
+	trans.setIdentity();// 位置姿勢行列の初期化
+	trans.setOrigin(pos);
+	trans.setRotation(qrot);	// 四元数を行列に変換して姿勢行列に掛け合わせる
+
+	// 剛体オブジェクト生成
+	btRigidBody* body1 = CreateRigidBody(1.0, trans, Capsule_shape, RX_COL_GROUP2, RX_COL_GROUP2 | RX_COL_GROUND, g_dynamicsworld, 0);
+	// ----- ここまで (球オブジェクト追加) -----
+
+
+	// すり抜け防止用Swept sphereの設定(CCD:Continuous Collision Detection)
+	body1->setCcdMotionThreshold(Capsule_HALF_EXTENTS);
+	body1->setCcdSweptSphereRadius(0.05 * Capsule_HALF_EXTENTS);
+
+	return body1;
+}
+
+void throughSphere(btVector3 pos, btVector3 dir, float spd) 
+{
+
+	// 剛体オブジェクト生成
+	btRigidBody* body1 = SetRigidSphere(pos);
+	// ----- ここまで (球オブジェクト追加) -----
+
+	// 反発係数の設定
+	body1->setRestitution(10.0);
+
+	// 初速度を与える
+	body1->setLinearVelocity(dir.normalize() * spd);
+}
+
+/*!
+* 円筒を任意の位置に追加
+*/
+btRigidBody* SetRigidCylinder(btVector3 pos, btVector3 size)
+{
+	btTransform trans;	// 剛体オブジェクトの位置姿勢を格納する変数(行列)
+	trans.setIdentity();// 位置姿勢行列の初期化
+
+	// ----- 球体オブジェクト追加 -----
+	// 形状設定
+	btCollisionShape* cylinder_shape = new btCylinderShape(size);
+	g_collisionshapes.push_back(cylinder_shape); // 最後に破棄(delete)するために形状データを格納しておく
+
+	// 初期位置・姿勢
+	btQuaternion qrot(0, 0, 0, 1);
+	trans.setIdentity();// 位置姿勢行列の初期化
+	trans.setOrigin(pos);
+	trans.setRotation(qrot);	// 四元数を行列に変換して姿勢行列に掛け合わせる
+
+	// 剛体オブジェクト生成
+	btRigidBody* body1 = CreateRigidBody(1.0, trans, cylinder_shape, g_dynamicsworld, 0);
+	// ----- ここまで (球オブジェクト追加) -----
+
+
+	// すり抜け防止用Swept sphereの設定(CCD:Continuous Collision Detection)
+	body1->setCcdMotionThreshold(size.norm());
+	body1->setCcdSweptSphereRadius(0.05 * size.norm());
+
+	return body1;
+}
+
+btRigidBody* SetRigidCylinder(btVector3 pos) {
+	const btScalar CYLINDER_HALF_EXTENTS = 0.2;	// 球の変の長さの半分(中心から辺までの距離)
+	return SetRigidCylinder(pos, btVector3(CYLINDER_HALF_EXTENTS, CYLINDER_HALF_EXTENTS, CYLINDER_HALF_EXTENTS));
+}
+
+btRigidBody* SetRigidCylinderX(btVector3 pos, btVector3 size)
+{
+	btTransform trans;	// 剛体オブジェクトの位置姿勢を格納する変数(行列)
+	trans.setIdentity();// 位置姿勢行列の初期化
+
+	// ----- 球体オブジェクト追加 -----
+	// 形状設定
+	btCollisionShape* cylinder_shape = new btCylinderShapeX(size);
+	g_collisionshapes.push_back(cylinder_shape); // 最後に破棄(delete)するために形状データを格納しておく
+
+	// 初期位置・姿勢
+	btQuaternion qrot(0, 0, 0, 1);
+	trans.setIdentity();// 位置姿勢行列の初期化
+	trans.setOrigin(pos);
+	trans.setRotation(qrot);	// 四元数を行列に変換して姿勢行列に掛け合わせる
+
+	// 剛体オブジェクト生成
+	btRigidBody* body1 = CreateRigidBody(20.0, trans, cylinder_shape, RX_COL_GROUP2, RX_COL_GROUP2 | RX_COL_GROUND, g_dynamicsworld, 0);
+	// ----- ここまで (球オブジェクト追加) -----
+
+
+	// すり抜け防止用Swept sphereの設定(CCD:Continuous Collision Detection)
+	body1->setCcdMotionThreshold(size.norm());
+	body1->setCcdSweptSphereRadius(0.05 * size.norm());
+
+	return body1;
+}
+
+// 車のオブジェクトを生成
+car_t cleateCarObject(btVector3 pos) {
+	const btVector3 bodySize = btVector3(0.3, 0.1, 0.4);
+	const btVector3 wheelSize = btVector3(0.08, 0.2, 0.2);
+	
+	// 本体を追加
+	btRigidBody* body = SetRigidCube(pos, bodySize, 1);
+
+	// 車輪を追加
+	btVector3 wheel0Pos = btVector3(bodySize[0] + wheelSize[0], 0, bodySize[2] - 0.1);
+	btVector3 wheel1Pos = btVector3(-(bodySize[0] + wheelSize[0]), 0, bodySize[2] - 0.1);
+	btVector3 wheel2Pos = btVector3(bodySize[0] + wheelSize[0], 0, -(bodySize[2] - 0.1));
+	btVector3 wheel3Pos = btVector3(-(bodySize[0] + wheelSize[0]), 0, -(bodySize[2] - 0.1));
+	btRigidBody* wheel0 = SetRigidCylinderX(pos + wheel0Pos, wheelSize);
+	btRigidBody* wheel1 = SetRigidCylinderX(pos + wheel1Pos, wheelSize);
+	btRigidBody* wheel2 = SetRigidCylinderX(pos + wheel2Pos, wheelSize);
+	btRigidBody* wheel3 = SetRigidCylinderX(pos + wheel3Pos, wheelSize);
+
+	// タイヤの摩擦を決定
+	wheel0->setRestitution(1);
+	wheel1->setRestitution(1);
+	wheel2->setRestitution(1);
+	wheel3->setRestitution(1);
+
+	// 本体と車体をくっつける
+	// (btHinge2Constraintの引数は非constの参照なので一時オブジェクトを渡せない -> 変数に入れておく)
+	btVector3 anchor0 = pos + wheel0Pos, anchor1 = pos + wheel1Pos;
+	btVector3 axis1(0, 1, 0), axis2(1, 0, 0);
+	btHinge2Constraint* constraintb0 = new btHinge2Constraint(*body, *wheel0, anchor0, axis1, axis2);
+	btHinge2Constraint* constraintb1 = new btHinge2Constraint(*body, *wheel1, anchor1, axis1, axis2);
+	btHingeConstraint* constraintb2 = new btHingeConstraint(*body, *wheel2, wheel2Pos, btVector3(0, 0, 0), btVector3(1, 0, 0), btVector3(1, 0, 0));
+	btHingeConstraint* constraintb3 = new btHingeConstraint(*body, *wheel3, wheel3Pos, btVector3(0, 0, 0), btVector3(1, 0, 0), btVector3(1, 0, 0));
+	g_dynamicsworld->addConstraint(constraintb0);
+	g_dynamicsworld->addConstraint(constraintb1);
+	g_dynamicsworld->addConstraint(constraintb2);
+	g_dynamicsworld->addConstraint(constraintb3);
+
+	// 前輪の設定
+	constraintb0->setLowerLimit(btRadians(-30.0));
+	constraintb0->setUpperLimit(btRadians( 30.0));
+	constraintb0->setLinearLowerLimit(btVector3(0, 0, 0));
+	constraintb0->setLinearUpperLimit(btVector3(0, 0, 0));
+	(constraintb0->getRotationalLimitMotor(0))->m_enableMotor = true;
+	(constraintb0->getRotationalLimitMotor(2))->m_enableMotor = true;
+	constraintb1->setLowerLimit(btRadians(-30.0));
+	constraintb1->setUpperLimit(btRadians( 30.0));
+	constraintb1->setLinearLowerLimit(btVector3(0, 0, 0));
+	constraintb1->setLinearUpperLimit(btVector3(0, 0, 0));
+	(constraintb1->getRotationalLimitMotor(0))->m_enableMotor = true;
+	(constraintb1->getRotationalLimitMotor(2))->m_enableMotor = true;
+	// モータをつける
+	constraintb2->enableAngularMotor(true, btRadians(0.0), 1.0);
+	constraintb3->enableAngularMotor(true, btRadians(0.0), 1.0);
+
+	return car_t{ wheel0, wheel1, wheel2, wheel3, constraintb0, constraintb1, constraintb2, constraintb3 };
+}
+
+/*!
+* 剛体オブジェクトの追加
+*/
+void SetRigidBodies(void)
+{
+	btTransform trans;	// 剛体オブジェクトの位置姿勢を格納する変数(行列)
+	trans.setIdentity();// 位置姿勢行列の初期化
+
+	const btScalar CUBE_HALF_EXTENTS = 0.2;	// 立方体の変の長さの半分(中心から辺までの距離)
+	const btScalar GROUND_HEIGHT = 0.0;		// 地面の高さ
+
+	// ----- 地面(質量0のx-z平面上で平べったい直方体で表現)の追加 -----
+	btCollisionShape *ground_shape = new btBoxShape(btVector3(20, CUBE_HALF_EXTENTS, 20));	// 形状
+	g_collisionshapes.push_back(ground_shape); // 最後に破棄(delete)するために形状データを格納しておく
+
+	ground_shape->setUserIndex(99); // 99とした場合のみ描画時にテクスチャ付き平面として描画．床を傾けたい等の場合は99にしないこと．
+	trans.setOrigin(btVector3(0, GROUND_HEIGHT-CUBE_HALF_EXTENTS, 0));	// 上の面がy=0になるように設定
+	
+	// 剛体オブジェクト(Static)生成
+	btRigidBody* body0 = CreateRigidBody(0.0, trans, ground_shape, g_dynamicsworld, 99);
+	// ----- ここまで (地面の追加) -----
+
+
+	// ----- 立方体オブジェクト追加 -----
+	SetRigidCube(btVector3(0, GROUND_HEIGHT + 10.0 * CUBE_HALF_EXTENTS, 0));
+	SetStaticCube(btVector3(1, 1, 1));
+
+	// ----- 立方体同士の拘束 -----
+	btRigidBody* body1 = SetRigidCube(btVector3(1, GROUND_HEIGHT + 10 * CUBE_HALF_EXTENTS, 0));
+	btRigidBody* body2 = SetRigidCube(btVector3(1, GROUND_HEIGHT + 10 * CUBE_HALF_EXTENTS, 0));
+
+	// body0を空間上に拘束
+	btVector3 pivot0(-CUBE_HALF_EXTENTS, -CUBE_HALF_EXTENTS, -CUBE_HALF_EXTENTS);
+	btTypedConstraint* joint01 = new btPoint2PointConstraint(*body1, pivot0);
+	g_dynamicsworld->addConstraint(joint01);
+
+	// body1をbody1に拘束
+	btVector3 pivot1( CUBE_HALF_EXTENTS,  CUBE_HALF_EXTENTS,  CUBE_HALF_EXTENTS);
+	btVector3 pivot2(-CUBE_HALF_EXTENTS, -CUBE_HALF_EXTENTS, -CUBE_HALF_EXTENTS);
+	btTypedConstraint* joint12 = new btPoint2PointConstraint(*body1, *body2, pivot1, pivot2);
+	joint12->enableFeedback(true);
+	btJointFeedback* feedback = new btJointFeedback();
+	joint12->setJointFeedback(feedback);
+	g_constraint = joint12;
+	g_dynamicsworld->addConstraint(joint12);
+
+	// 車の追加
+	g_carWheels = cleateCarObject(btVector3(0, 0.5, 0));
+}
+
+/*!
+* ブロードフェーズの名前
+* @param[in] type ブロードフェーズの種類(RX_BROADPHASE_*)
+*/
+const char* GetBroadphaseName(int type)
+{
+	static const char* names[] = { "sap", "axis3", "dbvt", "grid" };
+	return (type >= 0 && type < RX_BROADPHASE_NUM) ? names[type] : "unknown";
+}
+
+/*!
+* タスクスケジューラの名前
+* @param[in] type スケジューラの種類(RX_SCHED_*)
+*/
+const char* GetTaskSchedulerName(int type)
+{
+	static const char* names[] = { "sequential", "bullet", "openmp", "tbb", "ppl" };
+	return (type >= 0 && type < RX_SCHED_NUM) ? names[type] : "unknown";
+}
+
+/*!
+* タスクスケジューラの選択とスレッド数の設定
+* - btSetTaskSchedulerはBulletのメインスレッド(最初にBulletのスレッド関数を呼んだスレッド)から呼ぶこと
+* - 指定したスケジューラがBulletのビルド設定で使えない場合は並列化なしにする
+* @param[in] type スケジューラの種類(RX_SCHED_*)
+* @param[in] nthreads スレッド数(0以下でスケジューラの最大数)
+* @return 実際に設定したスケジューラの種類
+*/
+int SetTaskScheduler(int type, int nthreads)
+{
+	btITaskScheduler* ts = 0;
+	switch(type){
+	case RX_SCHED_BULLET:
+		if(!g_bullet_scheduler) g_bullet_scheduler = btCreateDefaultTaskScheduler();
+		ts = g_bullet_scheduler;
+		break;
+	case RX_SCHED_OPENMP: ts = btGetOpenMPTaskScheduler(); break;
+	case RX_SCHED_TBB:    ts = btGetTBBTaskScheduler(); break;
+	case RX_SCHED_PPL:    ts = btGetPPLTaskScheduler(); break;
+	default: break;
+	}
+
+	if(!ts){
+		if(type != RX_SCHED_SEQUENTIAL){
+			cout << "task scheduler '" << GetTaskSchedulerName(type) << "' is not available in this Bullet build (BT_THREADSAFE/BT_USE_*), falling back to sequential" << endl;
+		}
+		ts = btGetSequentialTaskScheduler();
+		type = RX_SCHED_SEQUENTIAL;
+	}
+
+	int n = ts->getMaxNumThreads();
+	if(nthreads > 0 && nthreads < n) n = nthreads;
+	ts->setNumThreads(n);
+	btSetTaskScheduler(ts);
+
+	return type;
+}
+
+/*!
+* Bullet初期化
+* - g_worldtypeがRX_WORLD_MTならば衝突判定，島ごとの拘束計算，積分を並列化したワールドを作る
+*/
+void InitBullet(void)
+{
+	// シーンファイル(剛体数でブロードフェーズを決めるのでワールドより先に開く)
+	rxTimer timer;
+	timer.Start();
+	rxSceneFile scene;
+	if(!g_scenefile.empty() && !scene.Open(g_scenefile)){
+		cout << "failed to load the scene file " << g_scenefile << ", using the built-in scene" << endl;
+	}
+	btScalar ws = (scene.IsOpen() ? scene.Header().world_size : 100);
+	int nbodies = scene.NumBodies();
+
+	// 衝突検出方法の選択(デフォルトを選択)
+	g_config = new btDefaultCollisionConfiguration();
+
+	// ブロードフェーズ法の設定
+	//  - 通常は毎ステップ全AABBをソートし直すSweep and prune(btSortAndSweepBroadphase)
+	//    ワールドの範囲や剛体数の制限がなく，ソートとペアの検出はタスクスケジューラで並列化される(RX_WORLD_MTのとき)
+	//    レイ/AABB判定用のbtDbvtBroadphaseは全AABBの更新コストがかかるので，レイを大量に投げるとき(g_raycastaccel)だけ作る．
+	//    ないときのrayTest/aabbTestは全剛体を調べる(マウスでのピックなど1本ずつなら十分速い)
+	//  - btAxisSweep3はオブジェクトの追加ごとに軸上のソート済みリストへ挿入するので(1個あたりO(n))，
+	//    剛体の多いシーンでは追加がO(log n)のDynamic AABB tree(btDbvtBroadphase)を使う
+	//  - 大きさのそろった剛体(球や箱)が大量にある場合は一様グリッド(btHashedGridBroadphase)が速い．
+	//    セルの大きさはAABBの平均の2倍で，それより大きい地面などはグリッドに入れずに全剛体と判定する
+	if(g_broadphasetype == RX_BROADPHASE_AXIS3 && nbodies < RX_DBVT_BODIES){
+		g_broadphase = new btAxisSweep3(btVector3(-ws, -ws, -ws), btVector3(ws, ws, ws));
+	}
+	else if(g_broadphasetype == RX_BROADPHASE_SAP){
+		g_broadphase = new btSortAndSweepBroadphase(0, !g_raycastaccel);
+	}
+	else if(g_broadphasetype == RX_BROADPHASE_GRID){
+		g_broadphase = new btHashedGridBroadphase();
+	}
+	else{
+		g_broadphase = new btDbvtBroadphase();
+	}
+
+	if(g_worldtype == RX_WORLD_MT){
+		// スケジューラのスレッド数に合わせてディスパッチャとソルバのプールを作るので先に設定しておく
+		g_scheduler = SetTaskScheduler(g_scheduler, g_numthreads);
+		int nthreads = btGetTaskScheduler()->getNumThreads();
+
+		g_dispatcher = new btCollisionDispatcherMt(g_config, 40);
+
+		// 拘束のソルバ : 島ごとにプール内のソルバを割り当てて並列に解き，大きな島は並列ソルバで解く
+		g_solver = new btConstraintSolverPoolMt(nthreads);
+		g_solver_mt = new btSequentialImpulseConstraintSolverMt();
+
+		// Bulletのワールド作成
+		g_dynamicsworld = new btDiscreteDynamicsWorldMt(g_dispatcher, g_broadphase, (btConstraintSolverPoolMt*)g_solver, g_solver_mt, g_config);
+
+		cout << "world : btDiscreteDynamicsWorldMt (" << GetTaskSchedulerName(g_scheduler) << ", " << nthreads << " threads)" << endl;
+	}
+	else{
+		g_dispatcher = new btCollisionDispatcher(g_config);
+
+		// 拘束(剛体間リンク)のソルバ設定
+		g_solver = new btSequentialImpulseConstraintSolver();
+
+		// Bulletのワールド作成
+		g_dynamicsworld = new btDiscreteDynamicsWorld(g_dispatcher, g_broadphase, g_solver, g_config);
+	}
+
+	// 重力加速度の設定(OpenGLに合わせてy軸方向を上下方向にする)
+	g_dynamicsworld->setGravity(btVector3(0, -9.8, 0));
+
+	g_constraint = 0;
+	g_carWheels = car_t();
+	if(scene.IsOpen()){
+		// シーンファイルの剛体と拘束
+		const rxSceneHeader &h = scene.Header();
+		g_dynamicsworld->setGravity(btVector3(h.gravity[0], h.gravity[1], h.gravity[2]));
+		scene.Build(g_dynamicsworld, g_collisionshapes);
+		if(h.car) g_carWheels = cleateCarObject(btVector3(h.car_pos[0], h.car_pos[1], h.car_pos[2]));
+
+		timer.Stop();
+		cout << "scene : " << g_scenefile << " (" << scene.NumShapes() << " shapes, " << nbodies << " bodies, " << scene.NumJoints() << " joints, "
+			 << (scene.IsMapped() ? "binary" : "text") << ") loaded in " << 1000.0*timer.GetTime(0) << " ms" << endl;
+		if(scene.NumMeshes()){
+			cout << "meshes : " << g_meshcache.NumHits() << " from the cache, " << g_meshcache.NumMisses() << " built in " << 1000.0*g_meshcache.Time() << " ms"
+				 << (g_meshcache.Dir().empty() ? " (cache disabled)" : "") << endl;
+		}
+	}
+	else{
+		SetRigidBodies();
+	}
+
+	// 初期状態を保存しておき，剛体の追加や削除がなければリセット時にワールドを作り直さずに戻す
+	SaveBulletState(g_initstate);
+}
+
+
+/*!
+* 設定したBulletの剛体オブジェクト，ワールドの破棄
+*/
+void CleanBullet(void)
+{
+	// 剛体オブジェクトの破棄
+	for(int i = g_dynamicsworld->getNumCollisionObjects()-1; i >= 0; --i){
+		btCollisionObject* obj = g_dynamicsworld->getCollisionObjectArray()[i];
+		btRigidBody* body = btRigidBody::upcast(obj);
+		if(body && body->getMotionState()){
+			delete body->getMotionState();
+		}
+		g_dynamicsworld->removeCollisionObject( obj );
+		delete obj;
+	}
+
+	// 形状の破棄
+	for(int j = 0; j < (int)g_collisionshapes.size(); ++j){
+		btCollisionShape* shape = g_collisionshapes[j];
+		g_collisionshapes[j] = 0;
+		delete shape;
+	}
+	g_collisionshapes.clear();
+
+	// 三角形メッシュのデータ(形状が参照していたもの)
+	g_meshcache.Clear();
+
+	// ワールド破棄
+	delete g_dynamicsworld;
+	g_dynamicsworld = 0;
+
+	delete g_solver_mt; g_solver_mt = 0;
+	delete g_solver; g_solver = 0;
+	delete g_dispatcher; g_dispatcher = 0;
+	delete g_broadphase; g_broadphase = 0;
+	delete g_config; g_config = 0;
+
+	// タスクスケジューラ(設定中のままだと破棄後に参照されるので逐次実行に戻してから破棄)
+	if(g_bullet_scheduler){
+		if(btGetTaskScheduler() == g_bullet_scheduler) btSetTaskScheduler(btGetSequentialTaskScheduler());
+		delete g_bullet_scheduler;
+		g_bullet_scheduler = 0;
+	}
+}
+
+
+/*!
+* ワールドの状態を保存
+* - 剛体の位置・速度，拘束の撃力，接触点，衝突ペア，ブロードフェーズをstate.worldに書き出す(btDiscreteDynamicsWorld::saveSnapshot)
+* - 車のモータの目標速度はステップごとにアプリ側で設定するので別に保存する
+* @param[out] state 保存先(バッファは再利用する)
+* @return 保存できなければfalse
+*/
+bool SaveBulletState(rxBulletState &state)
+{
+	state.valid = false;
+	if(!g_dynamicsworld || g_dynamicsworld->getWorldType() != BT_DISCRETE_DYNAMICS_WORLD) return false;
+
+	btDiscreteDynamicsWorld* world = static_cast<btDiscreteDynamicsWorld*>(g_dynamicsworld);
+	if(!world->saveSnapshot(state.world)) return false;
+
+	state.steering = g_targetStearingAngle;
+	if(g_carWheels.flontLeftJoint){
+		state.motor[0] = g_carWheels.flontLeftJoint->getRotationalLimitMotor(0)->m_targetVelocity;
+		state.motor[1] = g_carWheels.flontRightJoint->getRotationalLimitMotor(0)->m_targetVelocity;
+		state.motor[2] = g_carWheels.flontLeftJoint->getRotationalLimitMotor(2)->m_targetVelocity;
+		state.motor[3] = g_carWheels.flontRightJoint->getRotationalLimitMotor(2)->m_targetVelocity;
+		state.motor[4] = g_carWheels.rearLeftJoint->getMotorTargetVelocity();
+		state.motor[5] = g_carWheels.rearRightJoint->getMotorTargetVelocity();
+	}
+	state.valid = true;
+	return true;
+}
+
+/*!
+* 保存した状態にワールドを戻す
+* - 保存したときと同じ剛体・拘束がワールドにある場合のみ戻せる(球を投げた，拘束がちぎれたなどの場合はfalse)
+* @param[in] state SaveBulletStateで保存した状態
+* @return 戻せなければfalse(ワールドは変更しない)
+*/
+bool RestoreBulletState(const rxBulletState &state)
+{
+	if(!state.valid || !g_dynamicsworld || g_dynamicsworld->getWorldType() != BT_DISCRETE_DYNAMICS_WORLD) return false;
+
+	btDiscreteDynamicsWorld* world = static_cast<btDiscreteDynamicsWorld*>(g_dynamicsworld);
+	if(!world->restoreSnapshot(state.world)) return false;
+
+	g_targetStearingAngle = state.steering;
+	if(g_carWheels.flontLeftJoint){
+		g_carWheels.flontLeftJoint->getRotationalLimitMotor(0)->m_targetVelocity = state.motor[0];
+		g_carWheels.flontRightJoint->getRotationalLimitMotor(0)->m_targetVelocity = state.motor[1];
+		g_carWheels.flontLeftJoint->getRotationalLimitMotor(2)->m_targetVelocity = state.motor[2];
+		g_carWheels.flontRightJoint->getRotationalLimitMotor(2)->m_targetVelocity = state.motor[3];
+		g_carWheels.rearLeftJoint->setMotorTargetVelocity(state.motor[4]);
+		g_carWheels.rearRightJoint->setMotorTargetVelocity(state.motor[5]);
+	}
+	return true;
+}
+
+
+/*!
+* シミュレーションを1ステップ進める
+* - 車の操舵制御と拘束の破断判定もここで行う(GUI版/ヘッドレス版で共通)
+* - ソフトボディのワールドではbtSparseSdfのカウンタをプロファイラに出してから古いセルを破棄する
+* @param[in] dt 時間ステップ幅
+* @param[in] max_substeps,fixed_dt 最大サブステップ数と内部の固定時間ステップ幅(btDynamicsWorld::stepSimulationの引数)
+*/
+void StepBullet(btScalar dt, int max_substeps, btScalar fixed_dt)
+{
+	if(!g_dynamicsworld) return;
+
+	g_dynamicsworld->stepSimulation(dt, max_substeps, fixed_dt);
+
+	// 剛体との衝突判定用の距離場(GarbageCollectでカウンタもリセットされるのでステップごとの値になる)
+	if(g_dynamicsworld->getWorldType() == BT_SOFT_RIGID_DYNAMICS_WORLD){
+		btSparseSdf<3> &sdf = static_cast<btSoftRigidDynamicsWorld*>(g_dynamicsworld)->getWorldInfo().m_sparsesdf;
+		if(rxProfiler::Instance().IsEnabled()){
+			btSparseSdf<3>::Stats stats = sdf.getStats();
+			rxProfiler::AddCounter("sdf hits", stats.hits);
+			rxProfiler::AddCounter("sdf misses", stats.misses);
+			rxProfiler::AddCounter("sdf prefetched", stats.prefetched);
+			rxProfiler::AddCounter("sdf evictions", stats.evictions);
+			rxProfiler::SetCounter("sdf cells", stats.cells);
+			rxProfiler::SetCounter("sdf memory [KB]", stats.bytes/1024.0);
+		}
+		sdf.GarbageCollect();
+	}
+
+	// 車の操舵(シーンファイルで車を追加しなかった場合はなし)
+	if(g_carWheels.flontLeftJoint){
+		const double gain = 1;
+		(g_carWheels.flontLeftJoint->getRotationalLimitMotor(2))->m_targetVelocity = gain * (btRadians(g_targetStearingAngle) - g_carWheels.flontLeftJoint->getAngle1());
+		(g_carWheels.flontRightJoint->getRotationalLimitMotor(2))->m_targetVelocity = gain * (btRadians(g_targetStearingAngle) - g_carWheels.flontRightJoint->getAngle1());
+	}
+
+	// 拘束がちぎれないか確認
+	if(g_constraint) {
+		btJointFeedback* f = g_constraint->getJointFeedback();
+		// 力を取得
+		btVector3 force1 = f->m_appliedForceBodyA;
+		btVector3 force2 = f->m_appliedForceBodyB;
+		// 力はベクトルなので、スカラーを取得し、ちぎれないか確認
+		if (force1.norm() > 1000.0 || force2.norm() > 1000.0) {
+			g_dynamicsworld->removeConstraint(g_constraint);
+			delete g_constraint;
+			g_constraint = 0;
+		}
+	}
+}
+
+/*!
+* 描画用の位置・姿勢(btDefaultMotionState::m_graphicsWorldTrans)を補間
+* - 固定時間ステップで計算した後，まだ計算していない時間分だけ描画位置をずらす
+* - btDiscreteDynamicsWorld::synchronizeMotionStatesと同じ方法(速度・角速度による積分)
+* @param[in] t 最新の計算結果からの時間(負なら1つ前のステップとの間を補間)
+*/
+void InterpolateMotionStates(btScalar t)
+{
+	if(!g_dynamicsworld) return;
+
+	const int n = g_dynamicsworld->getNumCollisionObjects();
+	for(int i = 0; i < n; ++i){
+		btRigidBody* body = btRigidBody::upcast(g_dynamicsworld->getCollisionObjectArray()[i]);
+		if(!body || !body->getMotionState() || body->isStaticOrKinematicObject() || !body->isActive()) continue;
+
+		btTransform trans;
+		btTransformUtil::integrateTransform(body->getInterpolationWorldTransform(),
+			body->getInterpolationLinearVelocity(), body->getInterpolationAngularVelocity(), t, trans);
+		body->getMotionState()->setWorldTransform(trans);
+	}
+}
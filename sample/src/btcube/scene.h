@@ -0,0 +1,159 @@
+/*!
+  @file scene.h
+
+  @brief Bulletワールドとシーン(剛体オブジェクト)の構築
+		 - OpenGL/GLFWに依存しない部分なのでヘッドレス版(headless/headless.cpp)からも使う
+
+  @author Makoto Fujisawa
+  @date   2026-10
+*/
+
+#ifndef _SCENE_H_
+#define _SCENE_H_
+
+
+//-----------------------------------------------------------------------------
+// インクルードファイル
+//-----------------------------------------------------------------------------
+#include <iostream>
+#include <string>
+
+// Bullet
+#include <btBulletDynamicsCommon.h>
+
+#include <BulletCollision/Gimpact/btGImpactCollisionAlgorithm.h>
+#include <BulletCollision/Gimpact/btGImpactShape.h>
+
+#include <BulletSoftBody/btSoftRigidDynamicsWorld.h>
+#include <BulletSoftBody/btSoftBodyRigidBodyCollisionConfiguration.h>
+#include <BulletSoftBody/btSoftBodyHelpers.h>
+#include <BulletSoftBody/btSoftBody.h>
+
+// マルチスレッド版のワールド
+//  - 実際に並列化されるのはBulletライブラリとアプリの両方をBT_THREADSAFE=1でビルドした場合のみ
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+
+
+//-----------------------------------------------------------------------------
+// 定義
+//-----------------------------------------------------------------------------
+// 車の構造体
+struct {
+	btRigidBody* flontRightWheel;
+	btRigidBody* flontLeftWheel;
+	btRigidBody* rearRightWheel;
+	btRigidBody* rearLeftWheel;
+	btHinge2Constraint* flontRightJoint;
+	btHinge2Constraint* flontLeftJoint;
+	btHingeConstraint* rearRightJoint;
+	btHingeConstraint* rearLeftJoint;
+}typedef car_t;
+
+// ワールドの状態(SaveBulletStateで保存，RestoreBulletStateで戻す)
+//  - 剛体や拘束そのものではなく，その位置・速度や拘束の撃力，接触点などの状態だけを保存する
+struct rxBulletState
+{
+	btAlignedObjectArray<char> world;	//!< btDiscreteDynamicsWorld::saveSnapshotのバッファ
+	float steering;						//!< 車の目標操舵角(g_targetStearingAngle)
+	btScalar motor[6];					//!< 車のモータの目標速度(前輪の駆動 左右，前輪の操舵 左右，後輪 左右)
+	bool valid;
+
+	rxBulletState() : steering(0), valid(false){ for(int i = 0; i < 6; ++i) motor[i] = 0; }
+};
+
+// 衝突応答のためのグループ
+enum CollisionGroup {
+	RX_COL_NOTHING = 0, // 0000
+	RX_COL_GROUND = 1,  // 0001
+	RX_COL_GROUP1 = 2,  // 0010
+	RX_COL_GROUP2 = 4,  // 0100
+	RX_COL_GROUP3 = 8,  // 1000
+	RX_COL_ALL = 15,	// 1111
+};
+
+// ワールドの種類
+enum
+{
+	RX_WORLD_SINGLE = 0,	//!< btDiscreteDynamicsWorld
+	RX_WORLD_MT,			//!< btDiscreteDynamicsWorldMt(島ごとの拘束計算などをタスクスケジューラで並列化)
+};
+
+// ブロードフェーズの種類
+enum
+{
+	RX_BROADPHASE_SAP = 0,		//!< btSortAndSweepBroadphase(毎ステップ全AABBを基数ソートしてペアを求める．剛体数の上限なし)
+	RX_BROADPHASE_AXIS3,		//!< btAxisSweep3(16bit, 剛体数がRX_DBVT_BODIES以上ならbtDbvtBroadphase)
+	RX_BROADPHASE_DBVT,			//!< btDbvtBroadphase
+	RX_BROADPHASE_GRID,			//!< btHashedGridBroadphase(ハッシュ化した一様グリッド．大きさのそろった剛体が多いシーン向け)
+	RX_BROADPHASE_NUM,
+};
+
+// タスクスケジューラの種類(RX_WORLD_MTのときのみ使う)
+enum
+{
+	RX_SCHED_SEQUENTIAL = 0,	//!< 並列化なし
+	RX_SCHED_BULLET,			//!< Bullet組み込み(Win32スレッド/pthreads)
+	RX_SCHED_OPENMP,			//!< OpenMP(BT_USE_OPENMP=1)
+	RX_SCHED_TBB,				//!< Intel TBB(BT_USE_TBB=1)
+	RX_SCHED_PPL,				//!< Microsoft PPL(BT_USE_PPL=1)
+	RX_SCHED_NUM,
+};
+
+
+//-----------------------------------------------------------------------------
+// グローバル変数(実体はscene.cpp)
+//-----------------------------------------------------------------------------
+extern btDynamicsWorld* g_dynamicsworld;	//!< Bulletワールド
+extern btAlignedObjectArray<btCollisionShape*>	g_collisionshapes;		//!< 剛体オブジェクトの形状を格納する動的配列
+extern btTypedConstraint* g_constraint; // キューブ同士の結合
+
+extern car_t g_carWheels; // 車を保持する
+extern float g_targetStearingAngle; // タイヤの目標角度
+
+// ワールドの設定(InitBulletで参照する．変更はワールドを作り直してから有効)
+extern int g_worldtype;		//!< ワールドの種類(RX_WORLD_*)
+extern int g_broadphasetype;	//!< ブロードフェーズの種類(RX_BROADPHASE_*)
+extern bool g_raycastaccel;	//!< RX_BROADPHASE_SAPでレイ/AABB判定用の木を持たせるか(rayTestBatchを使うときなど)
+extern int g_scheduler;		//!< タスクスケジューラの種類(RX_SCHED_*)
+extern int g_numthreads;	//!< スレッド数(0でスケジューラの最大数)
+extern std::string g_scenefile;	//!< シーンファイル(空ならSetRigidBodiesで作るシーン, scenefile.h)
+
+extern rxBulletState g_initstate;	//!< InitBullet直後のワールドの状態(リセットで戻す)
+
+
+//-----------------------------------------------------------------------------
+// Bullet用関数
+//-----------------------------------------------------------------------------
+btRigidBody* CreateRigidBody(double mass, const btTransform& init_trans, btCollisionShape* shape, int myGroup, int targetGroup, btDynamicsWorld* world = 0, int index = 0);
+btRigidBody* CreateRigidBody(double mass, const btTransform& init_trans, btCollisionShape* shape, btDynamicsWorld* world = 0, int index = 0);
+
+btRigidBody* SetRigidCube(btVector3 pos, btVector3 size, float mass);
+btRigidBody* SetRigidCube(btVector3 pos, btVector3 size);
+btRigidBody* SetRigidCube(btVector3 pos);
+btRigidBody* SetStaticCube(btVector3 pos, btVector3 size);
+btRigidBody* SetStaticCube(btVector3 pos);
+btRigidBody* SetRigidSphere(btVector3 pos);
+void throughSphere(btVector3 pos, btVector3 dir, float spd);
+btRigidBody* SetRigidCylinder(btVector3 pos, btVector3 size);
+btRigidBody* SetRigidCylinder(btVector3 pos);
+btRigidBody* SetRigidCylinderX(btVector3 pos, btVector3 size);
+car_t cleateCarObject(btVector3 pos);
+
+void SetRigidBodies(void);
+
+const char* GetBroadphaseName(int type);
+const char* GetTaskSchedulerName(int type);
+int SetTaskScheduler(int type, int nthreads);
+void InitBullet(void);
+void CleanBullet(void);
+
+bool SaveBulletState(rxBulletState &state);
+bool RestoreBulletState(const rxBulletState &state);
+
+void StepBullet(btScalar dt, int max_substeps = 1, btScalar fixed_dt = btScalar(1.)/btScalar(60.));
+void InterpolateMotionStates(btScalar t);
+
+
+#endif // #ifndef _SCENE_H_
@@ -0,0 +1,748 @@
+/*!
+  @file scenefile.cpp
+
+  @brief シーン記述ファイルの読み込み
+
+		 テキスト形式の例
+		 ----------------------------------------------------------------------
+		 [world]
+		 gravity = 0, -9.8, 0
+		 car = true
+		 car_pos = 0, 0.5, 0
+
+		 [objects]
+		 # shape <名前> <種類> <大きさ...> [index=n]
+		 shape floor box 20 0.2 20 index=99
+		 shape cube box 0.2 0.2 0.2
+		 # shape <名前> mesh <OBJファイル> [スケール(1つまたはx y z)] [index=n]
+		 shape terrain mesh terrain.obj 2
+		 # body <名前|-> <形状名|種類:大きさ> <質量> <x> <y> <z> [quat=x,y,z,w] [euler=x,y,z(度)]
+		 #      [group=g] [mask=g|g...] [restitution=e] [friction=f] [index=n] [ccd]
+		 body ground floor 0 0 -0.2 0 index=99
+		 body b1 cube 1 1 2 0 group=group1 mask=group1|ground ccd
+		 body - sphere:0.2 1 0 3 0
+		 # joint <種類> <剛体名> <剛体名|-> [pa=x,y,z] [pb=x,y,z] [axis_a=x,y,z] [axis_b=x,y,z] [break=力積] [nocollide]
+		 joint p2p b1 - pa=-0.2,-0.2,-0.2
+		 ----------------------------------------------------------------------
+		 - [world]節はrxINIで読む(空白は無視されるので値の区切りは','を使う)
+		 - [objects]節は1行1レコードで1回の走査で読む．'#'以降はコメント
+		 - 種類・大きさ・indexが同じ形状は1つのbtCollisionShapeを共有する(名前付きの形状も同様)
+		 - 三角形メッシュ(mesh)は名前付きの形状としてのみ定義でき，質量0の剛体にだけ使える．
+		   BVHと内部エッジの情報はキャッシュ(meshcache.h)に保存して次回から読み込む
+
+  @author Makoto Fujisawa
+  @date   2026-10
+*/
+
+//-----------------------------------------------------------------------------
+// Include Files
+//-----------------------------------------------------------------------------
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <sstream>
+#include <typeinfo>
+#include <map>
+
+#ifdef WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "scenefile.h"
+
+// 三角形メッシュのキャッシュ
+#include "meshcache.h"
+#include <BulletCollision/CollisionDispatch/btInternalEdgeUtility.h>
+
+// 設定ファイル
+#include "rx_atom_ini.h"
+
+using namespace std;
+
+
+//-----------------------------------------------------------------------------
+// 文字列の解析
+//-----------------------------------------------------------------------------
+static const char* RX_SHAPE_NAMES[] = { "box", "sphere", "cylinder", "cylinderx", "cylinderz", "capsule", "cone", "plane", "mesh" };
+static const int RX_SHAPE_NVALS[] = { 3, 1, 3, 3, 3, 2, 2, 4, 0 };	//!< 形状ごとの大きさの値の数
+static const char* RX_JOINT_NAMES[] = { "p2p", "hinge", "fixed" };
+
+/*!
+* ','で区切られた数値の読み込み
+* @param[in] s 文字列
+* @param[out] v 数値
+* @param[in] n 最大の数
+* @return 読み込んだ数
+*/
+static int parseFloats(const char* s, float* v, int n)
+{
+	int i = 0;
+	while(i < n && *s){
+		char* end;
+		v[i] = (float)strtod(s, &end);
+		if(end == s) break;
+		i++;
+		s = end;
+		if(*s == ',') s++;
+	}
+	return i;
+}
+
+/*!
+* 衝突グループ(RX_COL_*の名前または数値を'|'でつないだもの)
+* @param[in] s 文字列
+* @return グループのビット列(解析できなければ-1)
+*/
+static int parseGroup(const char* s)
+{
+	static const char* names[] = { "nothing", "ground", "group1", "group2", "group3", "all" };
+	static const int groups[] = { RX_COL_NOTHING, RX_COL_GROUND, RX_COL_GROUP1, RX_COL_GROUP2, RX_COL_GROUP3, RX_COL_ALL };
+
+	int g = 0;
+	while(*s){
+		const char* end = strchr(s, '|');
+		size_t len = end ? (size_t)(end-s) : strlen(s);
+		int k = 0;
+		for(; k < 6; ++k){
+			if(strlen(names[k]) == len && !strncmp(s, names[k], len)) break;
+		}
+		if(k < 6){
+			g |= groups[k];
+		}
+		else{
+			char* e;
+			long v = strtol(s, &e, 0);
+			if(e != s+len) return -1;
+			g |= (int)v;
+		}
+		s += len;
+		if(*s == '|') s++;
+	}
+	return g;
+}
+
+//! 数値かどうか(オプションやファイル名と区別する)
+static bool isNumber(const char* s)
+{
+	char* end;
+	strtod(s, &end);
+	return end != s && *end == '\0';
+}
+
+//! 名前の検索(見つからなければ-1)
+static int findName(const char* s, const char** names, int n)
+{
+	for(int i = 0; i < n; ++i){
+		if(!strcmp(s, names[i])) return i;
+	}
+	return -1;
+}
+
+
+//-----------------------------------------------------------------------------
+// rxMappedFileクラスの実装
+//-----------------------------------------------------------------------------
+rxMappedFile::rxMappedFile() : m_pData(0), m_iSize(0), m_bWritable(false)
+{
+#ifdef WIN32
+	m_hFile = m_hMap = 0;
+#endif
+}
+
+/*!
+* ファイルを読み込み専用でメモリマップ
+* @param[in] fn ファイル名
+* @param[in] writable コピーオンライトで書き込み可能にする
+* @return マップできたらtrue(空のファイルはfalse)
+*/
+bool rxMappedFile::Open(const string &fn, bool writable)
+{
+	Close();
+#ifdef WIN32
+	HANDLE file = CreateFileA(fn.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER size;
+	GetFileSizeEx(file, &size);
+	HANDLE map = CreateFileMappingA(file, NULL, writable ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+	void* ptr = map ? MapViewOfFile(map, writable ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0) : NULL;
+	if(!ptr){
+		if(map) CloseHandle(map);
+		CloseHandle(file);
+		return false;
+	}
+	m_hFile = file;
+	m_hMap = map;
+	m_pData = ptr;
+	m_iSize = (size_t)size.QuadPart;
+#else
+	int fd = open(fn.c_str(), O_RDONLY);
+	if(fd < 0) return false;
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size == 0){
+		close(fd);
+		return false;
+	}
+	void* ptr = mmap(0, (size_t)st.st_size, writable ? PROT_READ|PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);	// マップはファイルを閉じても有効
+	if(ptr == MAP_FAILED) return false;
+	m_pData = ptr;
+	m_iSize = (size_t)st.st_size;
+#endif
+	m_bWritable = writable;
+	return true;
+}
+
+/*!
+* メモリマップの解除
+*/
+void rxMappedFile::Close(void)
+{
+	if(!m_pData) return;
+#ifdef WIN32
+	UnmapViewOfFile(m_pData);
+	CloseHandle((HANDLE)m_hMap);
+	CloseHandle((HANDLE)m_hFile);
+	m_hFile = m_hMap = 0;
+#else
+	munmap(m_pData, m_iSize);
+#endif
+	m_pData = 0;
+	m_iSize = 0;
+	m_bWritable = false;
+}
+
+
+//-----------------------------------------------------------------------------
+// rxSceneFileクラスの実装
+//-----------------------------------------------------------------------------
+rxSceneFile::rxSceneFile() : m_pHeader(0), m_pShapes(0), m_pBodies(0), m_pJoints(0), m_pMeshes(0), m_iMeshes(0)
+{
+}
+
+/*!
+* 三角形メッシュの接触点の法線の修正(gContactAddedCallback)
+*  - 三角形の境界(内部エッジ)に当たった接触の法線を隣の三角形とつながった面の法線に直し，
+*    平らなメッシュの上を滑る物体が三角形の継ぎ目で跳ねないようにする
+*  - 三角形メッシュの剛体にCF_CUSTOM_MATERIAL_CALLBACKを設定したときだけ呼ばれる(メッシュはcolObj1Wrap側)
+*/
+static bool adjustInternalEdgeContacts(btManifoldPoint& cp, const btCollisionObjectWrapper* colObj0Wrap, int partId0, int index0,
+									   const btCollisionObjectWrapper* colObj1Wrap, int partId1, int index1)
+{
+	btAdjustInternalEdgeContacts(cp, colObj1Wrap, colObj0Wrap, partId1, index1);
+	return true;
+}
+
+/*!
+* シーンファイルを開く
+*  - バイナリ形式はメモリマップするだけで，Closeするまでファイルの中身を直接参照する
+* @param[in] fn ファイル名
+* @return 読み込めたらtrue
+*/
+bool rxSceneFile::Open(const string &fn)
+{
+	Close();
+
+	FILE* fp = fopen(fn.c_str(), "rb");
+	if(!fp){
+		cout << "[rxSceneFile] cannot open " << fn << endl;
+		return false;
+	}
+	char magic[8] = { 0 };
+	size_t n = fread(magic, 1, 8, fp);
+	fclose(fp);
+
+	size_t slash = fn.find_last_of("/\\");
+	m_strDir = (slash == string::npos) ? "" : fn.substr(0, slash+1);
+
+	bool ok = (n == 8 && !memcmp(magic, RX_SCENE_MAGIC, sizeof(RX_SCENE_MAGIC))) ? mapBinary(fn) : loadText(fn);
+	if(!ok){
+		Close();
+		return false;
+	}
+
+	// 番号の範囲チェック(壊れたバイナリファイルでBuildが範囲外を参照しないように)
+	for(int i = 0; i < m_pHeader->nshapes; ++i){
+		if(m_pShapes[i].type < 0 || m_pShapes[i].type >= RX_SHAPE_NUM) ok = false;
+	}
+	for(int i = 0; i < m_pHeader->nbodies; ++i){
+		if(m_pBodies[i].shape < 0 || m_pBodies[i].shape >= m_pHeader->nshapes) ok = false;
+	}
+	for(int i = 0; i < m_pHeader->njoints; ++i){
+		const rxSceneJoint &j = m_pJoints[i];
+		if(j.type < 0 || j.type >= RX_JOINT_NUM || j.a < 0 || j.a >= m_pHeader->nbodies || j.b < -1 || j.b >= m_pHeader->nbodies) ok = false;
+	}
+	for(int i = 0; i < m_iMeshes; ++i){
+		if(!memchr(m_pMeshes[i].file, '\0', sizeof(m_pMeshes[i].file))) ok = false;
+	}
+	if(!ok){
+		cout << "[rxSceneFile] " << fn << " has invalid shape/body indices" << endl;
+		Close();
+	}
+	return ok;
+}
+
+/*!
+* 読み込んだデータの破棄(メモリマップの解除)
+*/
+void rxSceneFile::Close(void)
+{
+	m_Map.Close();
+	m_vShapes.clear();
+	m_vBodies.clear();
+	m_vJoints.clear();
+	m_vMeshes.clear();
+	m_pHeader = 0;
+	m_pShapes = 0;
+	m_pBodies = 0;
+	m_pJoints = 0;
+	m_pMeshes = 0;
+	m_iMeshes = 0;
+}
+
+/*!
+* バイナリ形式のファイルをメモリマップ
+* @param[in] fn ファイル名
+*/
+bool rxSceneFile::mapBinary(const string &fn)
+{
+	if(!m_Map.Open(fn)) return false;
+
+	const char* data = m_Map.Data();
+	const rxSceneHeader* h = (const rxSceneHeader*)data;
+	if(m_Map.Size() < sizeof(rxSceneHeader) || h->version != RX_SCENE_VERSION || h->nshapes < 0 || h->nbodies < 0 || h->njoints < 0){
+		cout << "[rxSceneFile] " << fn << " is not a supported binary scene (version " << (m_Map.Size() >= sizeof(rxSceneHeader) ? h->version : -1) << ")" << endl;
+		return false;
+	}
+	size_t size = sizeof(rxSceneHeader)+h->nshapes*sizeof(rxSceneShape)+h->nbodies*sizeof(rxSceneBody)+h->njoints*sizeof(rxSceneJoint);
+	if(m_Map.Size() < size){
+		cout << "[rxSceneFile] " << fn << " is truncated" << endl;
+		return false;
+	}
+
+	m_pHeader = h;
+	m_pShapes = (const rxSceneShape*)(data+sizeof(rxSceneHeader));
+	m_pBodies = (const rxSceneBody*)(m_pShapes+h->nshapes);
+	m_pJoints = (const rxSceneJoint*)(m_pBodies+h->nbodies);
+
+	// 三角形メッシュのファイル名(メッシュの形状の数だけ)
+	m_iMeshes = 0;
+	for(int i = 0; i < h->nshapes; ++i){
+		if(m_pShapes[i].type == RX_SHAPE_MESH) m_iMeshes++;
+	}
+	if(m_Map.Size() < size+m_iMeshes*sizeof(rxSceneMesh)){
+		cout << "[rxSceneFile] " << fn << " is truncated" << endl;
+		return false;
+	}
+	m_pMeshes = (const rxSceneMesh*)(m_pJoints+h->njoints);
+	return true;
+}
+
+/*!
+* テキスト形式のファイルの読み込み
+* @param[in] fn ファイル名
+*/
+bool rxSceneFile::loadText(const string &fn)
+{
+	// ファイル全体を一度に読み込む
+	FILE* fp = fopen(fn.c_str(), "rb");
+	if(!fp) return false;
+	fseek(fp, 0, SEEK_END);
+	long len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	vector<char> buf(len+1);
+	len = (long)fread(&buf[0], 1, len, fp);
+	fclose(fp);
+	buf[len] = '\0';
+
+	// [objects]の行でワールドの設定部分とオブジェクトの記述部分に分ける
+	char* objs = &buf[0]+len;
+	for(char* p = &buf[0]; *p; ){
+		char* q = p;
+		while(*q == ' ' || *q == '\t') q++;
+		if(!strncmp(q, "[objects]", 9)){
+			*p = '\0';
+			objs = q+9;
+			break;
+		}
+		p = strchr(p, '\n');
+		if(!p) break;
+		p++;
+	}
+
+	// ワールドの設定
+	memset(&m_Header, 0, sizeof(m_Header));
+	memcpy(m_Header.magic, RX_SCENE_MAGIC, sizeof(RX_SCENE_MAGIC));
+	m_Header.version = RX_SCENE_VERSION;
+
+	string gravity = "0,-9.8,0", car_pos = "0,0.5,0";
+	float world_size = 100.0f;
+	bool car = false;
+	rxINI ini;
+	ini.Set("world", "gravity", &gravity, gravity);
+	ini.Set("world", "world_size", &world_size, world_size);
+	ini.Set("world", "car", &car, car);
+	ini.Set("world", "car_pos", &car_pos, car_pos);
+	string str(&buf[0]);
+	istringstream settings(str);
+	if(!ini.Load(settings)) return false;
+
+	parseFloats(gravity.c_str(), m_Header.gravity, 3);
+	parseFloats(car_pos.c_str(), m_Header.car_pos, 3);
+	m_Header.world_size = world_size;
+	m_Header.car = (car ? 1 : 0);
+
+	// オブジェクト
+	map<string, int> shape_names, body_names;
+	map<string, int> shape_keys;	// 形状の種類・大きさ・indexから形状の番号を引く(同じ形状の共有)
+	vector<char*> tok;
+	int line = 0;
+	bool ok = true;
+	for(char* p = objs; p && *p && ok; ){
+		// 1行を取り出してトークンに分ける
+		char* next = strchr(p, '\n');
+		if(next) *next++ = '\0';
+		line++;
+		char* c = strchr(p, '#');
+		if(c) *c = '\0';
+
+		tok.clear();
+		for(char* s = p; *s; ){
+			while(*s == ' ' || *s == '\t' || *s == '\r') *s++ = '\0';
+			if(!*s) break;
+			tok.push_back(s);
+			while(*s && *s != ' ' && *s != '\t' && *s != '\r') s++;
+		}
+		p = next;
+		if(tok.empty()) continue;
+
+		// オプション(key=valueまたは数値でない4番目以降のトークン)の位置
+		size_t nargs = tok.size();
+		for(size_t i = 1; i < tok.size(); ++i){
+			const char c0 = tok[i][0];
+			if(strchr(tok[i], '=') || (i >= 3 && !isdigit((unsigned char)c0) && c0 != '-' && c0 != '+' && c0 != '.')){
+				nargs = i;
+				break;
+			}
+		}
+
+		if(!strcmp(tok[0], "shape") || !strcmp(tok[0], "body")){
+			bool is_body = (tok[0][0] == 'b');
+			if(nargs < (is_body ? 7u : 3u)){
+				cout << "[rxSceneFile] " << fn << ":" << line << " : too few values for " << tok[0] << endl;
+				ok = false;
+				break;
+			}
+
+			// 形状("shape 名前 種類 大きさ..."，または剛体の行の"種類:大きさ")
+			int shape = -1;
+			rxSceneShape s;
+			memset(&s, 0, sizeof(s));
+			const char* type = 0;
+			string inl;
+			string mesh;
+			if(!is_body && !strcmp(tok[2], "mesh")){
+				// 三角形メッシュ : ファイル名とスケール(1つならx,y,z共通)
+				type = tok[2];
+				if(tok.size() < 4 || strchr(tok[3], '=') || strlen(tok[3]) >= sizeof(rxSceneMesh().file)){
+					cout << "[rxSceneFile] " << fn << ":" << line << " : mesh needs a file name (shorter than " << sizeof(rxSceneMesh().file) << " characters)" << endl;
+					ok = false;
+					break;
+				}
+				mesh = tok[3];
+				size_t n = 4;
+				while(n < tok.size() && n < 7 && isNumber(tok[n])) n++;
+				s.size[0] = s.size[1] = s.size[2] = 1.0f;
+				if(n == 5) s.size[0] = s.size[1] = s.size[2] = (float)atof(tok[4]);
+				else if(n == 7) for(int k = 0; k < 3; ++k) s.size[k] = (float)atof(tok[4+k]);
+				else if(n != 4) type = "";
+				nargs = n;
+			}
+			else if(!is_body){
+				type = tok[2];
+				for(size_t i = 3; i < nargs && (int)(i-3) < 4; ++i) s.size[i-3] = (float)atof(tok[i]);
+				if(nargs-3 < (size_t)RX_SHAPE_NVALS[max(0, findName(type, RX_SHAPE_NAMES, RX_SHAPE_NUM))]) type = "";
+			}
+			else{
+				map<string, int>::iterator it = shape_names.find(tok[2]);
+				if(it != shape_names.end()){
+					shape = it->second;
+				}
+				else if(char* colon = strchr(tok[2], ':')){
+					inl.assign(tok[2], colon);
+					type = inl.c_str();
+					int k = findName(type, RX_SHAPE_NAMES, RX_SHAPE_NUM);
+					if(k == RX_SHAPE_MESH || parseFloats(colon+1, s.size, 4) < RX_SHAPE_NVALS[k < 0 ? 0 : k]) type = "";
+				}
+				else{
+					cout << "[rxSceneFile] " << fn << ":" << line << " : unknown shape " << tok[2] << endl;
+					ok = false;
+					break;
+				}
+			}
+			for(size_t i = nargs; i < tok.size() && !is_body; ++i){
+				if(!strncmp(tok[i], "index=", 6)) s.index = atoi(tok[i]+6);
+			}
+			if(type){
+				s.type = findName(type, RX_SHAPE_NAMES, RX_SHAPE_NUM);
+				if(s.type < 0){
+					cout << "[rxSceneFile] " << fn << ":" << line << " : invalid shape " << tok[2] << endl;
+					ok = false;
+					break;
+				}
+
+				// 同じ形状があればそれを使う(三角形メッシュはファイル名も同じもの)
+				string key((const char*)&s, sizeof(s));
+				key += mesh;
+				map<string, int>::iterator it = shape_keys.find(key);
+				if(it == shape_keys.end()){
+					shape = (int)m_vShapes.size();
+					m_vShapes.push_back(s);
+					shape_keys[key] = shape;
+					if(s.type == RX_SHAPE_MESH){
+						rxSceneMesh m;
+						memset(&m, 0, sizeof(m));
+						strcpy(m.file, mesh.c_str());
+						m_vMeshes.push_back(m);
+					}
+				}
+				else{
+					shape = it->second;
+				}
+			}
+			if(!is_body){
+				shape_names[tok[1]] = shape;
+				continue;
+			}
+
+			// 剛体
+			rxSceneBody b;
+			b.shape = shape;
+			b.mass = (float)atof(tok[3]);
+			for(int k = 0; k < 3; ++k) b.pos[k] = (float)atof(tok[4+k]);
+			b.rot[0] = b.rot[1] = b.rot[2] = 0.0f; b.rot[3] = 1.0f;
+			b.group = b.mask = RX_COL_ALL;
+			b.restitution = 0.0f;
+			b.friction = 0.5f;
+			b.index = 0;
+			b.flags = 0;
+			for(size_t i = nargs; i < tok.size(); ++i){
+				const char* t = tok[i];
+				const char* v = strchr(t, '=');
+				v = v ? v+1 : "";
+				if(!strncmp(t, "quat=", 5)){
+					parseFloats(v, b.rot, 4);
+				}
+				else if(!strncmp(t, "euler=", 6)){
+					float e[3] = { 0, 0, 0 };
+					parseFloats(v, e, 3);
+					btQuaternion q;
+					q.setEulerZYX(btRadians(e[2]), btRadians(e[1]), btRadians(e[0]));
+					for(int k = 0; k < 4; ++k) b.rot[k] = (float)q[k];
+				}
+				else if(!strncmp(t, "group=", 6)) b.group = parseGroup(v);
+				else if(!strncmp(t, "mask=", 5)) b.mask = parseGroup(v);
+				else if(!strncmp(t, "restitution=", 12)) b.restitution = (float)atof(v);
+				else if(!strncmp(t, "friction=", 9)) b.friction = (float)atof(v);
+				else if(!strncmp(t, "index=", 6)) b.index = atoi(v);
+				else if(!strcmp(t, "ccd")) b.flags |= RX_BODY_CCD;
+				else{
+					cout << "[rxSceneFile] " << fn << ":" << line << " : unknown option " << t << endl;
+				}
+			}
+			if(b.group < 0 || b.mask < 0){
+				cout << "[rxSceneFile] " << fn << ":" << line << " : invalid collision group" << endl;
+				ok = false;
+				break;
+			}
+			if(strcmp(tok[1], "-")) body_names[tok[1]] = (int)m_vBodies.size();
+			m_vBodies.push_back(b);
+		}
+		else if(!strcmp(tok[0], "joint")){
+			rxSceneJoint j;
+			memset(&j, 0, sizeof(j));
+			j.type = (tok.size() >= 4 ? findName(tok[1], RX_JOINT_NAMES, RX_JOINT_NUM) : -1);
+			if(j.type < 0){
+				cout << "[rxSceneFile] " << fn << ":" << line << " : invalid joint" << endl;
+				ok = false;
+				break;
+			}
+			map<string, int>::iterator ia = body_names.find(tok[2]), ib = body_names.find(tok[3]);
+			if(ia == body_names.end() || (strcmp(tok[3], "-") && ib == body_names.end())){
+				cout << "[rxSceneFile] " << fn << ":" << line << " : unknown body " << (ia == body_names.end() ? tok[2] : tok[3]) << endl;
+				ok = false;
+				break;
+			}
+			j.a = ia->second;
+			j.b = (ib == body_names.end() ? -1 : ib->second);
+			j.axis[0][0] = j.axis[1][0] = 1.0f;
+			for(size_t i = 4; i < tok.size(); ++i){
+				const char* t = tok[i];
+				const char* v = strchr(t, '=');
+				v = v ? v+1 : "";
+				if(!strncmp(t, "pa=", 3)) parseFloats(v, j.pivot[0], 3);
+				else if(!strncmp(t, "pb=", 3)) parseFloats(v, j.pivot[1], 3);
+				else if(!strncmp(t, "axis_a=", 7)) parseFloats(v, j.axis[0], 3);
+				else if(!strncmp(t, "axis_b=", 7)) parseFloats(v, j.axis[1], 3);
+				else if(!strncmp(t, "break=", 6)) j.breaking = (float)atof(v);
+				else if(!strcmp(t, "nocollide")) j.flags |= RX_JOINT_NOCOLLIDE;
+				else{
+					cout << "[rxSceneFile] " << fn << ":" << line << " : unknown option " << t << endl;
+				}
+			}
+			m_vJoints.push_back(j);
+		}
+		else{
+			cout << "[rxSceneFile] " << fn << ":" << line << " : unknown record " << tok[0] << endl;
+			ok = false;
+		}
+	}
+	if(!ok) return false;
+
+	m_Header.nshapes = (int)m_vShapes.size();
+	m_Header.nbodies = (int)m_vBodies.size();
+	m_Header.njoints = (int)m_vJoints.size();
+	m_pHeader = &m_Header;
+	m_pShapes = m_vShapes.empty() ? 0 : &m_vShapes[0];
+	m_pBodies = m_vBodies.empty() ? 0 : &m_vBodies[0];
+	m_pJoints = m_vJoints.empty() ? 0 : &m_vJoints[0];
+	m_pMeshes = m_vMeshes.empty() ? 0 : &m_vMeshes[0];
+	m_iMeshes = (int)m_vMeshes.size();
+	return true;
+}
+
+/*!
+* バイナリ形式で保存
+* @param[in] fn ファイル名
+*/
+bool rxSceneFile::SaveBinary(const string &fn) const
+{
+	if(!m_pHeader) return false;
+
+	FILE* fp = fopen(fn.c_str(), "wb");
+	if(!fp){
+		cout << "[rxSceneFile] cannot open " << fn << endl;
+		return false;
+	}
+	fwrite(m_pHeader, sizeof(rxSceneHeader), 1, fp);
+	if(m_pHeader->nshapes) fwrite(m_pShapes, sizeof(rxSceneShape), m_pHeader->nshapes, fp);
+	if(m_pHeader->nbodies) fwrite(m_pBodies, sizeof(rxSceneBody), m_pHeader->nbodies, fp);
+	if(m_pHeader->njoints) fwrite(m_pJoints, sizeof(rxSceneJoint), m_pHeader->njoints, fp);
+	if(m_iMeshes) fwrite(m_pMeshes, sizeof(rxSceneMesh), m_iMeshes, fp);
+	fclose(fp);
+	return true;
+}
+
+/*!
+* ワールドにシーンの剛体と拘束を追加
+*  - 作成した形状はshapesに追加する(CleanBulletで破棄)
+*  - 車(Header().car)は追加しない
+*  - 三角形メッシュはg_meshcacheで読み込む(CleanBulletで形状を破棄した後にg_meshcache.Clear()する)．
+*    読み込めなかったメッシュは剛体の番号がずれないように衝突しない形状(btEmptyShape)にする
+* @param[in] world 追加先のワールド
+* @param[out] shapes 作成した形状
+*/
+bool rxSceneFile::Build(btDynamicsWorld* world, btAlignedObjectArray<btCollisionShape*> &shapes) const
+{
+	if(!m_pHeader || !world) return false;
+
+	// 形状(同じ番号の形状を使う剛体は1つのbtCollisionShapeを共有する)
+	vector<btCollisionShape*> cs(m_pHeader->nshapes);
+	int nmeshes = 0;
+	for(int i = 0; i < m_pHeader->nshapes; ++i){
+		const rxSceneShape &s = m_pShapes[i];
+		btVector3 size(s.size[0], s.size[1], s.size[2]);
+		switch(s.type){
+		case RX_SHAPE_BOX:       cs[i] = new btBoxShape(size); break;
+		case RX_SHAPE_SPHERE:    cs[i] = new btSphereShape(s.size[0]); break;
+		case RX_SHAPE_CYLINDER:  cs[i] = new btCylinderShape(size); break;
+		case RX_SHAPE_CYLINDERX: cs[i] = new btCylinderShapeX(size); break;
+		case RX_SHAPE_CYLINDERZ: cs[i] = new btCylinderShapeZ(size); break;
+		case RX_SHAPE_CAPSULE:   cs[i] = new btCapsuleShape(s.size[0], s.size[1]); break;
+		case RX_SHAPE_CONE:      cs[i] = new btConeShape(s.size[0], s.size[1]); break;
+		case RX_SHAPE_PLANE:     cs[i] = new btStaticPlaneShape(size.normalized(), s.size[3]); break;
+		case RX_SHAPE_MESH:
+			{
+				string file = m_pMeshes[nmeshes++].file;
+				bool absolute = (!file.empty() && (file[0] == '/' || file[0] == '\\' || (file.size() > 1 && file[1] == ':')));
+				cs[i] = g_meshcache.CreateShape(absolute ? file : m_strDir+file, size);
+				if(!cs[i]) cs[i] = new btEmptyShape();
+			}
+			break;
+		}
+		cs[i]->setUserIndex(s.index);
+		shapes.push_back(cs[i]);
+	}
+
+	// 剛体
+	vector<btRigidBody*> rb(m_pHeader->nbodies);
+	for(int i = 0; i < m_pHeader->nbodies; ++i){
+		const rxSceneBody &b = m_pBodies[i];
+		btCollisionShape* shape = cs[b.shape];
+		btScalar mass = b.mass;
+		if(shape->getShapeType() == TRIANGLE_MESH_SHAPE_PROXYTYPE && mass != 0){
+			cout << "[rxSceneFile] triangle meshes can only be used for static bodies (mass 0)" << endl;
+			mass = 0;
+		}
+
+		btTransform trans;
+		trans.setIdentity();
+		trans.setOrigin(btVector3(b.pos[0], b.pos[1], b.pos[2]));
+		trans.setRotation(btQuaternion(b.rot[0], b.rot[1], b.rot[2], b.rot[3]));
+
+		btRigidBody* body = CreateRigidBody(mass, trans, shape, b.group, b.mask, world, b.index);
+		body->setRestitution(b.restitution);
+		body->setFriction(b.friction);
+		if(shape->getShapeType() == TRIANGLE_MESH_SHAPE_PROXYTYPE && static_cast<btBvhTriangleMeshShape*>(shape)->getTriangleInfoMap()){
+			// 内部エッジでの接触の法線を修正する
+			body->setCollisionFlags(body->getCollisionFlags() | btCollisionObject::CF_CUSTOM_MATERIAL_CALLBACK);
+			gContactAddedCallback = adjustInternalEdgeContacts;
+		}
+		if(b.flags & RX_BODY_CCD){
+			// すり抜け防止用Swept sphereの設定(SetRigidCubeなどと同じく形状を囲む球の半径から決める)
+			btVector3 center;
+			btScalar rad;
+			shape->getBoundingSphere(center, rad);
+			body->setCcdMotionThreshold(rad);
+			body->setCcdSweptSphereRadius(0.05*rad);
+		}
+		rb[i] = body;
+	}
+
+	// 拘束
+	for(int i = 0; i < m_pHeader->njoints; ++i){
+		const rxSceneJoint &j = m_pJoints[i];
+		btRigidBody &a = *rb[j.a];
+		btVector3 pa(j.pivot[0][0], j.pivot[0][1], j.pivot[0][2]), pb(j.pivot[1][0], j.pivot[1][1], j.pivot[1][2]);
+		btVector3 aa(j.axis[0][0], j.axis[0][1], j.axis[0][2]), ab(j.axis[1][0], j.axis[1][1], j.axis[1][2]);
+
+		btTypedConstraint* c = 0;
+		switch(j.type){
+		case RX_JOINT_P2P:
+			c = (j.b < 0) ? new btPoint2PointConstraint(a, pa) : new btPoint2PointConstraint(a, *rb[j.b], pa, pb);
+			break;
+		case RX_JOINT_HINGE:
+			c = (j.b < 0) ? new btHingeConstraint(a, pa, aa) : new btHingeConstraint(a, *rb[j.b], pa, pb, aa, ab);
+			break;
+		case RX_JOINT_FIXED:
+			{
+				btTransform fa, fb;
+				fa.setIdentity(); fa.setOrigin(pa);
+				fb.setIdentity(); fb.setOrigin(pb);
+				// 空間上の点に固定する場合はワールドに固定された剛体(btTypedConstraint::getFixedBody)に結合
+				c = new btFixedConstraint(a, (j.b < 0) ? btTypedConstraint::getFixedBody() : *rb[j.b], fa, fb);
+			}
+			break;
+		}
+		if(j.breaking > 0.0f) c->setBreakingImpulseThreshold(j.breaking);
+		world->addConstraint(c, (j.flags & RX_JOINT_NOCOLLIDE) != 0);
+	}
+
+	return true;
+}
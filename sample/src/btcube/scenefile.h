@@ -0,0 +1,211 @@
+/*!
+  @file scenefile.h
+
+  @brief シーン記述ファイル(剛体の形状,位置・姿勢,質量,衝突グループ,拘束)の読み込み
+		 - テキスト形式 : 先頭の[world]節はrxINIで読む設定，[objects]節以降は1行1オブジェクトの記述
+		 - バイナリ形式 : ヘッダと固定長レコードの配列をそのまま並べたもの．メモリマップしてパースなしで使う
+		 - OpenGL/GLFWに依存しないのでヘッドレス版からも使う
+
+  @author Makoto Fujisawa
+  @date   2026-10
+*/
+
+#ifndef _SCENEFILE_H_
+#define _SCENEFILE_H_
+
+
+//-----------------------------------------------------------------------------
+// インクルードファイル
+//-----------------------------------------------------------------------------
+#include <string>
+#include <vector>
+
+#include "scene.h"
+
+
+//-----------------------------------------------------------------------------
+// 定義
+//-----------------------------------------------------------------------------
+// 形状の種類
+enum
+{
+	RX_SHAPE_BOX = 0,		//!< 直方体(size:x,y,z方向の辺の長さの半分)
+	RX_SHAPE_SPHERE,		//!< 球(size:半径)
+	RX_SHAPE_CYLINDER,		//!< y軸方向の円筒(size:btCylinderShapeと同じ)
+	RX_SHAPE_CYLINDERX,		//!< x軸方向の円筒
+	RX_SHAPE_CYLINDERZ,		//!< z軸方向の円筒
+	RX_SHAPE_CAPSULE,		//!< y軸方向のカプセル(size:半径,円柱部分の長さ)
+	RX_SHAPE_CONE,			//!< y軸方向の円錐(size:半径,高さ)
+	RX_SHAPE_PLANE,			//!< 無限平面(size:法線x,y,z,原点からの距離)
+	RX_SHAPE_MESH,			//!< 三角形メッシュ(OBJファイル, size:x,y,z方向のスケール)．静的な剛体のみ
+	RX_SHAPE_NUM,
+};
+
+// 拘束の種類
+enum
+{
+	RX_JOINT_P2P = 0,		//!< 点で結合(btPoint2PointConstraint)
+	RX_JOINT_HINGE,			//!< 軸回りの回転のみ(btHingeConstraint)
+	RX_JOINT_FIXED,			//!< 固定(btFixedConstraint)
+	RX_JOINT_NUM,
+};
+
+// 剛体のフラグ
+enum
+{
+	RX_BODY_CCD = 0x01,		//!< すり抜け防止(CCD)を使う
+};
+
+// 拘束のフラグ
+enum
+{
+	RX_JOINT_NOCOLLIDE = 0x01,	//!< 結合した剛体同士の衝突判定をしない
+};
+
+//! バイナリ形式のファイル識別子とバージョン
+#define RX_SCENE_MAGIC "RXSCENE"
+#define RX_SCENE_VERSION 1
+
+// バイナリ形式のレコード
+//  - すべて4バイトのメンバだけで構成し，詰め物なしでファイルにそのまま書き込む(リトルエンディアン)
+//  - ファイルはヘッダ，形状，剛体，拘束の順に並べる．三角形メッシュの形状があれば最後にそのファイル名(rxSceneMesh)を形状の順に並べる
+
+//! ヘッダ(ワールドの設定を含む)
+struct rxSceneHeader
+{
+	char magic[8];			//!< RX_SCENE_MAGIC
+	int version;			//!< RX_SCENE_VERSION
+	int nshapes, nbodies, njoints;
+	float gravity[3];		//!< 重力加速度
+	float world_size;		//!< ブロードフェーズの範囲(原点を中心とした立方体の辺の長さの半分)
+	int car;				//!< 車を追加するかどうか
+	float car_pos[3];		//!< 車の位置
+};
+
+//! 形状
+struct rxSceneShape
+{
+	int type;				//!< 形状の種類(RX_SHAPE_*)
+	float size[4];			//!< 大きさ(形状によって意味が異なる)
+	int index;				//!< btCollisionShape::setUserIndexの値(99で床として描画)
+};
+
+//! 三角形メッシュのファイル名(RX_SHAPE_MESHの形状ごと)
+struct rxSceneMesh
+{
+	char file[256];			//!< OBJファイル名(相対パスはシーンファイルのディレクトリから)
+};
+
+//! 剛体
+struct rxSceneBody
+{
+	int shape;				//!< 形状の番号
+	float mass;				//!< 質量(0で静的なオブジェクト)
+	float pos[3];			//!< 位置
+	float rot[4];			//!< 姿勢(四元数x,y,z,w)
+	int group, mask;		//!< 衝突グループとグループマスク(RX_COL_*)
+	float restitution;		//!< 反発係数
+	float friction;			//!< 摩擦係数
+	int index;				//!< btCollisionObject::setUserIndexの値
+	int flags;				//!< RX_BODY_*
+};
+
+//! 拘束
+struct rxSceneJoint
+{
+	int type;				//!< 拘束の種類(RX_JOINT_*)
+	int a, b;				//!< 結合する剛体の番号(bが-1なら空間上の点に結合)
+	float pivot[2][3];		//!< 剛体a,bのローカル座標系での結合点
+	float axis[2][3];		//!< 剛体a,bのローカル座標系での回転軸(RX_JOINT_HINGE)
+	float breaking;			//!< これを超える力積で拘束が外れる(0以下で外れない)
+	int flags;				//!< RX_JOINT_*
+};
+
+
+//-----------------------------------------------------------------------------
+// 読み込み専用のメモリマップ(バイナリ形式のシーンファイル，状態ファイル(statefile.h)，メッシュのキャッシュ(meshcache.h)で使う)
+//-----------------------------------------------------------------------------
+class rxMappedFile
+{
+	void *m_pData;
+	size_t m_iSize;
+	bool m_bWritable;
+#ifdef WIN32
+	void *m_hFile, *m_hMap;
+#endif
+
+public:
+	rxMappedFile();
+	~rxMappedFile(){ Close(); }
+
+	// writable=trueならコピーオンライトでマップする(書き換えたページだけがプロセス内で複製され，ファイルは変更されない)
+	bool Open(const std::string &fn, bool writable = false);
+	void Close(void);
+
+	bool IsOpen(void) const { return m_pData != 0; }
+	const char* Data(void) const { return (const char*)m_pData; }
+	char* WritableData(void) const { return m_bWritable ? (char*)m_pData : 0; }
+	size_t Size(void) const { return m_iSize; }
+
+private:
+	rxMappedFile(const rxMappedFile&);
+	rxMappedFile& operator=(const rxMappedFile&);
+};
+
+
+//-----------------------------------------------------------------------------
+// シーンファイル
+//-----------------------------------------------------------------------------
+class rxSceneFile
+{
+protected:
+	// テキスト形式から読み込んだ場合のデータ
+	rxSceneHeader m_Header;
+	std::vector<rxSceneShape> m_vShapes;
+	std::vector<rxSceneBody> m_vBodies;
+	std::vector<rxSceneJoint> m_vJoints;
+	std::vector<rxSceneMesh> m_vMeshes;
+
+	// 参照するデータ(テキスト形式ならm_v*，バイナリ形式ならメモリマップしたファイル内)
+	const rxSceneHeader *m_pHeader;
+	const rxSceneShape *m_pShapes;
+	const rxSceneBody *m_pBodies;
+	const rxSceneJoint *m_pJoints;
+	const rxSceneMesh *m_pMeshes;
+	int m_iMeshes;
+
+	std::string m_strDir;	//!< シーンファイルのディレクトリ(三角形メッシュの相対パスの基準)
+
+	// メモリマップ
+	rxMappedFile m_Map;
+
+public:
+	rxSceneFile();
+	~rxSceneFile(){ Close(); }
+
+	// ファイルを開く(先頭がRX_SCENE_MAGICならバイナリ形式)
+	bool Open(const std::string &fn);
+	void Close(void);
+
+	// バイナリ形式で保存
+	bool SaveBinary(const std::string &fn) const;
+
+	// ワールドにシーンの剛体と拘束を追加(三角形メッシュはg_meshcache(meshcache.h)から読み込む)
+	bool Build(btDynamicsWorld* world, btAlignedObjectArray<btCollisionShape*> &shapes) const;
+
+	bool IsOpen(void) const { return m_pHeader != 0; }
+	bool IsMapped(void) const { return m_Map.IsOpen(); }
+
+	const rxSceneHeader& Header(void) const { return *m_pHeader; }
+	int NumShapes(void) const { return m_pHeader ? m_pHeader->nshapes : 0; }
+	int NumBodies(void) const { return m_pHeader ? m_pHeader->nbodies : 0; }
+	int NumJoints(void) const { return m_pHeader ? m_pHeader->njoints : 0; }
+	int NumMeshes(void) const { return m_iMeshes; }
+
+protected:
+	bool mapBinary(const std::string &fn);
+	bool loadText(const std::string &fn);
+};
+
+
+#endif // #ifndef _SCENEFILE_H_
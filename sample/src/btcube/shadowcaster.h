@@ -0,0 +1,164 @@
+/*!
+  @file shadowcaster.h
+
+  @brief シャドウマップのデプスパスで描画する剛体・ソフトボディのリスト
+		 - 光源視錐台と各オブジェクトのAABBで判定して視錐台外のオブジェクトを除く
+		 - 視錐台内のオブジェクトの位置・姿勢を前のフレームと比べて，変化がなければシャドウマップを作り直さない
+		 - instanced.hの後にインクルードすること
+
+  @author Makoto Fujisawa
+  @date   2026-10
+*/
+
+#ifndef _SHADOWCASTER_H_
+#define _SHADOWCASTER_H_
+
+
+//-----------------------------------------------------------------------------
+// インクルードファイル
+//-----------------------------------------------------------------------------
+#include <cstring>
+
+#include "simthread.h"
+
+
+//-----------------------------------------------------------------------------
+// シャドウマップ用描画リスト
+//-----------------------------------------------------------------------------
+class rxShadowCasters
+{
+protected:
+	vector<int> m_vBodies;		//!< デプスパスで1つずつ描画する剛体(スナップショットでの番号, インスタンス描画するものは除く)
+	vector<int> m_vSofts;		//!< デプスパスで描画するソフトボディ(スナップショットでの番号)
+
+	vector<rxBodySnapshot> m_vCasters[2];	//!< 光源視錐台内の剛体の形状と位置・姿勢(現在と前のフレーム)
+	vector<btVector3> m_vSoftVrts[2];		//!< 光源視錐台内のソフトボディの頂点(現在と前のフレーム)
+	bool m_bValid;							//!< 前のフレームのリストがあるかどうか
+
+	float m_fPlanes[6][4];		//!< 光源視錐台の6平面(ax+by+cz+d >= 0 が内側)
+
+public:
+	rxShadowCasters() : m_bValid(false) {}
+
+	//! 次のBuildで必ずシャドウマップを作り直すようにする(ワールドを作り直したときなど)
+	void Invalidate(void){ m_bValid = false; }
+
+	//! デプスパスで描画する剛体
+	const vector<int>& Bodies(void) const { return m_vBodies; }
+
+	//! デプスパスで描画するソフトボディ
+	const vector<int>& Softs(void) const { return m_vSofts; }
+
+	/*!
+	 * スナップショットからデプスパス用のリストを作成
+	 * @param[in] snap ワールドのスナップショット
+	 * @param[in] light_mvp 光源のプロジェクション行列とモデルビュー行列の積(列優先)
+	 * @param[in] inst インスタンス描画(Build済み, 使わない場合は0)
+	 * @return 前のフレームから影を落とすオブジェクトが変化していたらtrue(シャドウマップの作り直しが必要)
+	 */
+	bool Build(const rxWorldSnapshot &snap, const float light_mvp[16], const rxInstancedBodies *inst)
+	{
+		calPlanes(light_mvp);
+
+		m_vBodies.clear();
+		m_vSofts.clear();
+		m_vCasters[0].swap(m_vCasters[1]);
+		m_vSoftVrts[0].swap(m_vSoftVrts[1]);
+		m_vCasters[0].clear();
+		m_vSoftVrts[0].clear();
+
+		// 剛体
+		for(size_t i = 0; i < snap.bodies.size(); ++i){
+			const rxBodySnapshot &b = snap.bodies[i];
+			if(!isVisible(b)) continue;
+
+			m_vCasters[0].push_back(b);
+			if(!inst || !inst->IsInstanced((int)i)){
+				m_vBodies.push_back((int)i);
+			}
+		}
+
+		// ソフトボディ
+		for(size_t i = 0; i < snap.softs.size(); ++i){
+			const rxSoftSnapshot &soft = snap.softs[i];
+			if(!soft.num) continue;
+
+			btVector3 aabb_min = snap.sv_vrts[soft.start], aabb_max = aabb_min;
+			for(int j = soft.start+1; j < soft.start+soft.num; ++j){
+				aabb_min.setMin(snap.sv_vrts[j]);
+				aabb_max.setMax(snap.sv_vrts[j]);
+			}
+			if(!intersect(aabb_min, aabb_max)) continue;
+
+			m_vSofts.push_back((int)i);
+			m_vSoftVrts[0].insert(m_vSoftVrts[0].end(), snap.sv_vrts.begin()+soft.start, snap.sv_vrts.begin()+soft.start+soft.num);
+		}
+
+		// 前のフレームとの比較(スリープ中や静的なオブジェクトは位置・姿勢が変わらない)
+		bool changed = !m_bValid || !equal(m_vCasters[0], m_vCasters[1]) || m_vSoftVrts[0].size() != m_vSoftVrts[1].size() ||
+					   (!m_vSoftVrts[0].empty() && memcmp(&m_vSoftVrts[0][0], &m_vSoftVrts[1][0], sizeof(btVector3)*m_vSoftVrts[0].size()));
+		m_bValid = true;
+		return changed;
+	}
+
+protected:
+	/*!
+	 * 光源の変換行列から視錐台の6平面を求める
+	 * @param[in] m 変換行列(列優先)
+	 */
+	void calPlanes(const float m[16])
+	{
+		for(int k = 0; k < 3; ++k){
+			for(int j = 0; j < 4; ++j){
+				m_fPlanes[2*k][j]   = m[4*j+3]+m[4*j+k];
+				m_fPlanes[2*k+1][j] = m[4*j+3]-m[4*j+k];
+			}
+		}
+	}
+
+	/*!
+	 * AABBが光源視錐台と交差するかどうか(6平面のどれかの完全に外側なら交差しない)
+	 * @param[in] aabb_min,aabb_max AABB
+	 */
+	bool intersect(const btVector3 &aabb_min, const btVector3 &aabb_max) const
+	{
+		for(int k = 0; k < 6; ++k){
+			const float* p = m_fPlanes[k];
+			float d = p[3];
+			for(int j = 0; j < 3; ++j){
+				d += p[j]*(p[j] > 0.0f ? aabb_max[j] : aabb_min[j]);
+			}
+			if(d < 0.0f) return false;
+		}
+		return true;
+	}
+
+	/*!
+	 * 剛体が光源視錐台内にあるかどうか
+	 * @param[in] b 剛体
+	 */
+	bool isVisible(const rxBodySnapshot &b) const
+	{
+		// テクスチャ付き平面として描画する地面は衝突形状より大きく描画するので常に含める
+		if(b.shape->getShapeType() == BOX_SHAPE_PROXYTYPE && b.shape->getUserIndex() == 99) return true;
+
+		btTransform trans;
+		trans.setFromOpenGLMatrix(b.m);
+		btVector3 aabb_min, aabb_max;
+		b.shape->getAabb(trans, aabb_min, aabb_max);
+		return intersect(aabb_min, aabb_max);
+	}
+
+	//! 影を落とす剛体の形状と位置・姿勢が同じかどうか
+	static bool equal(const vector<rxBodySnapshot> &a, const vector<rxBodySnapshot> &b)
+	{
+		if(a.size() != b.size()) return false;
+		for(size_t i = 0; i < a.size(); ++i){
+			if(a[i].shape != b[i].shape || memcmp(a[i].m, b[i].m, sizeof(a[i].m))) return false;
+		}
+		return true;
+	}
+};
+
+
+#endif // #ifndef _SHADOWCASTER_H_
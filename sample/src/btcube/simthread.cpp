@@ -0,0 +1,307 @@
+/*!
+  @file simthread.cpp
+
+  @brief 物理シミュレーションを別スレッドで実行するための管理クラス
+
+  @author Makoto Fujisawa
+  @date   2026-10
+*/
+
+//-----------------------------------------------------------------------------
+// Include Files
+//-----------------------------------------------------------------------------
+#include <chrono>
+
+#include "simthread.h"
+
+// プロファイラ
+#include "rx_profiler.h"
+
+using namespace std;
+
+
+//-----------------------------------------------------------------------------
+// rxSimThreadの実装
+//-----------------------------------------------------------------------------
+rxSimThread::rxSimThread() : m_running(false), m_animation(false), m_dt(0.002f), m_step(0), m_interp(0.0)
+{
+}
+
+rxSimThread::~rxSimThread()
+{
+	Stop();
+}
+
+/*!
+* シミュレーションスレッドの開始
+*/
+void rxSimThread::Start(void)
+{
+	if(m_running) return;
+	m_running = true;
+	m_thread = std::thread(&rxSimThread::run, this);
+}
+
+/*!
+* シミュレーションスレッドの停止(現在のステップが終わるまで待つ)
+*/
+void rxSimThread::Stop(void)
+{
+	if(!m_running) return;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = false;
+	}
+	m_cond.notify_one();
+	if(m_thread.joinable()) m_thread.join();
+}
+
+/*!
+* ワールドへの操作をコマンドとして登録
+* - 登録されたコマンドは次のステップの前にシミュレーション側で順番に実行される
+* @param[in] cmd コマンド(関数オブジェクト)
+*/
+void rxSimThread::Push(const Command &cmd)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_commands.push_back(cmd);
+	}
+	m_cond.notify_one();
+}
+
+/*!
+* アニメーションON/OFF(ONにすると停止中のシミュレーションスレッドを起こす)
+*/
+void rxSimThread::SetAnimation(bool on)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_animation = on;
+	}
+	m_cond.notify_one();
+}
+
+/*!
+* 1ステップだけ進める(アニメーションOFF時のステップ実行用)
+*/
+void rxSimThread::StepOnce(void)
+{
+	Push([this](){ step(); });
+}
+
+/*!
+* 1フレームあたりの最大ステップ数の設定
+*/
+void rxSimThread::SetMaxSubsteps(int n)
+{
+	Push([this, n](){ m_stepper.SetMaxSubsteps(n); });
+}
+
+/*!
+* ワールドを作り直した後の状態リセット
+* - シミュレーションスレッドを止めてから呼ぶこと
+* - 古いワールドの形状を参照しているスナップショットが描画されないように新しいスナップショットを公開しておく
+*/
+void rxSimThread::Reset(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_commands.clear();
+	}
+	m_stepper.Reset();
+	m_step = 0;
+	m_interp = 0.0;
+	publish();
+}
+
+/*!
+* シミュレーションを進めてスナップショットを公開
+* - コマンドもステップもなく補間時間も変わらなければ前回のスナップショットのままにする
+* @param[in] elapsed 前回の呼び出しからの経過時間(実時間)
+*/
+void rxSimThread::Tick(double elapsed)
+{
+	RX_PROFILE("tick");
+
+	bool changed = execCommands();
+
+	float dt = m_dt;
+	bool animation = m_animation;
+	int n = m_stepper.Update(animation ? elapsed : 0.0, dt);
+	for(int i = 0; i < n; ++i){
+		step();
+	}
+	if(n > 0) changed = true;
+
+	// 持ち越した時間(1ステップ未満)に合わせて描画用の位置・姿勢を補間
+	//  - 1つ前のステップと最新のステップの間を補間するので描画は最大1ステップ遅れる
+	if(animation){
+		double t = m_stepper.GetDebt();
+		if(t > dt) t = dt;
+		if(changed || t-dt != m_interp){
+			InterpolateMotionStates(t-dt);
+			m_interp = t-dt;
+			changed = true;
+		}
+	}
+
+	if(changed) publish();
+}
+
+/*!
+* シミュレーションスレッドのメインループ
+*/
+void rxSimThread::run(void)
+{
+	rxProfiler::SetThreadName("simulation");
+
+	typedef std::chrono::steady_clock clock;
+	clock::time_point last = clock::now();
+	while(m_running){
+		clock::time_point now = clock::now();
+		double elapsed = std::chrono::duration<double>(now-last).count();
+		last = now;
+
+		Tick(elapsed);
+
+		// 一時停止中はコマンド(1ステップ実行，マウスピックなど)かアニメーションONまで待つ
+		if(!m_animation){
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cond.wait(lock, [this](){ return !m_running || m_animation || !m_commands.empty(); });
+			last = clock::now();
+			continue;
+		}
+
+		// 次のステップまでの時間が十分あればスリープ(最大1ms)
+		double wait = m_dt-m_stepper.GetDebt();
+		if(wait > 0.0){
+			std::this_thread::sleep_for(std::chrono::duration<double>(wait < 1.0e-3 ? wait : 1.0e-3));
+		}
+	}
+}
+
+/*!
+* 登録されたコマンドの実行
+* @return コマンドを実行したらtrue
+*/
+bool rxSimThread::execCommands(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(m_commands.empty()) return false;
+		m_executing.swap(m_commands);
+	}
+	for(size_t i = 0; i < m_executing.size(); ++i){
+		m_executing[i]();
+	}
+	m_executing.clear();
+	return true;
+}
+
+/*!
+* シミュレーションを固定幅で1ステップ進める(車の操舵・拘束の破断判定も含む)
+*/
+void rxSimThread::step(void)
+{
+	RX_PROFILE("step");
+	float dt = m_dt;
+	StepBullet(dt, 1, dt);
+	m_step++;
+}
+
+/*!
+* 現在のワールドの状態をスナップショットに書き出して公開
+*/
+void rxSimThread::publish(void)
+{
+	RX_PROFILE("publish");
+	rxWorldSnapshot &s = m_snapshots.Back();
+	s.bodies.clear();
+	s.softs.clear();
+	s.sv_vrts.clear();
+	s.sv_nrms.clear();
+	s.sv_idxs.clear();
+	s.contacts.clear();
+
+	s.step = m_step;
+	s.last_steps = m_stepper.GetLastSteps();
+	s.debt = m_stepper.GetDebt();
+	s.dropped = m_stepper.GetDropped();
+
+	if(g_dynamicsworld){
+		g_dynamicsworld->getBroadphase()->getBroadphaseAabb(s.world_min, s.world_max);
+
+		// 剛体の位置・姿勢とソフトボディの頂点
+		const int n = g_dynamicsworld->getNumCollisionObjects();
+		for(int i = 0; i < n; ++i){
+			btCollisionObject* obj = g_dynamicsworld->getCollisionObjectArray()[i];
+			const btCollisionShape* shape = obj->getCollisionShape();
+
+			if(shape->getShapeType() == SOFTBODY_SHAPE_PROXYTYPE){
+				btSoftBody* body = btSoftBody::upcast(obj);
+				rxSoftSnapshot soft;
+				soft.start = (int)s.sv_vrts.size();
+				soft.num = body->m_nodes.size();
+				soft.lines = (body->m_faces.size() == 0);
+
+				// 頂点はノードごとに1回だけ書き出し，三角形はインデックスで表す
+				for(int j = 0; j < soft.num; ++j){
+					s.sv_vrts.push_back(body->m_nodes[j].m_x);
+					s.sv_nrms.push_back(body->m_nodes[j].m_n);
+				}
+				soft.istart = (int)s.sv_idxs.size();
+				if(!soft.lines){
+					const btSoftBody::Node* node0 = &body->m_nodes[0];
+					for(int j = 0; j < body->m_faces.size(); ++j){
+						const btSoftBody::Face &face = body->m_faces[j];
+						for(int k = 0; k < 3; ++k){
+							s.sv_idxs.push_back((unsigned int)(soft.start+(face.m_n[k]-node0)));
+						}
+					}
+				}
+				soft.inum = (int)s.sv_idxs.size()-soft.istart;
+				s.softs.push_back(soft);
+			}
+			else{
+				rxBodySnapshot b;
+				b.shape = shape;
+
+				btRigidBody* body = btRigidBody::upcast(obj);
+				if(body && body->getMotionState()){
+					btDefaultMotionState* ms = (btDefaultMotionState*)body->getMotionState();
+					ms->m_graphicsWorldTrans.getOpenGLMatrix(b.m);
+				}
+				else{
+					obj->getWorldTransform().getOpenGLMatrix(b.m);
+				}
+
+				if(body && !body->isActive()){
+					b.state = RX_BODY_SLEEPING;
+				}
+				else if(body && body->getInvMass() > 1e-6){
+					b.state = RX_BODY_DYNAMIC;
+				}
+				else{
+					b.state = RX_BODY_STATIC;
+				}
+				s.bodies.push_back(b);
+			}
+		}
+
+		// 衝突点
+		int num_manifolds = g_dynamicsworld->getDispatcher()->getNumManifolds();
+		for(int i = 0; i < num_manifolds; ++i){
+			btPersistentManifold* manifold = g_dynamicsworld->getDispatcher()->getManifoldByIndexInternal(i);
+			int num_contacts = manifold->getNumContacts();
+			for(int j = 0; j < num_contacts; ++j){
+				btManifoldPoint& pt = manifold->getContactPoint(j);
+				if(pt.getDistance() <= 0.0f){
+					s.contacts.push_back(pt.getPositionWorldOnB());
+				}
+			}
+		}
+	}
+
+	m_snapshots.Publish();
+}
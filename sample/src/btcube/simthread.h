@@ -0,0 +1,175 @@
+/*!
+  @file simthread.h
+
+  @brief 物理シミュレーションを別スレッドで実行するための管理クラス
+		 - シミュレーションスレッドはワールドを進めて描画用のスナップショット(位置・姿勢,状態,衝突点)を公開する
+		 - 描画(メイン)スレッドはスナップショットだけを参照し，ワールドには直接触らない
+		 - ワールドへの操作(マウスピック，車の操作，オブジェクト追加など)はコマンドとして登録し，ステップの間で実行する
+
+  @author Makoto Fujisawa
+  @date   2026-10
+*/
+
+#ifndef _SIMTHREAD_H_
+#define _SIMTHREAD_H_
+
+
+//-----------------------------------------------------------------------------
+// インクルードファイル
+//-----------------------------------------------------------------------------
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+
+#include "scene.h"
+
+// 固定時間ステップ管理
+#include "rx_fixedstep.h"
+
+
+//-----------------------------------------------------------------------------
+// 描画用スナップショット
+//-----------------------------------------------------------------------------
+//! 剛体1つ分の描画情報
+struct rxBodySnapshot
+{
+	const btCollisionShape* shape;	//!< 衝突形状(形状データ自体はステップ計算で変化しないので共有する)
+	btScalar m[16];					//!< 位置・姿勢(OpenGLの変換行列)
+	int state;						//!< 状態(RX_BODY_*)
+};
+
+//! 剛体の状態(描画色の選択に使う)
+enum
+{
+	RX_BODY_DYNAMIC = 0,	//!< 動いている剛体
+	RX_BODY_SLEEPING,		//!< スリープ中の剛体
+	RX_BODY_STATIC,			//!< 静的(Kinematic)な剛体
+};
+
+//! ソフトボディ1つ分の描画情報(sv_vrts,sv_nrms,sv_idxsへの範囲)
+struct rxSoftSnapshot
+{
+	int start, num;		//!< 頂点(ノード)の開始位置と数
+	int istart, inum;	//!< 三角形の頂点インデックスの開始位置と数
+	bool lines;			//!< 面がない場合はline strip(ロープなど)
+};
+
+//! ワールド全体のスナップショット
+struct rxWorldSnapshot
+{
+	std::vector<rxBodySnapshot> bodies;		//!< 剛体
+	std::vector<rxSoftSnapshot> softs;		//!< ソフトボディ
+	std::vector<btVector3> sv_vrts, sv_nrms;	//!< ソフトボディの頂点座標と法線(ノードごと)
+	std::vector<unsigned int> sv_idxs;		//!< ソフトボディの三角形の頂点インデックス(sv_vrtsの先頭から)
+	std::vector<btVector3> contacts;		//!< 衝突点(オブジェクトB側)
+
+	btVector3 world_min, world_max;			//!< ブロードフェーズのAABB(三角形メッシュ描画用)
+
+	int step;			//!< 現在のステップ数
+	int last_steps;		//!< 直前のフレームで進めたステップ数
+	double debt;		//!< まだ計算していない時間
+	double dropped;		//!< 追いつけずに切り捨てた時間
+
+	rxWorldSnapshot() : world_min(0, 0, 0), world_max(0, 0, 0), step(0), last_steps(0), debt(0.0), dropped(0.0) {}
+};
+
+
+//-----------------------------------------------------------------------------
+// トリプルバッファ(ロックなしのスナップショット受け渡し)
+//  - 書き込み側(シミュレーション)はBack()に書いてPublish()
+//  - 読み込み側(描画)はFront()で最新の公開済みバッファを得る
+//  - 書き込み中のバッファと読み込み中のバッファが重ならないように中間バッファを1つ挟む
+//-----------------------------------------------------------------------------
+template<class T>
+class rxTripleBuffer
+{
+	T m_buf[3];
+	int m_back;				//!< 書き込み側が使うバッファ
+	int m_front;			//!< 読み込み側が使うバッファ
+	std::atomic<int> m_mid;	//!< 中間バッファ(下位2bit:インデックス, 4:新しいデータあり)
+
+public:
+	rxTripleBuffer() : m_back(0), m_front(1), m_mid(2) {}
+
+	//! 書き込み側 : 次に書き込むバッファ
+	T& Back(void){ return m_buf[m_back]; }
+
+	//! 書き込み側 : 書き込んだバッファを公開
+	void Publish(void){ m_back = m_mid.exchange(m_back | 4) & 3; }
+
+	//! 読み込み側 : 最新の公開済みバッファ(次にFrontを呼ぶまで有効)
+	const T& Front(void)
+	{
+		if(m_mid.load() & 4){
+			m_front = m_mid.exchange(m_front) & 3;
+		}
+		return m_buf[m_front];
+	}
+};
+
+
+//-----------------------------------------------------------------------------
+// シミュレーション実行管理クラス
+//-----------------------------------------------------------------------------
+class rxSimThread
+{
+public:
+	typedef std::function<void (void)> Command;
+
+protected:
+	std::thread m_thread;				//!< シミュレーションスレッド
+	std::atomic<bool> m_running;		//!< スレッド実行中フラグ
+
+	std::atomic<bool> m_animation;		//!< アニメーションON/OFF
+	std::atomic<float> m_dt;			//!< 時間ステップ幅
+
+	std::mutex m_mutex;					//!< コマンドキュー用
+	std::condition_variable m_cond;		//!< 停止中のシミュレーションスレッドをコマンドで起こす
+	std::vector<Command> m_commands;	//!< 次のステップの前に実行するコマンド
+	std::vector<Command> m_executing;	//!< 実行中のコマンド(キューと入れ替えて使う)
+
+	rxFixedStep m_stepper;				//!< 固定時間ステップ管理(シミュレーション側からのみ触る)
+	int m_step;							//!< 現在のステップ数
+	double m_interp;					//!< 最後に公開したスナップショットの補間時間
+
+	rxTripleBuffer<rxWorldSnapshot> m_snapshots;	//!< 描画用スナップショット
+
+public:
+	rxSimThread();
+	~rxSimThread();
+
+	// スレッドの開始/停止(停止中はメインスレッドからTickを呼ぶ)
+	void Start(void);
+	void Stop(void);
+	bool IsRunning(void) const { return m_running; }
+
+	// ワールドへの操作(どちらのスレッドで実行されるかに関わらずステップの間で実行される)
+	void Push(const Command &cmd);
+	void StepOnce(void);
+	void SetMaxSubsteps(int n);
+
+	// 設定
+	void SetAnimation(bool on);
+	void SetDt(float dt){ m_dt = dt; }
+
+	// シミュレーションを進めてスナップショットを公開(スレッド停止中にメインスレッドから呼ぶ)
+	void Tick(double elapsed);
+
+	// ワールドを作り直した後に呼ぶ(スレッド停止中に)
+	void Reset(void);
+
+	// 描画側 : 最新のスナップショット
+	const rxWorldSnapshot& Snapshot(void){ return m_snapshots.Front(); }
+
+protected:
+	void run(void);
+	bool execCommands(void);
+	void step(void);
+	void publish(void);
+};
+
+
+#endif // #ifndef _SIMTHREAD_H_
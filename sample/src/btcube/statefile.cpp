@@ -0,0 +1,340 @@
+/*!
+  @file statefile.cpp
+
+  @brief 剛体の状態の記録と読み込み
+
+		 ファイルの構成
+		 ----------------------------------------------------------------------
+		 rxStateHeader
+		 rxStateChunk(RX_STATE_KEY, step 0, n)    rxStateBody x n
+		 rxStateChunk(RX_STATE_DELTA, step 1, m)  rxStateBody x m  (変化した剛体のみ)
+		 ...
+		 rxStateChunk(RX_STATE_KEY, step k, n)    rxStateBody x n  (key_interval ステップごと)
+		 ...
+		 ----------------------------------------------------------------------
+		 - スリープ中の剛体や静的なオブジェクトは状態が変わらないので差分チャンクには入らない
+		 - 書き出し中に終了した場合も読み込みは最後の完全なチャンクまで使える
+
+  @author Makoto Fujisawa
+  @date   2026-10
+*/
+
+//-----------------------------------------------------------------------------
+// Include Files
+//-----------------------------------------------------------------------------
+#include <cstring>
+
+#include "statefile.h"
+
+using namespace std;
+
+
+//-----------------------------------------------------------------------------
+// 剛体の状態の取得と設定
+//-----------------------------------------------------------------------------
+/*!
+* 衝突オブジェクトの状態を取得
+* @param[in] obj 衝突オブジェクト
+* @param[out] b 状態
+*/
+void GetBodyState(const btCollisionObject* obj, rxStateBody &b)
+{
+	memset(&b, 0, sizeof(b));	// 比較はmemcmpで行うので未使用の部分も0にしておく
+	b.index = obj->getWorldArrayIndex();
+	b.activation = obj->getActivationState();
+	b.sleep_time = obj->getDeactivationTime();
+
+	const btTransform &t = obj->getWorldTransform();
+	for(int k = 0; k < 3; ++k){
+		b.pos[k] = t.getOrigin()[k];
+		for(int l = 0; l < 3; ++l) b.basis[3*k+l] = t.getBasis()[k][l];
+	}
+
+	const btRigidBody* body = btRigidBody::upcast(obj);
+	if(body){
+		for(int k = 0; k < 3; ++k){
+			b.vel[k] = body->getLinearVelocity()[k];
+			b.angvel[k] = body->getAngularVelocity()[k];
+		}
+	}
+}
+
+/*!
+* 衝突オブジェクトに状態を設定
+*  - 1ステップ前の位置・速度(補間用)も同じ値にする
+* @param[out] obj 衝突オブジェクト
+* @param[in] b 状態
+*/
+static void setstate(btCollisionObject* obj, const rxStateBody &b)
+{
+	btTransform t;
+	t.getBasis().setValue(b.basis[0], b.basis[1], b.basis[2], b.basis[3], b.basis[4], b.basis[5], b.basis[6], b.basis[7], b.basis[8]);
+	t.setOrigin(btVector3(b.pos[0], b.pos[1], b.pos[2]));
+	btVector3 v(b.vel[0], b.vel[1], b.vel[2]), w(b.angvel[0], b.angvel[1], b.angvel[2]);
+
+	obj->setWorldTransform(t);
+	obj->setInterpolationWorldTransform(t);
+	obj->setInterpolationLinearVelocity(v);
+	obj->setInterpolationAngularVelocity(w);
+	obj->forceActivationState(b.activation);
+	obj->setDeactivationTime(b.sleep_time);
+
+	btRigidBody* body = btRigidBody::upcast(obj);
+	if(body){
+		body->setLinearVelocity(v);
+		body->setAngularVelocity(w);
+		body->updateInertiaTensor();
+		if(body->getMotionState()) body->getMotionState()->setWorldTransform(t);
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// rxStateWriterクラスの実装
+//-----------------------------------------------------------------------------
+/*!
+* 書き出し用にファイルを開いてヘッダを書く
+* @param[in] fn ファイル名
+* @param[in] world 記録するワールド(剛体の数をヘッダに書く)
+* @param[in] dt 時間ステップ幅(ヘッダに書くだけ)
+* @param[in] key_interval キーフレームのステップ間隔
+* @return 開けたらtrue
+*/
+bool rxStateWriter::Open(const string &fn, btDynamicsWorld* world, float dt, int key_interval)
+{
+	Close();
+	if(!world) return false;
+
+	if((m_fp = fopen(fn.c_str(), "wb")) == NULL){
+		cout << "[rxStateWriter] cannot open " << fn << endl;
+		return false;
+	}
+
+	memset(&m_Header, 0, sizeof(m_Header));
+	memcpy(m_Header.magic, RX_STATE_MAGIC, sizeof(RX_STATE_MAGIC));
+	m_Header.version = RX_STATE_VERSION;
+	m_Header.nbodies = world->getNumCollisionObjects();
+	m_Header.dt = dt;
+	m_Header.key_interval = (key_interval > 0 ? key_interval : 1);
+	if(fwrite(&m_Header, sizeof(rxStateHeader), 1, m_fp) != 1){
+		cout << "[rxStateWriter] cannot write to " << fn << endl;
+		fclose(m_fp);
+		m_fp = 0;
+		return false;
+	}
+
+	m_vLast.resize(m_Header.nbodies);
+	m_vChunk.reserve(m_Header.nbodies);
+	m_iLastKey = 0;
+	m_bError = false;
+	m_iChunks = 0;
+	m_iRecords = 0;
+	m_iBytes = sizeof(rxStateHeader);
+	return true;
+}
+
+/*!
+* ファイルを閉じる
+*  - 書き込みの失敗はバッファに残ったデータのフラッシュ(fflush,fclose)でも起こるのでここでも確認する
+* @return それまでの書き込みがすべて成功していればtrue(開いていなければtrue)
+*/
+bool rxStateWriter::Close(void)
+{
+	if(m_fp){
+		if(fflush(m_fp) != 0) m_bError = true;
+		if(fclose(m_fp) != 0) m_bError = true;
+		m_fp = 0;
+	}
+	m_vLast.clear();
+	m_vChunk.clear();
+	return !m_bError;
+}
+
+/*!
+* 現在のワールドの状態をチャンクとして追記
+*  - 最初とkey_intervalステップごとはキーフレーム，それ以外は前回書き出した値から変化した剛体のみ
+*  - 変化した剛体がなくてもステップの区切りとして空のチャンクを書く
+* @param[in] world ワールド
+* @param[in] step ステップ数
+* @return 書き出せたらtrue(剛体の数がOpen時と異なる場合や書き込みに失敗した場合はfalse．一度失敗したら以降もfalse)
+*/
+bool rxStateWriter::Write(btDynamicsWorld* world, int step)
+{
+	if(!m_fp || !world || m_bError) return false;
+
+	const int n = world->getNumCollisionObjects();
+	if(n != m_Header.nbodies) return false;
+
+	bool key = (m_iChunks == 0 || step-m_iLastKey >= m_Header.key_interval);
+	const btCollisionObjectArray &objs = world->getCollisionObjectArray();
+	m_vChunk.clear();
+	for(int i = 0; i < n; ++i){
+		rxStateBody b;
+		GetBodyState(objs[i], b);
+		if(key || memcmp(&b, &m_vLast[i], sizeof(rxStateBody))){
+			m_vChunk.push_back(b);
+			m_vLast[i] = b;
+		}
+	}
+
+	rxStateChunk c;
+	c.type = (key ? RX_STATE_KEY : RX_STATE_DELTA);
+	c.step = step;
+	c.count = (int)m_vChunk.size();
+	bool ok = (fwrite(&c, sizeof(rxStateChunk), 1, m_fp) == 1);
+	if(ok && c.count) ok = (fwrite(&m_vChunk[0], sizeof(rxStateBody), c.count, m_fp) == (size_t)c.count);
+
+	// キーフレームごとにフラッシュして，記録中や異常終了後でもそこまでは読めるようにする
+	if(ok && key){
+		ok = (fflush(m_fp) == 0);
+		m_iLastKey = step;
+	}
+
+	// 途中まで書いたチャンクの後ろには書き足さない(読み込み側はそのチャンクの手前までを使う)
+	if(!ok){
+		cout << "[rxStateWriter] cannot write the state of step " << step << endl;
+		m_bError = true;
+		return false;
+	}
+
+	m_iChunks++;
+	m_iRecords += c.count;
+	m_iBytes += sizeof(rxStateChunk)+c.count*sizeof(rxStateBody);
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// rxStateFileクラスの実装
+//-----------------------------------------------------------------------------
+/*!
+* ファイルをメモリマップしてチャンクの索引を作る
+*  - 剛体の状態は読まずにチャンクのヘッダだけをたどる
+* @param[in] fn ファイル名
+* @return 読み込めたらtrue
+*/
+bool rxStateFile::Open(const string &fn)
+{
+	Close();
+
+	if(!m_Map.Open(fn)){
+		cout << "[rxStateFile] cannot open " << fn << endl;
+		return false;
+	}
+
+	const char* data = m_Map.Data();
+	const size_t size = m_Map.Size();
+	const rxStateHeader* h = (const rxStateHeader*)data;
+	if(size < sizeof(rxStateHeader) || memcmp(h->magic, RX_STATE_MAGIC, sizeof(RX_STATE_MAGIC)) || h->version != RX_STATE_VERSION || h->nbodies < 0){
+		cout << "[rxStateFile] " << fn << " is not a supported state file" << endl;
+		Close();
+		return false;
+	}
+
+	size_t offset = sizeof(rxStateHeader);
+	while(offset+sizeof(rxStateChunk) <= size){
+		const rxStateChunk* c = (const rxStateChunk*)(data+offset);
+		size_t bytes = sizeof(rxStateChunk)+(size_t)c->count*sizeof(rxStateBody);
+		if(c->count < 0 || c->count > h->nbodies || offset+bytes > size) break;
+		if(!m_vChunks.empty() && c->step < m_vChunks.back()->step) break;
+
+		if(c->type == RX_STATE_KEY) m_vKeys.push_back((int)m_vChunks.size());
+		m_vChunks.push_back(c);
+		offset += bytes;
+	}
+	if(offset != size){
+		cout << "[rxStateFile] " << fn << " is truncated, using the first " << m_vChunks.size() << " chunks" << endl;
+	}
+
+	m_pHeader = h;
+	return true;
+}
+
+/*!
+* メモリマップの解除
+*/
+void rxStateFile::Close(void)
+{
+	m_Map.Close();
+	m_vChunks.clear();
+	m_vKeys.clear();
+	m_pHeader = 0;
+}
+
+/*!
+* 記録された状態をワールドの剛体に設定
+*  - step以前の最後のキーフレームから，step以前のチャンクを順に適用する
+*  - 接触点などの状態は記録していないので，続けて計算すると記録時とは少し異なる結果になる
+* @param[in] world ワールド(記録したときと同じ剛体が同じ順番で入っていること)
+* @param[in] step ステップ数
+* @return 設定した状態のステップ数(該当するキーフレームがない，剛体の数が異なるなどの場合は-1)
+*/
+int rxStateFile::Apply(btDynamicsWorld* world, int step) const
+{
+	if(!m_pHeader || !world || world->getNumCollisionObjects() != m_pHeader->nbodies) return -1;
+
+	// step以前の最後のキーフレーム
+	int k = (int)m_vKeys.size()-1;
+	while(k >= 0 && m_vChunks[m_vKeys[k]]->step > step) k--;
+	if(k < 0) return -1;
+
+	btCollisionObjectArray &objs = world->getCollisionObjectArray();
+	const int n = world->getNumCollisionObjects();
+	int last = -1;
+	for(int i = m_vKeys[k]; i < (int)m_vChunks.size() && m_vChunks[i]->step <= step; ++i){
+		const rxStateChunk* c = m_vChunks[i];
+		const rxStateBody* b = (const rxStateBody*)(c+1);
+		for(int j = 0; j < c->count; ++j){
+			if(b[j].index >= 0 && b[j].index < n) setstate(objs[b[j].index], b[j]);
+		}
+		last = c->step;
+	}
+
+	// スリープ中のオブジェクトのAABBも更新しておく
+	world->updateAabbs();
+	return last;
+}
+
+/*!
+* 記録された状態を剛体の番号順の配列に設定(ワールドを作らずに記録どうしや計算結果と比べる用)
+*  - bodiesにlastステップの状態が入っていれば，その後のチャンクだけを適用する(ステップ順に読み進める場合)
+*  - そうでなければstep以前の最後のキーフレームから適用する
+* @param[in] step ステップ数
+* @param[inout] bodies 剛体の状態(index番目が剛体index)
+* @param[in] last bodiesに入っている状態のステップ数(-1でなし)
+* @return 設定した状態のステップ数(該当するキーフレームがなければ-1)
+*/
+int rxStateFile::Get(int step, vector<rxStateBody> &bodies, int last) const
+{
+	if(!m_pHeader) return -1;
+	const int n = m_pHeader->nbodies;
+
+	// 適用を始めるチャンク
+	int start = -1;
+	if(last >= 0 && last <= step && (int)bodies.size() == n){
+		int lo = 0, hi = (int)m_vChunks.size();
+		while(lo < hi){
+			int mid = (lo+hi)/2;
+			if(m_vChunks[mid]->step <= last) lo = mid+1; else hi = mid;
+		}
+		start = lo;
+	}
+	else{
+		int k = (int)m_vKeys.size()-1;
+		while(k >= 0 && m_vChunks[m_vKeys[k]]->step > step) k--;
+		if(k < 0) return -1;
+		start = m_vKeys[k];
+		last = -1;
+		bodies.assign(n, rxStateBody());
+	}
+
+	for(int i = start; i < (int)m_vChunks.size() && m_vChunks[i]->step <= step; ++i){
+		const rxStateChunk* c = m_vChunks[i];
+		const rxStateBody* b = (const rxStateBody*)(c+1);
+		for(int j = 0; j < c->count; ++j){
+			if(b[j].index >= 0 && b[j].index < n) bodies[b[j].index] = b[j];
+		}
+		last = c->step;
+	}
+	return last;
+}
@@ -0,0 +1,155 @@
+/*!
+  @file statefile.h
+
+  @brief 剛体の状態(位置・姿勢・速度)の記録と読み込み(リプレイ，チェックポイント用)
+		 - 書き出し : ステップごとに前回から変化した剛体の状態だけを差分チャンクとしてファイルに追記する
+					  一定ステップごとに全剛体の状態(キーフレーム)を書くので途中から読み出せる
+		 - 読み込み : ファイルをメモリマップし，チャンクの先頭だけをたどって索引を作る．剛体の状態はパースなしで直接参照する
+		 - 剛体そのもの(形状や質量)はシーン(scenefile.h)から作り，状態だけをこのファイルから設定する
+		 - OpenGL/GLFWに依存しないのでヘッドレス版からも使う
+
+  @author Makoto Fujisawa
+  @date   2026-10
+*/
+
+#ifndef _STATEFILE_H_
+#define _STATEFILE_H_
+
+
+//-----------------------------------------------------------------------------
+// インクルードファイル
+//-----------------------------------------------------------------------------
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "scene.h"
+#include "scenefile.h"
+
+
+//-----------------------------------------------------------------------------
+// 定義
+//-----------------------------------------------------------------------------
+//! ファイル識別子とバージョン
+#define RX_STATE_MAGIC "RXSTATE"
+#define RX_STATE_VERSION 1
+
+// チャンクの種類
+enum
+{
+	RX_STATE_KEY = 0,		//!< キーフレーム(全剛体の状態)
+	RX_STATE_DELTA,			//!< 差分(前のチャンクから変化した剛体の状態のみ)
+};
+
+// ファイルのレコード
+//  - シーンファイルのバイナリ形式と同じく4バイトのメンバだけで構成し，詰め物なしでそのまま書き込む(リトルエンディアン)
+//  - ファイルはヘッダの後にチャンク(チャンクのヘッダ+剛体の状態の配列)を並べる
+
+//! ヘッダ
+struct rxStateHeader
+{
+	char magic[8];			//!< RX_STATE_MAGIC
+	int version;			//!< RX_STATE_VERSION
+	int nbodies;			//!< ワールドの衝突オブジェクトの数(読み込み時にワールドと一致するか確認する)
+	float dt;				//!< 時間ステップ幅
+	int key_interval;		//!< キーフレームのステップ間隔
+};
+
+//! チャンクのヘッダ
+struct rxStateChunk
+{
+	int type;				//!< チャンクの種類(RX_STATE_*)
+	int step;				//!< ステップ数
+	int count;				//!< 剛体の状態の数
+};
+
+//! 剛体の状態
+//  - 姿勢は四元数ではなく回転行列で持つ(btScalarがfloatならワールドの値とビット単位で一致する)
+struct rxStateBody
+{
+	int index;				//!< btCollisionObject::getWorldArrayIndex
+	int activation;			//!< btCollisionObject::getActivationState
+	float pos[3];			//!< 位置
+	float basis[9];			//!< 回転行列(行ごと)
+	float vel[3];			//!< 速度
+	float angvel[3];		//!< 角速度
+	float sleep_time;		//!< btCollisionObject::getDeactivationTime
+};
+
+
+// 衝突オブジェクトの状態の取得
+void GetBodyState(const btCollisionObject* obj, rxStateBody &b);
+
+
+//-----------------------------------------------------------------------------
+// 状態の書き出し
+//-----------------------------------------------------------------------------
+class rxStateWriter
+{
+	FILE *m_fp;
+	rxStateHeader m_Header;
+	std::vector<rxStateBody> m_vLast;		//!< 最後に書き出した各剛体の状態
+	std::vector<rxStateBody> m_vChunk;		//!< 書き出すチャンクの状態(使い回す)
+	int m_iLastKey;							//!< 最後にキーフレームを書いたステップ
+	bool m_bError;							//!< 書き込みに失敗した(ディスクがいっぱいなど)
+
+	// 統計
+	int m_iChunks;
+	long long m_iRecords;
+	long long m_iBytes;
+
+public:
+	rxStateWriter() : m_fp(0), m_iLastKey(0), m_bError(false), m_iChunks(0), m_iRecords(0), m_iBytes(0){}
+	~rxStateWriter(){ Close(); }
+
+	bool Open(const std::string &fn, btDynamicsWorld* world, float dt, int key_interval = 100);
+	// ファイルを閉じる(それまでの書き込みがすべて成功していればtrue)
+	bool Close(void);
+
+	// 現在のワールドの状態を追記(剛体の数が変わっていた場合や書き込みに失敗した場合はfalse)
+	bool Write(btDynamicsWorld* world, int step);
+
+	bool IsOpen(void) const { return m_fp != 0; }
+	bool Failed(void) const { return m_bError; }
+	int NumChunks(void) const { return m_iChunks; }
+	long long NumRecords(void) const { return m_iRecords; }
+	long long NumBytes(void) const { return m_iBytes; }
+
+private:
+	rxStateWriter(const rxStateWriter&);
+	rxStateWriter& operator=(const rxStateWriter&);
+};
+
+
+//-----------------------------------------------------------------------------
+// 状態の読み込み
+//-----------------------------------------------------------------------------
+class rxStateFile
+{
+	rxMappedFile m_Map;
+	const rxStateHeader *m_pHeader;
+	std::vector<const rxStateChunk*> m_vChunks;		//!< チャンクの先頭(ステップ順)
+	std::vector<int> m_vKeys;						//!< キーフレームのチャンクの番号
+
+public:
+	rxStateFile() : m_pHeader(0){}
+	~rxStateFile(){ Close(); }
+
+	bool Open(const std::string &fn);
+	void Close(void);
+
+	// 指定ステップ以前で最後に記録された状態をワールドの剛体に設定(直前のキーフレームから差分を順に適用)
+	int Apply(btDynamicsWorld* world, int step) const;
+
+	// 指定ステップ以前で最後に記録された状態を剛体の番号順の配列に設定(lastステップの状態からの差分だけを適用できる)
+	int Get(int step, std::vector<rxStateBody> &bodies, int last = -1) const;
+
+	bool IsOpen(void) const { return m_pHeader != 0; }
+	const rxStateHeader& Header(void) const { return *m_pHeader; }
+	int NumChunks(void) const { return (int)m_vChunks.size(); }
+	int FirstStep(void) const { return m_vChunks.empty() ? -1 : m_vChunks.front()->step; }
+	int LastStep(void) const { return m_vChunks.empty() ? -1 : m_vChunks.back()->step; }
+};
+
+
+#endif // #ifndef _STATEFILE_H_
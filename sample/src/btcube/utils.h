@@ -60,6 +60,9 @@
 // 設定ファイル
 #include "rx_atom_ini.h"
 
+// 固定時間ステップ管理
+#include "rx_fixedstep.h"
+
 // トラックボール＆テクスチャ
 #include "rx_trackball.h"
 #include "rx_texture.h"
@@ -2036,12 +2039,120 @@ public:
 };
 
 
+/*!
+ * Bulletの三角形メッシュから描画用の頂点・法線を取り出すコールバック関数定義用のクラス
+ */
+class TriangleCollectCallback : public btTriangleCallback
+{
+public:
+	vector<GLfloat> vrts;	//!< 頂点座標と面法線(x,y,z,nx,ny,nz)の並び
+
+	TriangleCollectCallback(){}
+	virtual void processTriangle(btVector3* triangle, int partId, int triangleIndex)
+	{
+		btVector3 n = (triangle[0]-triangle[1]).cross(triangle[0]-triangle[2]);
+		if(n.length2() > SIMD_EPSILON) n.normalize();
+		for(int i = 0; i < 3; ++i){
+			vrts.push_back(triangle[i][0]); vrts.push_back(triangle[i][1]); vrts.push_back(triangle[i][2]);
+			vrts.push_back(n[0]); vrts.push_back(n[1]); vrts.push_back(n[2]);
+		}
+	}
+};
+
+//! 三角形メッシュ形状ごとの描画用VBO
+struct MeshCacheVBO
+{
+	GLuint vbo;			//!< 頂点座標と法線(インターリーブ)
+	int nvrts;			//!< 頂点数(=三角形数*3)
+	btVector3 scaling;	//!< 作成時の形状のスケーリング(変わったら作り直す)
+};
+
+/*!
+ * 三角形メッシュ形状をキーとしたVBOのキャッシュ
+ */
+static inline std::map<const btCollisionShape*, MeshCacheVBO>& GetMeshCache(void)
+{
+	static std::map<const btCollisionShape*, MeshCacheVBO> cache;
+	return cache;
+}
+
+/*!
+ * 三角形メッシュのVBOキャッシュの破棄
+ *  - 破棄された形状のアドレスが新しい形状で再利用されることがあるのでワールドを作り直すときに呼ぶこと
+ */
+static inline void ClearMeshCache(void)
+{
+	std::map<const btCollisionShape*, MeshCacheVBO> &cache = GetMeshCache();
+	std::map<const btCollisionShape*, MeshCacheVBO>::iterator i = cache.begin();
+	for(; i != cache.end(); ++i){
+		if(i->second.vbo) glDeleteBuffers(1, &i->second.vbo);
+	}
+	cache.clear();
+}
+
+/*!
+ * Bulletの三角形メッシュ(btBvhTriangleMeshShape,btGImpactMeshShape)をVBOで描画
+ *  - 最初の描画時に全三角形を1つのVBOにまとめ，以降のフレームやシャドウマップのパスでは再利用する
+ *  - 三角形は形状のローカル座標なので剛体が動いても作り直す必要はない
+ * @param[in] mesh 三角形メッシュ形状
+ */
+static inline void DrawMeshCacheVBO(const btConcaveShape* mesh)
+{
+	std::map<const btCollisionShape*, MeshCacheVBO> &cache = GetMeshCache();
+	std::map<const btCollisionShape*, MeshCacheVBO>::iterator i = cache.find(mesh);
+	if(i != cache.end() && i->second.scaling != mesh->getLocalScaling()){
+		if(i->second.vbo) glDeleteBuffers(1, &i->second.vbo);
+		cache.erase(i);
+		i = cache.end();
+	}
+
+	if(i == cache.end()){
+		// 形状のAABB全体にある三角形を取り出してVBOを作成
+		btTransform identity;
+		identity.setIdentity();
+		btVector3 aabb_min, aabb_max;
+		mesh->getAabb(identity, aabb_min, aabb_max);
+
+		TriangleCollectCallback collect;
+		mesh->processAllTriangles(&collect, aabb_min, aabb_max);
+
+		MeshCacheVBO m;
+		m.vbo = 0;
+		m.nvrts = (int)collect.vrts.size()/6;
+		m.scaling = mesh->getLocalScaling();
+		if(m.nvrts){
+			glGenBuffers(1, &m.vbo);
+			glBindBuffer(GL_ARRAY_BUFFER, m.vbo);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*collect.vrts.size(), &collect.vrts[0], GL_STATIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		i = cache.insert(std::make_pair((const btCollisionShape*)mesh, m)).first;
+	}
+
+	const MeshCacheVBO &m = i->second;
+	if(!m.nvrts) return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, m.vbo);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 6*sizeof(GLfloat), 0);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glNormalPointer(GL_FLOAT, 6*sizeof(GLfloat), (void*)(3*sizeof(GLfloat)));
+
+	glDrawArrays(GL_TRIANGLES, 0, m.nvrts);
+
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
 /*!
 * Bulletの衝突形状を描画
 * @param[in] shape 衝突形状
 * @param[in] world_min,world_max Bulletワールドの大きさ(ポリゴン描画時に必要)
+* @param[in] material falseならテクスチャの設定を省く(シャドウマップのデプスパス用)
 */
-static void DrawBulletShape(const btCollisionShape *shape, btVector3 &world_min, btVector3 &world_max)
+static void DrawBulletShape(const btCollisionShape *shape, btVector3 &world_min, btVector3 &world_max, bool material = true)
 {
 	int shapetype = shape->getShapeType();
 
@@ -2049,8 +2160,10 @@ static void DrawBulletShape(const btCollisionShape *shape, btVector3 &world_min,
 	bool use_tex = false;
 
 #ifdef USE_GLSL_SHADOW
-	use_tex = true;
-	BindPlainTexture(glm::vec3(0.0));
+	if(material){
+		use_tex = true;
+		BindPlainTexture(glm::vec3(0.0));
+	}
 #endif
 
 	// 形状の種類ごとに描画
@@ -2125,14 +2238,12 @@ static void DrawBulletShape(const btCollisionShape *shape, btVector3 &world_min,
 	else if(shapetype == TRIANGLE_MESH_SHAPE_PROXYTYPE){
 		// 三角形メッシュ
 		const btBvhTriangleMeshShape* mesh = static_cast<const btBvhTriangleMeshShape*>(shape);
-		TriangleDrawCallback draw_callback;
-		mesh->processAllTriangles(&draw_callback, world_min, world_max);
+		DrawMeshCacheVBO(mesh);
 	}
 	else if(shapetype == GIMPACT_SHAPE_PROXYTYPE){
 		// 三角形メッシュ(GIMPACT)
 		const btGImpactMeshShape* mesh = static_cast<const btGImpactMeshShape*>(shape);
-		TriangleDrawCallback draw_callback;
-		mesh->processAllTriangles(&draw_callback, world_min, world_max);
+		DrawMeshCacheVBO(mesh);
 	}
 	else if(shapetype == COMPOUND_SHAPE_PROXYTYPE){
 		// 複合形状
@@ -2148,7 +2259,7 @@ static void DrawBulletShape(const btCollisionShape *shape, btVector3 &world_min,
 #else
 			glMultMatrixf(mc);
 #endif
-			DrawBulletShape(compound->getChildShape(j), world_min, world_max);
+			DrawBulletShape(compound->getChildShape(j), world_min, world_max, material);
 			glPopMatrix();
 		}
 	}
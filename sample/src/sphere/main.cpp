@@ -58,6 +58,7 @@ const int MAX_TRAJ = 1024;					//!< ボール中心座標を格納する配列
 const btVector3 RX_INIT_POS(-1, 0.5, 0);	//!< ボールの初期位置
 
 float g_dt = 0.01;							//!< 時間ステップ幅Δt
+rxFixedStep g_stepper;						//!< 実時間に合わせて固定幅g_dtのステップを何回進めるかを管理
 
 // 立方体
 btVector3 g_cubepos = RX_INIT_POS;			//!< 中心座標
@@ -219,6 +220,7 @@ void reset(void)
 	g_cubepos = RX_INIT_POS;
 	g_vel = btVector3(0, 0, 0);
 	g_currentstep = 0;
+	g_stepper.Reset();
 	switchanimation(0);
 	g_num_trajectory = 0;
 	g_cubeRotation = btVector4(0, 0, 0, 1);
@@ -442,6 +444,7 @@ void SetImGUI(GLFWwindow* window)
 	ImGui::InputFloat("force", &(g_frc[0]), 0.1f, 1.0f, "%.1f");
 #endif
 	ImGui::InputFloat("dt", &(g_dt), 0.001f, 0.01f, "%.3f");
+	ImGui::Text("steps/frame: %d, debt: %.1f ms", g_stepper.GetLastSteps(), 1000.0*g_stepper.GetDebt());
 	ImGui::Separator();
 	if(ImGui::Button("save screenshot")){ savedisplay(-1); }
 	if(ImGui::Button("quit")){ glfwSetWindowShouldClose(window, GL_TRUE); }
@@ -498,7 +501,7 @@ int main(int argc, char *argv[])
 	ImGui_ImplOpenGL2_Init();
 
 	// Settings for timer to display FPS on ImGUI window
-	float cur_time = 0.0f, last_time = 0.0f, elapsed_time = 0.0f;
+	double cur_time = 0.0, last_time = 0.0, elapsed_time = 0.0;
 	glfwSetTime(0.0);	// Initialize the glfw timer
 
 	// Main loop
@@ -511,11 +514,13 @@ int main(int argc, char *argv[])
 		Display();
 
 		// Timer
+		//  - 経過した実時間分だけ固定幅g_dtのステップを進める(1フレームあたりの上限あり)
 		cur_time = glfwGetTime();
 		elapsed_time = cur_time-last_time;
-		if(elapsed_time >= g_dt){
+		last_time = cur_time;
+		int nsteps = g_stepper.Update(g_animation_on ? elapsed_time : 0.0, g_dt);
+		for(int i = 0; i < nsteps; ++i){
 			Timer();
-			last_time = glfwGetTime();
 		}
 
 		// Start the ImGui frame
@@ -60,6 +60,9 @@
 // 設定ファイル
 #include "rx_atom_ini.h"
 
+// 固定時間ステップ管理
+#include "rx_fixedstep.h"
+
 // トラックボール＆テクスチャ
 #include "rx_trackball.h"
 #include "rx_texture.h"